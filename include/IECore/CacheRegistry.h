@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef IECORE_CACHEREGISTRY_H
+#define IECORE_CACHEREGISTRY_H
+
+#include <string>
+#include <vector>
+
+#include "boost/function.hpp"
+#include "boost/noncopyable.hpp"
+#include "tbb/atomic.h"
+
+#include "IECore/Export.h"
+
+namespace IECore
+{
+
+/// \addtogroup environmentGroup
+///
+/// <b>IECORE_CACHE_MEMORY</b><br>
+/// Used to specify the initial memory budget, in megabytes, shared by all
+/// the caches registered with the CacheRegistry. See CacheRegistry::setMemoryBudget()
+/// for more information.
+
+/// The CacheRegistry keeps track of the memory held by the in-memory caches of
+/// the process (ObjectPool, IECoreGL::CachedConverter etc), so that a single
+/// budget can bound their total size. When a budget is set, it is shared among
+/// the caches according to their weights, with the portion unused by one cache
+/// being available to the others. Memory is reclaimed by lowering the limits of
+/// the caches holding more than their share, which evicts their least recently
+/// used items. The registry also gathers lookup statistics for each cache.
+/// \ingroup utilityGroup
+class IECORE_API CacheRegistry
+{
+
+	private :
+
+		struct Registry;
+
+	public :
+
+		typedef boost::function<size_t ()> MemoryUsageFunction;
+		typedef boost::function<size_t ()> GetMemoryLimitFunction;
+		typedef boost::function<void ( size_t )> SetMemoryLimitFunction;
+
+		/// Registers a cache with the registry for the lifetime of the Client.
+		/// Caches should hold their Client as a member declared after their storage,
+		/// so that it is deregistered before the storage is destroyed. Clients
+		/// constructed without memory functions contribute statistics only.
+		class IECORE_API Client : private boost::noncopyable
+		{
+
+			public :
+
+				Client( const std::string &name, MemoryUsageFunction memoryUsage, GetMemoryLimitFunction getMemoryLimit, SetMemoryLimitFunction setMemoryLimit, float weight = 1.0f );
+				/// Registers a statistics only client.
+				Client( const std::string &name );
+				~Client();
+
+				const std::string &name() const;
+
+				/// The weight determines the share of the budget guaranteed
+				/// to this cache, relative to the other caches.
+				float getWeight() const;
+				void setWeight( float weight );
+
+				/// Should be called by the cache for each lookup, and for each
+				/// lookup which failed to find the item.
+				void recordLookup();
+				void recordMiss();
+
+				/// Should be called by the cache after adding items, so that memory
+				/// can be reclaimed from the other caches if the budget is exceeded.
+				/// Only this cache's usage is queried, so this is cheap to call often.
+				/// The cache must not be locked, as reclaiming memory may set its limit.
+				void memoryAdded();
+
+			private :
+
+				friend class CacheRegistry;
+				friend struct CacheRegistry::Registry;
+
+				std::string m_name;
+				MemoryUsageFunction m_memoryUsage;
+				GetMemoryLimitFunction m_getMemoryLimit;
+				SetMemoryLimitFunction m_setMemoryLimit;
+				float m_weight;
+				// The limit of the cache before the budget was applied, restored when
+				// the budget is removed.
+				size_t m_originalLimit;
+				bool m_budgeted;
+				// The usage last seen by the registry, which keeps a running total.
+				tbb::atomic<size_t> m_reportedUsage;
+				tbb::atomic<size_t> m_lookups;
+				tbb::atomic<size_t> m_misses;
+
+		};
+
+		struct Statistics
+		{
+			std::string name;
+			float weight;
+			size_t memoryUsage;
+			size_t memoryLimit;
+			size_t lookups;
+			size_t misses;
+		};
+
+		/// Sets the total number of bytes that may be held by all the caches,
+		/// evicting items as necessary. A budget of 0 means no limit, in which
+		/// case each cache returns to the limit it had before the budget was
+		/// applied. The initial budget is taken from the IECORE_CACHE_MEMORY
+		/// environment variable, and is unlimited if that is not set.
+		static void setMemoryBudget( size_t bytes );
+		static size_t getMemoryBudget();
+
+		/// Returns the number of bytes held by all the caches.
+		static size_t memoryUsage();
+
+		/// Redistributes the budget among the caches, according to their
+		/// current usage and weights. This is called automatically when the
+		/// budget is exceeded, and there should be little need to call it directly.
+		static void rebalance();
+
+		/// Fills stats with the statistics for each of the registered caches.
+		static void statistics( std::vector<Statistics> &stats );
+		/// Resets the lookup and miss counts of all the caches.
+		static void resetStatistics();
+
+	private :
+
+		static Registry &registry();
+
+};
+
+} // namespace IECore
+
+#endif // IECORE_CACHEREGISTRY_H
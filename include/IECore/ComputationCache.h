@@ -106,7 +106,7 @@ class ComputationCache : public RefCounted
 		ComputeFn m_computeFn;
 		HashFn m_hashFn;
 
-		typedef IECore::LRUCache<MurmurHash, MurmurHash> Cache;
+		typedef IECore::LRUCache<MurmurHash, MurmurHash, LRUCachePolicy::Sharded> Cache;
 		Cache m_cache;
 
 		ObjectPoolPtr m_objectPool;
@@ -74,10 +74,6 @@ class IECORE_API FaceVaryingPromotionOp : public MeshPrimitiveOp
 
 		void modifyTypedPrimitive( MeshPrimitive *mesh, const CompoundObject *operands ) override;
 
-	private :
-
-		struct Promoter;
-
 };
 
 IE_CORE_DECLAREPTR( FaceVaryingPromotionOp );
@@ -42,6 +42,13 @@ namespace IECore
 {
 
 /// An implementation of StreamIndexedIO which operates within a single file on disk.
+/// Files opened for reading are accessed using lock-free positional reads. Passing
+/// IndexedIO::MemoryMapped in the open mode additionally maps the file into memory,
+/// so that data needing conversion, decompression or parsing (such as strings, compressed
+/// blocks and subindices) is read directly from the mapping, without an intermediate buffer.
+/// The mapped pages of large blocks are released once consumed, so that mapping the file
+/// doesn't increase the resident memory. Uncompressed arrays are still read into memory
+/// owned by the resulting Data, because TypedData can't yet hold a view of the mapping.
 /// \ingroup ioGroup
 class IECORE_API FileIndexedIO : public StreamIndexedIO
 {
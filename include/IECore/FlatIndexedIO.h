@@ -0,0 +1,220 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef IE_CORE_FLATINDEXEDIO_H
+#define IE_CORE_FLATINDEXEDIO_H
+
+#include "IECore/Export.h"
+#include "IECore/IndexedIO.h"
+#include "IECore/VectorTypedData.h"
+
+namespace IECore
+{
+
+/// An implementation of IndexedIO which serialises to a flat, contiguous buffer in memory.
+/// It is intended for sending Objects between processes, and for holding them in in-memory
+/// caches, where the directory tree and compressed index maintained by MemoryIndexedIO cost
+/// far more than the data itself.
+///
+/// The buffer is a small header followed by a sequence of self contained records, one for each
+/// directory created, file written or entry removed, in the order in which the operations were
+/// performed. There is no index to rewrite, so the buffer is only ever appended to, and may be
+/// sent incrementally as it is written. When reading, the records are parsed in a single pass
+/// to rebuild the directory tree, with files referring to their data within the buffer. The
+/// data for every file begins on a 16 byte boundary, so that arrays may be used in place via
+/// dataPointer() without copying.
+///
+/// Data is stored in the native byte order and layout. Buffers may be read by processes on
+/// machines with the same byte order, and attempting to read one from a machine with a different
+/// byte order throws. The format is versioned, so that future versions may continue to read
+/// buffers written by this one. Record bounds, scalar sizes, array lengths and the lengths of
+/// strings are all validated against the buffer when reading, and an Exception is thrown if a
+/// buffer is malformed. Buffers from untrusted sources should nonetheless be treated with care,
+/// as no other validation is performed on the data itself.
+///
+/// Read operations are thread safe on buffers opened for reading. Writing is not thread safe.
+/// \ingroup ioGroup
+class IECORE_API FlatIndexedIO : public IndexedIO
+{
+	public:
+
+		IE_CORE_DECLARERUNTIMETYPED( FlatIndexedIO, IndexedIO );
+
+		/// Opens the buffer with the specified root and mode. In Write mode any existing contents are
+		/// ignored and a new buffer is started. In Append mode new records are appended to a copy of the
+		/// existing buffer. The buffer is never modified.
+		FlatIndexedIO( ConstCharVectorDataPtr buffer, const IndexedIO::EntryIDList &root, IndexedIO::OpenMode mode );
+
+		~FlatIndexedIO() override;
+
+		/// Returns the buffer representing the entire file. This shares its data with the
+		/// internal buffer, so is cheap to call. But while the result is referenced, the
+		/// next write must first copy the entire internal buffer, so when writing this
+		/// should only be called once all the writes are done.
+		CharVectorDataPtr buffer();
+
+		/// Returns a pointer to the data stored for the named file, and fills in its size in bytes.
+		/// The data remains valid for the lifetime of the buffer, and begins on a 16 byte boundary
+		/// relative to the start of the buffer. Numeric data is stored in the native layout, so
+		/// arrays may be accessed in place, while strings are stored as described by
+		/// IndexedIO::DataFlattenTraits.
+		const char *dataPointer( const IndexedIO::EntryID &name, size_t &size ) const;
+
+		/// Returns true if the buffer was written by FlatIndexedIO.
+		static bool canRead( const CharVectorData *buffer );
+
+		/// Convenience functions to encode a single Object into a new buffer, and to
+		/// decode it again.
+		static CharVectorDataPtr encode( const Object *object );
+		static ObjectPtr decode( ConstCharVectorDataPtr buffer );
+
+		IndexedIO::OpenMode openMode() const override;
+
+		void path( IndexedIO::EntryIDList &result ) const override;
+
+		bool hasEntry( const IndexedIO::EntryID &name ) const override;
+
+		const IndexedIO::EntryID &currentEntryId() const override;
+
+		void entryIds( IndexedIO::EntryIDList &names ) const override;
+
+		void entryIds( IndexedIO::EntryIDList &names, IndexedIO::EntryType type ) const override;
+
+		IndexedIOPtr subdirectory( const IndexedIO::EntryID &name, IndexedIO::MissingBehaviour missingBehaviour = IndexedIO::ThrowIfMissing ) override;
+
+		ConstIndexedIOPtr subdirectory( const IndexedIO::EntryID &name, IndexedIO::MissingBehaviour missingBehaviour = IndexedIO::ThrowIfMissing ) const override;
+
+		IndexedIO::Entry entry( const IndexedIO::EntryID &name ) const override;
+
+		IndexedIOPtr createSubdirectory( const IndexedIO::EntryID &name ) override;
+
+		void remove( const IndexedIO::EntryID &name ) override;
+
+		void removeAll() override;
+
+		void commit() override;
+
+		IndexedIOPtr parentDirectory() override;
+
+		ConstIndexedIOPtr parentDirectory() const override;
+
+		IndexedIOPtr directory( const IndexedIO::EntryIDList &path, IndexedIO::MissingBehaviour missingBehaviour = IndexedIO::ThrowIfMissing ) override;
+
+		ConstIndexedIOPtr directory( const IndexedIO::EntryIDList &path, IndexedIO::MissingBehaviour missingBehaviour = IndexedIO::ThrowIfMissing ) const override;
+
+		void write(const IndexedIO::EntryID &name, const float *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const double *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const half *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const int *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const int64_t *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const uint64_t *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const unsigned int *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const char *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const unsigned char *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const short *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const unsigned short *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const std::string *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const InternedString *x, unsigned long arrayLength) override;
+		void write(const IndexedIO::EntryID &name, const float &x) override;
+		void write(const IndexedIO::EntryID &name, const double &x) override;
+		void write(const IndexedIO::EntryID &name, const half &x) override;
+		void write(const IndexedIO::EntryID &name, const int &x) override;
+		void write(const IndexedIO::EntryID &name, const int64_t &x) override;
+		void write(const IndexedIO::EntryID &name, const uint64_t &x) override;
+		void write(const IndexedIO::EntryID &name, const std::string &x) override;
+		void write(const IndexedIO::EntryID &name, const unsigned int &x) override;
+		void write(const IndexedIO::EntryID &name, const char &x) override;
+		void write(const IndexedIO::EntryID &name, const unsigned char &x) override;
+		void write(const IndexedIO::EntryID &name, const short &x) override;
+		void write(const IndexedIO::EntryID &name, const unsigned short &x) override;
+
+		void read(const IndexedIO::EntryID &name, float *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, double *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, half *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, int *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, int64_t *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, uint64_t *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, unsigned int *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, char *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, unsigned char *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, short *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, unsigned short *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, std::string *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, InternedString *&x, unsigned long arrayLength) const override;
+		void read(const IndexedIO::EntryID &name, float &x) const override;
+		void read(const IndexedIO::EntryID &name, double &x) const override;
+		void read(const IndexedIO::EntryID &name, half &x) const override;
+		void read(const IndexedIO::EntryID &name, int &x) const override;
+		void read(const IndexedIO::EntryID &name, int64_t &x) const override;
+		void read(const IndexedIO::EntryID &name, uint64_t &x) const override;
+		void read(const IndexedIO::EntryID &name, std::string &x) const override;
+		void read(const IndexedIO::EntryID &name, unsigned int &x) const override;
+		void read(const IndexedIO::EntryID &name, char &x) const override;
+		void read(const IndexedIO::EntryID &name, unsigned char &x) const override;
+		void read(const IndexedIO::EntryID &name, short &x) const override;
+		void read(const IndexedIO::EntryID &name, unsigned short &x) const override;
+
+	private :
+
+		class Index;
+		IE_CORE_DECLAREPTR( Index );
+
+		struct Node;
+
+		FlatIndexedIO( IndexPtr index, Node *node );
+
+		template<typename T>
+		void writeArray( const IndexedIO::EntryID &name, const T *x, unsigned long arrayLength );
+
+		template<typename T>
+		void writeScalar( const IndexedIO::EntryID &name, const T &x );
+
+		template<typename T>
+		void readArray( const IndexedIO::EntryID &name, T *&x, unsigned long arrayLength ) const;
+
+		template<typename T>
+		void readScalar( const IndexedIO::EntryID &name, T &x ) const;
+
+		const Node *dataNode( const IndexedIO::EntryID &name, IndexedIO::DataType dataType ) const;
+
+		IndexPtr m_index;
+		Node *m_node;
+
+};
+
+IE_CORE_DECLAREPTR( FlatIndexedIO )
+
+} // namespace IECore
+
+#endif // IE_CORE_FLATINDEXEDIO_H
@@ -69,6 +69,11 @@ class IECORE_API IndexedIO : public RunTimeTyped
 
 			Shared    = 1L << 3,
 			Exclusive = 1L << 4,
+
+			/// Only meaningful in combination with Read. Requests that the
+			/// file is mapped into memory rather than read through a stream,
+			/// for implementations that support it (see FileIndexedIO).
+			MemoryMapped = 1L << 5,
 		} ;
 
 		typedef unsigned OpenMode;
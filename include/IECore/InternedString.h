@@ -47,10 +47,25 @@
 namespace IECore
 {
 
+namespace Detail
+{
+
+// An entry in the table of unique strings used by InternedString.
+struct IECORE_API InternedStringEntry
+{
+	InternedStringEntry( const char *value, size_t length, size_t hash );
+	const std::string value;
+	const size_t hash;
+};
+
+} // namespace Detail
+
 /// The InternedString class provides a means of efficiently storing
 /// multiple different objects with the same string value. It does this
 /// by keeping a static table with the actual values in it, with
 /// the object instances just referencing the values in the table.
+/// The table is split into independently locked shards, so that strings
+/// may be constructed concurrently from many threads with little contention.
 /// \ingroup utilityGroup
 class IECORE_API InternedString
 {
@@ -72,26 +87,41 @@ class IECORE_API InternedString
 		inline bool operator == ( const InternedString &other ) const;
 		/// Note that this compares the addresses of the internal
 		/// unique strings, rather than performing an actual string
-		/// comparison.
-		/// \todo: Several use cases would benefit from sorting by string
-		/// value here. Investigate ways of making these comparisons by
-		/// string value, while maintaining constant-time complexity.
+		/// comparison. Use ValueLess where the order must be
+		/// consistent between processes.
 		inline bool operator < ( const InternedString &other ) const;
 
+		/// Comparison functor which orders by string value, for use with
+		/// std::sort or std::map. Equal strings are detected in constant
+		/// time, so only distinct strings pay for the string comparison.
+		struct ValueLess
+		{
+			inline bool operator()( const InternedString &a, const InternedString &b ) const;
+		};
+
 		inline operator const std::string & () const;
 
 		inline const std::string &value() const;
 		inline const std::string &string() const;
 		inline const char *c_str() const;
 
+		/// Returns a hash of the string value. This is computed once,
+		/// when the string is first interned, so is effectively free. It is
+		/// used by the `std::hash` and `hash_value` implementations, so
+		/// InternedStrings may be used as keys in hashed containers without
+		/// rehashing the string.
+		inline size_t hash() const;
+
 		static size_t numUniqueStrings();
 
 	private :
 
-		static const std::string *internedString( const char *value );
-		static const std::string *internedString( const char *value, size_t length );
+		typedef Detail::InternedStringEntry Entry;
 
-		const std::string *m_value;
+		static const Entry *internedString( const char *value );
+		static const Entry *internedString( const char *value, size_t length );
+
+		const Entry *m_value;
 
 		static const InternedString &emptyString();
 		static const InternedString &numberString( int64_t number );
@@ -100,6 +130,8 @@ class IECORE_API InternedString
 
 IECORE_API std::ostream &operator << ( std::ostream &o, const InternedString &str );
 
+inline size_t hash_value( const InternedString &str );
+
 } // namespace IECore
 
 #include "IECore/InternedString.inl"
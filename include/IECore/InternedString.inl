@@ -87,24 +87,39 @@ inline bool InternedString::operator < ( const InternedString &other ) const
 	return m_value < other.m_value;
 }
 
+inline bool InternedString::ValueLess::operator()( const InternedString &a, const InternedString &b ) const
+{
+	return a.m_value != b.m_value && a.m_value->value < b.m_value->value;
+}
+
 inline InternedString::operator const std::string & () const
 {
-	return *m_value;
+	return m_value->value;
 }
 
 inline const std::string &InternedString::value() const
 {
-	return *m_value;
+	return m_value->value;
 }
 
 inline const std::string &InternedString::string() const
 {
-	return *m_value;
+	return m_value->value;
 }
 
 inline const char *InternedString::c_str() const
 {
-	return m_value->c_str();
+	return m_value->value.c_str();
+}
+
+inline size_t InternedString::hash() const
+{
+	return m_value->hash;
+}
+
+inline size_t hash_value( const InternedString &str )
+{
+	return str.hash();
 }
 
 } // namespace IECore
@@ -118,7 +133,7 @@ struct hash<IECore::InternedString>
 
 	size_t operator()( const IECore::InternedString &s ) const
 	{
-		return std::hash<std::string>()( s.string() );
+		return s.hash();
 	}
 
 };
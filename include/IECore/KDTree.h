@@ -74,6 +74,7 @@ class KDTree
 		/// Builds the tree for the specified points - the iterator range
 		/// must remain valid and unchanged as long as the tree is in use.
 		/// This method can be called again to rebuild the tree at any time.
+		/// Large trees are built using multiple threads.
 		/// \threading This can't be called while other threads are
 		/// making queries.
 		void init( PointIterator first, PointIterator last, int maxLeafSize=4  );
@@ -101,6 +102,23 @@ class KDTree
 		/// \threading May be called by multiple concurrent threads provided they are each using a different vector for the result.
 		unsigned int nearestNNeighbours( const Point &p, unsigned int numNeighbours, std::vector<Neighbour> &nearNeighbours ) const;
 
+		/// Performs nearestNNeighbours() for every point in the range [first, last), using multiple threads.
+		/// Rather than using a vector per query, the results are stored contiguously in nearNeighbours,
+		/// with the neighbours of the ith query point occupying the range [i * n, ( i + 1 ) * n), sorted
+		/// with the closest first. Returns n, which is the smaller of numNeighbours and the number of
+		/// points in the tree.
+		/// \threading May be called by multiple concurrent threads provided they are each using a different vector for the result.
+		template<typename QueryIterator>
+		unsigned int nearestNNeighbours( QueryIterator first, QueryIterator last, unsigned int numNeighbours, std::vector<Neighbour> &nearNeighbours ) const;
+
+		/// Performs nearestNeighbours() for every point in the range [first, last), using multiple threads.
+		/// The results are stored contiguously in nearNeighbours, in the compressed sparse row style. Offsets
+		/// is filled with one more entry than there are query points, such that the neighbours of the ith query
+		/// point occupy the range [offsets[i], offsets[i+1]). Returns the total number of neighbours found.
+		/// \threading May be called by multiple concurrent threads provided they are each using different vectors for the result.
+		template<typename QueryIterator>
+		size_t nearestNeighbours( QueryIterator first, QueryIterator last, BaseType r, std::vector<PointIterator> &nearNeighbours, std::vector<size_t> &offsets ) const;
+
 		/// Finds all the points contained by the specified bound, outputting them to the specified iterator.
 		/// \threading May be called by multiple concurrent threads.
 		template<typename Box, typename OutputIterator>
@@ -128,18 +146,26 @@ class KDTree
 		typedef typename Permutation::const_iterator PermutationConstIterator;
 
 		class AxisSort;
-
-		unsigned char majorAxis( PermutationConstIterator permFirst, PermutationConstIterator permLast );
+		class BuildTask;
+		class CountingIterator;
+		template<typename QueryIterator>
+		class NearestNNeighboursTask;
+		template<typename QueryIterator>
+		class NearestNeighboursTask;
+
+		unsigned char majorAxis( PermutationConstIterator permFirst, PermutationConstIterator permLast ) const;
 		void build( NodeIndex nodeIndex, PermutationIterator permFirst, PermutationIterator permLast );
 
 		void nearestNeighbourWalk( NodeIndex nodeIndex, const Point &p, PointIterator &closestPoint, BaseType &distSquared ) const;
 
-		void nearestNeighboursWalk( NodeIndex nodeIndex, const Point &p, BaseType r2, std::vector<PointIterator> &nearNeighbours ) const;
+		template<typename OutputIterator>
+		void nearestNeighboursWalk( NodeIndex nodeIndex, const Point &p, BaseType r2, OutputIterator &it ) const;
 
 		template<typename Box, typename OutputIterator>
 		void enclosedPointsWalk( NodeIndex nodeIndex, const Box &bound, OutputIterator it ) const;
 
-		void nearestNNeighboursWalk( NodeIndex nodeIndex, const Point &p, unsigned int numNeighbours, std::vector<Neighbour> &nearNeighbours, BaseType &maxDistSquared ) const;
+		// Maintains a max-heap of up to numNeighbours entries in the array starting at nearNeighbours.
+		void nearestNNeighboursWalk( NodeIndex nodeIndex, const Point &p, unsigned int numNeighbours, Neighbour *nearNeighbours, unsigned int &numFound, BaseType &maxDistSquared ) const;
 
 		Permutation m_perm;
 		NodeVector m_nodes;
@@ -33,6 +33,12 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include <algorithm>
+#include <iterator>
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_invoke.h"
+
 #include "OpenEXR/ImathLimits.h"
 #include "IECore/VectorOps.h"
 #include "IECore/BoxOps.h"
@@ -108,6 +114,147 @@ class KDTree<PointIterator>::AxisSort
 		const unsigned int m_axis;
 };
 
+template<class PointIterator>
+class KDTree<PointIterator>::BuildTask
+{
+	public :
+
+		BuildTask( KDTree *tree, NodeIndex nodeIndex, PermutationIterator permFirst, PermutationIterator permLast )
+			:	m_tree( tree ), m_nodeIndex( nodeIndex ), m_permFirst( permFirst ), m_permLast( permLast )
+		{
+		}
+
+		void operator()() const
+		{
+			m_tree->build( m_nodeIndex, m_permFirst, m_permLast );
+		}
+
+	private :
+
+		KDTree *m_tree;
+		NodeIndex m_nodeIndex;
+		PermutationIterator m_permFirst;
+		PermutationIterator m_permLast;
+};
+
+// An output iterator which just counts the number of
+// values written to it, for use in sizing result buffers.
+template<class PointIterator>
+class KDTree<PointIterator>::CountingIterator
+{
+	public :
+
+		CountingIterator() : m_count( 0 )
+		{
+		}
+
+		CountingIterator &operator*()
+		{
+			return *this;
+		}
+
+		CountingIterator &operator=( const PointIterator & )
+		{
+			return *this;
+		}
+
+		CountingIterator &operator++()
+		{
+			++m_count;
+			return *this;
+		}
+
+		CountingIterator &operator++( int )
+		{
+			++m_count;
+			return *this;
+		}
+
+		size_t count() const
+		{
+			return m_count;
+		}
+
+	private :
+
+		size_t m_count;
+};
+
+template<class PointIterator>
+template<typename QueryIterator>
+class KDTree<PointIterator>::NearestNNeighboursTask
+{
+	public :
+
+		NearestNNeighboursTask( const KDTree *tree, QueryIterator first, unsigned int numNeighbours, Neighbour *nearNeighbours )
+			:	m_tree( tree ), m_first( first ), m_numNeighbours( numNeighbours ), m_nearNeighbours( nearNeighbours )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				Neighbour *nearNeighbours = m_nearNeighbours + i * m_numNeighbours;
+				unsigned int numFound = 0;
+				BaseType maxDistSquared = Imath::limits<BaseType>::max();
+				m_tree->nearestNNeighboursWalk( m_tree->rootIndex(), *(m_first + i), m_numNeighbours, nearNeighbours, numFound, maxDistSquared );
+				assert( numFound == m_numNeighbours );
+				std::sort_heap( nearNeighbours, nearNeighbours + numFound );
+			}
+		}
+
+	private :
+
+		const KDTree *m_tree;
+		QueryIterator m_first;
+		unsigned int m_numNeighbours;
+		Neighbour *m_nearNeighbours;
+};
+
+// Operates in two passes. When nearNeighbours is null, the
+// number of neighbours for each query is written into offsets,
+// otherwise the neighbours are written into nearNeighbours at
+// the positions specified by offsets.
+template<class PointIterator>
+template<typename QueryIterator>
+class KDTree<PointIterator>::NearestNeighboursTask
+{
+	public :
+
+		NearestNeighboursTask( const KDTree *tree, QueryIterator first, BaseType r2, size_t *offsets, PointIterator *nearNeighbours )
+			:	m_tree( tree ), m_first( first ), m_r2( r2 ), m_offsets( offsets ), m_nearNeighbours( nearNeighbours )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				if( m_nearNeighbours )
+				{
+					PointIterator *it = m_nearNeighbours + m_offsets[i];
+					m_tree->nearestNeighboursWalk( m_tree->rootIndex(), *(m_first + i), m_r2, it );
+					assert( it == m_nearNeighbours + m_offsets[i+1] );
+				}
+				else
+				{
+					CountingIterator it;
+					m_tree->nearestNeighboursWalk( m_tree->rootIndex(), *(m_first + i), m_r2, it );
+					m_offsets[i] = it.count();
+				}
+			}
+		}
+
+	private :
+
+		const KDTree *m_tree;
+		QueryIterator m_first;
+		BaseType m_r2;
+		size_t *m_offsets;
+		PointIterator *m_nearNeighbours;
+};
+
 // initialisation
 
 template<class PointIterator>
@@ -133,12 +280,25 @@ void KDTree<PointIterator>::init( PointIterator first, PointIterator last, int m
 		m_perm[i++] = it;
 	}
 
-	/// \todo Can we reserve() enough space for m_nodes before doing this?
+	// Allocate all the nodes up front, so that subtrees can be built
+	// concurrently. The high child of each branch receives the larger
+	// half of the points, so the deepest and therefore highest index
+	// is found by following the high children from the root.
+	NodeIndex maxNodeIndex = rootIndex();
+	size_t numPoints = m_perm.size();
+	while( numPoints > (size_t)m_maxLeafSize )
+	{
+		maxNodeIndex = highChildIndex( maxNodeIndex );
+		numPoints -= numPoints / 2;
+	}
+	m_nodes.clear();
+	m_nodes.resize( maxNodeIndex + 1 );
+
 	build( rootIndex(), m_perm.begin(), m_perm.end() );
 }
 
 template<class PointIterator>
-unsigned char KDTree<PointIterator>::majorAxis( PermutationConstIterator permFirst, PermutationConstIterator permLast )
+unsigned char KDTree<PointIterator>::majorAxis( PermutationConstIterator permFirst, PermutationConstIterator permLast ) const
 {
 	Point min, max;
 	for( unsigned char i=0; i<VectorTraits<Point>::dimensions(); i++ ) {
@@ -174,11 +334,10 @@ unsigned char KDTree<PointIterator>::majorAxis( PermutationConstIterator permFir
 template<class PointIterator>
 void KDTree<PointIterator>::build( NodeIndex nodeIndex, PermutationIterator permFirst, PermutationIterator permLast )
 {
-	// make room for the new node
-	if( nodeIndex>=m_nodes.size() )
-	{
-		m_nodes.resize( nodeIndex+1 );
-	}
+	// Subtrees with more points than this are built in parallel
+	const int parallelBuildThreshold = 1000;
+
+	assert( nodeIndex < m_nodes.size() );
 
 	if( permLast - permFirst > m_maxLeafSize )
 	{
@@ -189,8 +348,18 @@ void KDTree<PointIterator>::build( NodeIndex nodeIndex, PermutationIterator perm
 		// insert node
 		m_nodes[nodeIndex].makeBranch( cutAxis, cutValue );
 
-		build( lowChildIndex( nodeIndex ), permFirst, permMid );
-		build( highChildIndex( nodeIndex ), permMid, permLast );
+		if( permLast - permFirst > parallelBuildThreshold )
+		{
+			tbb::parallel_invoke(
+				BuildTask( this, lowChildIndex( nodeIndex ), permFirst, permMid ),
+				BuildTask( this, highChildIndex( nodeIndex ), permMid, permLast )
+			);
+		}
+		else
+		{
+			build( lowChildIndex( nodeIndex ), permFirst, permMid );
+			build( highChildIndex( nodeIndex ), permMid, permLast );
+		}
 	}
 	else
 	{
@@ -223,11 +392,50 @@ unsigned int KDTree<PointIterator>::nearestNeighbours( const Point &p, BaseType
 {
 	nearNeighbours.clear();
 
-	nearestNeighboursWalk(rootIndex(), p, r*r, nearNeighbours );
+	std::back_insert_iterator<std::vector<PointIterator> > it( nearNeighbours );
+	nearestNeighboursWalk( rootIndex(), p, r*r, it );
 
 	return nearNeighbours.size();
 }
 
+template<class PointIterator>
+template<typename QueryIterator>
+size_t KDTree<PointIterator>::nearestNeighbours( QueryIterator first, QueryIterator last, BaseType r, std::vector<PointIterator> &nearNeighbours, std::vector<size_t> &offsets ) const
+{
+	const size_t numQueries = last - first;
+	const BaseType r2 = r * r;
+
+	// First pass counts the neighbours for each query
+	offsets.resize( numQueries + 1 );
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, numQueries ),
+		NearestNeighboursTask<QueryIterator>( this, first, r2, &offsets[0], nullptr )
+	);
+
+	// Convert counts to offsets
+	size_t numNeighbours = 0;
+	for( size_t i = 0; i < numQueries; ++i )
+	{
+		const size_t count = offsets[i];
+		offsets[i] = numNeighbours;
+		numNeighbours += count;
+	}
+	offsets[numQueries] = numNeighbours;
+
+	// Second pass writes the neighbours into place
+	nearNeighbours.clear();
+	nearNeighbours.resize( numNeighbours );
+	if( numNeighbours )
+	{
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>( 0, numQueries ),
+			NearestNeighboursTask<QueryIterator>( this, first, r2, &offsets[0], &nearNeighbours[0] )
+		);
+	}
+
+	return numNeighbours;
+}
+
 template<class PointIterator>
 template<typename Box, typename OutputIterator>
 void KDTree<PointIterator>::enclosedPoints( const Box &bound, OutputIterator it ) const
@@ -240,16 +448,41 @@ unsigned int KDTree<PointIterator>::nearestNNeighbours( const Point &p, unsigned
 {
 	nearNeighbours.clear();
 
+	numNeighbours = std::min<size_t>( numNeighbours, m_perm.size() );
 	if( numNeighbours )
 	{
+		nearNeighbours.resize( numNeighbours, Neighbour( m_lastPoint, 0 ) );
+		unsigned int numFound = 0;
 		BaseType maxDistSquared = Imath::limits<BaseType>::max();
-		nearestNNeighboursWalk( rootIndex(), p, numNeighbours, nearNeighbours, maxDistSquared );
+		nearestNNeighboursWalk( rootIndex(), p, numNeighbours, &nearNeighbours[0], numFound, maxDistSquared );
+		nearNeighbours.resize( numFound, Neighbour( m_lastPoint, 0 ) );
 		std::sort_heap( nearNeighbours.begin(), nearNeighbours.end() );
 	}
 
 	return nearNeighbours.size();
 }
 
+template<class PointIterator>
+template<typename QueryIterator>
+unsigned int KDTree<PointIterator>::nearestNNeighbours( QueryIterator first, QueryIterator last, unsigned int numNeighbours, std::vector<Neighbour> &nearNeighbours ) const
+{
+	const size_t numQueries = last - first;
+
+	numNeighbours = std::min<size_t>( numNeighbours, m_perm.size() );
+
+	nearNeighbours.clear();
+	nearNeighbours.resize( numQueries * numNeighbours, Neighbour( m_lastPoint, 0 ) );
+	if( numNeighbours && numQueries )
+	{
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>( 0, numQueries ),
+			NearestNNeighboursTask<QueryIterator>( this, first, numNeighbours, &nearNeighbours[0] )
+		);
+	}
+
+	return numNeighbours;
+}
+
 template<class PointIterator>
 void KDTree<PointIterator>::nearestNeighbourWalk( NodeIndex nodeIndex, const Point &p, PointIterator &closestPoint, BaseType &distSquared ) const
 {
@@ -294,7 +527,8 @@ void KDTree<PointIterator>::nearestNeighbourWalk( NodeIndex nodeIndex, const Poi
 }
 
 template<class PointIterator>
-void KDTree<PointIterator>::nearestNeighboursWalk( NodeIndex nodeIndex, const Point &p, BaseType r2, std::vector<PointIterator> &nearNeighbours ) const
+template<typename OutputIterator>
+void KDTree<PointIterator>::nearestNeighboursWalk( NodeIndex nodeIndex, const Point &p, BaseType r2, OutputIterator &it ) const
 {
 	const Node &node = m_nodes[nodeIndex];
 	if( node.isLeaf() )
@@ -307,7 +541,7 @@ void KDTree<PointIterator>::nearestNeighboursWalk( NodeIndex nodeIndex, const Po
 
 			if (dist2 < r2 )
 			{
-				nearNeighbours.push_back( *perm );
+				*it++ = *perm;
 			}
 		}
 	}
@@ -327,16 +561,16 @@ void KDTree<PointIterator>::nearestNeighboursWalk( NodeIndex nodeIndex, const Po
 			secondChild = highChildIndex( nodeIndex );
 		}
 
-		nearestNeighboursWalk( firstChild, p, r2, nearNeighbours );
+		nearestNeighboursWalk( firstChild, p, r2, it );
 		if( d*d < r2 )
 		{
-			nearestNeighboursWalk( secondChild, p, r2, nearNeighbours );
+			nearestNeighboursWalk( secondChild, p, r2, it );
 		}
 	}
 }
 
 template<class PointIterator>
-void KDTree<PointIterator>::nearestNNeighboursWalk( NodeIndex nodeIndex, const Point &p, unsigned int numNeighbours, std::vector<Neighbour> &nearNeighbours, BaseType &maxDistSquared ) const
+void KDTree<PointIterator>::nearestNNeighboursWalk( NodeIndex nodeIndex, const Point &p, unsigned int numNeighbours, Neighbour *nearNeighbours, unsigned int &numFound, BaseType &maxDistSquared ) const
 {
 	const Node &node = m_nodes[nodeIndex];
 	if( node.isLeaf() )
@@ -347,29 +581,28 @@ void KDTree<PointIterator>::nearestNNeighboursWalk( NodeIndex nodeIndex, const P
 			const Point &pp = **perm;
 			BaseType dist2 = vecDistance2( p, pp );
 
-			if( dist2 < maxDistSquared || nearNeighbours.size() < numNeighbours )
+			if( dist2 < maxDistSquared || numFound < numNeighbours )
 			{
 				Neighbour n( *perm, dist2 );
-				assert( nearNeighbours.size() <= numNeighbours );
+				assert( numFound <= numNeighbours );
 
-				if( nearNeighbours.size() == numNeighbours )
+				if( numFound == numNeighbours )
 				{
-					std::pop_heap( nearNeighbours.begin(), nearNeighbours.end() );
-					*(nearNeighbours.rbegin()) = n;
+					std::pop_heap( nearNeighbours, nearNeighbours + numFound );
+					nearNeighbours[numFound-1] = n;
 				}
 				else
 				{
-					nearNeighbours.push_back( n );
+					nearNeighbours[numFound++] = n;
 				}
-				
-				std::push_heap( nearNeighbours.begin(), nearNeighbours.end() );
 
-				assert( nearNeighbours.size() > 0 );
-				
+				std::push_heap( nearNeighbours, nearNeighbours + numFound );
+
+				assert( numFound > 0 );
+
 				// first element is furthest point away
-				typename std::vector<Neighbour>::const_iterator it = nearNeighbours.begin();
-				assert( it->distSquared >= nearNeighbours.rbegin()->distSquared );
-				maxDistSquared = it->distSquared;
+				assert( nearNeighbours[0].distSquared >= nearNeighbours[numFound-1].distSquared );
+				maxDistSquared = nearNeighbours[0].distSquared;
 			}
 		}
 	}
@@ -389,10 +622,10 @@ void KDTree<PointIterator>::nearestNNeighboursWalk( NodeIndex nodeIndex, const P
 			secondChild = highChildIndex( nodeIndex );
 		}
 
-		nearestNNeighboursWalk( firstChild, p, numNeighbours, nearNeighbours, maxDistSquared );
-		if( d*d < maxDistSquared || nearNeighbours.size()<numNeighbours )
+		nearestNNeighboursWalk( firstChild, p, numNeighbours, nearNeighbours, numFound, maxDistSquared );
+		if( d*d < maxDistSquared || numFound<numNeighbours )
 		{
-			nearestNNeighboursWalk( secondChild, p, numNeighbours, nearNeighbours, maxDistSquared );
+			nearestNNeighboursWalk( secondChild, p, numNeighbours, nearNeighbours, numFound, maxDistSquared );
 		}
 	}
 }
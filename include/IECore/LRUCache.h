@@ -58,6 +58,63 @@ class Serial;
 template<typename LRUCache>
 class Parallel;
 
+/// As Serial, but scan resistant. Items are first admitted into a
+/// probationary segment, and are only promoted to a protected segment
+/// when they are accessed again. Items are evicted from the probationary
+/// segment first, so a single pass over a large number of items (such as
+/// a render stepping through the frames of a sequence) can't evict items
+/// which are in repeated use. Not threadsafe.
+template<typename LRUCache>
+class SerialSegmented;
+
+/// As Parallel, but scan resistant. Rather than a single "recently used"
+/// flag, each item counts the number of times it is accessed (up to a small
+/// maximum), and survives that number of passes of the eviction algorithm.
+/// Items which have been accessed only once are evicted on the first pass,
+/// so a single pass over a large number of items evicts them in preference
+/// to items in repeated use. Threadsafe.
+template<typename LRUCache>
+class ParallelFrequency;
+
+/// Threadsafe, and designed for low contention when used from many
+/// threads at once. Keys are hashed into independent shards, each
+/// with its own lock and LRU list, and the current cost is maintained
+/// approximately, without a single shared counter. Eviction visits the
+/// shards in turn, so is only approximately in LRU order. Hit, miss,
+/// eviction and contention counts are maintained for each shard and
+/// may be queried via `LRUCache::policy().statistics()`. Key type must
+/// have a `hash_value` implementation as described in the boost
+/// documentation.
+template<typename LRUCache>
+class Sharded;
+
+/// Statistics gathered for each shard of the Sharded policy.
+struct ShardStatistics
+{
+	ShardStatistics()
+		:	hits( 0 ), misses( 0 ), evictions( 0 ), contention( 0 )
+	{
+	}
+
+	/// Number of calls to `get()` which found a cached value.
+	size_t hits;
+	/// Number of calls to `get()` which had to compute the value.
+	size_t misses;
+	/// Number of cached values removed to limit the cost of
+	/// the cache, or by `clear()`.
+	size_t evictions;
+	/// Number of times a lock was found to be held by another thread.
+	size_t contention;
+};
+
+namespace Detail
+{
+
+template<typename LRUCache, int MaxUses>
+class ParallelBase;
+
+} // namespace Detail
+
 } // namespace LRUCachePolicy
 
 /// A mapping from keys to values, where values are computed from keys using a user
@@ -136,6 +193,10 @@ class LRUCache : private boost::noncopyable
 		/// Returns the current cost of all cached items.
 		Cost currentCost() const;
 
+		/// Provides access to the policy, for queries specific to
+		/// a particular policy, such as `Sharded::statistics()`.
+		const Policy<LRUCache> &policy() const;
+
 	private :
 
 		// Data
@@ -143,6 +204,9 @@ class LRUCache : private boost::noncopyable
 
 		// Give Policy access to CacheEntry definitions.
 		friend class Policy<LRUCache>;
+		// And the implementation shared by the parallel policies.
+		template<typename, int>
+		friend class LRUCachePolicy::Detail::ParallelBase;
 
 		// A function for computing values, and one for notifying of removals.
 		GetterFunction m_getter;
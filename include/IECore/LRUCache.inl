@@ -36,12 +36,16 @@
 #ifndef IECORE_LRUCACHE_INL
 #define IECORE_LRUCACHE_INL
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 
 #include "tbb/spin_mutex.h"
 #include "tbb/spin_rw_mutex.h"
+#include "tbb/atomic.h"
 #include "tbb/tbb_thread.h"
 
 #include "boost/multi_index_container.hpp"
@@ -171,6 +175,7 @@ class Serial
 				if( m_inited )
 				{
 					m_it->hasHandle = false;
+					m_inited = false;
 				}
 			}
 
@@ -268,11 +273,243 @@ class Serial
 
 };
 
+// As Serial, but maintaining two segments in the list, as described
+// in "Caching Strategies to Improve Disk System Performance" (Karedla
+// et al). The list is ordered with the probationary segment first, so
+// that items are popped from there in preference to the protected
+// segment. Rather than store the segments separately, we maintain an
+// iterator to the first protected item. Moving this iterator forward
+// demotes the least recently used protected item to the front of the
+// probationary segment.
+template<typename LRUCache>
+class SerialSegmented
+{
+
+	public :
+
+		typedef typename LRUCache::CacheEntry CacheEntry;
+		typedef typename LRUCache::KeyType Key;
+
+		struct Item
+		{
+			Item( const Key &key )
+				:	key( key ), hasHandle( false ), pushed( false ), isProtected( false )
+			{
+			}
+
+			Key key;
+			mutable CacheEntry cacheEntry;
+			mutable bool hasHandle;
+			// True once push() has been called following insertion.
+			mutable bool pushed;
+			mutable bool isProtected;
+		};
+
+		typedef boost::multi_index_container<
+			Item,
+			boost::multi_index::indexed_by<
+				boost::multi_index::hashed_unique<
+					boost::multi_index::member<Item, Key, &Item::key>
+				>,
+				boost::multi_index::sequenced<>
+			>
+		> MapAndList;
+
+		typedef typename MapAndList::iterator MapIterator;
+		typedef typename MapAndList::template nth_index<1>::type List;
+
+		SerialSegmented()
+			:	currentCost( 0 ), m_numProtected( 0 )
+		{
+			m_protectedBegin = m_mapAndList.template get<1>().end();
+		}
+
+		struct Handle : private boost::noncopyable
+		{
+
+			Handle()
+				:	m_inited( false )
+			{
+			}
+
+			~Handle()
+			{
+				release();
+			}
+
+			const CacheEntry &readable()
+			{
+				return m_it->cacheEntry;
+			}
+
+			CacheEntry &writable()
+			{
+				return m_it->cacheEntry;
+			}
+
+			void release()
+			{
+				if( m_inited )
+				{
+					m_it->hasHandle = false;
+					m_inited = false;
+				}
+			}
+
+			private :
+
+				void init( MapIterator it )
+				{
+					assert( !m_inited );
+					m_it = it;
+					assert( !m_it->hasHandle );
+					m_it->hasHandle = true;
+					m_inited = true;
+				}
+
+				friend class SerialSegmented;
+				MapIterator m_it;
+				bool m_inited;
+
+		};
+
+		bool acquire( const Key &key, Handle &handle, AcquireMode mode )
+		{
+			if( mode == Insert || mode == InsertWritable )
+			{
+				std::pair<MapIterator, bool> i = m_mapAndList.insert( Item( key ) );
+				if( i.second )
+				{
+					// New items go to the back of the probationary segment.
+					List &list = m_mapAndList.template get<1>();
+					list.relocate( m_protectedBegin, m_mapAndList.template project<1>( i.first ) );
+				}
+				handle.init( i.first );
+				return true;
+			}
+			else
+			{
+				assert( mode == FindReadable || mode == FindWritable );
+				MapIterator it = m_mapAndList.find( key );
+				if( it == m_mapAndList.end() )
+				{
+					return false;
+				}
+				handle.init( it );
+				return true;
+			}
+		}
+
+		void push( Handle &handle )
+		{
+			const Item &item = *(handle.m_it);
+			if( !item.pushed )
+			{
+				// This is the access which inserted the item, so
+				// it stays in the probationary segment.
+				item.pushed = true;
+				return;
+			}
+
+			List &list = m_mapAndList.template get<1>();
+			typename List::iterator it = list.iterator_to( item );
+			if( item.isProtected )
+			{
+				if( it == m_protectedBegin )
+				{
+					if( ++m_protectedBegin == list.end() )
+					{
+						// It was the only protected item, so it
+						// stays where it is.
+						m_protectedBegin = it;
+						return;
+					}
+				}
+				list.relocate( list.end(), it );
+				return;
+			}
+
+			// Second access - promote to the protected segment.
+			list.relocate( list.end(), it );
+			item.isProtected = true;
+			if( m_protectedBegin == list.end() )
+			{
+				m_protectedBegin = it;
+			}
+			m_numProtected++;
+
+			// And demote protected items if the protected segment
+			// has grown too large.
+			while( m_numProtected * protectedRatioDenominator > list.size() * protectedRatioNumerator )
+			{
+				m_protectedBegin->isProtected = false;
+				++m_protectedBegin;
+				m_numProtected--;
+			}
+		}
+
+		bool pop( Key &key, CacheEntry &cacheEntry )
+		{
+			List &list = m_mapAndList.template get<1>();
+
+			// See comments in Serial::pop().
+			typename List::iterator it = list.begin();
+			while( it != list.end() && it->hasHandle )
+			{
+				++it;
+			}
+
+			if( it == list.end() )
+			{
+				return false;
+			}
+
+			const Item &item = *it;
+
+			key = item.key;
+			cacheEntry = item.cacheEntry;
+
+			if( item.isProtected )
+			{
+				m_numProtected--;
+			}
+			if( it == m_protectedBegin )
+			{
+				++m_protectedBegin;
+			}
+
+			list.erase( it );
+
+			return true;
+		}
+
+		typename LRUCache::Cost currentCost;
+
+	private :
+
+		// The protected segment may hold at most 80% of the items.
+		static const size_t protectedRatioNumerator = 4;
+		static const size_t protectedRatioDenominator = 5;
+
+		MapAndList m_mapAndList;
+		typename List::iterator m_protectedBegin;
+		size_t m_numProtected;
+
+};
+
+namespace Detail
+{
+
 // Uses a binned map to allow concurrent map operations, and
 // uses a second-chance algorithm to avoid the serial operations
-// associated with managing an LRU list.
-template<typename LRUCache>
-class Parallel
+// associated with managing an LRU list. MaxUses is the maximum
+// number of chances an item may accumulate by being accessed.
+// When it is 1, this is the classic second-chance algorithm
+// used by the Parallel policy. When it is greater, the access
+// that inserts an item doesn't count, so items used only once
+// are evicted first - this is the ParallelFrequency policy.
+template<typename LRUCache, int MaxUses>
+class ParallelBase
 {
 
 	public :
@@ -283,16 +520,21 @@ class Parallel
 
 		struct Item
 		{
-			Item() : recentlyUsed() {}
-			Item( const Key &key ) : key( key ), recentlyUsed() {}
-			Item( const Item &other ) : key( other.key ), cacheEntry( other.cacheEntry ), recentlyUsed() {}
+			Item() { uses = initialUses(); }
+			Item( const Key &key ) : key( key ) { uses = initialUses(); }
+			Item( const Item &other ) : key( other.key ), cacheEntry( other.cacheEntry ) { uses = initialUses(); }
 			Key key;
 			mutable CacheEntry cacheEntry;
 			// Mutex to protect cacheEntry.
 			typedef tbb::spin_rw_mutex Mutex;
 			mutable Mutex mutex;
-			// Flag used in second-chance algorithm.
-			mutable tbb::atomic<bool> recentlyUsed;
+			// Count used in second-chance algorithm.
+			mutable tbb::atomic<int> uses;
+
+			static int initialUses()
+			{
+				return MaxUses > 1 ? -1 : 0;
+			}
 		};
 
 		// We would love to use one of TBB's concurrent containers as
@@ -336,7 +578,7 @@ class Parallel
 
 		typedef std::vector<Bin> Bins;
 
-		Parallel()
+		ParallelBase()
 		{
 			m_bins.resize( tbb::tbb_thread::hardware_concurrency() );
 			m_popBinIndex = 0;
@@ -448,7 +690,7 @@ class Parallel
 					}
 				}
 
-				friend class Parallel;
+				friend class ParallelBase;
 
 				const Item *m_item;
 				typename Item::Mutex::scoped_lock m_itemLock;
@@ -467,8 +709,23 @@ class Parallel
 			// recently. We will then give it a second chance
 			// in pop(), so it will not be evicted immediately.
 			// We don't need the handle to be writable to write
-			// here, because `recentlyUsed` is atomic.
-			handle.m_item->recentlyUsed = true;
+			// here, because `uses` is atomic.
+			if( MaxUses == 1 )
+			{
+				handle.m_item->uses = 1;
+			}
+			else
+			{
+				// Count the use, unless we're at the maximum
+				// already. If another thread is counting at the
+				// same time the compare_and_swap may fail, but
+				// losing an occasional use is of no consequence.
+				const int uses = handle.m_item->uses;
+				if( uses < MaxUses )
+				{
+					handle.m_item->uses.compare_and_swap( uses + 1, uses );
+				}
+			}
 		}
 
 		bool pop( Key &key, CacheEntry &cacheEntry )
@@ -510,7 +767,7 @@ class Parallel
 
 				if( itemLock.try_acquire( m_popIterator->mutex ) )
 				{
-					if( !m_popIterator->recentlyUsed )
+					if( m_popIterator->uses <= 0 )
 					{
 						// Pop this item.
 						key = m_popIterator->key;
@@ -528,10 +785,10 @@ class Parallel
 					}
 					else
 					{
-						// Item has been used recently. Flag it so we
-						// can pop it next time round, unless another
-						// thread resets the flag.
-						m_popIterator->recentlyUsed = false;
+						// Item has been used recently. Use up one of
+						// its chances, so we can pop it next time round
+						// unless another thread uses it again.
+						--m_popIterator->uses;
 						itemLock.release();
 					}
 				}
@@ -565,6 +822,408 @@ class Parallel
 
 };
 
+} // namespace Detail
+
+template<typename LRUCache>
+class Parallel : public Detail::ParallelBase<LRUCache, 1>
+{
+};
+
+// Three chances strikes a reasonable balance between protecting
+// frequently used items and allowing the cache to adapt when the
+// working set changes.
+template<typename LRUCache>
+class ParallelFrequency : public Detail::ParallelBase<LRUCache, 3>
+{
+};
+
+namespace Detail
+{
+
+// Returns a small integer identifying the calling thread, suitable
+// for indexing into per-thread storage.
+inline size_t threadIndex()
+{
+	static tbb::atomic<size_t> g_nextThreadIndex;
+	static thread_local size_t index = g_nextThreadIndex++;
+	return index;
+}
+
+// A counter for use as the currentCost of a policy. Rather than
+// use a single atomic value, which would be contended by every thread
+// adding and removing items, the count is split across a number of
+// stripes, each on its own cache line. Each thread updates only its
+// own stripe, and reading the value sums all the stripes.
+template<typename T>
+class StripedCounter : private boost::noncopyable
+{
+
+	public :
+
+		StripedCounter()
+			:	m_stripes( std::max( tbb::tbb_thread::hardware_concurrency(), 1u ) )
+		{
+			for( typename Stripes::iterator it = m_stripes.begin(); it != m_stripes.end(); ++it )
+			{
+				it->value = 0;
+			}
+		}
+
+		StripedCounter &operator += ( T value )
+		{
+			stripe().value += value;
+			return *this;
+		}
+
+		StripedCounter &operator -= ( T value )
+		{
+			stripe().value -= value;
+			return *this;
+		}
+
+		// Stripes are unsigned and wrap around when a thread removes
+		// more than it added, so the sum is exact when no other threads
+		// are updating the counter. When they are, we may see a removal
+		// without the corresponding addition, so we clamp the result to
+		// avoid returning a huge value.
+		operator T () const
+		{
+			T result = 0;
+			for( typename Stripes::const_iterator it = m_stripes.begin(); it != m_stripes.end(); ++it )
+			{
+				result += it->value;
+			}
+			typedef typename std::make_signed<T>::type SignedT;
+			return static_cast<SignedT>( result ) < 0 ? 0 : result;
+		}
+
+	private :
+
+		struct Stripe
+		{
+			tbb::atomic<T> value;
+			char padding[64 - sizeof( tbb::atomic<T> )];
+		};
+
+		typedef std::vector<Stripe> Stripes;
+		Stripes m_stripes;
+
+		Stripe &stripe()
+		{
+			return m_stripes[threadIndex() % m_stripes.size()];
+		}
+
+};
+
+} // namespace Detail
+
+// Splits the storage into shards in the same way as Parallel, but each
+// shard maintains its own LRU list using a multi_index_container in the
+// same way as Serial. Items are moved to the back of the list when they
+// are used, and popped from the front. To avoid contention on the shard
+// lock, push() skips the move if the lock is held by another thread, and
+// instead flags the item so that it is given a second chance by pop().
+template<typename LRUCache>
+class Sharded
+{
+
+	public :
+
+		typedef typename LRUCache::CacheEntry CacheEntry;
+		typedef typename LRUCache::KeyType Key;
+
+		struct Item
+		{
+			Item( const Key &key ) : key( key ) { recentlyUsed = false; }
+			Item( const Item &other ) : key( other.key ), cacheEntry( other.cacheEntry ) { recentlyUsed = false; }
+			Key key;
+			mutable CacheEntry cacheEntry;
+			// Mutex to protect cacheEntry.
+			typedef tbb::spin_rw_mutex Mutex;
+			mutable Mutex mutex;
+			// Flag used to give a second chance to items that
+			// push() was unable to move in the list.
+			mutable tbb::atomic<bool> recentlyUsed;
+		};
+
+		typedef boost::multi_index::multi_index_container<
+			Item,
+			boost::multi_index::indexed_by<
+				boost::multi_index::hashed_unique<
+					boost::multi_index::member<Item, Key, &Item::key>
+				>,
+				boost::multi_index::sequenced<>
+			>
+		> MapAndList;
+
+		typedef typename MapAndList::iterator MapIterator;
+		typedef typename MapAndList::template nth_index<1>::type List;
+
+		struct Shard
+		{
+			Shard() { resetStatistics(); }
+			Shard( const Shard &other ) : mapAndList( other.mapAndList ) { resetStatistics(); }
+			Shard &operator = ( const Shard &other ) { mapAndList = other.mapAndList; return *this; }
+
+			void resetStatistics()
+			{
+				hits = 0;
+				misses = 0;
+				evictions = 0;
+				contention = 0;
+			}
+
+			MapAndList mapAndList;
+			typedef tbb::spin_rw_mutex Mutex;
+			Mutex mutex;
+
+			tbb::atomic<size_t> hits;
+			tbb::atomic<size_t> misses;
+			tbb::atomic<size_t> evictions;
+			tbb::atomic<size_t> contention;
+		};
+
+		typedef std::vector<Shard> Shards;
+
+		Sharded()
+		{
+			m_shards.resize( tbb::tbb_thread::hardware_concurrency() );
+			m_popShardIndex = 0;
+		}
+
+		struct Handle : private boost::noncopyable
+		{
+
+			Handle()
+				:	m_item( nullptr ), m_shard( nullptr ), m_writable( false )
+			{
+			}
+
+			const CacheEntry &readable()
+			{
+				return m_item->cacheEntry;
+			}
+
+			CacheEntry &writable()
+			{
+				assert( m_writable );
+				return m_item->cacheEntry;
+			}
+
+			void release()
+			{
+				if( m_item )
+				{
+					m_itemLock.release();
+					m_item = nullptr;
+				}
+			}
+
+			private :
+
+				// As for Parallel::Handle::acquire(), but counting
+				// hits, misses and contention.
+				bool acquire( Shard &shard, const Key &key, AcquireMode mode )
+				{
+					assert( !m_item );
+
+					bool contended = false;
+					typename Shard::Mutex::scoped_lock shardLock;
+					while( true )
+					{
+						if( !shardLock.try_acquire( shard.mutex, /* write = */ false ) )
+						{
+							contended = true;
+							shardLock.acquire( shard.mutex, /* write = */ false );
+						}
+
+						MapIterator it = shard.mapAndList.find( key );
+						bool inserted = false;
+						if( it == shard.mapAndList.end() )
+						{
+							if( mode != Insert && mode != InsertWritable )
+							{
+								return false;
+							}
+							shardLock.upgrade_to_writer();
+							// New items are inserted at the back of the list.
+							std::tie<MapIterator, bool>( it, inserted ) = shard.mapAndList.insert( Item( key ) );
+						}
+
+						m_writable = inserted || mode == FindWritable || mode == InsertWritable;
+
+						if( m_itemLock.try_acquire( it->mutex, /* write = */ m_writable ) )
+						{
+							if( !m_writable && mode == Insert && it->cacheEntry.status() == LRUCache::Uncached )
+							{
+								m_itemLock.upgrade_to_writer();
+								m_writable = true;
+							}
+
+							if( mode == Insert )
+							{
+								if( it->cacheEntry.status() == LRUCache::Cached )
+								{
+									++shard.hits;
+								}
+								else
+								{
+									++shard.misses;
+								}
+							}
+							if( contended )
+							{
+								++shard.contention;
+							}
+
+							m_item = &*it;
+							m_shard = &shard;
+							return true;
+						}
+						else
+						{
+							// Release the shard lock and retry, to avoid
+							// deadlock with reentrant GetterFunctions.
+							contended = true;
+							shardLock.release();
+						}
+					}
+				}
+
+				friend class Sharded;
+
+				const Item *m_item;
+				Shard *m_shard;
+				typename Item::Mutex::scoped_lock m_itemLock;
+				bool m_writable;
+
+		};
+
+		bool acquire( const Key &key, Handle &handle, AcquireMode mode )
+		{
+			return handle.acquire( shard( key ), key, mode );
+		}
+
+		void push( Handle &handle )
+		{
+			Shard &shard = *handle.m_shard;
+			typename Shard::Mutex::scoped_lock shardLock;
+			if( !shardLock.try_acquire( shard.mutex, /* write = */ true ) )
+			{
+				// Rather than wait for the lock, leave the item
+				// where it is and let pop() give it a second chance.
+				++shard.contention;
+				handle.m_item->recentlyUsed = true;
+				return;
+			}
+
+			List &list = shard.mapAndList.template get<1>();
+			list.relocate( list.end(), list.iterator_to( *handle.m_item ) );
+		}
+
+		bool pop( Key &key, CacheEntry &cacheEntry )
+		{
+			// Visit the shards in turn, starting from a different
+			// shard each time, so that evictions are spread evenly
+			// across them.
+			const size_t numShards = m_shards.size();
+			const size_t firstShardIndex = m_popShardIndex++;
+			for( size_t i = 0; i < numShards; ++i )
+			{
+				Shard &shard = m_shards[( firstShardIndex + i ) % numShards];
+				typename Shard::Mutex::scoped_lock shardLock;
+				if( !shardLock.try_acquire( shard.mutex, /* write = */ true ) )
+				{
+					++shard.contention;
+					shardLock.acquire( shard.mutex, /* write = */ true );
+				}
+
+				List &list = shard.mapAndList.template get<1>();
+				typename Item::Mutex::scoped_lock itemLock;
+				typename List::iterator it = list.begin();
+				while( it != list.end() )
+				{
+					if( !itemLock.try_acquire( it->mutex ) )
+					{
+						// Another thread has a handle to this item,
+						// so we can't pop it.
+						++it;
+						continue;
+					}
+
+					if( it->recentlyUsed )
+					{
+						// Give the item a second chance by moving it to
+						// the back of the list. We hold the shard lock,
+						// so no new handles can be acquired for it and it
+						// will be popped if we come round to it again.
+						it->recentlyUsed = false;
+						itemLock.release();
+						typename List::iterator next = it; ++next;
+						list.relocate( list.end(), it );
+						it = next;
+						continue;
+					}
+
+					key = it->key;
+					cacheEntry = it->cacheEntry;
+					if( cacheEntry.status() == LRUCache::Cached )
+					{
+						++shard.evictions;
+					}
+					// See comments in Parallel::pop().
+					itemLock.release();
+					list.erase( it );
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// Returns the number of shards.
+		size_t numShards() const
+		{
+			return m_shards.size();
+		}
+
+		// Fills stats with the statistics for each shard.
+		void statistics( std::vector<ShardStatistics> &stats ) const
+		{
+			stats.resize( m_shards.size() );
+			for( size_t i = 0; i < m_shards.size(); ++i )
+			{
+				stats[i].hits = m_shards[i].hits;
+				stats[i].misses = m_shards[i].misses;
+				stats[i].evictions = m_shards[i].evictions;
+				stats[i].contention = m_shards[i].contention;
+			}
+		}
+
+		// Resets the statistics for all shards to 0.
+		void resetStatistics()
+		{
+			for( typename Shards::iterator it = m_shards.begin(); it != m_shards.end(); ++it )
+			{
+				it->resetStatistics();
+			}
+		}
+
+		Detail::StripedCounter<typename LRUCache::Cost> currentCost;
+
+	private :
+
+		Shards m_shards;
+		tbb::atomic<size_t> m_popShardIndex;
+
+		Shard &shard( const Key &key )
+		{
+			size_t shardIndex = boost::hash<Key>()( key ) % m_shards.size();
+			return m_shards[shardIndex];
+		};
+
+};
+
 } // namespace LRUCachePolicy
 
 // CacheEntry
@@ -646,6 +1305,12 @@ typename LRUCache<Key, Value, Policy, GetterKey>::Cost LRUCache<Key, Value, Poli
 	return m_policy.currentCost;
 }
 
+template<typename Key, typename Value, template <typename> class Policy, typename GetterKey>
+const Policy<LRUCache<Key, Value, Policy, GetterKey> > &LRUCache<Key, Value, Policy, GetterKey>::policy() const
+{
+	return m_policy;
+}
+
 template<typename Key, typename Value, template <typename> class Policy, typename GetterKey>
 Value LRUCache<Key, Value, Policy, GetterKey>::get( const GetterKey &key )
 {
@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef IECORE_MESHADJACENCY_H
+#define IECORE_MESHADJACENCY_H
+
+#include <vector>
+
+#include "IECore/Export.h"
+#include "IECore/RefCounted.h"
+
+namespace IECore
+{
+
+/// Provides the connectivity of a polygon mesh in a form suitable for
+/// parallel algorithms, as compressed arrays indexed by face, vertex and
+/// FaceVarying position. MeshAdjacency is immutable once constructed,
+/// so may be shared freely between threads. It is typically obtained
+/// via MeshPrimitive::adjacency() rather than constructed directly,
+/// so that it is shared by all meshes with the same topology.
+///
+/// Each FaceVarying position is the start of a half-edge running from
+/// its vertex to the vertex of the next position around the same face.
+/// \ingroup geometryGroup
+class IECORE_API MeshAdjacency : public RefCounted
+{
+
+	public :
+
+		IE_CORE_DECLAREMEMBERPTR( MeshAdjacency );
+
+		/// Builds the adjacency for the specified topology. Vertex ids
+		/// must be in the range [0, numVertices).
+		MeshAdjacency( const std::vector<int> &verticesPerFace, const std::vector<int> &vertexIds, size_t numVertices );
+		~MeshAdjacency() override;
+
+		size_t numFaces() const;
+		size_t numVertices() const;
+		size_t numFaceVaryings() const;
+
+		/// The index of the first FaceVarying position of each face,
+		/// followed by a final entry holding numFaceVaryings().
+		const std::vector<int> &faceOffsets() const;
+		/// The face containing each FaceVarying position.
+		const std::vector<int> &faceVaryingFaces() const;
+
+		/// The FaceVarying positions using vertex v are
+		/// `vertexFaceVaryings()[vertexOffsets()[v]]` to
+		/// `vertexFaceVaryings()[vertexOffsets()[v+1]-1]`, in
+		/// ascending order. The faces using a vertex may be found
+		/// via faceVaryingFaces().
+		const std::vector<int> &vertexOffsets() const;
+		const std::vector<int> &vertexFaceVaryings() const;
+
+		/// The FaceVarying positions following and preceding i
+		/// around its face.
+		int nextFaceVarying( int i ) const;
+		int previousFaceVarying( int i ) const;
+
+		/// The half-edge running in the opposite direction to each
+		/// half-edge, or -1 for edges used by only one face, or by
+		/// more than two faces or two faces with inconsistent winding.
+		const std::vector<int> &oppositeHalfEdges() const;
+		/// Returns true if the half-edge is used by no other face.
+		bool isBoundaryEdge( int halfEdge ) const;
+		/// Returns true if the vertex is on a boundary edge.
+		bool isBoundaryVertex( int vertex ) const;
+
+		/// Returns the number of bytes used.
+		size_t memoryUsage() const;
+
+	private :
+
+		std::vector<int> m_faceOffsets;
+		std::vector<int> m_faceVaryingFaces;
+		std::vector<int> m_vertexOffsets;
+		std::vector<int> m_vertexFaceVaryings;
+		std::vector<int> m_oppositeHalfEdges;
+		// Bytes rather than bools so that they may
+		// be written in parallel.
+		std::vector<unsigned char> m_boundaryEdges;
+		std::vector<unsigned char> m_boundaryVertices;
+
+};
+
+IE_CORE_DECLAREPTR( MeshAdjacency );
+
+} // namespace IECore
+
+#endif // IECORE_MESHADJACENCY_H
@@ -63,6 +63,11 @@ std::pair<PrimitiveVariable, PrimitiveVariable> calculateDistortion( const MeshP
 
 void resamplePrimitiveVariable( const MeshPrimitive *mesh, PrimitiveVariable& primitiveVariable, PrimitiveVariable::Interpolation interpolation );
 
+/// Resamples all the primitive variables in the map, giving the same results as calling
+/// resamplePrimitiveVariable() for each in turn. This is much faster when there are many
+/// variables, as they are all resampled in a single parallel pass over the mesh.
+void resamplePrimitiveVariables( const MeshPrimitive *mesh, PrimitiveVariableMap &primitiveVariables, PrimitiveVariable::Interpolation interpolation );
+
 /// create a new MeshPrimitive deleting faces from the input MeshPrimitive based on the facesToDelete uniform (int|float|bool) PrimitiveVariable
 /// When invert is set then zeros in facesToDelete indicate which faces should be deleted
 MeshPrimitivePtr deleteFaces( const MeshPrimitive *meshPrimitive, const PrimitiveVariable &facesToDelete, bool invert = false );
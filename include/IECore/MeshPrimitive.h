@@ -35,9 +35,12 @@
 #ifndef IECORE_MESHPRIMITIVE_H
 #define IECORE_MESHPRIMITIVE_H
 
+#include "tbb/spin_mutex.h"
+
 #include "IECore/Export.h"
 #include "IECore/Primitive.h"
 #include "IECore/VectorTypedData.h"
+#include "IECore/MeshAdjacency.h"
 
 namespace IECore
 {
@@ -82,6 +85,12 @@ class IECORE_API MeshPrimitive : public Primitive
 		void setInterpolation( const std::string &interpolation );
 		PolygonIterator faceBegin();
 		PolygonIterator faceEnd();
+		/// Returns the adjacency for the current topology, building it if
+		/// necessary. Adjacency is cached globally by topology, so is built
+		/// only once for all meshes sharing the same topology, and is retained
+		/// by the mesh until its topology changes. May be called concurrently
+		/// from multiple threads.
+		ConstMeshAdjacencyPtr adjacency() const;
 		//@}
 
 		size_t variableSize( PrimitiveVariable::Interpolation interpolation ) const override;
@@ -112,6 +121,9 @@ class IECORE_API MeshPrimitive : public Primitive
 		mutable int m_minVerticesPerFace;
 		mutable int m_maxVerticesPerFace;
 
+		mutable tbb::spin_mutex m_adjacencyMutex;
+		mutable ConstMeshAdjacencyPtr m_adjacency;
+
 };
 
 }
@@ -37,6 +37,7 @@
 
 #include <vector>
 
+#include "tbb/atomic.h"
 #include "tbb/mutex.h"
 
 #include "IECore/Export.h"
@@ -47,7 +48,10 @@
 namespace IECore
 {
 
-/// An implementation of PrimitiveEvaluator to allow spatial queries to be performed on MeshPrimitive instances
+/// An implementation of PrimitiveEvaluator to allow spatial queries to be performed on MeshPrimitive instances.
+/// Closest point and ray intersection queries are accelerated using a bounding volume hierarchy, which
+/// is built in parallel using the surface area heuristic, and stored in depth first order so that
+/// traversal is cache friendly.
 /// \ingroup geometryProcessingGroup
 class IECORE_API MeshPrimitiveEvaluator : public PrimitiveEvaluator
 {
@@ -126,6 +130,15 @@ class IECORE_API MeshPrimitiveEvaluator : public PrimitiveEvaluator
 		int intersectionPoints( const Imath::V3f &origin, const Imath::V3f &direction,
 			std::vector<PrimitiveEvaluator::ResultPtr> &results, float maxDistance = Imath::limits<float>::max() ) const override;
 
+		/// Performs closestPoint() for each of the points in parallel. On return, results contains a Result for
+		/// each point, or a null pointer where the query failed.
+		void closestPoints( const std::vector<Imath::V3f> &points, std::vector<PrimitiveEvaluator::ResultPtr> &results ) const;
+
+		/// Performs intersectionPoint() for each of the rays in parallel. On return, results contains a Result
+		/// for the nearest intersection of each ray, or a null pointer where the ray didn't hit the mesh.
+		void closestIntersectionPoints( const std::vector<Imath::V3f> &origins, const std::vector<Imath::V3f> &directions,
+			std::vector<PrimitiveEvaluator::ResultPtr> &results, float maxDistance = Imath::limits<float>::max() ) const;
+
 		/// A query specific to the MeshPrimitiveEvaluator, this just chooses a barycentric position on a specific triangle.
 		bool barycentricPosition( unsigned int triangleIndex, const Imath::V3f &barycentricCoordinates, PrimitiveEvaluator::Result *result ) const;
 
@@ -157,6 +170,7 @@ class IECORE_API MeshPrimitiveEvaluator : public PrimitiveEvaluator
 		const TriangleBoundVector *triangleBounds() const;
 		/// Returns a pointer to a tree that can be used for performing fast spacial queries.
 		///  The iterators in this tree point to elements in the vector returned by triangleBounds().
+		/// The tree isn't used by the MeshPrimitiveEvaluator itself, so is built on the first call.
 		const TriangleBoundTree *triangleBoundTree() const;
 
 		/// A type for storing the uv bounding box for a triangle.
@@ -181,15 +195,20 @@ class IECORE_API MeshPrimitiveEvaluator : public PrimitiveEvaluator
 		const std::vector<int> *m_meshVertexIds;
 
 		TriangleBoundVector m_triangles;
-		TriangleBoundTree *m_tree;
+		mutable tbb::atomic<TriangleBoundTree *> m_tree;
+		typedef tbb::mutex TreeMutex;
+		mutable TreeMutex m_treeMutex;
+
+		class BVH;
+		BVH *m_bvh;
 
 		UVBoundVector m_uvTriangles;
 		UVBoundTree *m_uvTree;
 
 		bool pointAtUVWalk( UVBoundTree::NodeIndex nodeIndex, const Imath::V2f &targetUV, Result *result ) const;
-		void closestPointWalk( TriangleBoundTree::NodeIndex nodeIndex, const Imath::V3f &p, float &closestDistanceSqrd, Result *result ) const;
-		bool intersectionPointWalk( TriangleBoundTree::NodeIndex nodeIndex, const Imath::Line3f &ray, float &maxDistSqrd, Result *result, bool &hit ) const;
-		void intersectionPointsWalk( TriangleBoundTree::NodeIndex nodeIndex, const Imath::Line3f &ray, float maxDistSqrd, std::vector<PrimitiveEvaluator::ResultPtr> &results ) const;
+		bool closestPointTraverse( const Imath::V3f &p, Result *result ) const;
+		bool intersectionPointTraverse( const Imath::Line3f &ray, float maxDistance, Result *result ) const;
+		void intersectionPointsTraverse( const Imath::Line3f &ray, float maxDistance, std::vector<PrimitiveEvaluator::ResultPtr> &results ) const;
 
 		void calculateMassProperties() const;
 		void calculateAverageNormals() const;
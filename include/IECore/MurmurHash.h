@@ -36,6 +36,7 @@
 #define IECORE_MURMURHASH_H
 
 #include <stdint.h>
+#include <algorithm>
 #include <iostream>
 
 #include "tbb/concurrent_hash_map.h"
@@ -143,6 +144,35 @@ class IECORE_API MurmurHash
 		inline MurmurHash &append( const Imath::Quatf *data, size_t numElements );
 		inline MurmurHash &append( const Imath::Quatd *data, size_t numElements );
 
+		/// Algorithms used by appendArray().
+		enum ArrayHashVersion
+		{
+			/// The whole array is hashed serially, exactly as by
+			/// `append( data, numElements )`.
+			SerialArrayHash = 0,
+			/// Arrays larger than a single chunk of 1Mb are split into
+			/// chunks which are hashed in parallel, and the chunk hashes
+			/// are then appended in order. The chunks are hashed serially
+			/// when built against TBB versions prior to 2018, which lack
+			/// the task isolation needed. The chunk size is fixed, so the
+			/// result doesn't depend on the number of threads, but it
+			/// differs from the SerialArrayHash result for the same data.
+			ChunkedArrayHash = 1
+		};
+
+		/// Sets the algorithm used by appendArray(). This defaults to SerialArrayHash,
+		/// so that existing hashes (and therefore any cache keys derived from them)
+		/// are not changed unless explicitly requested. It should be set once at
+		/// startup, since hashes computed with different versions can't be compared.
+		static void setArrayHashVersion( ArrayHashVersion version );
+		static ArrayHashVersion getArrayHashVersion();
+
+		/// Appends an array of elements, using the algorithm returned by
+		/// getArrayHashVersion(). This is used to hash the contents of the
+		/// VectorTypedData classes.
+		template<typename T>
+		inline MurmurHash &appendArray( const T *data, size_t numElements );
+
 		inline const MurmurHash &operator = ( const MurmurHash &other );
 
 		inline bool operator == ( const MurmurHash &other ) const;
@@ -156,6 +186,13 @@ class IECORE_API MurmurHash
 
 		inline void append( const void *data, size_t bytes, int elementSize );
 
+		// Used by appendArray() to hash the elements [begin, end) of
+		// a chunk, with the threading kept out of line.
+		typedef void (*ChunkHasher)( MurmurHash &h, const void *data, size_t begin, size_t end );
+		template<typename T>
+		static void appendChunk( MurmurHash &h, const void *data, size_t begin, size_t end );
+		void appendChunks( const void *data, size_t numElements, size_t chunkElements, ChunkHasher chunkHasher );
+
 		uint64_t m_h1;
 		uint64_t m_h2;
 
@@ -570,6 +570,36 @@ inline MurmurHash &MurmurHash::append( const Imath::Quatd *data, size_t numEleme
 	return *this;
 }
 	
+namespace Detail
+{
+
+// The size of the chunks used by MurmurHash::ChunkedArrayHash. This
+// is part of the definition of the hash, so must never be changed.
+static const size_t g_arrayHashChunkSize = 1024 * 1024;
+
+} // namespace Detail
+
+template<typename T>
+inline MurmurHash &MurmurHash::appendArray( const T *data, size_t numElements )
+{
+	const size_t chunkElements = std::max<size_t>( Detail::g_arrayHashChunkSize / sizeof( T ), 1 );
+	if( numElements <= chunkElements || getArrayHashVersion() == SerialArrayHash )
+	{
+		// Arrays which fit in a single chunk hash identically
+		// in both versions.
+		return append( data, numElements );
+	}
+
+	appendChunks( data, numElements, chunkElements, &appendChunk<T> );
+	return *this;
+}
+
+template<typename T>
+void MurmurHash::appendChunk( MurmurHash &h, const void *data, size_t begin, size_t end )
+{
+	h.append( static_cast<const T *>( data ) + begin, end - begin );
+}
+
 inline const MurmurHash &MurmurHash::operator = ( const MurmurHash &other )
 {
 	m_h1 = other.m_h1;
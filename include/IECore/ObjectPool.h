@@ -35,6 +35,8 @@
 #ifndef IECORE_OBJECTPOOL_H
 #define IECORE_OBJECTPOOL_H
 
+#include <vector>
+
 #include "boost/shared_ptr.hpp"
 
 #include "IECore/Export.h"
@@ -46,6 +48,13 @@ namespace IECore
 
 IE_CORE_FORWARDDECLARE( ObjectPool );
 
+namespace LRUCachePolicy
+{
+
+struct ShardStatistics;
+
+} // namespace LRUCachePolicy
+
 /// \addtogroup environmentGroup
 ///
 /// <b>IECORE_OBJECTPOOL_MEMORY</b><br>
@@ -55,6 +64,8 @@ IE_CORE_FORWARDDECLARE( ObjectPool );
 /// The ObjectPool class implements a cache of Object instances indexed by their own hash and limited by the memory consumption.
 /// The function defaultObjectPool() returns a singleton object that should be used by most of the operations,
 /// so there will be one single place where the total memory used by IECore objects is defined.
+/// All pools are registered with the CacheRegistry, which may lower their memory limit to
+/// keep within the global cache budget.
 ///
 /// \ingroup utilityGroup
 class IECORE_API ObjectPool : public RefCounted
@@ -81,6 +92,12 @@ class IECORE_API ObjectPool : public RefCounted
 		/// Returns the current memory cost of items held in the pool
 		size_t memoryUsage() const;
 
+		/// Fills stats with the statistics for each shard of the pool's
+		/// internal storage. Note that retrieve() records an empty entry for
+		/// hashes which are not in the pool, so a subsequent store() of the
+		/// same hash counts as a hit.
+		void shardStatistics( std::vector<LRUCachePolicy::ShardStatistics> &stats ) const;
+
 		/// Returns true if the object with the given hash is in the pool.
 		/// Note: this function doesn't garantee that retrieve() will return an object in a multi-threaded application.
 		bool contains( const MurmurHash &hash ) const;
@@ -49,6 +49,11 @@ IE_CORE_FORWARDDECLARE( SceneCache );
 /// The destruction of the root scene will trigger the recursive computation of the bounding boxes for all the
 /// locations that no bounds were written. It will also store (without duplication) all the
 /// sample times used by objects, transforms, bounds and attributes.
+/// When writing to a StreamIndexedIO (which includes files), sibling locations may be created and written
+/// concurrently from different threads, although each location must only be written by one thread at a time.
+/// Objects, attributes and transforms are saved on a worker thread, so an error while saving them is
+/// reported by the next write to any location, or by flush(). The final bounding box computation also
+/// processes siblings in parallel.
 /// \ingroup ioGroup
 class IECORE_API SceneCache : public SampledSceneInterface
 {
@@ -129,9 +134,38 @@ class IECORE_API SceneCache : public SampledSceneInterface
 
 		void hash( HashType hashType, double time, MurmurHash &h ) const override;
 
+		/// Reads the stored samples either side of the requested time into the
+		/// caches shared by all the locations of this file. Only available when reading.
+		PrefetchMonitorPtr prefetch( const std::vector<Path> &paths, double time, int what = PrefetchAll, PrefetchMonitor *monitor = nullptr ) const override;
+
 		/// tells you if this scene cache is read only or writable:
 		bool readOnly() const;
 
+		/// Enables delta encoding for the objects written from now on, anywhere in the file.
+		/// When enabled, the "P", "N" and "velocity" primitive variables of a Primitive are stored
+		/// as the bitwise XOR with the previous sample, provided they have the same type and length.
+		/// For deforming geometry most of the bits are then zero, so this is intended for use with
+		/// StreamIndexedIO::setDataCompression(), which it allows to compress much further. One in
+		/// every keyframeInterval samples is stored in full, bounding the number of samples which
+		/// must be read to decode a sample out of order. Reading decodes the samples transparently,
+		/// but files using delta encoding can't be read correctly by older versions of the library.
+		/// Only available when writing.
+		void setObjectDeltaEncoding( bool enabled, size_t keyframeInterval = 16 );
+		/// Sets the delta encoding used by files opened for writing from now on.
+		static void setDefaultObjectDeltaEncoding( bool enabled, size_t keyframeInterval = 16 );
+
+		/// Enables the concurrent writing described above, which is enabled by default when
+		/// writing to a StreamIndexedIO. When disabled, samples are saved on the calling thread
+		/// and the final flush processes one location at a time, as in previous versions, and
+		/// only one thread may write to the file. Only available when writing.
+		void setConcurrentWriting( bool enabled );
+
+		/// Completes the file, as the destruction of the root location otherwise does, waiting
+		/// for the samples being saved in the background and throwing if anything failed. Errors
+		/// from the destructor can only be logged, so writers should call this when they are done.
+		/// No further changes may be made afterwards. Only available on the root location when writing.
+		void flush();
+
 		// The attribute names used to mark animated topology and primitive variables
 		// when SceneCache objects are Primitives.
 		static const Name &animatedObjectTopologyAttribute;
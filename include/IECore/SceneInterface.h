@@ -38,6 +38,9 @@
 #include "OpenEXR/ImathBox.h"
 #include "OpenEXR/ImathMatrix.h"
 
+#include "tbb/atomic.h"
+#include "tbb/task_group.h"
+
 #include "IECore/Export.h"
 #include "IECore/Object.h"
 #include "IECore/Renderable.h"
@@ -259,6 +262,79 @@ class IECORE_API SceneInterface : public RunTimeTyped
 		/// as well as add the time dependency as applicable.
 		virtual void hash( HashType hashType, double time, MurmurHash &h ) const;
 
+		/*
+		 * Prefetching
+		 */
+
+		/// Flags used to choose what is read by prefetch().
+		enum PrefetchFlags {
+			PrefetchBound = 1,
+			PrefetchTransform = 2,
+			PrefetchAttributes = 4,
+			PrefetchObject = 8,
+			PrefetchAll = PrefetchBound | PrefetchTransform | PrefetchAttributes | PrefetchObject
+		};
+
+		/// Tracks the reads scheduled by prefetch(), allowing them to be waited on or cancelled.
+		/// Derived classes may implement progress() to be notified as locations are read. Since
+		/// the reads in flight may still call progress() until they complete, such classes must
+		/// call cancel() and wait() in their own destructor, before the derived part is destroyed.
+		class IECORE_API PrefetchMonitor : public RefCounted
+		{
+			public :
+
+				IE_CORE_DECLAREMEMBERPTR( PrefetchMonitor );
+
+				PrefetchMonitor();
+				/// Cancels any outstanding reads and waits for the ones in flight.
+				~PrefetchMonitor() override;
+
+				/// Requests that the locations not read yet are skipped.
+				void cancel();
+				bool cancelled() const;
+
+				/// Blocks until all the scheduled locations have been read or skipped.
+				/// Rethrows any exception raised while reading them.
+				void wait();
+
+				/// Returns the number of locations read or skipped so far.
+				size_t numCompleted() const;
+				/// Returns the number of locations scheduled so far.
+				size_t numScheduled() const;
+
+				/// Used by implementations of prefetch() to run f in the background. The
+				/// functor is expected to call locationCompleted() once for each of the
+				/// numLocations it reads, including the ones skipped due to cancellation.
+				template<typename F>
+				void schedule( size_t numLocations, const F &f );
+				void locationCompleted();
+
+			protected :
+
+				/// Called from a background thread each time a location has been read or skipped,
+				/// unless the monitor has been cancelled. The default implementation does nothing.
+				virtual void progress( size_t numCompleted, size_t numScheduled );
+
+			private :
+
+				// Held by pointer so it can be waited on before it is destroyed.
+				tbb::task_group *m_tasks;
+				tbb::atomic<size_t> m_numScheduled;
+				tbb::atomic<size_t> m_numCompleted;
+				tbb::atomic<bool> m_cancelled;
+
+		};
+
+		IE_CORE_DECLAREPTR( PrefetchMonitor );
+
+		/// Schedules background reads for the given locations at the given time, so that subsequent
+		/// reads may be served from memory. The paths are full paths and what is a combination of
+		/// PrefetchFlags. Returns immediately with the monitor tracking the reads, which is the
+		/// given monitor if there is one. Destroying the monitor cancels the prefetch, so it must
+		/// be kept alive for as long as the reads are wanted.
+		/// The base class implementation schedules nothing.
+		virtual PrefetchMonitorPtr prefetch( const std::vector<Path> &paths, double time, int what = PrefetchAll, PrefetchMonitor *monitor = nullptr ) const;
+
 		/*
 		 * Utility functions
 		 */
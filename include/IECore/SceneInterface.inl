@@ -50,6 +50,13 @@ SceneInterfacePtr SceneInterface::FileFormatDescription<T>::creator( const std::
 	return new T( fileName, mode );
 }
 
+template<typename F>
+void SceneInterface::PrefetchMonitor::schedule( size_t numLocations, const F &f )
+{
+	m_numScheduled += numLocations;
+	m_tasks->run( f );
+}
+
 } // namespace IECore
 
 #endif // IE_CORE_SCENEINTERFACE_INL
@@ -51,7 +51,17 @@ namespace IECore
 {
 /// Abstract base class implementation of IndexedIO which operates with a stream file handle.
 /// It handles data instancing transparently for compact file sizes.
-/// Read operations are thread safe on read-only opened files.
+/// Read operations are thread safe on read-only opened files. Data reads go through
+/// StreamFile::positionalRead(), which derived classes may implement without locking so
+/// that concurrent reads from different threads are not serialised.
+/// On writable files, different locations may be written concurrently from different threads.
+/// Data is hashed and compressed without holding any lock, and only the update of the index
+/// and the writing of the final block to the stream are serialised. Writing the same entry
+/// from several threads, or committing a directory while its descendants are being written,
+/// is not supported.
+/// Data blocks and the index may optionally be compressed - see setDataCompression() and
+/// setIndexCompression(). Files using these options are written with format version 6,
+/// otherwise version 5 is written so that older versions of the library can read them.
 /// \ingroup ioGroup
 class IECORE_API StreamIndexedIO : public IndexedIO
 {
@@ -59,6 +69,36 @@ class IECORE_API StreamIndexedIO : public IndexedIO
 
 		IE_CORE_DECLARERUNTIMETYPED( StreamIndexedIO, IndexedIO );
 
+		/// Codecs used for data blocks and the index.
+		enum Compression
+		{
+			Uncompressed = 0,
+			/// Deflate with gzip framing. This is the index codec used by all files
+			/// prior to version 6, and is not supported for data blocks.
+			Gzip = 1,
+			/// Deflate with the lighter zlib framing, at the fastest level unless
+			/// told otherwise. This is the same algorithm as Gzip, and is offered
+			/// because zlib is already a dependency - there is not yet a dedicated
+			/// fast codec such as LZ4 or Zstd.
+			Deflate = 2
+		};
+
+		/// Sets the codec used for data blocks written from now on. Files opened for
+		/// Append keep the settings they were written with, until this is called. The level is passed
+		/// to the codec, with -1 choosing the fastest setting. When shuffle is true, arrays
+		/// of 2, 4 and 8 byte types have their bytes grouped by significance before being
+		/// compressed, which greatly improves the compression of floating point data.
+		/// Small blocks, and blocks which don't shrink when compressed, are stored uncompressed.
+		void setDataCompression( Compression compression, int level = -1, bool shuffle = true );
+		/// Sets the codec used for the index and sub-indices. This may only be changed
+		/// for new files, before anything has been committed with commit().
+		void setIndexCompression( Compression compression );
+
+		/// The compression settings applied to files opened for writing from now on.
+		/// These may be called concurrently with the opening of files in other threads.
+		static void setDefaultDataCompression( Compression compression, int level = -1, bool shuffle = true );
+		static void setDefaultIndexCompression( Compression compression );
+
 		~StreamIndexedIO() override;
 
 		IndexedIO::OpenMode openMode() const override;
@@ -180,6 +220,23 @@ class IECORE_API StreamIndexedIO : public IndexedIO
 				// utility function that returns a temporary buffer for io operations (not thread safe).
 				char *ioBuffer( unsigned long size );
 
+				/// Reads size bytes starting at the absolute position pos. This function is thread safe
+				/// and does not modify the get pointer of the stream. The default implementation locks
+				/// mutex() and uses seekg()/read(), derived classes may override it to provide lock-free
+				/// positional reads (for instance using pread()).
+				virtual void positionalRead( char *buffer, size_t size, size_t pos );
+
+				/// Returns a pointer to the size bytes starting at the absolute position pos,
+				/// if the file is mapped into memory, and null otherwise. The pointer remains
+				/// valid for the lifetime of the StreamFile. This function is thread safe. The
+				/// default implementation returns null.
+				virtual const char *mappedData( size_t size, size_t pos );
+
+				/// Called once the data returned by mappedData() has been consumed, so that
+				/// its pages need no longer be resident in memory. This function is thread
+				/// safe. The default implementation does nothing.
+				virtual void releaseMappedData( size_t size, size_t pos );
+
 				/// called after the main index is saved to disk, ready to close the file.
 				virtual void flush( size_t endPosition );
 
@@ -439,6 +439,7 @@ enum TypeId
 	EXRDeepImageReaderTypeId = 391, // obsolete - available for reuse
 	EXRDeepImageWriterTypeId = 392, // obsolete - available for reuse
 	ExternalProceduralTypeId = 393,
+	FlatIndexedIOTypeId = 394,
 
 	// Remember to update TypeIdBinding.cpp !!!
 
@@ -147,7 +147,7 @@ class SharedDataHolder
 		MurmurHash hash() const
 		{
 			MurmurHash result;
-			result.append( &(readable()[0]), readable().size() );
+			result.appendArray( &(readable()[0]), readable().size() );
 			return result;
 		}
 
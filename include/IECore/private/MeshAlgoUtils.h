@@ -0,0 +1,115 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef IECORE_MESHALGOUTILS_H
+#define IECORE_MESHALGOUTILS_H
+
+#include <vector>
+
+namespace IECore
+{
+namespace Detail
+{
+
+/// Fills offsets with the index of the first FaceVarying value of each face,
+/// followed by a final entry holding the total number of FaceVarying values.
+/// Allows faces to be processed independently, and therefore in parallel.
+inline void faceOffsets( const std::vector<int> &verticesPerFace, std::vector<int> &offsets )
+{
+	offsets.resize( verticesPerFace.size() + 1 );
+	int offset = 0;
+	for( size_t i = 0; i < verticesPerFace.size(); ++i )
+	{
+		offsets[i] = offset;
+		offset += verticesPerFace[i];
+	}
+	offsets.back() = offset;
+}
+
+/// Fills offsets so that the number of uses of each of the values [0, numIndices)
+/// in indices is given by `offsets[i+1] - offsets[i]`. This provides the row
+/// offsets for the compressed sparse row mappings below.
+inline void indexUsageOffsets( const std::vector<int> &indices, size_t numIndices, std::vector<int> &offsets )
+{
+	offsets.clear();
+	offsets.resize( numIndices + 1, 0 );
+	for( std::vector<int>::const_iterator it = indices.begin(), eIt = indices.end(); it != eIt; ++it )
+	{
+		offsets[*it + 1]++;
+	}
+	for( size_t i = 1; i <= numIndices; ++i )
+	{
+		offsets[i] += offsets[i-1];
+	}
+}
+
+/// Builds a compressed sparse row mapping from each value [0, numIndices) to the
+/// positions in indices at which it is used. The positions for value i are
+/// `faceVaryings[offsets[i]]` to `faceVaryings[offsets[i+1]-1]`, in ascending order.
+/// Accumulating over these in order gives the same result as looping over the
+/// faces serially, but allows each value to be computed independently, without
+/// scattered writes.
+inline void indexFaceVaryings( const std::vector<int> &indices, size_t numIndices, std::vector<int> &offsets, std::vector<int> &faceVaryings )
+{
+	indexUsageOffsets( indices, numIndices, offsets );
+
+	std::vector<int> next( offsets.begin(), offsets.end() - 1 );
+	faceVaryings.resize( indices.size() );
+	for( size_t i = 0; i < indices.size(); ++i )
+	{
+		faceVaryings[next[indices[i]]++] = i;
+	}
+}
+
+/// As above, but mapping to the faces using each value rather than the individual
+/// FaceVarying positions. A face using a value more than once is listed once per use.
+inline void indexFaces( const std::vector<int> &faceOffsets, const std::vector<int> &indices, size_t numIndices, std::vector<int> &offsets, std::vector<int> &faces )
+{
+	indexUsageOffsets( indices, numIndices, offsets );
+
+	std::vector<int> next( offsets.begin(), offsets.end() - 1 );
+	faces.resize( indices.size() );
+	for( size_t f = 0, numFaces = faceOffsets.size() - 1; f < numFaces; ++f )
+	{
+		for( int i = faceOffsets[f]; i < faceOffsets[f+1]; ++i )
+		{
+			faces[next[indices[i]]++] = f;
+		}
+	}
+}
+
+} // namespace Detail
+} // namespace IECore
+
+#endif // IECORE_MESHALGOUTILS_H
@@ -46,9 +46,23 @@ namespace IECoreImage
 
 
 /// Connects to a DisplayDriverServer and forwards the image to the server using socket messages.
-/// This client class works synchronously.
+/// Calls to imageData() encode the bucket and queue it to be sent by a separate thread, so they
+/// may be made concurrently and only block when the "displayMaxBucketsInFlight" IntData parameter
+/// (defaulting to 32) is exceeded. imageClose() waits for all buckets to be sent.
 /// It forwards all parameters to the server and also includes one called "clientPID" to help grouping AOVs from the same render.
 /// You must set the parameter 'remoteDisplayType' with a registered display driver to be instantiated in the server side.
+/// The optional StringData parameters "displayPixelFormat" ( "float" or "half" ) and "displayCompression"
+/// ( "none" or "zip" ) request a more compact encoding for the pixels, which is used if the server
+/// supports it.
+/// When the server is on the same host, the pixels are passed through a shared memory ring buffer
+/// rather than the socket, which carries only the location of each bucket. This may be disabled
+/// with a "displaySharedMemory" BoolData parameter, and the size of the buffer set in bytes with
+/// a "displaySharedMemorySize" IntData parameter ( defaulting to 64Mb ).
+///
+/// \note No encoding is zero copy. Because imageData() returns before the bucket is sent, the
+/// pixels are always copied out of the caller's buffer first. With the default "float" and "none"
+/// encoding, the bucket is copied into the send queue unchanged. With shared memory, it is copied
+/// into the ring buffer. The other encodings replace this copy with the conversion or compression.
 /// \ingroup renderingGroup
 class IECOREIMAGE_API ClientDisplayDriver : public DisplayDriver
 {
@@ -68,6 +82,11 @@ class IECOREIMAGE_API ClientDisplayDriver : public DisplayDriver
 		// Get the port number or service name
 		std::string port() const;
 
+		// Returns true if the server has agreed to receive the pixels through
+		// shared memory. Buckets too large for the shared memory are still sent
+		// over the socket.
+		bool sharedMemory() const;
+
 		bool scanLineOrderOnly() const override;
 
 		bool acceptsRepeatedData() const override;
@@ -81,7 +100,7 @@ class IECOREIMAGE_API ClientDisplayDriver : public DisplayDriver
 		static const DisplayDriverDescription<ClientDisplayDriver> g_description;
 
 		void sendHeader( int msg, size_t dataSize );
-		size_t receiveHeader( int msg );
+		size_t receiveHeader( int msg, int *protocolVersion = nullptr );
 
 		class PrivateData;
 		IE_CORE_DECLAREPTR( PrivateData );
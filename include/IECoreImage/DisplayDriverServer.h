@@ -52,7 +52,13 @@ namespace IECoreImage
 /// Server class that receives images from ClientDisplayDriver connections and forwards the data to local display drivers.
 /// The type of the local display drivers is defined by the 'remoteDisplayType' parameter.
 ///
-/// The server object creates a thread to control the socket connection. The thread dies when the object is destroyed.
+/// The server object creates a pool of threads to service the client connections, so that images from several
+/// clients are received concurrently. The threads die when the object is destroyed.
+///
+/// \threading The pool has one thread per core, up to a maximum of 8. Messages from a single client are handled
+/// in order, so each display driver only receives one call at a time, but successive calls may be made from
+/// different threads. Drivers for different clients are called concurrently, so display driver types used with
+/// the server must protect any state they share between instances, as ImageDisplayDriver does for its image pool.
 /// \ingroup renderingGroup
 class IECOREIMAGE_API DisplayDriverServer : public IECore::RunTimeTyped
 {
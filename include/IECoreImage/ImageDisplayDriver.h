@@ -47,7 +47,17 @@ namespace IECoreImage
 {
 
 /// Display driver that creates an ImagePrimitive object held
-/// in memory.
+/// in memory. Pixels are stored internally in tiles, so imageData()
+/// may be called concurrently from several threads, and snapshots
+/// of the image in progress may be taken cheaply at any time.
+///
+/// \note Until imageClose() is called, the tiles are held in addition
+/// to the ImagePrimitive returned by image(), so an image in progress
+/// uses roughly twice the memory of the final image. imageClose()
+/// brings the image up to date and releases the tiles, after which
+/// no more calls to imageData() are accepted. In Python, image(),
+/// storedImage() and removeStoredImage() each return a copy of the
+/// image, so every call costs a further full copy.
 /// \ingroup renderingGroup
 class IECOREIMAGE_API ImageDisplayDriver : public DisplayDriver
 {
@@ -65,8 +75,19 @@ class IECOREIMAGE_API ImageDisplayDriver : public DisplayDriver
 		void imageData( const Imath::Box2i &box, const float *data, size_t dataSize ) override;
 		void imageClose() override;
 
-		/// Access to the image being created. This should always be valid for reading, even
-		/// before imageClose() has been called.
+		/// Returns a snapshot of the image being created. This may be called at any
+		/// time, even before imageClose() has been called, and is consistent with
+		/// respect to concurrent calls to imageData(). If nothing has been written
+		/// since the last call, the previous snapshot is returned without blocking
+		/// imageData(). Otherwise the snapshot is updated incrementally, so that only
+		/// the tiles modified since the last snapshot are copied.
+		///
+		/// \note Channels are stored contiguously in the ImagePrimitive, so
+		/// unmodified data can't be shared between successive snapshots. If the
+		/// previous snapshot is still referenced (including via a copy of it, such as
+		/// the one returned to Python), each channel is copied in full before it is
+		/// updated. Callers should therefore release a snapshot before requesting
+		/// the next one.
 		ConstImagePrimitivePtr image() const;
 
 		//! @name Image pool
@@ -89,7 +110,9 @@ class IECOREIMAGE_API ImageDisplayDriver : public DisplayDriver
 
 		static const DisplayDriverDescription<ImageDisplayDriver> g_description;
 
-		ImagePrimitivePtr m_image;
+		class TileStore;
+		IE_CORE_DECLAREPTR( TileStore );
+		TileStorePtr m_tileStore;
 
 };
 
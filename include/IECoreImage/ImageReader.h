@@ -81,6 +81,12 @@ class IECOREIMAGE_API ImageReader : public IECore::Reader
 		/// If true, the values will not be linearized nor converted to float.
 		IECore::BoolParameter *rawChannelsParameter();
 		const IECore::BoolParameter *rawChannelsParameter() const;
+		/// The parameter specifying the region of the image to load. If this
+		/// is empty (the default) then the data window stored in the file is
+		/// loaded. Pixels outside the data window of the file are filled with
+		/// zero.
+		IECore::Box2iParameter *dataWindowParameter();
+		const IECore::Box2iParameter *dataWindowParameter() const;
 		//@}
 
 		//! @name Image specific reading functions
@@ -101,11 +107,17 @@ class IECOREIMAGE_API ImageReader : public IECore::Reader
 		/// each element corresponds to a pixel. If that does not correspond
 		/// to the native file format, then it should return a FloatVectorData.
 		IECore::DataPtr readChannel( const std::string &name, bool raw = false );
+		/// As readChannel(), but reads several channels at once, filling the
+		/// channels vector with the data for each name in turn. The file is
+		/// decoded in parallel, and all channels are deinterleaved and colour
+		/// converted in a single pass, so this is considerably faster than
+		/// repeated calls to readChannel().
+		void readChannels( const std::vector<std::string> &names, std::vector<IECore::DataPtr> &channels, bool raw = false );
 		//@}
 
 	protected :
 
-		/// Implemented using displayWindow(), dataWindow(), channelNames() and readChannel().
+		/// Implemented using displayWindow(), dataWindow(), channelNames() and readChannels().
 		IECore::ObjectPtr doOperation( const IECore::CompoundObject *operands ) override;
 
 	private :
@@ -113,11 +125,14 @@ class IECOREIMAGE_API ImageReader : public IECore::Reader
 		/// Fills the passed vector with the intersection of channelNames() and
 		/// the channels requested by the user in channelNamesParameter().
 		void channelsToRead( std::vector<std::string> &names );
+		/// Returns the requested window, or dataWindow() if it is empty.
+		Imath::Box2i dataWindowToRead( const Imath::Box2i &requested );
 
 		static const ReaderDescription<ImageReader> g_readerDescription;
 
 		IECore::StringVectorParameterPtr m_channelNamesParameter;
 		IECore::BoolParameterPtr m_rawChannelsParameter;
+		IECore::Box2iParameterPtr m_dataWindowParameter;
 
 		class Implementation;
 		std::unique_ptr<Implementation> m_implementation;
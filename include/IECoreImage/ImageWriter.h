@@ -85,6 +85,11 @@ class IECOREIMAGE_API ImageWriter : public IECore::Writer
 		IECore::CompoundParameter *formatSettingsParameter();
 		const IECore::CompoundParameter *formatSettingsParameter() const;
 
+		/// The parameter specifying the maximum number of threads
+		/// used to convert and write the image.
+		IECore::IntParameter *threadsParameter();
+		const IECore::IntParameter *threadsParameter() const;
+
 		/// Convenience function to access the channels that will be written
 		/// to disk. This is calculated based on the requested channelNames,
 		/// the channels existing in the ImagePrimitive, and the capabilities
@@ -105,6 +110,7 @@ class IECOREIMAGE_API ImageWriter : public IECore::Writer
 		IECore::StringVectorParameterPtr m_channelsParameter;
 		IECore::BoolParameterPtr m_rawChannelsParameter;
 		IECore::CompoundParameterPtr m_formatSettingsParameter;
+		IECore::IntParameterPtr m_threadsParameter;
 
 };
 
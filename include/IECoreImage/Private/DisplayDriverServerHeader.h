@@ -35,6 +35,14 @@
 #ifndef IECOREIMAGE_DISPLAYDRIVERSERVERHEADER
 #define IECOREIMAGE_DISPLAYDRIVERSERVERHEADER
 
+#include <string>
+#include <vector>
+
+#include "boost/noncopyable.hpp"
+#include "boost/cstdint.hpp"
+
+#include "tbb/atomic.h"
+
 #include "IECoreImage/DisplayDriverServer.h"
 
 namespace IECoreImage
@@ -43,22 +51,37 @@ namespace IECoreImage
 /* Header block used by back and forth messages with the server.
 * 7 bytes long:
 * [0] - magic number ( 0x82 )
-* [1] - protocol version ( 1 )
-* [2] - message type ( imageOpen, imageData, imageClose )
+* [1] - protocol version ( 2 to 4 )
+* [2] - message type ( imageOpen, imageData, imageClose, imageSharedData )
 * [3-6] - length of following data block.
+*
+* Clients request protocol version 3 by passing a "displayProtocolVersion"
+* parameter with imageOpen, which is sent with a version 2 header and written
+* with MemoryIndexedIO so that older servers may still accept it. Servers supporting version 3 then
+* reply using version 3 headers, and send an additional imageOpen reply
+* containing the DisplayDriverServerEncoding to be used for imageData.
+*
+* With version 4, clients on the same host as the server also pass a
+* "displaySharedMemoryFile" parameter naming a DisplayDriverServerSharedMemory
+* region. The encoding reply gains a third byte, which is 1 if the server
+* mapped the region, in which case the client may send imageSharedData
+* messages with a SharedBucket in place of the pixels. Servers only map
+* the region for clients connected from the same address, and only if
+* it is a file which the client could have created for the purpose.
 */
 class DisplayDriverServerHeader
 {
 	public:
 
-		enum MessageType { imageOpen = 1, imageData = 2, imageClose = 3, exception = 4 };
+		enum MessageType { imageOpen = 1, imageData = 2, imageClose = 3, exception = 4, imageSharedData = 5 };
 
 		static const unsigned char headerLength = 7;
 		static const unsigned char magicNumber = 0x82;
-		static const unsigned char currentProtocolVersion = 2;
+		static const unsigned char currentProtocolVersion = 4;
+		static const unsigned char minimumProtocolVersion = 2;
 
 		DisplayDriverServerHeader();
-		DisplayDriverServerHeader( MessageType msg, size_t dataSize );
+		DisplayDriverServerHeader( MessageType msg, size_t dataSize, unsigned char protocolVersion = currentProtocolVersion );
 
 		// returns internal buffer ( length = headerLength constant )
 		unsigned char *buffer();
@@ -75,11 +98,99 @@ class DisplayDriverServerHeader
 		// returns the message type defined in the header.
 		MessageType messageType();
 
+		// returns the protocol version defined in the header.
+		unsigned char protocolVersion();
+
 	private:
 
 		unsigned char m_header[ headerLength ];
 };
 
+/* Encoding of the pixels in imageData messages, negotiated when the image
+* is opened with protocol version 3. The data block of an imageData message
+* contains the box followed by the encoded pixels. When compression is used,
+* the encoded pixels are preceded by their uncompressed size in 4 bytes.
+*/
+class DisplayDriverServerEncoding
+{
+	public:
+
+		enum PixelFormat { floatFormat = 0, halfFormat = 1 };
+		enum Compression { noCompression = 0, zipCompression = 1 };
+
+		DisplayDriverServerEncoding( PixelFormat pixelFormat = floatFormat, Compression compression = noCompression );
+
+		// Makes an encoding from the "displayPixelFormat" and "displayCompression"
+		// values, falling back to floatFormat and noCompression for unknown values.
+		DisplayDriverServerEncoding( const std::string &pixelFormat, const std::string &compression );
+
+		PixelFormat pixelFormat() const;
+		Compression compression() const;
+
+		// returns true if the pixels are sent as uncompressed floats,
+		// as they are in protocol version 2.
+		bool raw() const;
+
+		// Appends the encoding of dataSize floats to buffer.
+		void encode( const float *data, size_t dataSize, std::vector<char> &buffer ) const;
+		// Decodes size bytes of encoded pixels into result.
+		void decode( const char *data, size_t size, std::vector<float> &result ) const;
+
+	private:
+
+		PixelFormat m_pixelFormat;
+		Compression m_compression;
+};
+
+/* A region of memory shared between a client and a server on the same host,
+* used as a ring buffer for the encoded pixels of imageSharedData messages.
+* The client writes each bucket at increasing positions, wrapping around
+* at the end of the region, and the server advances readPosition() as it
+* consumes them, so the client knows which parts may be reused.
+*/
+class DisplayDriverServerSharedMemory : boost::noncopyable
+{
+	public:
+
+		// Describes the location of a bucket in the region. It follows
+		// the box in the data block of an imageSharedData message.
+		struct SharedBucket
+		{
+			boost::uint64_t offset;
+			boost::uint64_t size;
+			// the write position following this bucket, which the server
+			// stores in readPosition() once it has consumed the bucket.
+			boost::uint64_t endPosition;
+		};
+
+		// Creates a new region with room for size bytes of pixels, for use by a client.
+		explicit DisplayDriverServerSharedMemory( size_t size );
+		// Maps an existing region created by a client, for use by a server. Throws
+		// unless fileName names a regular file created by the constructor above,
+		// belonging to the current user and accessible only to them.
+		explicit DisplayDriverServerSharedMemory( const std::string &fileName );
+		~DisplayDriverServerSharedMemory();
+
+		const std::string &fileName() const;
+		// Removes the file from the filesystem, leaving the mapping intact.
+		// Clients call this once the server has had the chance to map it.
+		void unlink();
+
+		// The number of bytes available for pixels.
+		size_t capacity() const;
+		// The start of the pixels.
+		char *data();
+
+		tbb::atomic<boost::uint64_t> &readPosition();
+
+	private:
+
+		std::string m_fileName;
+		bool m_owner;
+		char *m_map;
+		size_t m_mapSize;
+};
+
 } // namespace IECoreImage
 
 #endif // IECOREIMAGE_DISPLAYDRIVERSERVERHEADER
@@ -38,6 +38,7 @@
 #include "DDImage/Iop.h"
 
 #include "IECoreImage/DisplayDriverServer.h"
+#include "IECoreImage/ImagePrimitive.h"
 
 namespace IECoreNuke
 {
@@ -83,6 +84,9 @@ class DisplayIop : public DD::Image::Iop
 		// and those ops would have missed the display driver creation.
 		unsigned int m_updateCount;
 		IECoreNuke::NukeDisplayDriverPtr m_driver;
+		// snapshot of the image taken in _validate(), and
+		// used by engine().
+		IECoreImage::ConstImagePrimitivePtr m_image;
 
 };
 
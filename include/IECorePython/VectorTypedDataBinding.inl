@@ -35,14 +35,374 @@
 #ifndef IECOREPYTHON_VECTORTYPEDDATABINDING_INL
 #define IECOREPYTHON_VECTORTYPEDDATABINDING_INL
 
+#include "boost/python/def_visitor.hpp"
+
+#include "OpenEXR/half.h"
+
+#include "IECore/ByteOrder.h"
+
 #include "IECorePython/IECoreBinding.h"
 #include "IECorePython/RunTimeTypedBinding.h"
 
+#include <cstring>
+#include <map>
 #include <sstream>
 
 namespace IECorePython
 {
 
+namespace Detail
+{
+
+/// Describes the element types which may be shared with python using the
+/// buffer protocol, providing the struct module format character used by
+/// PEP 3118 and the type kind used by numpy's `__array_interface__`.
+template<typename T>
+struct BufferFormat
+{
+	static const bool supported = false;
+};
+
+#define IECOREPYTHON_DEFINEBUFFERFORMAT( TYPE, FORMAT, KIND )	\
+template<>														\
+struct BufferFormat<TYPE>										\
+{																\
+	static const bool supported = true;							\
+	static const char *format() { return FORMAT; }				\
+	static char kind() { return KIND; }							\
+};
+
+IECOREPYTHON_DEFINEBUFFERFORMAT( half, "e", 'f' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( float, "f", 'f' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( double, "d", 'f' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( char, "b", 'i' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( unsigned char, "B", 'u' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( short, "h", 'i' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( unsigned short, "H", 'u' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( int, "i", 'i' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( unsigned int, "I", 'u' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( int64_t, "q", 'i' )
+IECOREPYTHON_DEFINEBUFFERFORMAT( uint64_t, "Q", 'u' )
+
+#undef IECOREPYTHON_DEFINEBUFFERFORMAT
+
+/// The number of writable buffers currently exported by each VectorTypedData.
+/// Only accessed with the GIL held.
+inline std::map<const IECore::Data *, size_t> &writableBufferExports()
+{
+	static std::map<const IECore::Data *, size_t> g_exports;
+	return g_exports;
+}
+
+} // namespace Detail
+
+/// Implements the python buffer protocol and numpy's `__array_interface__` for
+/// VectorTypedData with a base type, so that the contents may be accessed from
+/// python (and numpy in particular) without copying them. Vectors of types with
+/// more than one component (V3f for instance) are presented as two dimensional
+/// arrays.
+///
+/// Read-only views use readable() and so never copy the data. Writable views use
+/// writable(), so copy the data only if it is shared with another object. Each
+/// view holds a copy of the vector sharing its storage, so the storage remains
+/// valid for the lifetime of the view whatever happens to the vector. A read-only
+/// view is therefore a snapshot : modifying the vector afterwards copies it once
+/// and leaves the view unchanged. While a writable view exists, the python methods
+/// which would modify the vector raise BufferError instead, as does a request for
+/// a second writable view, because the modification would be made to a copy that
+/// the view doesn't see. The `__array_interface__` has no means of knowing when it
+/// is no longer used, so the storage it references is kept alive for the lifetime
+/// of the python object it was obtained from, and modifying the vector afterwards
+/// also copies it once.
+template<typename ThisClass, bool Supported = Detail::BufferFormat<typename ThisClass::BaseType>::supported>
+class VectorTypedDataBuffer
+{
+
+	public :
+
+		typedef typename ThisClass::Ptr ThisClassPtr;
+		typedef typename ThisClass::BaseType BaseType;
+		typedef typename ThisClass::ValueType::value_type ElementType;
+		typedef Detail::BufferFormat<BaseType> Format;
+
+		/// Returns the number of base type components in each element of the vector.
+		static size_t numComponents()
+		{
+			return sizeof( ElementType ) / sizeof( BaseType );
+		}
+
+		/// Adds the buffer protocol and `__array_interface__` to the bound class.
+		template<typename Class>
+		static void bind( Class &c )
+		{
+			static PyBufferProcs bufferProcs;
+			bufferProcs.bf_getbuffer = &getBuffer;
+			bufferProcs.bf_releasebuffer = &releaseBuffer;
+
+			PyTypeObject *type = reinterpret_cast<PyTypeObject *>( c.ptr() );
+			type->tp_as_buffer = &bufferProcs;
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+			type->tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+
+			c.add_property( "__array_interface__", &arrayInterface );
+		}
+
+		/// Fills result with a copy of the contents of a buffer with a matching format
+		/// and shape, using a single copy rather than converting each element. Vectors
+		/// of types with more than one component require a two dimensional buffer with
+		/// the same number of components, so for instance a V3fVectorData can't be used
+		/// to make a FloatVectorData. Returns false if the object doesn't provide a
+		/// suitable buffer.
+		static bool fromBuffer( PyObject *o, ThisClassPtr &result )
+		{
+			if( !PyObject_CheckBuffer( o ) )
+			{
+				return false;
+			}
+
+			Py_buffer view;
+			if( PyObject_GetBuffer( o, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS ) == -1 )
+			{
+				PyErr_Clear();
+				return false;
+			}
+
+			const char *format = view.format ? view.format : "B";
+			if( *format == '@' || *format == '=' || *format == ( IECore::littleEndian() ? '<' : '>' ) )
+			{
+				format++;
+			}
+
+			bool matches =
+				view.itemsize == (Py_ssize_t)sizeof( BaseType ) &&
+				strcmp( format, Format::format() ) == 0 &&
+				view.len % sizeof( ElementType ) == 0
+			;
+
+			if( numComponents() > 1 )
+			{
+				matches = matches && view.ndim == 2 && view.shape && view.shape[1] == (Py_ssize_t)numComponents();
+			}
+			else
+			{
+				matches = matches && view.ndim == 1;
+			}
+
+			if( matches )
+			{
+				result = new ThisClass();
+				typename ThisClass::ValueType &data = result->writable();
+				data.resize( view.len / sizeof( ElementType ) );
+				memcpy( data.data(), view.buf, view.len );
+			}
+
+			PyBuffer_Release( &view );
+			return matches;
+		}
+
+		/// Raises BufferError if x has exported a writable buffer, in which case
+		/// modifying it from python would copy it away from the view.
+		static void checkNotExported( const ThisClass &x )
+		{
+			if( Detail::writableBufferExports().count( &x ) )
+			{
+				PyErr_SetString( PyExc_BufferError, "Existing exports of data: object cannot be modified" );
+				boost::python::throw_error_already_set();
+			}
+		}
+
+	private :
+
+		// Storage for the shape and strides of a view, referenced by Py_buffer::internal.
+		struct ViewInfo
+		{
+			Py_ssize_t shape[2];
+			Py_ssize_t strides[2];
+			// The vector a writable view was exported from, if any.
+			ThisClassPtr writableExporter;
+		};
+
+		static int getBuffer( PyObject *exporter, Py_buffer *view, int flags )
+		{
+			boost::python::extract<ThisClass &> e( exporter );
+			if( !e.check() )
+			{
+				PyErr_SetString( PyExc_BufferError, "Object does not contain VectorTypedData" );
+				view->obj = nullptr;
+				return -1;
+			}
+
+			ThisClass &x = e();
+			const bool writable = flags & PyBUF_WRITABLE;
+			if( writable )
+			{
+				if( Detail::writableBufferExports().count( &x ) )
+				{
+					PyErr_SetString( PyExc_BufferError, "A writable buffer has already been exported" );
+					view->obj = nullptr;
+					return -1;
+				}
+				// Copies the data if it is shared, before the view below shares it again.
+				x.writable();
+			}
+
+			// The view references a copy sharing the storage, rather than the exporter,
+			// so that the storage outlives any modification made to the exporter.
+			boost::python::object storage;
+			try
+			{
+				storage = boost::python::object( ThisClassPtr( x.copy() ) );
+			}
+			catch( const boost::python::error_already_set & )
+			{
+				view->obj = nullptr;
+				return -1;
+			}
+
+			const ThisClass &storageData = boost::python::extract<const ThisClass &>( storage )();
+			void *data = const_cast<ElementType *>( storageData.readable().data() );
+			const size_t size = storageData.readable().size();
+
+			if( PyBuffer_FillInfo( view, storage.ptr(), data, size * sizeof( ElementType ), !writable, flags ) == -1 )
+			{
+				return -1;
+			}
+
+			ViewInfo *info = new ViewInfo;
+			if( writable )
+			{
+				info->writableExporter = &x;
+				Detail::writableBufferExports()[&x]++;
+			}
+			info->shape[0] = size;
+			info->shape[1] = numComponents();
+			info->strides[0] = sizeof( ElementType );
+			info->strides[1] = sizeof( BaseType );
+			view->internal = info;
+
+			// Without a format the consumer can only interpret the view as
+			// bytes, which is what PyBuffer_FillInfo() has provided already.
+			if( flags & PyBUF_FORMAT )
+			{
+				view->format = const_cast<char *>( Format::format() );
+				view->itemsize = sizeof( BaseType );
+				if( ( flags & PyBUF_ND ) == PyBUF_ND )
+				{
+					view->ndim = numComponents() > 1 ? 2 : 1;
+					view->shape = info->shape;
+				}
+				if( ( flags & PyBUF_STRIDES ) == PyBUF_STRIDES )
+				{
+					view->strides = info->strides;
+				}
+			}
+
+			return 0;
+		}
+
+		static void releaseBuffer( PyObject *exporter, Py_buffer *view )
+		{
+			ViewInfo *info = static_cast<ViewInfo *>( view->internal );
+			if( info->writableExporter )
+			{
+				std::map<const IECore::Data *, size_t> &exports = Detail::writableBufferExports();
+				std::map<const IECore::Data *, size_t>::iterator it = exports.find( info->writableExporter.get() );
+				if( --it->second == 0 )
+				{
+					exports.erase( it );
+				}
+			}
+			delete info;
+		}
+
+		static boost::python::dict arrayInterface( boost::python::object self )
+		{
+			// numpy keeps a reference to self, so self keeps a copy sharing the storage,
+			// one for each distinct storage it has handed out.
+			ThisClass &x = boost::python::extract<ThisClass &>( self )();
+			boost::python::dict selfDict( self.attr( "__dict__" ) );
+			boost::python::list storages( selfDict.get( "_arrayInterfaceStorage", boost::python::list() ) );
+			const ThisClass *storage = nullptr;
+			for( boost::python::ssize_t i = 0, n = boost::python::len( storages ); i < n; ++i )
+			{
+				const ThisClass &s = boost::python::extract<const ThisClass &>( storages[i] )();
+				if( s.readable().data() == x.readable().data() )
+				{
+					storage = &s;
+					break;
+				}
+			}
+			if( !storage )
+			{
+				boost::python::object s( ThisClassPtr( x.copy() ) );
+				storages.append( s );
+				selfDict["_arrayInterfaceStorage"] = storages;
+				storage = &boost::python::extract<const ThisClass &>( s )();
+			}
+
+			const typename ThisClass::ValueType &data = storage->readable();
+
+			std::ostringstream typeStr;
+			typeStr << ( sizeof( BaseType ) == 1 ? '|' : ( IECore::littleEndian() ? '<' : '>' ) ) << Format::kind() << sizeof( BaseType );
+
+			boost::python::dict result;
+			result["version"] = 3;
+			result["typestr"] = typeStr.str();
+			if( numComponents() > 1 )
+			{
+				result["shape"] = boost::python::make_tuple( data.size(), numComponents() );
+			}
+			else
+			{
+				result["shape"] = boost::python::make_tuple( data.size() );
+			}
+			result["data"] = boost::python::make_tuple( reinterpret_cast<size_t>( data.data() ), true );
+			return result;
+		}
+
+};
+
+/// Types without a numeric base type (strings and bools) can't be shared with
+/// python directly, so don't support the buffer protocol.
+template<typename ThisClass>
+class VectorTypedDataBuffer<ThisClass, false>
+{
+
+	public :
+
+		template<typename Class>
+		static void bind( Class &c )
+		{
+		}
+
+		static bool fromBuffer( PyObject *o, typename ThisClass::Ptr &result )
+		{
+			return false;
+		}
+
+		static void checkNotExported( const ThisClass &x )
+		{
+		}
+
+};
+
+/// A def_visitor to add the buffer protocol to a VectorTypedData binding
+/// where it is supported.
+template<typename ThisClass>
+class VectorTypedDataBufferVisitor : public boost::python::def_visitor<VectorTypedDataBufferVisitor<ThisClass> >
+{
+
+	friend class boost::python::def_visitor_access;
+
+	template<typename Class>
+	void visit( Class &c ) const
+	{
+		VectorTypedDataBuffer<ThisClass>::bind( c );
+	}
+
+};
+
 template<typename ThisClass>
 class VectorTypedDataFunctions
 {
@@ -67,30 +427,36 @@ class VectorTypedDataFunctions
 		dataListOrSizeConstructor( boost::python::object v )
 		{
 			boost::python::extract<size_type> x( v );
+			ThisClassPtr r;
 			if ( x.check() )
 			{
 				// we've got a length
-				ThisClassPtr r = new ThisClass();
+				r = new ThisClass();
 				r->writable().resize( x() );
 				return r;
 			}
+			else if ( VectorTypedDataBuffer<ThisClass>::fromBuffer( v.ptr(), r ) )
+			{
+				// we've got a buffer with matching contents, such as a numpy array
+				return r;
+			}
 			else
 			{
-				ThisClassPtr r = new ThisClass();
+				r = new ThisClass();
 				boost::python::container_utils::extend_container( r->writable(), v );
 				return r;
 			}
 		}
 
 		//
-		static iterator begin( ThisClass &x )
+		static const_iterator begin( ThisClass &x )
 		{
-			return x.writable().begin();
+			return x.readable().begin();
 		}
 
-		static iterator end( ThisClass &x )
+		static const_iterator end( ThisClass &x )
 		{
-			return x.writable().end();
+			return x.readable().end();
 		}
 
 		/// binding for __getitem__ function
@@ -126,6 +492,7 @@ class VectorTypedDataFunctions
 		/// binding for __setitem__ function
 		static void setItem( ThisClass &x, PyObject *i, boost::python::object v )
 		{
+			VectorTypedDataBuffer<ThisClass>::checkNotExported( x );
 			if ( PySlice_Check( i ) )
 			{
 				setSlice( x, reinterpret_cast<PySliceObject*>( i ), v );
@@ -190,6 +557,7 @@ class VectorTypedDataFunctions
 		/// binding for append function
 		static void append( ThisClass &x, PyObject* v )
 		{
+			VectorTypedDataBuffer<ThisClass>::checkNotExported( x );
 			Container &xData = x.writable();
 			boost::python::extract<data_type&> elem( v );
 			xData.push_back( convertValue( v ) );
@@ -198,6 +566,7 @@ class VectorTypedDataFunctions
 		/// binding for __delitem__ function
 		static void delItem( ThisClass &x, PyObject *i )
 		{
+			VectorTypedDataBuffer<ThisClass>::checkNotExported( x );
 			if ( PySlice_Check( i ) )
 			{
 				delSlice( x, reinterpret_cast<PySliceObject*>( i ) );
@@ -232,11 +601,13 @@ class VectorTypedDataFunctions
 
 		static void resize( ThisClass &x, size_t s )
 		{
+			VectorTypedDataBuffer<ThisClass>::checkNotExported( x );
 			x.writable().resize( s );
 		}
 
 		static void resizeWithValue( ThisClass &x, size_t s, const data_type &v )
 		{
+			VectorTypedDataBuffer<ThisClass>::checkNotExported( x );
 			x.writable().resize( s, v );
 		}
 
@@ -258,6 +629,7 @@ class VectorTypedDataFunctions
 		/// ... works fine.
 		static void extend( ThisClass &x, boost::python::object v )
 		{
+			VectorTypedDataBuffer<ThisClass>::checkNotExported( x );
 			Container temp;
 			const Container *vData = &temp;
 			if ( PyList_Check( v.ptr() ) )
@@ -340,6 +712,7 @@ class VectorTypedDataFunctions
 		/// binding for insert function
 		static void insert( ThisClass &x, PyObject *i, PyObject *v )
 		{
+			VectorTypedDataBuffer<ThisClass>::checkNotExported( x );
 			Container &xData = x.writable();
 			typename Container::iterator iterX = xData.begin() + convertIndex( x, i, true );
 			xData.insert( iterX, convertValue( v ) );
@@ -382,6 +755,7 @@ class VectorTypedDataFunctions
 
 /// \todo Get rid of this macro
 #define BINARY_OPERATOR_CODE(op)																\
+		VectorTypedDataBuffer<ThisClass>::checkNotExported( x );								\
 		const Container &xData = x.readable();													\
 		boost::python::extract<ThisClass&> elem(y);												\
 		/* try if y is another vector of the same type */										\
@@ -674,7 +1048,8 @@ std::string str<TypedData<std::vector<TYPE> > >( TypedData<std::vector<TYPE> > &
 			.def("__init__", make_constructor(&ThisBinder::dataConstructor), "Default constructor: creates an empty vector.")	\
 			.def("__init__", make_constructor(&ThisBinder::dataListOrSizeConstructor),										\
 						 "Accepts another vector of the same class or a python list containing " Tname \
-						 "\nor any other python built-in type that is convertible to it. Alternatively accepts the size of the new vector.")	 						\
+						 "\nor any other python built-in type that is convertible to it. Alternatively accepts the size of the new vector,\n"	\
+						 "or an object supporting the buffer protocol (such as a numpy array) with matching element type.")	 						\
 			.def("__getitem__", &ThisBinder::getItem, "indexing operator.\nAccept an integer index (starting from 0), slices and negative indexes too.")		\
 			.def("__setitem__", &ThisBinder::setItem, "index assignment operator.\nWorks exactly like on python lists but it only accepts " Tname " as the new value.")	\
 			.def("__delitem__", &ThisBinder::delItem, "index deletion operator.\nWorks exactly like on python lists.")		\
@@ -696,6 +1071,7 @@ std::string str<TypedData<std::vector<TYPE> > >( TypedData<std::vector<TYPE> > &
 			.def("hasBase", &ThisClass::hasBase ).staticmethod( "hasBase" ) \
 			.def("__str__", &str<ThisClass> )	\
 			.def("__repr__", &repr<ThisClass> )	\
+			.def( VectorTypedDataBufferVisitor<ThisClass>() )	\
 
 // bind a VectorTypedData class that does not support Math operators
 #define BIND_VECTOR_TYPEDDATA(T, Tname)													\
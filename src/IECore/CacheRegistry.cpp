@@ -0,0 +1,430 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "boost/lexical_cast.hpp"
+
+#include "tbb/spin_mutex.h"
+#include "tbb/spin_rw_mutex.h"
+#include "tbb/tbb_thread.h"
+
+#include "IECore/CacheRegistry.h"
+#include "IECore/MessageHandler.h"
+
+#include <algorithm>
+
+using namespace IECore;
+
+//////////////////////////////////////////////////////////////////////////
+// Registry implementation
+//////////////////////////////////////////////////////////////////////////
+
+struct CacheRegistry::Registry
+{
+
+	Registry()
+	{
+		size_t mi = 0;
+		if( const char *m = getenv( "IECORE_CACHE_MEMORY" ) )
+		{
+			// we're typically constructed during static initialisation,
+			// where throwing would terminate the process.
+			try
+			{
+				mi = boost::lexical_cast<size_t>( m );
+			}
+			catch( const boost::bad_lexical_cast & )
+			{
+				msg( Msg::Warning, "CacheRegistry", boost::format( "Ignoring invalid IECORE_CACHE_MEMORY value \"%s\"" ) % m );
+			}
+		}
+		budget = 1024 * 1024 * mi;
+		reportedUsage = 0;
+		applyingClient = nullptr;
+	}
+
+	typedef tbb::spin_rw_mutex ClientsMutex;
+	typedef tbb::spin_mutex RebalanceMutex;
+
+	std::vector<Client *> clients;
+	ClientsMutex clientsMutex;
+	// Makes sure only one thread at a time applies new limits.
+	RebalanceMutex rebalanceMutex;
+	tbb::atomic<size_t> budget;
+	// The sum of the usage last reported by each client. This is kept up to
+	// date by memoryAdded() and rebalance(), so that memoryAdded() needn't
+	// query every cache to decide whether or not the budget is exceeded.
+	tbb::atomic<size_t> reportedUsage;
+	// The client whose limit is being set by rebalance(), which must not
+	// be destroyed until it is done.
+	tbb::atomic<Client *> applyingClient;
+
+	// Must be called with clientsMutex locked.
+	size_t memoryUsage() const
+	{
+		size_t result = 0;
+		for( std::vector<Client *>::const_iterator it = clients.begin(); it != clients.end(); ++it )
+		{
+			if( (*it)->m_memoryUsage )
+			{
+				result += (*it)->m_memoryUsage();
+			}
+		}
+		return result;
+	}
+
+	// Updates the usage reported by a client, returning the new total.
+	size_t reportUsage( Client *client, size_t usage )
+	{
+		const size_t previous = client->m_reportedUsage.fetch_and_store( usage );
+		// modular arithmetic gives the right result when the usage has decreased.
+		return reportedUsage.fetch_and_add( usage - previous ) + usage - previous;
+	}
+
+	typedef std::vector<std::pair<Client *, size_t> > Limits;
+
+	// Must be called with rebalanceMutex locked. Setting a limit may evict
+	// items from a cache, and destroying those may destroy other caches,
+	// so the limits are computed with clientsMutex locked and then applied
+	// after it has been released.
+	void rebalance()
+	{
+		Limits limits;
+		{
+			ClientsMutex::scoped_lock lock( clientsMutex, /* write = */ false );
+			computeLimits( limits );
+		}
+
+		for( Limits::const_iterator it = limits.begin(); it != limits.end(); ++it )
+		{
+			Client *client = it->first;
+			{
+				ClientsMutex::scoped_lock lock( clientsMutex, /* write = */ false );
+				if( std::find( clients.begin(), clients.end(), client ) == clients.end() )
+				{
+					// destroyed while applying a previous limit.
+					continue;
+				}
+				applyingClient = client;
+			}
+
+			try
+			{
+				client->m_setMemoryLimit( it->second );
+				reportUsage( client, client->m_memoryUsage() );
+			}
+			catch( ... )
+			{
+				applyingClient = nullptr;
+				throw;
+			}
+			applyingClient = nullptr;
+		}
+	}
+
+	// Must be called with clientsMutex and rebalanceMutex locked.
+	void computeLimits( Limits &limits )
+	{
+		std::vector<Client *> budgeted;
+		for( std::vector<Client *>::const_iterator it = clients.begin(); it != clients.end(); ++it )
+		{
+			if( (*it)->m_memoryUsage )
+			{
+				budgeted.push_back( *it );
+			}
+		}
+
+		const size_t totalBudget = budget;
+		if( !totalBudget )
+		{
+			// restore the limits the caches had before we started managing them.
+			for( std::vector<Client *>::const_iterator it = budgeted.begin(); it != budgeted.end(); ++it )
+			{
+				if( (*it)->m_budgeted )
+				{
+					limits.push_back( std::make_pair( *it, (*it)->m_originalLimit ) );
+					(*it)->m_budgeted = false;
+				}
+			}
+			return;
+		}
+
+		if( budgeted.empty() )
+		{
+			return;
+		}
+
+		// Share the budget by weight, handing the portion not used by the
+		// smaller caches over to the others ("water filling"). The caches
+		// using more than their final share are limited to it, and the
+		// others may grow into their share.
+		const size_t numClients = budgeted.size();
+		std::vector<double> usage( numClients );
+		std::vector<double> weights( numClients );
+		std::vector<bool> satisfied( numClients, false );
+		for( size_t i = 0; i < numClients; ++i )
+		{
+			const size_t u = budgeted[i]->m_memoryUsage();
+			reportUsage( budgeted[i], u );
+			usage[i] = u;
+			weights[i] = std::max( budgeted[i]->m_weight, 1e-6f );
+		}
+
+		double remaining = totalBudget;
+		double unsatisfiedWeight = 0;
+		for( size_t i = 0; i < numClients; ++i )
+		{
+			unsatisfiedWeight += weights[i];
+		}
+
+		bool changed = true;
+		while( changed && unsatisfiedWeight > 0 )
+		{
+			changed = false;
+			const double level = remaining / unsatisfiedWeight;
+			for( size_t i = 0; i < numClients; ++i )
+			{
+				if( !satisfied[i] && usage[i] <= level * weights[i] )
+				{
+					satisfied[i] = true;
+					remaining -= usage[i];
+					unsatisfiedWeight -= weights[i];
+					changed = true;
+				}
+			}
+		}
+
+		double totalWeight = 0;
+		for( size_t i = 0; i < numClients; ++i )
+		{
+			totalWeight += weights[i];
+		}
+
+		for( size_t i = 0; i < numClients; ++i )
+		{
+			Client *client = budgeted[i];
+			double limit;
+			if( unsatisfiedWeight > 0 )
+			{
+				limit = std::max( 0.0, remaining ) / unsatisfiedWeight * weights[i];
+				if( satisfied[i] )
+				{
+					limit = std::max( limit, usage[i] );
+				}
+			}
+			else
+			{
+				// everything fits, so the spare memory is shared by weight.
+				limit = usage[i] + remaining / totalWeight * weights[i];
+			}
+
+			if( !client->m_budgeted )
+			{
+				client->m_originalLimit = client->m_getMemoryLimit();
+				client->m_budgeted = true;
+			}
+			limits.push_back( std::make_pair( client, (size_t)limit ) );
+		}
+	}
+
+};
+
+CacheRegistry::Registry &CacheRegistry::registry()
+{
+	// Deliberately leaked, as caches may be registered and deregistered
+	// during static initialisation and destruction.
+	static Registry *r = new Registry;
+	return *r;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Client
+//////////////////////////////////////////////////////////////////////////
+
+CacheRegistry::Client::Client( const std::string &name, MemoryUsageFunction memoryUsage, GetMemoryLimitFunction getMemoryLimit, SetMemoryLimitFunction setMemoryLimit, float weight )
+	:	m_name( name ), m_memoryUsage( memoryUsage ), m_getMemoryLimit( getMemoryLimit ), m_setMemoryLimit( setMemoryLimit ), m_weight( weight ), m_originalLimit( 0 ), m_budgeted( false )
+{
+	m_lookups = 0;
+	m_misses = 0;
+	m_reportedUsage = 0;
+	Registry &r = registry();
+	Registry::ClientsMutex::scoped_lock lock( r.clientsMutex, /* write = */ true );
+	r.clients.push_back( this );
+}
+
+CacheRegistry::Client::Client( const std::string &name )
+	:	m_name( name ), m_weight( 0 ), m_originalLimit( 0 ), m_budgeted( false )
+{
+	m_lookups = 0;
+	m_misses = 0;
+	m_reportedUsage = 0;
+	Registry &r = registry();
+	Registry::ClientsMutex::scoped_lock lock( r.clientsMutex, /* write = */ true );
+	r.clients.push_back( this );
+}
+
+CacheRegistry::Client::~Client()
+{
+	Registry &r = registry();
+	{
+		Registry::ClientsMutex::scoped_lock lock( r.clientsMutex, /* write = */ true );
+		r.clients.erase( std::find( r.clients.begin(), r.clients.end(), this ) );
+	}
+
+	// Another thread may be in the middle of setting our limit, after which it
+	// reports our usage again. We can't wait with the lock held, because setting
+	// the limit may destroy other caches, which must be able to deregister.
+	while( r.applyingClient == this )
+	{
+		tbb::this_tbb_thread::yield();
+	}
+
+	// Now nothing else can report our usage, so we can remove it from the total.
+	Registry::ClientsMutex::scoped_lock lock( r.clientsMutex, /* write = */ true );
+	r.reportedUsage -= m_reportedUsage;
+}
+
+const std::string &CacheRegistry::Client::name() const
+{
+	return m_name;
+}
+
+float CacheRegistry::Client::getWeight() const
+{
+	return m_weight;
+}
+
+void CacheRegistry::Client::setWeight( float weight )
+{
+	m_weight = weight;
+	if( registry().budget )
+	{
+		CacheRegistry::rebalance();
+	}
+}
+
+void CacheRegistry::Client::recordLookup()
+{
+	++m_lookups;
+}
+
+void CacheRegistry::Client::recordMiss()
+{
+	++m_misses;
+}
+
+void CacheRegistry::Client::memoryAdded()
+{
+	Registry &r = registry();
+	const size_t budget = r.budget;
+	if( !budget )
+	{
+		return;
+	}
+
+	const size_t usage = r.reportUsage( this, m_memoryUsage ? m_memoryUsage() : 0 );
+	if( m_budgeted && usage <= budget )
+	{
+		return;
+	}
+
+	Registry::RebalanceMutex::scoped_lock rebalanceLock;
+	if( !rebalanceLock.try_acquire( r.rebalanceMutex ) )
+	{
+		// someone else is already making room.
+		return;
+	}
+
+	r.rebalance();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// CacheRegistry
+//////////////////////////////////////////////////////////////////////////
+
+void CacheRegistry::setMemoryBudget( size_t bytes )
+{
+	registry().budget = bytes;
+	rebalance();
+}
+
+size_t CacheRegistry::getMemoryBudget()
+{
+	return registry().budget;
+}
+
+size_t CacheRegistry::memoryUsage()
+{
+	Registry &r = registry();
+	Registry::ClientsMutex::scoped_lock lock( r.clientsMutex, /* write = */ false );
+	return r.memoryUsage();
+}
+
+void CacheRegistry::rebalance()
+{
+	Registry &r = registry();
+	Registry::RebalanceMutex::scoped_lock rebalanceLock( r.rebalanceMutex );
+	r.rebalance();
+}
+
+void CacheRegistry::statistics( std::vector<Statistics> &stats )
+{
+	Registry &r = registry();
+	Registry::ClientsMutex::scoped_lock lock( r.clientsMutex, /* write = */ false );
+	stats.clear();
+	stats.reserve( r.clients.size() );
+	for( std::vector<Client *>::const_iterator it = r.clients.begin(); it != r.clients.end(); ++it )
+	{
+		const Client *client = *it;
+		Statistics s;
+		s.name = client->m_name;
+		s.weight = client->m_weight;
+		s.memoryUsage = client->m_memoryUsage ? client->m_memoryUsage() : 0;
+		s.memoryLimit = client->m_getMemoryLimit ? client->m_getMemoryLimit() : 0;
+		s.lookups = client->m_lookups;
+		s.misses = client->m_misses;
+		stats.push_back( s );
+	}
+}
+
+void CacheRegistry::resetStatistics()
+{
+	Registry &r = registry();
+	Registry::ClientsMutex::scoped_lock lock( r.clientsMutex, /* write = */ false );
+	for( std::vector<Client *>::const_iterator it = r.clients.begin(); it != r.clients.end(); ++it )
+	{
+		(*it)->m_lookups = 0;
+		(*it)->m_misses = 0;
+	}
+}
@@ -36,9 +36,8 @@
 #include "boost/format.hpp"
 
 #include "IECore/FaceVaryingPromotionOp.h"
-#include "IECore/DespatchTypedData.h"
 #include "IECore/CompoundParameter.h"
-#include "IECore/PolygonVertexIterator.h"
+#include "IECore/MeshAlgo.h"
 
 using namespace IECore;
 
@@ -125,67 +124,6 @@ const BoolParameter *FaceVaryingPromotionOp::promoteVertexParameter() const
 	return parameters()->parameter<BoolParameter>( "promoteVertex" );
 }
 
-struct FaceVaryingPromotionOp::Promoter
-{
-	typedef DataPtr ReturnType;
-
-	Promoter( const std::vector<int> &vertsPerFace,  const std::vector<int> &vertIds )
-		:	m_interpolation( PrimitiveVariable::Invalid ), m_vertsPerFace( vertsPerFace ), m_vertIds( vertIds )
-	{
-	}
-
-	void setInterpolation( PrimitiveVariable::Interpolation interpolation )
-	{
-		m_interpolation = interpolation;
-	}
-
-	template<typename T>
-	ReturnType operator()( T *data )
-	{
-		typedef typename T::ValueType Container;
-		typedef typename Container::const_iterator ConstIterator;
-
-		typename T::Ptr result = new T;
-		result->writable().reserve( m_vertIds.size() );
-		std::back_insert_iterator<Container> inserter( result->writable() );
-		switch( m_interpolation )
-		{
-			case PrimitiveVariable::Uniform :
-			{
-				ConstIterator dataIt = data->readable().begin();
-				for( std::vector<int>::const_iterator it=m_vertsPerFace.begin(); it!=m_vertsPerFace.end(); ++it, ++dataIt )
-				{
-					std::fill_n( inserter, *it, *dataIt );
-				}
-				break;
-			}
-			case PrimitiveVariable::Vertex :
-			case PrimitiveVariable::Varying :
-			{
-				std::copy(
-					PolygonVertexIterator<ConstIterator>( m_vertIds.begin(), data->readable().begin() ),
-					PolygonVertexIterator<ConstIterator>( m_vertIds.end(), data->readable().begin() ),
-					inserter
-				);
-				break;
-			}
-			default :
-				assert( 0 ); // shouldn't get here
-		}
-
-		assert( result->readable().size() == m_vertIds.size() );
-
-		return result;
-	}
-
-	private :
-
-		PrimitiveVariable::Interpolation m_interpolation;
-		const std::vector<int> &m_vertsPerFace;
-		const std::vector<int> &m_vertIds;
-
-};
-
 void FaceVaryingPromotionOp::modifyTypedPrimitive( MeshPrimitive *mesh, const CompoundObject *operands )
 {
 	const std::vector<std::string> &names = operands->member<StringVectorData>( "primVarNames" )->readable();
@@ -199,7 +137,7 @@ void FaceVaryingPromotionOp::modifyTypedPrimitive( MeshPrimitive *mesh, const Co
 	bool promoteVarying = operands->member<BoolData>( "promoteVarying" )->readable();
 	bool promoteVertex = operands->member<BoolData>( "promoteVertex" )->readable();
 
-	Promoter promoter( mesh->verticesPerFace()->readable(), mesh->vertexIds()->readable() );
+	PrimitiveVariableMap toPromote;
 	for( PrimitiveVariableMap::iterator it=mesh->variables.begin(); it!=mesh->variables.end(); ++it )
 	{
 		switch( it->second.interpolation )
@@ -251,19 +189,15 @@ void FaceVaryingPromotionOp::modifyTypedPrimitive( MeshPrimitive *mesh, const Co
 			throw Exception( boost::str( boost::format( "Primitive variable \"%s\" is not valid." ) % it->first ) );
 		}
 
-		promoter.setInterpolation( it->second.interpolation );
-
-		if( it->second.indices )
-		{
-			it->second.indices = runTimeCast<IntVectorData>( despatchTypedData<Promoter, TypeTraits::IsVectorTypedData>( it->second.indices.get(), promoter ) );
-		}
-		else
-		{
-			it->second.data = despatchTypedData<Promoter, TypeTraits::IsVectorTypedData>( it->second.data.get(), promoter );
-		}
+		toPromote.insert( *it );
+	}
 
-		it->second.interpolation = PrimitiveVariable::FaceVarying;
+	// promote everything in a single pass over the mesh
+	MeshAlgo::resamplePrimitiveVariables( mesh, toPromote, PrimitiveVariable::FaceVarying );
 
+	for( PrimitiveVariableMap::const_iterator it=toPromote.begin(); it!=toPromote.end(); ++it )
+	{
+		mesh->variables[it->first] = it->second;
 		assert( mesh->isPrimitiveVariableValid( it->second ) );
 	}
 }
@@ -32,6 +32,14 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
 #include "boost/filesystem/operations.hpp"
 
 #include "IECore/MessageHandler.h"
@@ -43,6 +51,13 @@ namespace fs = boost::filesystem;
 
 IE_CORE_DEFINERUNTIMETYPEDDESCRIPTION( FileIndexedIO )
 
+namespace
+{
+
+// Blocks read from memory mapped files at least this big release their mapped pages once consumed.
+const size_t g_releaseThreshold = 64 * 1024;
+
+} // namespace
 
 ///////////////////////////////////////////////
 //
@@ -58,6 +73,15 @@ class FileIndexedIO::StreamFile : public StreamIndexedIO::StreamFile
 
 		size_t m_endPosition;
 
+		/// File descriptor used for lock-free positional reads. Only opened in Read mode,
+		/// otherwise -1 and reads fall back to the locked stream implementation.
+		int m_fd;
+
+		/// Read-only mapping of the whole file, only made when opened with
+		/// IndexedIO::MemoryMapped. Null otherwise.
+		char *m_map;
+		size_t m_mapSize;
+
 		StreamFile( const std::string &filename, IndexedIO::OpenMode mode );
 
 		~StreamFile() override;
@@ -66,9 +90,15 @@ class FileIndexedIO::StreamFile : public StreamIndexedIO::StreamFile
 
 		void flush( size_t endPosition ) override;
 
+		void positionalRead( char *buffer, size_t size, size_t pos ) override;
+
+		const char *mappedData( size_t size, size_t pos ) override;
+
+		void releaseMappedData( size_t size, size_t pos ) override;
+
 };
 
-FileIndexedIO::StreamFile::StreamFile( const std::string &filename, IndexedIO::OpenMode mode ) : StreamIndexedIO::StreamFile(mode), m_filename( filename ), m_endPosition(0)
+FileIndexedIO::StreamFile::StreamFile( const std::string &filename, IndexedIO::OpenMode mode ) : StreamIndexedIO::StreamFile(mode), m_filename( filename ), m_endPosition(0), m_fd(-1), m_map(nullptr), m_mapSize(0)
 {
 	if (mode & IndexedIO::Write)
 	{
@@ -129,6 +159,20 @@ FileIndexedIO::StreamFile::StreamFile( const std::string &filename, IndexedIO::O
 			throw IOException( "FileIndexedIO: Cannot open file '" + filename + "' for read" );
 		}
 
+		// If this fails we simply fall back to reading through the stream.
+		m_fd = ::open( filename.c_str(), O_RDONLY );
+
+		struct stat fileStat;
+		if ( m_fd >= 0 && ( mode & IndexedIO::MemoryMapped ) && ::fstat( m_fd, &fileStat ) == 0 && fileStat.st_size > 0 )
+		{
+			void *map = ::mmap( nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, m_fd, 0 );
+			if ( map != MAP_FAILED )
+			{
+				m_map = static_cast< char * >( map );
+				m_mapSize = fileStat.st_size;
+			}
+		}
+
 		try
 		{
 			setStream( f, false );
@@ -153,6 +197,16 @@ void FileIndexedIO::StreamFile::flush( size_t endPosition )
 
 FileIndexedIO::StreamFile::~StreamFile()
 {
+	if ( m_map )
+	{
+		::munmap( m_map, m_mapSize );
+	}
+
+	if ( m_fd >= 0 )
+	{
+		::close( m_fd );
+	}
+
 	if ( m_openmode == IndexedIO::Write || m_openmode == IndexedIO::Append )
 	{
 		std::fstream *f = static_cast< std::fstream * >( m_stream );
@@ -173,6 +227,66 @@ FileIndexedIO::StreamFile::~StreamFile()
 	}
 }
 
+void FileIndexedIO::StreamFile::positionalRead( char *buffer, size_t size, size_t pos )
+{
+	if ( m_fd < 0 )
+	{
+		StreamIndexedIO::StreamFile::positionalRead( buffer, size, pos );
+		return;
+	}
+
+	while ( size )
+	{
+		ssize_t count = ::pread( m_fd, buffer, size, pos );
+		if ( count > 0 )
+		{
+			buffer += count;
+			size -= count;
+			pos += count;
+		}
+		else if ( count < 0 && errno == EINTR )
+		{
+			continue;
+		}
+		else
+		{
+			throw IOException( "FileIndexedIO: Error reading from file '" + m_filename + "'" );
+		}
+	}
+}
+
+const char *FileIndexedIO::StreamFile::mappedData( size_t size, size_t pos )
+{
+	if ( !m_map )
+	{
+		return nullptr;
+	}
+
+	if ( pos + size > m_mapSize )
+	{
+		throw IOException( "FileIndexedIO: Error reading from file '" + m_filename + "'" );
+	}
+
+	return m_map + pos;
+}
+
+void FileIndexedIO::StreamFile::releaseMappedData( size_t size, size_t pos )
+{
+	if ( !m_map || size < g_releaseThreshold )
+	{
+		return;
+	}
+
+	// Release the pages spanned by the block, so that the data isn't left resident
+	// in our address space once consumed. Neighbouring blocks sharing the first or
+	// last page are unaffected, because the pages remain in the page cache and are
+	// faulted back in if they are needed again.
+	static const size_t pageSize = sysconf( _SC_PAGESIZE );
+	const size_t begin = ( pos / pageSize ) * pageSize;
+	const size_t end = std::min( ( ( pos + size + pageSize - 1 ) / pageSize ) * pageSize, ( ( m_mapSize + pageSize - 1 ) / pageSize ) * pageSize );
+	::madvise( m_map + begin, end - begin, MADV_DONTNEED );
+}
+
 bool FileIndexedIO::StreamFile::canRead( const std::string &path )
 {
 	std::fstream d( path.c_str(), std::ios::binary | std::ios::in);
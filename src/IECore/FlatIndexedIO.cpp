@@ -0,0 +1,1047 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "IECore/FlatIndexedIO.h"
+
+#include "IECore/Exception.h"
+#include "IECore/Object.h"
+
+#include <algorithm>
+#include <deque>
+#include <string.h>
+
+using namespace IECore;
+
+IE_CORE_DEFINERUNTIMETYPEDDESCRIPTION( FlatIndexedIO )
+
+//////////////////////////////////////////////////////////////////////////
+// File format
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// The buffer starts with a Header, and is followed by a sequence of records,
+// each of which is a RecordHeader followed by the entry name and any data.
+// Records and their data begin on g_alignment byte boundaries.
+
+const char g_magic[8] = { 'I', 'E', 'F', 'L', 'A', 'T', 'I', 'O' };
+const uint32_t g_version = 1;
+const uint32_t g_byteOrderMark = 0x01020304;
+const size_t g_alignment = 16;
+
+struct Header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+};
+
+enum RecordType
+{
+	DirectoryRecord = 1,
+	FileRecord = 2,
+	RemoveRecord = 3,
+	RemoveAllRecord = 4
+};
+
+struct RecordHeader
+{
+	uint32_t type;
+	// Directories are numbered in the order in which their
+	// records appear, with the root directory being 0.
+	uint32_t parent;
+	uint32_t dataType;
+	uint32_t nameLength;
+	uint64_t arrayLength;
+	uint64_t dataSize;
+};
+
+static_assert( sizeof( Header ) % g_alignment == 0, "Unexpected header size" );
+static_assert( sizeof( RecordHeader ) % g_alignment == 0, "Unexpected record header size" );
+
+inline size_t align( size_t offset )
+{
+	return ( offset + g_alignment - 1 ) & ~( g_alignment - 1 );
+}
+
+const IndexedIO::EntryID g_objectEntry( "object" );
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+// Node
+//////////////////////////////////////////////////////////////////////////
+
+struct FlatIndexedIO::Node
+{
+
+	Node( Node *parent, const IndexedIO::EntryID &name, uint32_t directoryId )
+		:	parent( parent ), name( name ), entryType( IndexedIO::Directory ), directoryId( directoryId ),
+			dataType( IndexedIO::Invalid ), arrayLength( 0 ), dataOffset( 0 ), dataSize( 0 )
+	{
+	}
+
+	Node( Node *parent, const IndexedIO::EntryID &name, IndexedIO::DataType dataType, uint64_t arrayLength, size_t dataOffset, size_t dataSize )
+		:	parent( parent ), name( name ), entryType( IndexedIO::File ), directoryId( 0 ),
+			dataType( dataType ), arrayLength( arrayLength ), dataOffset( dataOffset ), dataSize( dataSize )
+	{
+	}
+
+	typedef std::map<IndexedIO::EntryID, Node *> ChildMap;
+
+	Node *parent;
+	IndexedIO::EntryID name;
+	IndexedIO::EntryType entryType;
+	uint32_t directoryId;
+	IndexedIO::DataType dataType;
+	uint64_t arrayLength;
+	size_t dataOffset;
+	size_t dataSize;
+	ChildMap children;
+
+	Node *directoryChild( const IndexedIO::EntryID &childName ) const
+	{
+		ChildMap::const_iterator it = children.find( childName );
+		if( it == children.end() || it->second->entryType != IndexedIO::Directory )
+		{
+			return nullptr;
+		}
+		return it->second;
+	}
+
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Index
+//////////////////////////////////////////////////////////////////////////
+
+/// Owns the buffer and all the nodes of the directory tree. Nodes are never
+/// deallocated before the Index itself, so that removing an entry leaves any
+/// FlatIndexedIO instances referring to it in a harmless state.
+class FlatIndexedIO::Index : public RefCounted
+{
+
+	public :
+
+		Index( ConstCharVectorDataPtr buffer, IndexedIO::OpenMode mode )
+			:	m_mode( mode )
+		{
+			IndexedIO::validateOpenMode( m_mode );
+
+			if( m_mode & IndexedIO::Read )
+			{
+				if( !buffer )
+				{
+					throw IOException( "FlatIndexedIO: No buffer to read" );
+				}
+				m_buffer = buffer->copy();
+				parse();
+			}
+			else if( ( m_mode & IndexedIO::Append ) && buffer && buffer->readable().size() )
+			{
+				m_buffer = buffer->copy();
+				parse();
+			}
+			else
+			{
+				m_buffer = new CharVectorData();
+				Header header;
+				memcpy( header.magic, g_magic, sizeof( g_magic ) );
+				header.version = g_version;
+				header.byteOrder = g_byteOrderMark;
+				std::vector<char> &b = m_buffer->writable();
+				b.resize( sizeof( Header ) );
+				memcpy( b.data(), &header, sizeof( Header ) );
+				insertDirectory( nullptr, IndexedIO::rootName );
+			}
+		}
+
+		IndexedIO::OpenMode openMode() const
+		{
+			return m_mode;
+		}
+
+		Node *root() const
+		{
+			return m_directories[0];
+		}
+
+		// Shares the data with m_buffer, until either is modified.
+		CharVectorDataPtr buffer() const
+		{
+			return m_buffer->copy();
+		}
+
+		const char *data( const Node *node ) const
+		{
+			return m_buffer->readable().data() + node->dataOffset;
+		}
+
+		Node *addDirectory( Node *parent, const IndexedIO::EntryID &name )
+		{
+			appendRecord( DirectoryRecord, parent, name, IndexedIO::Invalid, 0, 0 );
+			return insertDirectory( parent, name );
+		}
+
+		// Returns the location for the caller to fill with dataSize bytes of data.
+		char *addFile( Node *parent, const IndexedIO::EntryID &name, IndexedIO::DataType dataType, uint64_t arrayLength, size_t dataSize )
+		{
+			size_t dataOffset = appendRecord( FileRecord, parent, name, dataType, arrayLength, dataSize );
+			insertFile( parent, name, dataType, arrayLength, dataOffset, dataSize );
+			return m_buffer->writable().data() + dataOffset;
+		}
+
+		void remove( Node *parent, const IndexedIO::EntryID &name )
+		{
+			if( !parent->children.count( name ) )
+			{
+				throw IOException( "FlatIndexedIO: Entry not found '" + name.value() + "'" );
+			}
+			appendRecord( RemoveRecord, parent, name, IndexedIO::Invalid, 0, 0 );
+			parent->children.erase( name );
+		}
+
+		void removeAll( Node *parent )
+		{
+			if( parent->children.empty() )
+			{
+				return;
+			}
+			appendRecord( RemoveAllRecord, parent, IndexedIO::EntryID(), IndexedIO::Invalid, 0, 0 );
+			parent->children.clear();
+		}
+
+	private :
+
+		size_t appendRecord( RecordType type, const Node *parent, const IndexedIO::EntryID &name, IndexedIO::DataType dataType, uint64_t arrayLength, size_t dataSize )
+		{
+			const std::string &nameString = name.string();
+
+			std::vector<char> &b = m_buffer->writable();
+			const size_t recordOffset = b.size();
+			const size_t dataOffset = align( recordOffset + sizeof( RecordHeader ) + nameString.size() );
+			b.resize( align( dataOffset + dataSize ) );
+
+			RecordHeader header;
+			header.type = type;
+			header.parent = parent->directoryId;
+			header.dataType = dataType;
+			header.nameLength = nameString.size();
+			header.arrayLength = arrayLength;
+			header.dataSize = dataSize;
+			memcpy( b.data() + recordOffset, &header, sizeof( RecordHeader ) );
+			memcpy( b.data() + recordOffset + sizeof( RecordHeader ), nameString.c_str(), nameString.size() );
+
+			return dataOffset;
+		}
+
+		void parse()
+		{
+			const std::vector<char> &b = m_buffer->readable();
+			if( !FlatIndexedIO::canRead( m_buffer.get() ) )
+			{
+				throw IOException( "FlatIndexedIO: Not a FlatIndexedIO buffer" );
+			}
+
+			Header header;
+			memcpy( &header, b.data(), sizeof( Header ) );
+			if( header.byteOrder != g_byteOrderMark )
+			{
+				throw IOException( "FlatIndexedIO: Buffer was written with a different byte order" );
+			}
+			if( header.version > g_version )
+			{
+				throw IOException( "FlatIndexedIO: Buffer version greater than library version" );
+			}
+
+			insertDirectory( nullptr, IndexedIO::rootName );
+
+			size_t offset = sizeof( Header );
+			while( offset < b.size() )
+			{
+				if( b.size() - offset < sizeof( RecordHeader ) )
+				{
+					throw IOException( "FlatIndexedIO: Truncated buffer" );
+				}
+
+				RecordHeader record;
+				memcpy( &record, b.data() + offset, sizeof( RecordHeader ) );
+
+				const size_t nameOffset = offset + sizeof( RecordHeader );
+				if( record.nameLength > b.size() - nameOffset )
+				{
+					throw IOException( "FlatIndexedIO: Truncated buffer" );
+				}
+				const size_t dataOffset = align( nameOffset + record.nameLength );
+				if( dataOffset > b.size() || record.dataSize > b.size() - dataOffset )
+				{
+					throw IOException( "FlatIndexedIO: Truncated buffer" );
+				}
+
+				if( record.parent >= m_directories.size() )
+				{
+					throw IOException( "FlatIndexedIO: Invalid parent directory" );
+				}
+				Node *parent = m_directories[record.parent];
+				const IndexedIO::EntryID name( b.data() + nameOffset, record.nameLength );
+
+				switch( record.type )
+				{
+					case DirectoryRecord :
+						insertDirectory( parent, name );
+						break;
+					case FileRecord :
+						insertFile( parent, name, (IndexedIO::DataType)record.dataType, record.arrayLength, dataOffset, record.dataSize );
+						break;
+					case RemoveRecord :
+						parent->children.erase( name );
+						break;
+					case RemoveAllRecord :
+						parent->children.clear();
+						break;
+					default :
+						throw IOException( "FlatIndexedIO: Invalid record type" );
+				}
+
+				offset = align( dataOffset + record.dataSize );
+			}
+		}
+
+		Node *insertDirectory( Node *parent, const IndexedIO::EntryID &name )
+		{
+			m_nodes.push_back( Node( parent, name, m_directories.size() ) );
+			Node *node = &m_nodes.back();
+			m_directories.push_back( node );
+			if( parent )
+			{
+				parent->children[name] = node;
+			}
+			return node;
+		}
+
+		void insertFile( Node *parent, const IndexedIO::EntryID &name, IndexedIO::DataType dataType, uint64_t arrayLength, size_t dataOffset, size_t dataSize )
+		{
+			m_nodes.push_back( Node( parent, name, dataType, arrayLength, dataOffset, dataSize ) );
+			parent->children[name] = &m_nodes.back();
+		}
+
+		IndexedIO::OpenMode m_mode;
+		CharVectorDataPtr m_buffer;
+		// A deque, so that the addresses of nodes are stable.
+		std::deque<Node> m_nodes;
+		std::vector<Node *> m_directories;
+
+};
+
+//////////////////////////////////////////////////////////////////////////
+// FlatIndexedIO
+//////////////////////////////////////////////////////////////////////////
+
+FlatIndexedIO::FlatIndexedIO( ConstCharVectorDataPtr buffer, const IndexedIO::EntryIDList &root, IndexedIO::OpenMode mode )
+	:	m_index( new Index( buffer, mode ) ), m_node( m_index->root() )
+{
+	for( IndexedIO::EntryIDList::const_iterator it = root.begin(); it != root.end(); ++it )
+	{
+		Node *child = m_node->directoryChild( *it );
+		if( !child )
+		{
+			if( m_index->openMode() & ( IndexedIO::Write | IndexedIO::Append ) )
+			{
+				child = m_index->addDirectory( m_node, *it );
+			}
+			else
+			{
+				throw IOException( "FlatIndexedIO: Cannot find entry '" + it->value() + "'" );
+			}
+		}
+		m_node = child;
+	}
+}
+
+FlatIndexedIO::FlatIndexedIO( IndexPtr index, Node *node )
+	:	m_index( index ), m_node( node )
+{
+}
+
+FlatIndexedIO::~FlatIndexedIO()
+{
+}
+
+CharVectorDataPtr FlatIndexedIO::buffer()
+{
+	return m_index->buffer();
+}
+
+const char *FlatIndexedIO::dataPointer( const IndexedIO::EntryID &name, size_t &size ) const
+{
+	Node::ChildMap::const_iterator it = m_node->children.find( name );
+	if( it == m_node->children.end() || it->second->entryType != IndexedIO::File )
+	{
+		throw IOException( "FlatIndexedIO::dataPointer: Data entry not found '" + name.value() + "'" );
+	}
+	size = it->second->dataSize;
+	return m_index->data( it->second );
+}
+
+bool FlatIndexedIO::canRead( const CharVectorData *buffer )
+{
+	const std::vector<char> &b = buffer->readable();
+	return b.size() >= sizeof( Header ) && memcmp( b.data(), g_magic, sizeof( g_magic ) ) == 0;
+}
+
+CharVectorDataPtr FlatIndexedIO::encode( const Object *object )
+{
+	FlatIndexedIOPtr io = new FlatIndexedIO( nullptr, IndexedIO::rootPath, IndexedIO::Exclusive | IndexedIO::Write );
+	object->save( io, g_objectEntry );
+	return io->buffer();
+}
+
+ObjectPtr FlatIndexedIO::decode( ConstCharVectorDataPtr buffer )
+{
+	ConstIndexedIOPtr io = new FlatIndexedIO( buffer, IndexedIO::rootPath, IndexedIO::Exclusive | IndexedIO::Read );
+	return Object::load( io, g_objectEntry );
+}
+
+IndexedIO::OpenMode FlatIndexedIO::openMode() const
+{
+	return m_index->openMode();
+}
+
+void FlatIndexedIO::path( IndexedIO::EntryIDList &result ) const
+{
+	result.clear();
+	for( const Node *n = m_node; n->parent; n = n->parent )
+	{
+		result.push_back( n->name );
+	}
+	std::reverse( result.begin(), result.end() );
+}
+
+bool FlatIndexedIO::hasEntry( const IndexedIO::EntryID &name ) const
+{
+	return m_node->children.count( name );
+}
+
+const IndexedIO::EntryID &FlatIndexedIO::currentEntryId() const
+{
+	return m_node->name;
+}
+
+void FlatIndexedIO::entryIds( IndexedIO::EntryIDList &names ) const
+{
+	names.clear();
+	names.reserve( m_node->children.size() );
+	for( Node::ChildMap::const_iterator it = m_node->children.begin(); it != m_node->children.end(); ++it )
+	{
+		names.push_back( it->first );
+	}
+}
+
+void FlatIndexedIO::entryIds( IndexedIO::EntryIDList &names, IndexedIO::EntryType type ) const
+{
+	names.clear();
+	for( Node::ChildMap::const_iterator it = m_node->children.begin(); it != m_node->children.end(); ++it )
+	{
+		if( it->second->entryType == type )
+		{
+			names.push_back( it->first );
+		}
+	}
+}
+
+IndexedIOPtr FlatIndexedIO::subdirectory( const IndexedIO::EntryID &name, IndexedIO::MissingBehaviour missingBehaviour )
+{
+	Node *child = m_node->directoryChild( name );
+	if( !child )
+	{
+		if( missingBehaviour == IndexedIO::CreateIfMissing )
+		{
+			writable( name );
+			if( m_node->children.count( name ) )
+			{
+				throw IOException( "FlatIndexedIO: Could not insert child '" + name.value() + "'" );
+			}
+			child = m_index->addDirectory( m_node, name );
+		}
+		else if( missingBehaviour == IndexedIO::NullIfMissing )
+		{
+			return nullptr;
+		}
+		else
+		{
+			throw IOException( "FlatIndexedIO: Could not find child '" + name.value() + "'" );
+		}
+	}
+	return new FlatIndexedIO( m_index, child );
+}
+
+ConstIndexedIOPtr FlatIndexedIO::subdirectory( const IndexedIO::EntryID &name, IndexedIO::MissingBehaviour missingBehaviour ) const
+{
+	Node *child = m_node->directoryChild( name );
+	if( !child )
+	{
+		if( missingBehaviour == IndexedIO::NullIfMissing )
+		{
+			return nullptr;
+		}
+		if( missingBehaviour == IndexedIO::CreateIfMissing )
+		{
+			throw IOException( "FlatIndexedIO: No write access!" );
+		}
+		throw IOException( "FlatIndexedIO: Could not find child '" + name.value() + "'" );
+	}
+	return new FlatIndexedIO( m_index, child );
+}
+
+IndexedIO::Entry FlatIndexedIO::entry( const IndexedIO::EntryID &name ) const
+{
+	Node::ChildMap::const_iterator it = m_node->children.find( name );
+	if( it == m_node->children.end() )
+	{
+		throw IOException( "FlatIndexedIO::entry: Entry not found '" + name.value() + "'" );
+	}
+	const Node *node = it->second;
+	return IndexedIO::Entry( node->name, node->entryType, node->dataType, node->arrayLength );
+}
+
+IndexedIOPtr FlatIndexedIO::createSubdirectory( const IndexedIO::EntryID &name )
+{
+	if( m_node->children.count( name ) )
+	{
+		throw IOException( "Child '" + name.value() + "' already exists!" );
+	}
+	writable( name );
+	return new FlatIndexedIO( m_index, m_index->addDirectory( m_node, name ) );
+}
+
+void FlatIndexedIO::remove( const IndexedIO::EntryID &name )
+{
+	writable( name );
+	m_index->remove( m_node, name );
+}
+
+void FlatIndexedIO::removeAll()
+{
+	writable( m_node->name );
+	m_index->removeAll( m_node );
+}
+
+void FlatIndexedIO::commit()
+{
+	// Nothing to do - records are complete as soon as they are written.
+}
+
+IndexedIOPtr FlatIndexedIO::parentDirectory()
+{
+	if( !m_node->parent )
+	{
+		return nullptr;
+	}
+	return new FlatIndexedIO( m_index, m_node->parent );
+}
+
+ConstIndexedIOPtr FlatIndexedIO::parentDirectory() const
+{
+	if( !m_node->parent )
+	{
+		return nullptr;
+	}
+	return new FlatIndexedIO( m_index, m_node->parent );
+}
+
+IndexedIOPtr FlatIndexedIO::directory( const IndexedIO::EntryIDList &path, IndexedIO::MissingBehaviour missingBehaviour )
+{
+	Node *node = m_index->root();
+	for( IndexedIO::EntryIDList::const_iterator it = path.begin(); it != path.end(); ++it )
+	{
+		Node *child = node->directoryChild( *it );
+		if( !child )
+		{
+			if( missingBehaviour == IndexedIO::CreateIfMissing )
+			{
+				writable( *it );
+				if( node->children.count( *it ) )
+				{
+					throw IOException( "FlatIndexedIO: Could not insert child '" + it->value() + "'" );
+				}
+				child = m_index->addDirectory( node, *it );
+			}
+			else if( missingBehaviour == IndexedIO::NullIfMissing )
+			{
+				return nullptr;
+			}
+			else
+			{
+				throw IOException( "FlatIndexedIO: Could not find child '" + it->value() + "'" );
+			}
+		}
+		node = child;
+	}
+	return new FlatIndexedIO( m_index, node );
+}
+
+ConstIndexedIOPtr FlatIndexedIO::directory( const IndexedIO::EntryIDList &path, IndexedIO::MissingBehaviour missingBehaviour ) const
+{
+	return const_cast<FlatIndexedIO *>( this )->directory( path, missingBehaviour == IndexedIO::CreateIfMissing ? IndexedIO::ThrowIfMissing : missingBehaviour );
+}
+
+const FlatIndexedIO::Node *FlatIndexedIO::dataNode( const IndexedIO::EntryID &name, IndexedIO::DataType dataType ) const
+{
+	Node::ChildMap::const_iterator it = m_node->children.find( name );
+	if( it == m_node->children.end() || it->second->entryType != IndexedIO::File )
+	{
+		throw IOException( "FlatIndexedIO::read: Data entry not found '" + name.value() + "'" );
+	}
+	if( it->second->dataType != dataType )
+	{
+		throw IOException( "FlatIndexedIO::read: Data entry '" + name.value() + "' has an unexpected type" );
+	}
+	return it->second;
+}
+
+namespace
+{
+
+// The buffer may have come from another process, so string data is
+// unflattened with bounds checks rather than via IndexedIO::DataFlattenTraits,
+// which trusts the embedded lengths.
+
+void unflattenString( const IndexedIO::EntryID &name, const char *data, size_t dataSize, std::string &x )
+{
+	const char *end = static_cast<const char *>( memchr( data, '\0', dataSize ) );
+	if( !end )
+	{
+		throw IOException( "FlatIndexedIO::read: Unterminated string in data entry '" + name.value() + "'" );
+	}
+	x = std::string( data, end );
+}
+
+void unflattenStrings( const IndexedIO::EntryID &name, const char *data, size_t dataSize, std::string *&x, unsigned long arrayLength )
+{
+	const size_t lengthSize = IndexedIODetail::size<unsigned long>();
+	if( arrayLength > dataSize / lengthSize )
+	{
+		throw IOException( "FlatIndexedIO::read: Array length too long for data entry '" + name.value() + "'" );
+	}
+
+	std::vector<std::string> strings( arrayLength );
+	IndexedIODetail::InputMemoryStream mstream( data );
+	size_t remaining = dataSize;
+	for( unsigned long i = 0; i < arrayLength; ++i )
+	{
+		if( remaining < lengthSize )
+		{
+			throw IOException( "FlatIndexedIO::read: Truncated string array in data entry '" + name.value() + "'" );
+		}
+		unsigned long stringLength = 0;
+		IndexedIODetail::Reader<IndexedIODetail::MemoryStreamIO, IndexedIODetail::InputMemoryStream, unsigned long>::read( mstream, stringLength );
+		remaining -= lengthSize;
+		if( stringLength > remaining )
+		{
+			throw IOException( "FlatIndexedIO::read: Truncated string array in data entry '" + name.value() + "'" );
+		}
+		strings[i].assign( mstream.next(), stringLength );
+		mstream.skip( stringLength );
+		remaining -= stringLength;
+	}
+
+	if( !x )
+	{
+		x = new std::string[arrayLength];
+	}
+	std::copy( strings.begin(), strings.end(), x );
+}
+
+} // namespace
+
+template<typename T>
+void FlatIndexedIO::writeArray( const IndexedIO::EntryID &name, const T *x, unsigned long arrayLength )
+{
+	writable( name );
+	const size_t size = arrayLength * sizeof( T );
+	char *data = m_index->addFile( m_node, name, IndexedIO::DataTypeTraits<T*>::type(), arrayLength, size );
+	memcpy( data, x, size );
+}
+
+template<>
+void FlatIndexedIO::writeArray( const IndexedIO::EntryID &name, const std::string *x, unsigned long arrayLength )
+{
+	writable( name );
+	const size_t size = IndexedIO::DataSizeTraits<std::string*>::size( x, arrayLength );
+	char *data = m_index->addFile( m_node, name, IndexedIO::StringArray, arrayLength, size );
+	IndexedIO::DataFlattenTraits<std::string*>::flatten( x, arrayLength, data );
+}
+
+template<typename T>
+void FlatIndexedIO::writeScalar( const IndexedIO::EntryID &name, const T &x )
+{
+	writable( name );
+	char *data = m_index->addFile( m_node, name, IndexedIO::DataTypeTraits<T>::type(), 0, sizeof( T ) );
+	memcpy( data, &x, sizeof( T ) );
+}
+
+template<>
+void FlatIndexedIO::writeScalar( const IndexedIO::EntryID &name, const std::string &x )
+{
+	writable( name );
+	const size_t size = IndexedIO::DataSizeTraits<std::string>::size( x );
+	char *data = m_index->addFile( m_node, name, IndexedIO::String, 0, size );
+	IndexedIO::DataFlattenTraits<std::string>::flatten( x, data );
+}
+
+template<typename T>
+void FlatIndexedIO::readArray( const IndexedIO::EntryID &name, T *&x, unsigned long arrayLength ) const
+{
+	readable( name );
+	const Node *node = dataNode( name, IndexedIO::DataTypeTraits<T*>::type() );
+	if( arrayLength > node->arrayLength || arrayLength > node->dataSize / sizeof( T ) )
+	{
+		throw IOException( "FlatIndexedIO::read: Array length too long for data entry '" + name.value() + "'" );
+	}
+	if( !x )
+	{
+		x = new T[arrayLength];
+	}
+	memcpy( x, m_index->data( node ), arrayLength * sizeof( T ) );
+}
+
+template<>
+void FlatIndexedIO::readArray( const IndexedIO::EntryID &name, std::string *&x, unsigned long arrayLength ) const
+{
+	readable( name );
+	const Node *node = dataNode( name, IndexedIO::StringArray );
+	if( arrayLength > node->arrayLength )
+	{
+		throw IOException( "FlatIndexedIO::read: Array length too long for data entry '" + name.value() + "'" );
+	}
+	unflattenStrings( name, m_index->data( node ), node->dataSize, x, arrayLength );
+}
+
+template<typename T>
+void FlatIndexedIO::readScalar( const IndexedIO::EntryID &name, T &x ) const
+{
+	readable( name );
+	const Node *node = dataNode( name, IndexedIO::DataTypeTraits<T>::type() );
+	if( node->dataSize != sizeof( T ) )
+	{
+		throw IOException( "FlatIndexedIO::read: Data entry '" + name.value() + "' has an unexpected size" );
+	}
+	memcpy( &x, m_index->data( node ), sizeof( T ) );
+}
+
+template<>
+void FlatIndexedIO::readScalar( const IndexedIO::EntryID &name, std::string &x ) const
+{
+	readable( name );
+	const Node *node = dataNode( name, IndexedIO::String );
+	unflattenString( name, m_index->data( node ), node->dataSize, x );
+}
+
+// Write
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const float *x, unsigned long arrayLength)
+{
+	writeArray<float>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const double *x, unsigned long arrayLength)
+{
+	writeArray<double>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const half *x, unsigned long arrayLength)
+{
+	writeArray<half>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const int *x, unsigned long arrayLength)
+{
+	writeArray<int>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const int64_t *x, unsigned long arrayLength)
+{
+	writeArray<int64_t>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const uint64_t *x, unsigned long arrayLength)
+{
+	writeArray<uint64_t>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const unsigned int *x, unsigned long arrayLength)
+{
+	writeArray<unsigned int>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const char *x, unsigned long arrayLength)
+{
+	writeArray<char>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const unsigned char *x, unsigned long arrayLength)
+{
+	writeArray<unsigned char>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const short *x, unsigned long arrayLength)
+{
+	writeArray<short>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const unsigned short *x, unsigned long arrayLength)
+{
+	writeArray<unsigned short>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const std::string *x, unsigned long arrayLength)
+{
+	writeArray<std::string>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const InternedString *x, unsigned long arrayLength)
+{
+	writable( name );
+	std::vector<std::string> strings( x, x + arrayLength );
+	const std::string *s = strings.data();
+	const size_t size = IndexedIO::DataSizeTraits<std::string*>::size( s, arrayLength );
+	char *data = m_index->addFile( m_node, name, IndexedIO::InternedStringArray, arrayLength, size );
+	IndexedIO::DataFlattenTraits<std::string*>::flatten( s, arrayLength, data );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const float &x)
+{
+	writeScalar<float>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const double &x)
+{
+	writeScalar<double>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const half &x)
+{
+	writeScalar<half>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const int &x)
+{
+	writeScalar<int>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const int64_t &x)
+{
+	writeScalar<int64_t>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const uint64_t &x)
+{
+	writeScalar<uint64_t>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const std::string &x)
+{
+	writeScalar<std::string>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const unsigned int &x)
+{
+	writeScalar<unsigned int>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const char &x)
+{
+	writeScalar<char>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const unsigned char &x)
+{
+	writeScalar<unsigned char>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const short &x)
+{
+	writeScalar<short>( name, x );
+}
+
+void FlatIndexedIO::write(const IndexedIO::EntryID &name, const unsigned short &x)
+{
+	writeScalar<unsigned short>( name, x );
+}
+
+// Read
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, float *&x, unsigned long arrayLength) const
+{
+	readArray<float>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, double *&x, unsigned long arrayLength) const
+{
+	readArray<double>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, half *&x, unsigned long arrayLength) const
+{
+	readArray<half>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, int *&x, unsigned long arrayLength) const
+{
+	readArray<int>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, int64_t *&x, unsigned long arrayLength) const
+{
+	readArray<int64_t>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, uint64_t *&x, unsigned long arrayLength) const
+{
+	readArray<uint64_t>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, unsigned int *&x, unsigned long arrayLength) const
+{
+	readArray<unsigned int>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, char *&x, unsigned long arrayLength) const
+{
+	readArray<char>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, unsigned char *&x, unsigned long arrayLength) const
+{
+	readArray<unsigned char>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, short *&x, unsigned long arrayLength) const
+{
+	readArray<short>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, unsigned short *&x, unsigned long arrayLength) const
+{
+	readArray<unsigned short>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, std::string *&x, unsigned long arrayLength) const
+{
+	readArray<std::string>( name, x, arrayLength );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, InternedString *&x, unsigned long arrayLength) const
+{
+	readable( name );
+	const Node *node = dataNode( name, IndexedIO::InternedStringArray );
+	if( arrayLength > node->arrayLength )
+	{
+		throw IOException( "FlatIndexedIO::read: Array length too long for data entry '" + name.value() + "'" );
+	}
+
+	std::string *strings = nullptr;
+	unflattenStrings( name, m_index->data( node ), node->dataSize, strings, arrayLength );
+
+	if( !x )
+	{
+		x = new InternedString[arrayLength];
+	}
+	for( unsigned long i = 0; i < arrayLength; ++i )
+	{
+		x[i] = strings[i];
+	}
+	delete [] strings;
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, float &x) const
+{
+	readScalar<float>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, double &x) const
+{
+	readScalar<double>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, half &x) const
+{
+	readScalar<half>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, int &x) const
+{
+	readScalar<int>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, int64_t &x) const
+{
+	readScalar<int64_t>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, uint64_t &x) const
+{
+	readScalar<uint64_t>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, std::string &x) const
+{
+	readScalar<std::string>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, unsigned int &x) const
+{
+	readScalar<unsigned int>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, char &x) const
+{
+	readScalar<char>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, unsigned char &x) const
+{
+	readScalar<unsigned char>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, short &x) const
+{
+	readScalar<short>( name, x );
+}
+
+void FlatIndexedIO::read(const IndexedIO::EntryID &name, unsigned short &x) const
+{
+	readScalar<unsigned short>( name, x );
+}
@@ -104,7 +104,7 @@ void IndexedIO::validateOpenMode(IndexedIO::OpenMode &mode)
 {
 	// Clear 'other' bits
 	mode &= IndexedIO::Read | IndexedIO::Write | IndexedIO::Append
-			| IndexedIO::Shared | IndexedIO::Exclusive;
+			| IndexedIO::Shared | IndexedIO::Exclusive | IndexedIO::MemoryMapped;
 
 	// Check for mutual exclusivity
 	if ((mode & IndexedIO::Shared)
@@ -128,6 +128,12 @@ void IndexedIO::validateOpenMode(IndexedIO::OpenMode &mode)
 		mode |= IndexedIO::Read;
 	}
 
+	// Memory mapping only applies to read-only access
+	if ( (mode & IndexedIO::MemoryMapped) && (mode & (IndexedIO::Write | IndexedIO::Append)) )
+	{
+		mode &= ~IndexedIO::MemoryMapped;
+	}
+
 	// Set up default as 'shared'
 	if (!(mode & IndexedIO::Shared
 		|| mode & IndexedIO::Exclusive))
@@ -42,6 +42,7 @@
 #include "boost/lexical_cast.hpp"
 
 #include "IECore/InternedString.h"
+#include "IECore/MurmurHash.h"
 
 namespace IECore
 {
@@ -49,150 +50,144 @@ namespace IECore
 namespace Detail
 {
 
-// Simple type for specifying a range of characters, to
-// represent non-null-terminated strings.
-typedef std::pair<const char *, const char *> CharRange;
+InternedStringEntry::InternedStringEntry( const char *value, size_t length, size_t hash )
+	:	value( value, length ), hash( hash )
+{
+}
 
-// Hash for strings of various types.
-// By overloading it for multiple types, we are able to do
-// lookups into HashSet using any type as a key, and without
-// needing to construct a temporary std::string when the type
-// is a raw c string.
-struct Hash
+// Type used to look up a string in the HashSet, without needing
+// to construct a temporary std::string, and without needing to
+// recompute the hash as the HashSet grows.
+struct Key
 {
 
-	// Dan Bernstein's original string hash
-	size_t operator()( const char *s ) const
+	Key( const char *value, size_t length )
+		:	value( value ), length( length ), hash( hash_value( MurmurHash().append( value, length ) ) )
 	{
-		size_t hash = 5381;
-		while( *s )
-		{
-			hash = ( ( hash << 5 ) + hash ) + *s++;
-		}
-
-		return hash;
 	}
 
-	size_t operator()( const std::string &s ) const
-	{
-		return (*this)( s.c_str() );
-	}
-
-	size_t operator()( const CharRange &range ) const
-	{
-		size_t hash = 5381;
-		for( const char *s = range.first; s != range.second; ++s )
-		{
-			hash = ( ( hash << 5 ) + hash ) + *s;
-		}
-
-		return hash;
-	}
+	const char *value;
+	size_t length;
+	size_t hash;
 
 };
 
-// Equality operator between strings of various types.
-// As above, this allows HashSet lookups to be performed
-// using any type, without the overhead of constructing
-// temporary std::strings.
-struct Equal
+// Hash for entries and keys. Both store the hash computed
+// by Key's constructor, so no hashing actually happens here.
+struct Hash
 {
 
-	bool operator()( const std::string &s1, const std::string &s2 ) const
+	size_t operator()( const InternedStringEntry &e ) const
 	{
-		return s1 == s2;
+		return e.hash;
 	}
 
-	bool operator()( const char *c, const std::string &s ) const
+	size_t operator()( const Key &k ) const
 	{
-		return strcmp( c, s.c_str() )==0;
+		return k.hash;
 	}
 
-	bool operator()( const std::string &s, const char *c ) const
+};
+
+// Equality operator between entries and keys. Comparing the
+// hashes first means we only compare the characters of strings
+// which are almost certainly equal.
+struct Equal
+{
+
+	bool operator()( const InternedStringEntry &e1, const InternedStringEntry &e2 ) const
 	{
-		return strcmp( c, s.c_str() )==0;
+		return e1.hash == e2.hash && e1.value == e2.value;
 	}
 
-	bool operator()( const CharRange &c, const std::string &s ) const
+	bool operator()( const Key &k, const InternedStringEntry &e ) const
 	{
-		return s.compare( 0, std::string::npos, c.first, c.second - c.first )==0;
+		return k.hash == e.hash && e.value.compare( 0, std::string::npos, k.value, k.length )==0;
 	}
 
-	bool operator()( const std::string &s, const CharRange &c ) const
+	bool operator()( const InternedStringEntry &e, const Key &k ) const
 	{
-		return s.compare( 0, std::string::npos, c.first, c.second - c.first )==0;
+		return (*this)( k, e );
 	}
 
 };
 
 typedef boost::multi_index::multi_index_container<
-	std::string,
+	InternedStringEntry,
 	boost::multi_index::indexed_by<
 		boost::multi_index::hashed_unique<
-			boost::multi_index::identity<std::string>,
+			boost::multi_index::identity<InternedStringEntry>,
 			Hash,
 			Equal
 		>
 	>
 > HashSet;
 
-typedef HashSet::nth_index<0>::type Index;
-typedef HashSet::nth_index_const_iterator<0>::type ConstIterator;
 typedef tbb::spin_rw_mutex Mutex;
 
-static HashSet *hashSet()
+// The table of unique strings is split into shards, chosen using
+// the high bits of the hash (the HashSet uses the low bits to choose
+// buckets). Each has its own lock, so threads interning different
+// strings rarely contend with each other.
+struct Shard
 {
-	static HashSet g_hashSet;
-	return &g_hashSet;
+	Mutex mutex;
+	HashSet hashSet;
+	// Keep the mutexes of neighbouring shards off the same cache line.
+	char padding[64];
+};
+
+static const size_t g_shardBits = 6;
+static const size_t g_numShards = 1 << g_shardBits;
+
+static Shard *shards()
+{
+	static Shard g_shards[g_numShards];
+	return g_shards;
 }
 
-static Mutex *mutex()
+static Shard &shard( size_t hash )
 {
-	static Detail::Mutex g_mutex;
-	return &g_mutex;
+	return shards()[ ( hash >> ( sizeof( size_t ) * 8 - g_shardBits ) ) & ( g_numShards - 1 ) ];
 }
 
 } // namespace Detail
 
-const std::string *InternedString::internedString( const char *value )
+const InternedString::Entry *InternedString::internedString( const char *value )
 {
-	Detail::HashSet *hashSet = Detail::hashSet();
-	Detail::Index &hashIndex = hashSet->get<0>();
-	Detail::Mutex::scoped_lock lock( *Detail::mutex(), false ); // read-only lock
-	Detail::HashSet::const_iterator it = hashIndex.find( value );
-	if( it!=hashIndex.end() )
-	{
-		return &(*it);
-	}
-	else
-	{
-		lock.upgrade_to_writer();
-		return &(*(hashSet->insert( std::string( value ) ).first ) );
-	}
+	return internedString( value, strlen( value ) );
 }
 
-const std::string *InternedString::internedString( const char *value, size_t length )
+const InternedString::Entry *InternedString::internedString( const char *value, size_t length )
 {
-	Detail::HashSet *hashSet = Detail::hashSet();
-	Detail::Index &hashIndex = hashSet->get<0>();
-	Detail::Mutex::scoped_lock lock( *Detail::mutex(), false ); // read-only lock
-	Detail::HashSet::const_iterator it = hashIndex.find( Detail::CharRange( value, value + length ) );
-	if( it!=hashIndex.end() )
-	{
-		return &(*it);
-	}
-	else
+	const Detail::Key key( value, length );
+	Detail::Shard &shard = Detail::shard( key.hash );
+
 	{
-		lock.upgrade_to_writer();
-		return &(*(hashSet->insert( std::string( value, length ) ).first ) );
+		Detail::Mutex::scoped_lock lock( shard.mutex, false ); // read-only lock
+		Detail::HashSet::const_iterator it = shard.hashSet.find( key );
+		if( it!=shard.hashSet.end() )
+		{
+			return &(*it);
+		}
 	}
+
+	// Another thread may have inserted the string since we released the
+	// read lock, in which case insert() returns the existing entry.
+	Detail::Mutex::scoped_lock lock( shard.mutex, true );
+	return &(*(shard.hashSet.insert( Entry( value, length, key.hash ) ).first ) );
 }
 
 size_t InternedString::numUniqueStrings()
 {
-	Detail::Mutex::scoped_lock lock( *Detail::mutex(), false ); // read-only lock
-	Detail::HashSet *hashSet = Detail::hashSet();
-	return hashSet->size();
+	size_t result = 0;
+	Detail::Shard *shards = Detail::shards();
+	for( size_t i = 0; i < Detail::g_numShards; ++i )
+	{
+		Detail::Mutex::scoped_lock lock( shards[i].mutex, false ); // read-only lock
+		result += shards[i].hashSet.size();
+	}
+	return result;
 }
 
 static InternedString g_emptyString("");
@@ -0,0 +1,328 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
+#include "IECore/MeshAdjacency.h"
+#include "IECore/private/MeshAlgoUtils.h"
+
+using namespace std;
+using namespace IECore;
+
+//////////////////////////////////////////////////////////////////////////
+// Internal utilities
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+int nextInFace( const vector<int> &faceOffsets, const vector<int> &faceVaryingFaces, int i )
+{
+	const int f = faceVaryingFaces[i];
+	return i + 1 < faceOffsets[f+1] ? i + 1 : faceOffsets[f];
+}
+
+int previousInFace( const vector<int> &faceOffsets, const vector<int> &faceVaryingFaces, int i )
+{
+	const int f = faceVaryingFaces[i];
+	return i > faceOffsets[f] ? i - 1 : faceOffsets[f+1] - 1;
+}
+
+class FaceVaryingFaces
+{
+
+	public :
+
+		FaceVaryingFaces( const vector<int> &faceOffsets, vector<int> &faceVaryingFaces )
+			:	m_faceOffsets( faceOffsets ), m_faceVaryingFaces( faceVaryingFaces )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t f = r.begin(); f != r.end(); ++f )
+			{
+				for( int i = m_faceOffsets[f], e = m_faceOffsets[f+1]; i < e; ++i )
+				{
+					m_faceVaryingFaces[i] = f;
+				}
+			}
+		}
+
+	private :
+
+		const vector<int> &m_faceOffsets;
+		vector<int> &m_faceVaryingFaces;
+
+};
+
+// Finds the opposite of each half-edge by searching the half-edges
+// leaving its end vertex, so each is computed independently and the
+// cost is proportional to vertex valence rather than mesh size.
+class HalfEdges
+{
+
+	public :
+
+		HalfEdges(
+			const vector<int> &vertexIds, const vector<int> &faceOffsets, const vector<int> &faceVaryingFaces,
+			const vector<int> &vertexOffsets, const vector<int> &vertexFaceVaryings,
+			vector<int> &oppositeHalfEdges, vector<unsigned char> &boundaryEdges
+		)
+			:	m_vertexIds( vertexIds ), m_faceOffsets( faceOffsets ), m_faceVaryingFaces( faceVaryingFaces ),
+				m_vertexOffsets( vertexOffsets ), m_vertexFaceVaryings( vertexFaceVaryings ),
+				m_oppositeHalfEdges( oppositeHalfEdges ), m_boundaryEdges( boundaryEdges )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t h = r.begin(); h != r.end(); ++h )
+			{
+				const int v0 = m_vertexIds[h];
+				const int v1 = m_vertexIds[nextInFace( m_faceOffsets, m_faceVaryingFaces, h )];
+
+				m_oppositeHalfEdges[h] = -1;
+				m_boundaryEdges[h] = 0;
+				if( v0 == v1 )
+				{
+					// Degenerate edge
+					continue;
+				}
+
+				int numSame = 0;
+				int numOpposite = 0;
+				int opposite = -1;
+				countUses( v0, v1, numSame, opposite );
+				countUses( v1, v0, numOpposite, opposite );
+
+				if( numSame == 1 && numOpposite == 1 )
+				{
+					m_oppositeHalfEdges[h] = opposite;
+				}
+				else if( numSame == 1 && numOpposite == 0 )
+				{
+					m_boundaryEdges[h] = 1;
+				}
+			}
+		}
+
+	private :
+
+		// Counts the half-edges running from v0 to v1, storing the last one
+		// found in halfEdge.
+		void countUses( int v0, int v1, int &count, int &halfEdge ) const
+		{
+			for( int i = m_vertexOffsets[v0], e = m_vertexOffsets[v0+1]; i < e; ++i )
+			{
+				const int fv = m_vertexFaceVaryings[i];
+				if( m_vertexIds[nextInFace( m_faceOffsets, m_faceVaryingFaces, fv )] == v1 )
+				{
+					count++;
+					halfEdge = fv;
+				}
+			}
+		}
+
+		const vector<int> &m_vertexIds;
+		const vector<int> &m_faceOffsets;
+		const vector<int> &m_faceVaryingFaces;
+		const vector<int> &m_vertexOffsets;
+		const vector<int> &m_vertexFaceVaryings;
+		vector<int> &m_oppositeHalfEdges;
+		vector<unsigned char> &m_boundaryEdges;
+
+};
+
+// A vertex is on the boundary if any of the half-edges
+// entering or leaving it is a boundary edge.
+class BoundaryVertices
+{
+
+	public :
+
+		BoundaryVertices(
+			const vector<int> &faceOffsets, const vector<int> &faceVaryingFaces,
+			const vector<int> &vertexOffsets, const vector<int> &vertexFaceVaryings,
+			const vector<unsigned char> &boundaryEdges, vector<unsigned char> &boundaryVertices
+		)
+			:	m_faceOffsets( faceOffsets ), m_faceVaryingFaces( faceVaryingFaces ),
+				m_vertexOffsets( vertexOffsets ), m_vertexFaceVaryings( vertexFaceVaryings ),
+				m_boundaryEdges( boundaryEdges ), m_boundaryVertices( boundaryVertices )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t v = r.begin(); v != r.end(); ++v )
+			{
+				unsigned char boundary = 0;
+				for( int i = m_vertexOffsets[v], e = m_vertexOffsets[v+1]; i < e && !boundary; ++i )
+				{
+					const int fv = m_vertexFaceVaryings[i];
+					boundary = m_boundaryEdges[fv] || m_boundaryEdges[previousInFace( m_faceOffsets, m_faceVaryingFaces, fv )];
+				}
+				m_boundaryVertices[v] = boundary;
+			}
+		}
+
+	private :
+
+		const vector<int> &m_faceOffsets;
+		const vector<int> &m_faceVaryingFaces;
+		const vector<int> &m_vertexOffsets;
+		const vector<int> &m_vertexFaceVaryings;
+		const vector<unsigned char> &m_boundaryEdges;
+		vector<unsigned char> &m_boundaryVertices;
+
+};
+
+template<typename T>
+size_t vectorMemoryUsage( const vector<T> &v )
+{
+	return v.capacity() * sizeof( T );
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+// MeshAdjacency
+//////////////////////////////////////////////////////////////////////////
+
+MeshAdjacency::MeshAdjacency( const std::vector<int> &verticesPerFace, const std::vector<int> &vertexIds, size_t numVertices )
+{
+	const size_t numFaceVaryings = vertexIds.size();
+
+	Detail::faceOffsets( verticesPerFace, m_faceOffsets );
+
+	m_faceVaryingFaces.resize( numFaceVaryings );
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, verticesPerFace.size() ),
+		FaceVaryingFaces( m_faceOffsets, m_faceVaryingFaces )
+	);
+
+	Detail::indexFaceVaryings( vertexIds, numVertices, m_vertexOffsets, m_vertexFaceVaryings );
+
+	m_oppositeHalfEdges.resize( numFaceVaryings );
+	m_boundaryEdges.resize( numFaceVaryings );
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, numFaceVaryings ),
+		HalfEdges( vertexIds, m_faceOffsets, m_faceVaryingFaces, m_vertexOffsets, m_vertexFaceVaryings, m_oppositeHalfEdges, m_boundaryEdges )
+	);
+
+	m_boundaryVertices.resize( numVertices );
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, numVertices ),
+		BoundaryVertices( m_faceOffsets, m_faceVaryingFaces, m_vertexOffsets, m_vertexFaceVaryings, m_boundaryEdges, m_boundaryVertices )
+	);
+}
+
+MeshAdjacency::~MeshAdjacency()
+{
+}
+
+size_t MeshAdjacency::numFaces() const
+{
+	return m_faceOffsets.size() - 1;
+}
+
+size_t MeshAdjacency::numVertices() const
+{
+	return m_boundaryVertices.size();
+}
+
+size_t MeshAdjacency::numFaceVaryings() const
+{
+	return m_faceVaryingFaces.size();
+}
+
+const std::vector<int> &MeshAdjacency::faceOffsets() const
+{
+	return m_faceOffsets;
+}
+
+const std::vector<int> &MeshAdjacency::faceVaryingFaces() const
+{
+	return m_faceVaryingFaces;
+}
+
+const std::vector<int> &MeshAdjacency::vertexOffsets() const
+{
+	return m_vertexOffsets;
+}
+
+const std::vector<int> &MeshAdjacency::vertexFaceVaryings() const
+{
+	return m_vertexFaceVaryings;
+}
+
+int MeshAdjacency::nextFaceVarying( int i ) const
+{
+	return nextInFace( m_faceOffsets, m_faceVaryingFaces, i );
+}
+
+int MeshAdjacency::previousFaceVarying( int i ) const
+{
+	return previousInFace( m_faceOffsets, m_faceVaryingFaces, i );
+}
+
+const std::vector<int> &MeshAdjacency::oppositeHalfEdges() const
+{
+	return m_oppositeHalfEdges;
+}
+
+bool MeshAdjacency::isBoundaryEdge( int halfEdge ) const
+{
+	return m_boundaryEdges[halfEdge];
+}
+
+bool MeshAdjacency::isBoundaryVertex( int vertex ) const
+{
+	return m_boundaryVertices[vertex];
+}
+
+size_t MeshAdjacency::memoryUsage() const
+{
+	return
+		sizeof( *this ) +
+		vectorMemoryUsage( m_faceOffsets ) +
+		vectorMemoryUsage( m_faceVaryingFaces ) +
+		vectorMemoryUsage( m_vertexOffsets ) +
+		vectorMemoryUsage( m_vertexFaceVaryings ) +
+		vectorMemoryUsage( m_oppositeHalfEdges ) +
+		vectorMemoryUsage( m_boundaryEdges ) +
+		vectorMemoryUsage( m_boundaryVertices )
+	;
+}
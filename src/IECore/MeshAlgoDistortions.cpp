@@ -32,9 +32,12 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
 #include "IECore/DespatchTypedData.h"
 #include "IECore/MeshAlgo.h"
-#include "IECore/PolygonIterator.h"
+#include "IECore/private/MeshAlgoUtils.h"
 
 using namespace std;
 using namespace Imath;
@@ -52,7 +55,7 @@ struct CalculateDistortions
 	public :
 
 		CalculateDistortions(
-			const vector<int> &vertsPerFace,
+			const MeshAdjacency &adjacency,
 			const vector<int> &vertIds,
 			size_t faceVaryingSize,
 			const vector<Imath::V3f> &p,
@@ -62,7 +65,7 @@ struct CalculateDistortions
 		) :
 			distortionData( nullptr ),
 			uvDistortionData( nullptr ),
-			m_vertsPerFace( vertsPerFace ),
+			m_adjacency( adjacency ),
 			m_vertIds( vertIds ),
 			m_faceVaryingSize( faceVaryingSize ),
 			m_p( p ),
@@ -78,7 +81,7 @@ struct CalculateDistortions
 
 	private :
 
-		const vector<int> &m_vertsPerFace;
+		const MeshAdjacency &m_adjacency;
 		const vector<int> &m_vertIds;
 		const size_t m_faceVaryingSize;
 		const vector<Imath::V3f> &m_p;
@@ -86,130 +89,189 @@ struct CalculateDistortions
 		const vector<Imath::V2f> &m_uvs;
 		const vector<int> &m_uvIds;
 
-		struct UVDistortion
-		{
-			Imath::V2f distortion;
-			int counter;
-
-			UVDistortion() : distortion(0), counter(0) 	{};
+		// Distortions of the two edges adjacent to each FaceVarying
+		// vertex, summed. These are computed independently for each
+		// face, and then gathered for each vertex and uv.
+		vector<float> m_faceVaryingDistortions;
+		vector<Imath::V2f> m_faceVaryingUVDistortions;
 
-			void accumulateDistortion( float dist, const Imath::V2f &uv )
+		struct FaceDistortions
+		{
+			FaceDistortions( CalculateDistortions &c, const vector<int> &faceOffsets )
+				:	m_c( c ), m_faceOffsets( faceOffsets )
 			{
-				distortion.x += fabs( uv.x ) * dist;
-				distortion.y += fabs( uv.y ) * dist;
-				counter++;
 			}
-		};
-		std::vector< UVDistortion > m_uvDistortions;
 
-		struct VertexDistortion
-		{
-			float distortion;
-			int counter;
+			void operator()( const tbb::blocked_range<size_t> &r ) const
+			{
+				for( size_t faceIndex = r.begin(); faceIndex != r.end(); ++faceIndex )
+				{
+					const int firstFvi = m_faceOffsets[faceIndex];
+					const int lastFvi = m_faceOffsets[faceIndex+1] - 1;
+					if( lastFvi < firstFvi )
+					{
+						continue;
+					}
 
-			VertexDistortion() : distortion(0), counter(0) 	{};
+					// distortion of the edge ending at the first vertex, which is
+					// the final edge of the face.
+					float prevDistortion = 0;
+					Imath::V2f prevUVDistortion( 0 );
+					edgeDistortion( lastFvi, firstFvi, prevDistortion, prevUVDistortion );
 
-			void accumulateDistortion( float dist )
-			{
-				distortion += dist;
-				counter++;
-			}
-		};
-		std::vector< VertexDistortion > m_distortions;
+					for( int fvi0 = firstFvi; fvi0 <= lastFvi; ++fvi0 )
+					{
+						const int fvi1 = fvi0 == lastFvi ? firstFvi : fvi0 + 1;
 
-	public :
+						float distortion;
+						Imath::V2f uvDistortion;
+						edgeDistortion( fvi0, fvi1, distortion, uvDistortion );
 
-		void calculate()
-		{
-			m_distortions.clear();
-			m_distortions.resize( m_p.size() );
+						m_c.m_faceVaryingDistortions[fvi0] = prevDistortion + distortion;
+						m_c.m_faceVaryingUVDistortions[fvi0] = prevUVDistortion + uvDistortion;
 
-			int numUniqueTangents = 1 + *max_element( m_uvIds.begin(), m_uvIds.end() );
-			m_uvDistortions.clear();
-			m_uvDistortions.resize( numUniqueTangents );
+						prevDistortion = distortion;
+						prevUVDistortion = uvDistortion;
+					}
+				}
+			}
 
-			size_t fvi0 = 0;
+			void edgeDistortion( int fvi0, int fvi1, float &distortion, Imath::V2f &uvDistortion ) const
+			{
+				unsigned vertex0 = m_c.m_vertIds[ fvi0 ];
+				unsigned vertex1 = m_c.m_vertIds[ fvi1 ];
+				// compute distortion along the edge
+				const V3f &p0 = m_c.m_p[ vertex0 ];
+				const V3f &refP0 = m_c.m_pRef[ vertex0 ];
+				const V3f &p1 = m_c.m_p[ vertex1 ];
+				const V3f &refP1 = m_c.m_pRef[ vertex1 ];
+				V3f edge = p1 - p0;
+				V3f refEdge = refP1 - refP0;
+				float edgeLen = edge.length();
+				float refEdgeLen = refEdge.length();
+				if ( edgeLen >= refEdgeLen )
+				{
+					distortion = fabs((edgeLen / refEdgeLen) - 1.0f);
+				}
+				else
+				{
+					distortion = -fabs( (refEdgeLen / edgeLen) - 1.0f );
+				}
 
-			for( size_t faceIndex = 0; faceIndex < m_vertsPerFace.size() ; faceIndex++ )
+				// compute uv vector
+				const Imath::V2f uvDir = ( m_c.m_uvs[ fvi1 ] - m_c.m_uvs[ fvi0 ] ).normalized();
+				uvDistortion = Imath::V2f( fabs( uvDir.x ) * distortion, fabs( uvDir.y ) * distortion );
+			}
+
+			CalculateDistortions &m_c;
+			const vector<int> &m_faceOffsets;
+		};
+
+		// Averages the FaceVarying distortions for each vertex
+		// or uv, visiting them in ascending order so the results
+		// are deterministic.
+		template<typename T>
+		struct GatherDistortions
+		{
+			GatherDistortions( const vector<T> &faceVaryingDistortions, const vector<int> &offsets, const vector<int> &faceVaryings, vector<T> &result )
+				:	m_faceVaryingDistortions( faceVaryingDistortions ), m_offsets( offsets ), m_faceVaryings( faceVaryings ), m_result( result )
 			{
-				size_t firstFvi = fvi0;
-				unsigned vertex0 = m_vertIds[ fvi0 ];
-				Imath::V2f uv0( m_uvs[ fvi0 ] );
+			}
 
-				for ( int v = 1; v <= m_vertsPerFace[faceIndex]; v++, fvi0++ )
+			void operator()( const tbb::blocked_range<size_t> &r ) const
+			{
+				for( size_t i = r.begin(); i != r.end(); ++i )
 				{
-					size_t fvi1 = fvi0 + 1;
-					if ( v == m_vertsPerFace[faceIndex] )
+					T distortion( 0 );
+					for( int j = m_offsets[i], e = m_offsets[i+1]; j < e; ++j )
 					{
-						// final edge must also be computed...
-						fvi1 = firstFvi;
+						distortion += m_faceVaryingDistortions[m_faceVaryings[j]];
 					}
-					unsigned vertex1 = m_vertIds[ fvi1 ];
-					// compute distortion along the edge
-					const V3f &p0 = m_p[ vertex0 ];
-					const V3f &refP0 = m_pRef[ vertex0 ];
-					const V3f &p1 = m_p[ vertex1 ];
-					const V3f &refP1 = m_pRef[ vertex1 ];
-					V3f edge = p1 - p0;
-					V3f refEdge = refP1 - refP0;
-					float edgeLen = edge.length();
-					float refEdgeLen = refEdge.length();
-					float distortion = 0;
-					if ( edgeLen >= refEdgeLen )
+					// each FaceVarying vertex accounts for two edges
+					const int counter = 2 * ( m_offsets[i+1] - m_offsets[i] );
+					if( counter )
 					{
-						distortion = fabs((edgeLen / refEdgeLen) - 1.0f);
+						distortion *= 1.0f / counter;
 					}
-					else
-					{
-						distortion = -fabs( (refEdgeLen / edgeLen) - 1.0f );
-					}
-
-					// accumulate vertex distortions
-					m_distortions[ vertex0 ].accumulateDistortion( distortion );
-					m_distortions[ vertex1 ].accumulateDistortion( distortion );
-					vertex0 = vertex1;
-
-					// compute uv vector
-					Imath::V2f uv1( m_uvs[ fvi1 ] );
-					const Imath::V2f uvDir = (uv1 - uv0).normalized();
-					// accumulate uv distortion
-					m_uvDistortions[ m_uvIds[fvi0] ].accumulateDistortion( distortion, uvDir );
-					m_uvDistortions[ m_uvIds[fvi1] ].accumulateDistortion( distortion, uvDir );
-					uv0 = uv1;
+					m_result[i] = distortion;
 				}
-				fvi0 = firstFvi + m_vertsPerFace[faceIndex];
 			}
 
-			// normalize distortions and build output vectors
+			const vector<T> &m_faceVaryingDistortions;
+			const vector<int> &m_offsets;
+			const vector<int> &m_faceVaryings;
+			vector<T> &m_result;
+		};
 
-			// create the distortion prim var.
-			distortionData = new FloatVectorData();
-			std::vector<float> &distortionVec = distortionData->writable();
-			distortionVec.reserve( m_distortions.size() );
-			for( auto &dist : m_distortions )
+		struct ExpandUVDistortions
+		{
+			ExpandUVDistortions( const vector<Imath::V2f> &uvDistortions, const vector<int> &uvIds, vector<Imath::V2f> &result )
+				:	m_uvDistortions( uvDistortions ), m_uvIds( uvIds ), m_result( result )
 			{
-				float invCounter = 0;
-				if ( dist.counter )
-				{
-					invCounter = ( 1.0f / dist.counter );
-				}
-				distortionVec.push_back( dist.distortion * invCounter );
 			}
 
-			// create U and V distortions
-			uvDistortionData = new V2fVectorData();
-			std::vector<Imath::V2f> &uvDistortionVec = uvDistortionData->writable();
-			uvDistortionVec.reserve( m_faceVaryingSize );
-			for( auto &id : m_uvIds )
+			void operator()( const tbb::blocked_range<size_t> &r ) const
 			{
-				UVDistortion &uvDist = m_uvDistortions[id];
-				if ( uvDist.counter )
+				for( size_t i = r.begin(); i != r.end(); ++i )
 				{
-					uvDist.distortion /= (float)uvDist.counter;
-					uvDist.counter = 0;
+					m_result[i] = m_uvDistortions[m_uvIds[i]];
 				}
-				uvDistortionVec.push_back( uvDist.distortion );
 			}
+
+			const vector<Imath::V2f> &m_uvDistortions;
+			const vector<int> &m_uvIds;
+			vector<Imath::V2f> &m_result;
+		};
+
+	public :
+
+		void calculate()
+		{
+			const vector<int> &faceOffsets = m_adjacency.faceOffsets();
+
+			// compute the distortions for each face
+
+			m_faceVaryingDistortions.resize( m_vertIds.size() );
+			m_faceVaryingUVDistortions.resize( m_vertIds.size() );
+
+			tbb::parallel_for(
+				tbb::blocked_range<size_t>( 0, m_adjacency.numFaces() ),
+				FaceDistortions( *this, faceOffsets )
+			);
+
+			// create the distortion prim var by averaging for each vertex.
+
+			distortionData = new FloatVectorData();
+			std::vector<float> &distortionVec = distortionData->writable();
+			distortionVec.resize( m_p.size() );
+
+			tbb::parallel_for(
+				tbb::blocked_range<size_t>( 0, m_p.size() ),
+				GatherDistortions<float>( m_faceVaryingDistortions, m_adjacency.vertexOffsets(), m_adjacency.vertexFaceVaryings(), distortionVec )
+			);
+
+			// create U and V distortions by averaging for each
+			// uv and then expanding to FaceVarying.
+
+			int numUniqueTangents = 1 + *max_element( m_uvIds.begin(), m_uvIds.end() );
+			vector<int> offsets, faceVaryings;
+			Detail::indexFaceVaryings( m_uvIds, numUniqueTangents, offsets, faceVaryings );
+
+			vector<Imath::V2f> uvDistortions( numUniqueTangents );
+			tbb::parallel_for(
+				tbb::blocked_range<size_t>( 0, numUniqueTangents ),
+				GatherDistortions<Imath::V2f>( m_faceVaryingUVDistortions, offsets, faceVaryings, uvDistortions )
+			);
+
+			uvDistortionData = new V2fVectorData();
+			std::vector<Imath::V2f> &uvDistortionVec = uvDistortionData->writable();
+			assert( m_uvIds.size() == m_faceVaryingSize );
+			uvDistortionVec.resize( m_faceVaryingSize );
+
+			tbb::parallel_for(
+				tbb::blocked_range<size_t>( 0, uvDistortionVec.size() ),
+				ExpandUVDistortions( uvDistortions, m_uvIds, uvDistortionVec )
+			);
 		}
 };
 
@@ -240,8 +302,9 @@ std::pair<PrimitiveVariable, PrimitiveVariable> MeshAlgo::calculateDistortion( c
 	const V2fVectorData *uvData = runTimeCast<const V2fVectorData>( uvIt->second.data.get() );
 	const IntVectorData *uvIndicesData = uvIt->second.indices ? uvIt->second.indices.get() : mesh->vertexIds();
 
+	ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
 	CalculateDistortions calc(
-		mesh->verticesPerFace()->readable(),
+		*adjacency,
 		mesh->vertexIds()->readable(),
 		mesh->variableSize( PrimitiveVariable::FaceVarying ),
 		pData->readable(),
@@ -37,9 +37,12 @@
 #include "boost/iterator/zip_iterator.hpp"
 #include "boost/iterator/transform_iterator.hpp"
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
 #include "IECore/MeshAlgo.h"
 #include "IECore/PolygonAlgo.h"
-#include "IECore/PolygonIterator.h"
+#include "IECore/PolygonVertexIterator.h"
 
 using namespace Imath;
 using namespace IECore;
@@ -61,6 +64,75 @@ struct V2fToV3f
 	}
 };
 
+struct FaceAreas
+{
+
+	FaceAreas( const std::vector<V3f> &p, const std::vector<int> &vertIds, const std::vector<int> &faceOffsets, std::vector<float> &areas )
+		:	m_p( p ), m_vertIds( vertIds ), m_faceOffsets( faceOffsets ), m_areas( areas )
+	{
+	}
+
+	void operator()( const tbb::blocked_range<size_t> &r ) const
+	{
+		typedef PolygonVertexIterator<std::vector<V3f>::const_iterator> VertexIterator;
+		for( size_t f = r.begin(); f != r.end(); ++f )
+		{
+			VertexIterator begin( m_vertIds.begin() + m_faceOffsets[f], m_p.begin() );
+			VertexIterator end( m_vertIds.begin() + m_faceOffsets[f+1], m_p.begin() );
+			m_areas[f] = polygonArea( begin, end );
+		}
+	}
+
+	const std::vector<V3f> &m_p;
+	const std::vector<int> &m_vertIds;
+	const std::vector<int> &m_faceOffsets;
+	std::vector<float> &m_areas;
+
+};
+
+struct FaceTextureAreas
+{
+
+	FaceTextureAreas( const std::vector<V2f> &uvs, PrimitiveVariable::Interpolation uvInterpolation, const std::vector<int> &vertIds, const std::vector<int> &faceOffsets, std::vector<float> &areas )
+		:	m_uvs( uvs ), m_uvInterpolation( uvInterpolation ), m_vertIds( vertIds ), m_faceOffsets( faceOffsets ), m_areas( areas )
+	{
+	}
+
+	void operator()( const tbb::blocked_range<size_t> &r ) const
+	{
+		for( size_t f = r.begin(); f != r.end(); ++f )
+		{
+			if( m_uvInterpolation==PrimitiveVariable::Vertex )
+			{
+				typedef PolygonVertexIterator<std::vector<Imath::V2f>::const_iterator> VertexIterator;
+				typedef boost::transform_iterator<V2fToV3f, VertexIterator> STIterator;
+
+				STIterator begin( VertexIterator( m_vertIds.begin() + m_faceOffsets[f], m_uvs.begin() ) );
+				STIterator end( VertexIterator( m_vertIds.begin() + m_faceOffsets[f+1], m_uvs.begin() ) );
+
+				m_areas[f] = polygonArea( begin, end );
+			}
+			else
+			{
+				assert( m_uvInterpolation==PrimitiveVariable::FaceVarying );
+				typedef boost::transform_iterator<V2fToV3f, std::vector<Imath::V2f>::const_iterator> STIterator;
+
+				STIterator begin( m_uvs.begin() + m_faceOffsets[f] );
+				STIterator end( m_uvs.begin() + m_faceOffsets[f+1] );
+
+				m_areas[f] = polygonArea( begin, end );
+			}
+		}
+	}
+
+	const std::vector<V2f> &m_uvs;
+	PrimitiveVariable::Interpolation m_uvInterpolation;
+	const std::vector<int> &m_vertIds;
+	const std::vector<int> &m_faceOffsets;
+	std::vector<float> &m_areas;
+
+};
+
 } // namespace
 
 PrimitiveVariable MeshAlgo::calculateFaceArea( const MeshPrimitive *mesh, const std::string &position )
@@ -72,16 +144,17 @@ PrimitiveVariable MeshAlgo::calculateFaceArea( const MeshPrimitive *mesh, const
 	}
 	const std::vector<V3f> &p = pData->readable();
 
+	ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
+	const std::vector<int> &faceOffsets = adjacency->faceOffsets();
+
 	FloatVectorDataPtr areasData = new FloatVectorData;
 	std::vector<float> &areas = areasData->writable();
-	areas.reserve( mesh->variableSize( PrimitiveVariable::Uniform ) );
+	areas.resize( mesh->variableSize( PrimitiveVariable::Uniform ) );
 
-	/// \todo: can MeshPrimitive::faceEnd() be const?
-	PolygonIterator faceEnd = const_cast<MeshPrimitive*>( mesh )->faceEnd();
-	for( PolygonIterator pIt = const_cast<MeshPrimitive*>( mesh )->faceBegin(); pIt != faceEnd; pIt++ )
-	{
-		areas.push_back( polygonArea( pIt.vertexBegin( p.begin() ), pIt.vertexEnd( p.begin() ) ) );
-	}
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, areas.size() ),
+		FaceAreas( p, mesh->vertexIds()->readable(), faceOffsets, areas )
+	);
 
 	return PrimitiveVariable( PrimitiveVariable::Uniform, areasData );
 }
@@ -101,35 +174,17 @@ PrimitiveVariable MeshAlgo::calculateFaceTextureArea( const MeshPrimitive *mesh,
 	}
 	const std::vector<Imath::V2f> &uvs = uvData->readable();
 
+	ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
+	const std::vector<int> &faceOffsets = adjacency->faceOffsets();
+
 	FloatVectorDataPtr textureAreasData = new FloatVectorData;
 	std::vector<float> &textureAreas = textureAreasData->writable();
-	textureAreas.reserve( mesh->variableSize( PrimitiveVariable::Uniform ) );
+	textureAreas.resize( mesh->variableSize( PrimitiveVariable::Uniform ) );
 
-	/// \todo: can MeshPrimitive::faceEnd() be const?
-	PolygonIterator faceEnd = const_cast<MeshPrimitive*>( mesh )->faceEnd();
-	for( PolygonIterator pIt = const_cast<MeshPrimitive*>( mesh )->faceBegin(); pIt!=faceEnd; pIt++ )
-	{
-		if( uvInterpolation==PrimitiveVariable::Vertex )
-		{
-			typedef PolygonVertexIterator<std::vector<Imath::V2f>::const_iterator> VertexIterator;
-			typedef boost::transform_iterator<V2fToV3f, VertexIterator> STIterator;
-
-			STIterator begin( pIt.vertexBegin( uvs.begin() ) );
-			STIterator end( pIt.vertexEnd( uvs.begin() ) );
-
-			textureAreas.push_back( polygonArea( begin, end ) );
-		}
-		else
-		{
-			assert( uvInterpolation==PrimitiveVariable::FaceVarying );
-			typedef boost::transform_iterator<V2fToV3f, std::vector<Imath::V2f>::const_iterator> STIterator;
-
-			STIterator begin( pIt.faceVaryingBegin( uvs.begin() ) );
-			STIterator end( pIt.faceVaryingEnd( uvs.begin() ) );
-
-			textureAreas.push_back( polygonArea( begin, end ) );
-		}
-	}
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, textureAreas.size() ),
+		FaceTextureAreas( uvs, uvInterpolation, mesh->vertexIds()->readable(), faceOffsets, textureAreas )
+	);
 
 	return PrimitiveVariable( PrimitiveVariable::Uniform, textureAreasData );
 }
@@ -32,8 +32,13 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include "boost/shared_ptr.hpp"
+#include "boost/type_traits/is_same.hpp"
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
 #include "IECore/DespatchTypedData.h"
-#include "IECore/FaceVaryingPromotionOp.h"
 #include "IECore/MeshAlgo.h"
 
 #include "IECore/private/PrimitiveAlgoUtils.h"
@@ -48,299 +53,427 @@ using namespace IECore;
 namespace
 {
 
-struct MeshVertexToUniform
+// Provides access to the source values of a primitive variable,
+// optionally via its indices, so that indexed variables needn't
+// be expanded before resampling.
+template<typename T>
+class Source
 {
-	typedef DataPtr ReturnType;
 
-	MeshVertexToUniform( const MeshPrimitive *mesh )	:	m_mesh( mesh )
-	{
-	}
+	public :
 
-	template<typename From> ReturnType operator()( const From* data )
-	{
-		typename From::Ptr result = static_cast< From* >( Object::create( data->typeId() ).get() );
-		typename From::ValueType &trg = result->writable();
-		const typename From::ValueType &src = data->readable();
-
-		// TODO sipmlify this code by using polygon face & vertex iterators
-		trg.reserve( m_mesh->numFaces() );
+		Source( const std::vector<T> &data, const std::vector<int> *indices )
+			:	m_data( data ), m_indices( indices )
+		{
+		}
 
-		std::vector<int>::const_iterator vId = m_mesh->vertexIds()->readable().begin();
-		const std::vector<int> &verticesPerFace = m_mesh->verticesPerFace()->readable();
-		for( std::vector<int>::const_iterator it = verticesPerFace.begin(); it < verticesPerFace.end(); ++it )
+		typename std::vector<T>::const_reference operator[]( size_t i ) const
 		{
-			// initialize with the first value to avoid
-			// ambiguitity during default construction
-			typename From::ValueType::value_type total = src[ *vId ];
-			++vId;
+			return m_indices ? m_data[(*m_indices)[i]] : m_data[i];
+		}
 
-			for( int j = 1; j < *it; ++j, ++vId )
-			{
-				total += src[ *vId ];
-			}
+	private :
+
+		const std::vector<T> &m_data;
+		const std::vector<int> *m_indices;
+
+};
 
-			trg.push_back( total / *it );
+// Base class for resampling a single primitive variable. The elements of
+// the result are computed in ranges, which are faces when resampling to
+// Uniform or FaceVarying and vertices otherwise. This allows all the
+// variables to be resampled in a single parallel pass over the mesh.
+class Resampler
+{
+
+	public :
+
+		virtual ~Resampler()
+		{
 		}
 
-		return result;
-	}
+		virtual void operator()( const tbb::blocked_range<size_t> &range ) const = 0;
+		// Returns false if neighbouring results may not be written
+		// concurrently, as is the case for std::vector<bool>.
+		virtual bool parallel() const = 0;
 
-	const MeshPrimitive *m_mesh;
 };
 
-struct MeshUniformToVertex
+typedef boost::shared_ptr<Resampler> ResamplerPtr;
+
+template<typename T>
+class TypedResampler : public Resampler
 {
-	typedef DataPtr ReturnType;
 
-	MeshUniformToVertex( const MeshPrimitive *mesh )	:	m_mesh( mesh )
-	{
-	}
+	public :
 
-	template<typename From> ReturnType operator()( const From* data )
-	{
-		typename From::Ptr result = static_cast< From* >( Object::create( data->typeId() ).get() );
-		typename From::ValueType &trg = result->writable();
-		const typename From::ValueType &src = data->readable();
-
-		size_t numVerts = m_mesh->variableSize( PrimitiveVariable::Vertex );
-		std::vector<int> count( numVerts, 0 );
-		trg.resize( numVerts, typename From::ValueType::value_type( 0.0f ) );
-
-		typename From::ValueType::const_iterator srcIt = src.begin();
-		std::vector<int>::const_iterator vId = m_mesh->vertexIds()->readable().begin();
-		const std::vector<int> &verticesPerFace = m_mesh->verticesPerFace()->readable();
-		for( std::vector<int>::const_iterator it = verticesPerFace.begin(); it < verticesPerFace.end(); ++it, ++srcIt )
+		TypedResampler( const MeshAdjacency &adjacency, const std::vector<int> &vertexIds, PrimitiveVariable::Interpolation srcInterpolation, const Source<T> &src, std::vector<T> &dst )
+			:	m_adjacency( adjacency ), m_vertexIds( vertexIds ), m_srcInterpolation( srcInterpolation ), m_src( src ), m_dst( dst )
 		{
-			for( int j = 0; j < *it; ++j, ++vId )
-			{
-				trg[ *vId ] += *srcIt;
-				++count[ *vId ];
-			}
 		}
 
-		std::vector<int>::const_iterator cIt = count.begin();
-		typename From::ValueType::iterator trgIt = trg.begin(), trgEnd = trg.end();
-		for( trgIt = trg.begin(); trgIt != trgEnd ; ++trgIt, ++cIt )
+		bool parallel() const override
 		{
-			*trgIt /= *cIt;
+			return !boost::is_same<T, bool>::value;
 		}
 
-		return result;
-	}
+	protected :
+
+		// Returns the index into the source for the specified FaceVarying
+		// position, when the source is not Uniform.
+		int sourceIndex( int faceVarying ) const
+		{
+			return m_srcInterpolation == PrimitiveVariable::FaceVarying ? faceVarying : m_vertexIds[faceVarying];
+		}
+
+		const MeshAdjacency &m_adjacency;
+		const std::vector<int> &m_vertexIds;
+		const PrimitiveVariable::Interpolation m_srcInterpolation;
+		const Source<T> m_src;
+		std::vector<T> &m_dst;
 
-	const MeshPrimitive *m_mesh;
 };
 
-struct MeshFaceVaryingToVertex
+template<typename T>
+class ToFaceVarying : public TypedResampler<T>
 {
-	typedef DataPtr ReturnType;
 
-	MeshFaceVaryingToVertex( const MeshPrimitive *mesh )	:	m_mesh( mesh )
-	{
-	}
+	public :
 
-	template<typename From> ReturnType operator()( const From* data )
-	{
-		typename From::Ptr result = static_cast< From* >( Object::create( data->typeId() ).get() );
-		typename From::ValueType &trg = result->writable();
-		const typename From::ValueType &src = data->readable();
+		ToFaceVarying( const MeshAdjacency &adjacency, const std::vector<int> &vertexIds, PrimitiveVariable::Interpolation srcInterpolation, const Source<T> &src, std::vector<T> &dst )
+			:	TypedResampler<T>( adjacency, vertexIds, srcInterpolation, src, dst )
+		{
+		}
 
-		size_t numVerts = m_mesh->variableSize( PrimitiveVariable::Vertex );
-		std::vector<int> count( numVerts, 0 );
-		trg.resize( numVerts, typename From::ValueType::value_type( 0.0f ) );
+		void operator()( const tbb::blocked_range<size_t> &range ) const override
+		{
+			const std::vector<int> &faceOffsets = this->m_adjacency.faceOffsets();
+			for( size_t f = range.begin(); f != range.end(); ++f )
+			{
+				if( this->m_srcInterpolation == PrimitiveVariable::Uniform )
+				{
+					std::fill( this->m_dst.begin() + faceOffsets[f], this->m_dst.begin() + faceOffsets[f+1], this->m_src[f] );
+				}
+				else
+				{
+					for( int i = faceOffsets[f], e = faceOffsets[f+1]; i < e; ++i )
+					{
+						this->m_dst[i] = this->m_src[this->sourceIndex( i )];
+					}
+				}
+			}
+		}
 
-		const std::vector<int>& vertexIds = m_mesh->vertexIds()->readable();
-		std::vector<int>::const_iterator vertexIdIt = vertexIds.begin();
-		typename From::ValueType::const_iterator srcIt = src.begin(), srcEnd = src.end();
+};
 
-		for( ; srcIt != srcEnd ; ++srcIt, ++vertexIdIt )
+template<typename T>
+class ToUniform : public TypedResampler<T>
+{
+
+	public :
+
+		ToUniform( const MeshAdjacency &adjacency, const std::vector<int> &vertexIds, PrimitiveVariable::Interpolation srcInterpolation, const Source<T> &src, std::vector<T> &dst )
+			:	TypedResampler<T>( adjacency, vertexIds, srcInterpolation, src, dst )
 		{
-			trg[ *vertexIdIt ] += *srcIt;
-			++count[ *vertexIdIt ];
 		}
 
-		std::vector<int>::const_iterator cIt = count.begin();
-		typename From::ValueType::iterator trgIt = trg.begin(), trgEnd = trg.end();
-		for( trgIt = trg.begin(); trgIt != trgEnd ; ++trgIt, ++cIt )
+		void operator()( const tbb::blocked_range<size_t> &range ) const override
 		{
-			*trgIt /= *cIt;
+			const std::vector<int> &faceOffsets = this->m_adjacency.faceOffsets();
+			for( size_t f = range.begin(); f != range.end(); ++f )
+			{
+				const int begin = faceOffsets[f];
+				const int end = faceOffsets[f+1];
+
+				// initialize with the first value to avoid
+				// ambiguity during default construction
+				T total = this->m_src[this->sourceIndex( begin )];
+				for( int i = begin + 1; i < end; ++i )
+				{
+					total += this->m_src[this->sourceIndex( i )];
+				}
+
+				this->m_dst[f] = total / ( end - begin );
+			}
 		}
 
-		return result;
-	}
-
-	const MeshPrimitive *m_mesh;
 };
 
-struct MeshFaceVaryingToUniform
+// Averages the values used by each vertex, visiting them
+// in face order so results match a serial accumulation.
+template<typename T>
+class ToVertex : public TypedResampler<T>
 {
-	typedef DataPtr ReturnType;
 
-	MeshFaceVaryingToUniform( const MeshPrimitive *mesh )	:	m_mesh( mesh )
-	{
-	}
+	public :
 
-	template<typename From> ReturnType operator()( const From* data )
-	{
-		typename From::Ptr result = static_cast< From* >( Object::create( data->typeId() ).get() );
-		typename From::ValueType &trg = result->writable();
-		const typename From::ValueType &src = data->readable();
-
-		trg.reserve( m_mesh->numFaces() );
-
-		typename From::ValueType::const_iterator srcIt = src.begin();
+		ToVertex( const MeshAdjacency &adjacency, const std::vector<int> &vertexIds, PrimitiveVariable::Interpolation srcInterpolation, const Source<T> &src, std::vector<T> &dst )
+			:	TypedResampler<T>( adjacency, vertexIds, srcInterpolation, src, dst )
+		{
+		}
 
-		const std::vector<int> &verticesPerFace = m_mesh->verticesPerFace()->readable();
-		for( std::vector<int>::const_iterator it = verticesPerFace.begin(); it < verticesPerFace.end(); ++it )
+		void operator()( const tbb::blocked_range<size_t> &range ) const override
 		{
-			// initialize with the first value to avoid
-			// ambiguity during default construction
-			typename From::ValueType::value_type total = *srcIt;
-			++srcIt;
+			const std::vector<int> &vertexOffsets = this->m_adjacency.vertexOffsets();
+			const std::vector<int> &vertexFaceVaryings = this->m_adjacency.vertexFaceVaryings();
+			const std::vector<int> &faceVaryingFaces = this->m_adjacency.faceVaryingFaces();
+			const bool uniform = this->m_srcInterpolation == PrimitiveVariable::Uniform;
 
-			for( int j = 1; j < *it; ++j, ++srcIt )
+			for( size_t v = range.begin(); v != range.end(); ++v )
 			{
-				total += *srcIt;
+				T total( 0.0f );
+				const int begin = vertexOffsets[v];
+				const int end = vertexOffsets[v+1];
+				for( int i = begin; i < end; ++i )
+				{
+					const int fv = vertexFaceVaryings[i];
+					total += this->m_src[uniform ? faceVaryingFaces[fv] : fv];
+				}
+
+				if( end > begin )
+				{
+					total /= ( end - begin );
+				}
+				this->m_dst[v] = total;
 			}
+		}
+
+};
+
+// Converts between Vertex and Varying, expanding indexed sources.
+template<typename T>
+class VertexToVertex : public TypedResampler<T>
+{
 
-			trg.push_back( total / *it );
+	public :
+
+		VertexToVertex( const MeshAdjacency &adjacency, const std::vector<int> &vertexIds, PrimitiveVariable::Interpolation srcInterpolation, const Source<T> &src, std::vector<T> &dst )
+			:	TypedResampler<T>( adjacency, vertexIds, srcInterpolation, src, dst )
+		{
 		}
 
-		return result;
-	}
+		void operator()( const tbb::blocked_range<size_t> &range ) const override
+		{
+			for( size_t v = range.begin(); v != range.end(); ++v )
+			{
+				this->m_dst[v] = this->m_src[v];
+			}
+		}
 
-	const MeshPrimitive *m_mesh;
 };
 
-struct MeshAnythingToFaceVarying
+// Creates a Resampler for each variable, along with the data it will fill.
+template<template<typename> class ResamplerType>
+class CreateResampler
 {
-	typedef DataPtr ReturnType;
 
-	MeshAnythingToFaceVarying( const MeshPrimitive *mesh, PrimitiveVariable::Interpolation srcInterpolation )
-		: m_mesh( mesh ), m_srcInterpolation( srcInterpolation )
-	{
-	}
+	public :
 
-	template<typename From> ReturnType operator()( const From* data )
-	{
+		typedef DataPtr ReturnType;
 
-		// TODO replace the call to the IECore::FaceVaryingPromotionOpPtr and include the logic in this file.
+		CreateResampler( const MeshAdjacency &adjacency, const std::vector<int> &vertexIds, size_t size, PrimitiveVariable::Interpolation srcInterpolation, const IntVectorData *srcIndices, std::vector<ResamplerPtr> &resamplers )
+			:	m_adjacency( adjacency ), m_vertexIds( vertexIds ), m_size( size ), m_srcInterpolation( srcInterpolation ), m_srcIndices( srcIndices ), m_resamplers( resamplers )
+		{
+		}
 
-		// we need to duplicate because the Op expects a primvar to manipulate..
-		IECore::MeshPrimitivePtr tmpMesh = m_mesh->copy();
-		// cast OK due to read-only access.
-		tmpMesh->variables["tmpPrimVar"] = IECore::PrimitiveVariable( m_srcInterpolation, const_cast< From * >(data) );
-		IECore::FaceVaryingPromotionOpPtr promoteOp = new IECore::FaceVaryingPromotionOp();
-		promoteOp->inputParameter()->setValue( tmpMesh );
-		IECore::StringVectorDataPtr names = new StringVectorData();
-		names->writable().push_back( "tmpPrimVar" );
-		promoteOp->primVarNamesParameter()->setValue( names );
-		ReturnType result = runTimeCast< MeshPrimitive >( promoteOp->operate() )->variables["tmpPrimVar"].data;
+		template<typename From>
+		ReturnType operator()( const From *data )
+		{
+			typedef typename From::ValueType::value_type ValueType;
 
+			typename From::Ptr result = new From;
+			std::vector<ValueType> &dst = result->writable();
+			dst.resize( m_size );
 
-		return result;
-	}
+			const Source<ValueType> src( data->readable(), m_srcIndices ? &m_srcIndices->readable() : nullptr );
+			m_resamplers.push_back( ResamplerPtr( new ResamplerType<ValueType>( m_adjacency, m_vertexIds, m_srcInterpolation, src, dst ) ) );
 
-	const MeshPrimitive *m_mesh;
-	PrimitiveVariable::Interpolation m_srcInterpolation;
-};
+			return result;
+		}
 
-} // namespace
+	private :
 
-void IECore::MeshAlgo::resamplePrimitiveVariable( const MeshPrimitive *mesh, PrimitiveVariable& primitiveVariable, PrimitiveVariable::Interpolation interpolation )
+		const MeshAdjacency &m_adjacency;
+		const std::vector<int> &m_vertexIds;
+		const size_t m_size;
+		const PrimitiveVariable::Interpolation m_srcInterpolation;
+		const IntVectorData *m_srcIndices;
+		std::vector<ResamplerPtr> &m_resamplers;
+
+};
+
+class Resample
 {
-	PrimitiveVariable::Interpolation srcInterpolation = primitiveVariable.interpolation;
-	if ( srcInterpolation == interpolation )
-	{
-		return;
-	}
 
-	DataPtr dstData = nullptr;
-	DataPtr srcData = nullptr;
+	public :
 
-	if( primitiveVariable.indices )
-	{
-		if( srcInterpolation < interpolation )
+		Resample( const std::vector<ResamplerPtr> &resamplers )
+			:	m_resamplers( resamplers )
 		{
-			// upsampling can be a resampling of indices
-			srcData = primitiveVariable.indices;
 		}
-		else
+
+		void operator()( const tbb::blocked_range<size_t> &range ) const
 		{
-			// downsampling forces index expansion to
-			// simplify the algorithms.
-			// \todo: allow indices to be maintained.
-			srcData = primitiveVariable.expandedData();
-			primitiveVariable.indices = nullptr;
+			for( std::vector<ResamplerPtr>::const_iterator it = m_resamplers.begin(), eIt = m_resamplers.end(); it != eIt; ++it )
+			{
+				if( (*it)->parallel() )
+				{
+					(**it)( range );
+				}
+			}
 		}
-	}
-	else
-	{
-		// with no indices we can just resample the data
-		srcData = primitiveVariable.data;
-	}
 
+	private :
+
+		const std::vector<ResamplerPtr> &m_resamplers;
+
+};
+
+bool isVertexInterpolation( PrimitiveVariable::Interpolation interpolation )
+{
+	return interpolation == PrimitiveVariable::Vertex || interpolation == PrimitiveVariable::Varying;
+}
+
+// Resampling to and from Constant is independent of topology, so is
+// done for each variable individually.
+void resampleConstant( const MeshPrimitive *mesh, PrimitiveVariable &primitiveVariable, PrimitiveVariable::Interpolation interpolation )
+{
 	// average array to single value
-	if ( interpolation == PrimitiveVariable::Constant )
+	if( interpolation == PrimitiveVariable::Constant )
 	{
+		DataPtr srcData = primitiveVariable.indices ? primitiveVariable.expandedData() : primitiveVariable.data;
 		Detail::AverageValueFromVector fn;
-		dstData = despatchTypedData<Detail::AverageValueFromVector, Detail::IsArithmeticVectorTypedData>( srcData.get(), fn );
+		DataPtr dstData = despatchTypedData<Detail::AverageValueFromVector, Detail::IsArithmeticVectorTypedData>( srcData.get(), fn );
 		primitiveVariable = PrimitiveVariable( interpolation, dstData );
 		return;
 	}
 
-	if ( primitiveVariable.interpolation == PrimitiveVariable::Constant )
+	DataPtr arrayData = Detail::createArrayData( primitiveVariable, mesh, interpolation );
+	if( arrayData )
 	{
-		DataPtr arrayData = Detail::createArrayData(primitiveVariable, mesh, interpolation);
-		if (arrayData)
-		{
-			primitiveVariable = PrimitiveVariable(interpolation, arrayData);
-		}
-		return;
+		primitiveVariable = PrimitiveVariable( interpolation, arrayData );
 	}
+}
 
-	if( interpolation == PrimitiveVariable::Uniform )
+void resample( const MeshPrimitive *mesh, const std::vector<PrimitiveVariable *> &primitiveVariables, PrimitiveVariable::Interpolation interpolation )
+{
+	ConstMeshAdjacencyPtr adjacency;
+	const std::vector<int> &vertexIds = mesh->vertexIds()->readable();
+	const bool faceBased = interpolation == PrimitiveVariable::Uniform || interpolation == PrimitiveVariable::FaceVarying;
+	const size_t size = mesh->variableSize( interpolation );
+	const size_t rangeSize = faceBased ? mesh->numFaces() : size;
+
+	std::vector<ResamplerPtr> resamplers;
+	// The results are only assigned once everything has succeeded, so
+	// that an exception leaves the primitive variables untouched. This
+	// also keeps the source data alive for the resamplers.
+	std::vector<std::pair<PrimitiveVariable *, PrimitiveVariable> > results;
+	results.reserve( primitiveVariables.size() );
+
+	for( std::vector<PrimitiveVariable *>::const_iterator it = primitiveVariables.begin(), eIt = primitiveVariables.end(); it != eIt; ++it )
 	{
-		if( srcInterpolation == PrimitiveVariable::Varying || srcInterpolation == PrimitiveVariable::Vertex )
+		const PrimitiveVariable &primitiveVariable = **it;
+		const PrimitiveVariable::Interpolation srcInterpolation = primitiveVariable.interpolation;
+		if( srcInterpolation == interpolation )
 		{
-			MeshVertexToUniform fn( mesh );
-			dstData = despatchTypedData<MeshVertexToUniform, Detail::IsArithmeticVectorTypedData>( srcData.get(), fn );
+			continue;
 		}
-		else if( srcInterpolation == PrimitiveVariable::FaceVarying )
+
+		if( srcInterpolation == PrimitiveVariable::Constant || interpolation == PrimitiveVariable::Constant )
 		{
-			MeshFaceVaryingToUniform fn( mesh );
-			dstData = despatchTypedData<MeshFaceVaryingToUniform, Detail::IsArithmeticVectorTypedData>( srcData.get(), fn );
+			PrimitiveVariable result = primitiveVariable;
+			resampleConstant( mesh, result, interpolation );
+			results.push_back( std::make_pair( *it, result ) );
+			continue;
 		}
-	}
-	else if( interpolation == PrimitiveVariable::Varying || interpolation == PrimitiveVariable::Vertex )
-	{
-		if( srcInterpolation == PrimitiveVariable::Uniform )
+
+		// Upsampling can be a resampling of indices. Otherwise
+		// we resample the data, reading it through the indices.
+		const bool resampleIndices = primitiveVariable.indices && srcInterpolation < interpolation;
+		Data *srcData = resampleIndices ? primitiveVariable.indices.get() : primitiveVariable.data.get();
+		const IntVectorData *srcIndices = resampleIndices ? nullptr : primitiveVariable.indices.get();
+
+		if( isVertexInterpolation( srcInterpolation ) && isVertexInterpolation( interpolation ) && !srcIndices )
+		{
+			// nothing to resample
+			PrimitiveVariable result = primitiveVariable;
+			result.interpolation = interpolation;
+			results.push_back( std::make_pair( *it, result ) );
+			continue;
+		}
+
+		if( !adjacency )
+		{
+			adjacency = mesh->adjacency();
+		}
+
+		DataPtr dstData;
+		if( isVertexInterpolation( srcInterpolation ) && isVertexInterpolation( interpolation ) )
 		{
-			MeshUniformToVertex fn( mesh );
-			dstData = despatchTypedData<MeshUniformToVertex, Detail::IsArithmeticVectorTypedData>( srcData.get(), fn );
+			CreateResampler<VertexToVertex> fn( *adjacency, vertexIds, size, srcInterpolation, srcIndices, resamplers );
+			dstData = despatchTypedData<CreateResampler<VertexToVertex>, TypeTraits::IsVectorTypedData>( srcData, fn );
 		}
-		else if( srcInterpolation == PrimitiveVariable::FaceVarying )
+		else if( interpolation == PrimitiveVariable::FaceVarying )
 		{
-			MeshFaceVaryingToVertex fn( mesh );
-			dstData = despatchTypedData<MeshFaceVaryingToVertex, Detail::IsArithmeticVectorTypedData>( srcData.get(), fn );
+			CreateResampler<ToFaceVarying> fn( *adjacency, vertexIds, size, srcInterpolation, srcIndices, resamplers );
+			dstData = despatchTypedData<CreateResampler<ToFaceVarying>, TypeTraits::IsVectorTypedData>( srcData, fn );
 		}
-		else if( srcInterpolation == PrimitiveVariable::Varying || srcInterpolation == PrimitiveVariable::Vertex )
+		else if( interpolation == PrimitiveVariable::Uniform )
+		{
+			CreateResampler<ToUniform> fn( *adjacency, vertexIds, size, srcInterpolation, srcIndices, resamplers );
+			dstData = despatchTypedData<CreateResampler<ToUniform>, Detail::IsArithmeticVectorTypedData>( srcData, fn );
+		}
+		else
+		{
+			CreateResampler<ToVertex> fn( *adjacency, vertexIds, size, srcInterpolation, srcIndices, resamplers );
+			dstData = despatchTypedData<CreateResampler<ToVertex>, Detail::IsArithmeticVectorTypedData>( srcData, fn );
+		}
+
+		if( resampleIndices )
+		{
+			results.push_back( std::make_pair( *it, PrimitiveVariable( interpolation, primitiveVariable.data, runTimeCast<IntVectorData>( dstData ) ) ) );
+		}
+		else
 		{
-			dstData = srcData;
+			results.push_back( std::make_pair( *it, PrimitiveVariable( interpolation, dstData ) ) );
 		}
 	}
-	else if( interpolation == PrimitiveVariable::FaceVarying )
+
+	if( !resamplers.empty() && rangeSize )
 	{
-		MeshAnythingToFaceVarying fn( mesh, srcInterpolation );
-		dstData = despatchTypedData<MeshAnythingToFaceVarying, Detail::IsArithmeticVectorTypedData>( srcData.get(), fn );
+		const tbb::blocked_range<size_t> range( 0, rangeSize );
+		tbb::parallel_for( range, Resample( resamplers ) );
+
+		for( std::vector<ResamplerPtr>::const_iterator it = resamplers.begin(), eIt = resamplers.end(); it != eIt; ++it )
+		{
+			if( !(*it)->parallel() )
+			{
+				(**it)( range );
+			}
+		}
 	}
 
-	if( primitiveVariable.indices )
+	for( std::vector<std::pair<PrimitiveVariable *, PrimitiveVariable> >::const_iterator it = results.begin(), eIt = results.end(); it != eIt; ++it )
 	{
-		primitiveVariable = PrimitiveVariable( interpolation, primitiveVariable.data, runTimeCast<IntVectorData>( dstData ) );
+		*(it->first) = it->second;
 	}
-	else
+}
+
+} // namespace
+
+void IECore::MeshAlgo::resamplePrimitiveVariable( const MeshPrimitive *mesh, PrimitiveVariable& primitiveVariable, PrimitiveVariable::Interpolation interpolation )
+{
+	resample( mesh, std::vector<PrimitiveVariable *>( 1, &primitiveVariable ), interpolation );
+}
+
+void IECore::MeshAlgo::resamplePrimitiveVariables( const MeshPrimitive *mesh, PrimitiveVariableMap &primitiveVariables, PrimitiveVariable::Interpolation interpolation )
+{
+	std::vector<PrimitiveVariable *> toResample;
+	toResample.reserve( primitiveVariables.size() );
+	for( PrimitiveVariableMap::iterator it = primitiveVariables.begin(), eIt = primitiveVariables.end(); it != eIt; ++it )
 	{
-		primitiveVariable = PrimitiveVariable( interpolation, dstData );
+		toResample.push_back( &it->second );
 	}
+
+	resample( mesh, toResample, interpolation );
 }
@@ -32,7 +32,11 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
 #include "IECore/MeshAlgo.h"
+#include "IECore/private/MeshAlgoUtils.h"
 
 using namespace Imath;
 using namespace IECore;
@@ -41,6 +45,168 @@ using namespace IECore;
 // Calculate tangents
 //////////////////////////////////////////////////////////////////////////
 
+namespace
+{
+
+struct FaceTangents
+{
+
+	FaceTangents(
+		const std::vector<V3f> &points, const std::vector<int> &vertIds,
+		const std::vector<V2f> &uvs, const std::vector<int> &uvIndices,
+		std::vector<V3f> &tangents, std::vector<V3f> &bitangents, std::vector<V3f> &normals
+	)
+		:	m_points( points ), m_vertIds( vertIds ), m_uvs( uvs ), m_uvIndices( uvIndices ),
+			m_tangents( tangents ), m_bitangents( bitangents ), m_normals( normals )
+	{
+	}
+
+	void operator()( const tbb::blocked_range<size_t> &r ) const
+	{
+		for( size_t faceIndex = r.begin(); faceIndex != r.end(); ++faceIndex )
+		{
+			// indices into the facevarying data for this face
+			size_t fvi0 = faceIndex * 3;
+			size_t fvi1 = fvi0 + 1;
+			size_t fvi2 = fvi1 + 1;
+			assert( fvi2 < m_vertIds.size() );
+			assert( fvi2 < m_uvIndices.size() );
+
+			// positions for each vertex of this face
+			const V3f &p0 = m_points[m_vertIds[fvi0]];
+			const V3f &p1 = m_points[m_vertIds[fvi1]];
+			const V3f &p2 = m_points[m_vertIds[fvi2]];
+
+			// uv coordinates for each vertex of this face
+			const V2f &uv0 = m_uvs[m_uvIndices[fvi0]];
+			const V2f &uv1 = m_uvs[m_uvIndices[fvi1]];
+			const V2f &uv2 = m_uvs[m_uvIndices[fvi2]];
+
+			// compute tangents and normal for this face
+			const V3f e0 = p1 - p0;
+			const V3f e1 = p2 - p0;
+
+			const V2f e0uv = uv1 - uv0;
+			const V2f e1uv = uv2 - uv0;
+
+			m_tangents[faceIndex] = ( e0 * -e1uv.y + e1 * e0uv.y ).normalized();
+			m_bitangents[faceIndex] = ( e0 * -e1uv.x + e1 * e0uv.x ).normalized();
+
+			V3f normal = ( p2 - p1 ).cross( p0 - p1 );
+			normal.normalize();
+			m_normals[faceIndex] = normal;
+		}
+	}
+
+	const std::vector<V3f> &m_points;
+	const std::vector<int> &m_vertIds;
+	const std::vector<V2f> &m_uvs;
+	const std::vector<int> &m_uvIndices;
+	std::vector<V3f> &m_tangents;
+	std::vector<V3f> &m_bitangents;
+	std::vector<V3f> &m_normals;
+
+};
+
+// Gathers the tangents of the faces using each uv, in face order,
+// and then normalizes and orthogonalizes them.
+struct UVTangents
+{
+
+	UVTangents(
+		const std::vector<int> &uvFaceVaryingOffsets, const std::vector<int> &uvFaceVaryings,
+		const std::vector<V3f> &faceTangents, const std::vector<V3f> &faceBitangents, const std::vector<V3f> &faceNormals,
+		bool orthoTangents, std::vector<V3f> &uTangents, std::vector<V3f> &vTangents
+	)
+		:	m_uvFaceVaryingOffsets( uvFaceVaryingOffsets ), m_uvFaceVaryings( uvFaceVaryings ),
+			m_faceTangents( faceTangents ), m_faceBitangents( faceBitangents ), m_faceNormals( faceNormals ),
+			m_orthoTangents( orthoTangents ), m_uTangents( uTangents ), m_vTangents( vTangents )
+	{
+	}
+
+	void operator()( const tbb::blocked_range<size_t> &r ) const
+	{
+		for( size_t i = r.begin(); i != r.end(); ++i )
+		{
+			V3f uTangent( 0 );
+			V3f vTangent( 0 );
+			V3f normal( 0 );
+			for( int j = m_uvFaceVaryingOffsets[i], e = m_uvFaceVaryingOffsets[i+1]; j < e; ++j )
+			{
+				// meshes are triangulated, so the face is found directly from the facevarying index
+				const int faceIndex = m_uvFaceVaryings[j] / 3;
+				uTangent += m_faceTangents[faceIndex];
+				vTangent += m_faceBitangents[faceIndex];
+				normal += m_faceNormals[faceIndex];
+			}
+
+			normal.normalize();
+
+			uTangent.normalize();
+			vTangent.normalize();
+
+			// Make uTangent/vTangent orthogonal to normal
+			uTangent -= normal * uTangent.dot( normal );
+			vTangent -= normal * vTangent.dot( normal );
+
+			uTangent.normalize();
+			vTangent.normalize();
+
+			if( m_orthoTangents )
+			{
+				vTangent -= uTangent * vTangent.dot( uTangent );
+				vTangent.normalize();
+			}
+
+			// Ensure we have set of basis vectors (n, uT, vT) with the correct handedness.
+			if( uTangent.cross( vTangent ).dot( normal ) < 0.0f )
+			{
+				uTangent *= -1.0f;
+			}
+
+			m_uTangents[i] = uTangent;
+			m_vTangents[i] = vTangent;
+		}
+	}
+
+	const std::vector<int> &m_uvFaceVaryingOffsets;
+	const std::vector<int> &m_uvFaceVaryings;
+	const std::vector<V3f> &m_faceTangents;
+	const std::vector<V3f> &m_faceBitangents;
+	const std::vector<V3f> &m_faceNormals;
+	bool m_orthoTangents;
+	std::vector<V3f> &m_uTangents;
+	std::vector<V3f> &m_vTangents;
+
+};
+
+struct ExpandTangents
+{
+
+	ExpandTangents( const std::vector<int> &uvIndices, const std::vector<V3f> &uTangents, const std::vector<V3f> &vTangents, std::vector<V3f> &fvU, std::vector<V3f> &fvV )
+		:	m_uvIndices( uvIndices ), m_uTangents( uTangents ), m_vTangents( vTangents ), m_fvU( fvU ), m_fvV( fvV )
+	{
+	}
+
+	void operator()( const tbb::blocked_range<size_t> &r ) const
+	{
+		for( size_t i = r.begin(); i != r.end(); ++i )
+		{
+			m_fvU[i] = m_uTangents[m_uvIndices[i]];
+			m_fvV[i] = m_vTangents[m_uvIndices[i]];
+		}
+	}
+
+	const std::vector<int> &m_uvIndices;
+	const std::vector<V3f> &m_uTangents;
+	const std::vector<V3f> &m_vTangents;
+	std::vector<V3f> &m_fvU;
+	std::vector<V3f> &m_fvV;
+
+};
+
+} // namespace
+
 std::pair<PrimitiveVariable, PrimitiveVariable> IECore::MeshAlgo::calculateTangents(
 	const MeshPrimitive *mesh,
 	const std::string &uvSet, /* = "uv" */
@@ -81,87 +247,29 @@ std::pair<PrimitiveVariable, PrimitiveVariable> IECore::MeshAlgo::calculateTange
 	const IntVectorData::ValueType &uvIndices = uvIt->second.indices ? uvIt->second.indices->readable() : vertIds;
 
 	size_t numUVs = uvs.size();
+	size_t numFaces = vertsPerFace.size();
 
-	std::vector<V3f> uTangents( numUVs, V3f( 0 ) );
-	std::vector<V3f> vTangents( numUVs, V3f( 0 ) );
-	std::vector<V3f> normals( numUVs, V3f( 0 ) );
-
-	for( size_t faceIndex = 0; faceIndex < vertsPerFace.size(); faceIndex++ )
-	{
-		assert( vertsPerFace[faceIndex] == 3 );
-
-		// indices into the facevarying data for this face
-		size_t fvi0 = faceIndex * 3;
-		size_t fvi1 = fvi0 + 1;
-		size_t fvi2 = fvi1 + 1;
-		assert( fvi2 < vertIds.size() );
-		assert( fvi2 < uvIndices.size() );
-
-		// positions for each vertex of this face
-		const V3f &p0 = points[vertIds[fvi0]];
-		const V3f &p1 = points[vertIds[fvi1]];
-		const V3f &p2 = points[vertIds[fvi2]];
-
-		// uv coordinates for each vertex of this face
-		const V2f &uv0 = uvs[uvIndices[fvi0]];
-		const V2f &uv1 = uvs[uvIndices[fvi1]];
-		const V2f &uv2 = uvs[uvIndices[fvi2]];
-
-		// compute tangents and normal for this face
-		const V3f e0 = p1 - p0;
-		const V3f e1 = p2 - p0;
-
-		const V2f e0uv = uv1 - uv0;
-		const V2f e1uv = uv2 - uv0;
-
-		V3f tangent = ( e0 * -e1uv.y + e1 * e0uv.y ).normalized();
-		V3f bitangent = ( e0 * -e1uv.x + e1 * e0uv.x ).normalized();
+	// compute the tangents and normal of each face
+	std::vector<V3f> faceTangents( numFaces );
+	std::vector<V3f> faceBitangents( numFaces );
+	std::vector<V3f> faceNormals( numFaces );
 
-		V3f normal = ( p2 - p1 ).cross( p0 - p1 );
-		normal.normalize();
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, numFaces ),
+		FaceTangents( points, vertIds, uvs, uvIndices, faceTangents, faceBitangents, faceNormals )
+	);
 
-		// and accumlate them into the computation so far
-		uTangents[uvIndices[fvi0]] += tangent;
-		uTangents[uvIndices[fvi1]] += tangent;
-		uTangents[uvIndices[fvi2]] += tangent;
+	// accumulate them for each uv, then normalize and orthogonalize everything
+	std::vector<int> uvFaceVaryingOffsets, uvFaceVaryings;
+	Detail::indexFaceVaryings( uvIndices, numUVs, uvFaceVaryingOffsets, uvFaceVaryings );
 
-		vTangents[uvIndices[fvi0]] += bitangent;
-		vTangents[uvIndices[fvi1]] += bitangent;
-		vTangents[uvIndices[fvi2]] += bitangent;
+	std::vector<V3f> uTangents( numUVs );
+	std::vector<V3f> vTangents( numUVs );
 
-		normals[uvIndices[fvi0]] += normal;
-		normals[uvIndices[fvi1]] += normal;
-		normals[uvIndices[fvi2]] += normal;
-
-	}
-
-	// normalize and orthogonalize everything
-	for( size_t i = 0; i < uTangents.size(); i++ )
-	{
-		normals[i].normalize();
-
-		uTangents[i].normalize();
-		vTangents[i].normalize();
-
-		// Make uTangent/vTangent orthogonal to normal
-		uTangents[i] -= normals[i] * uTangents[i].dot( normals[i] );
-		vTangents[i] -= normals[i] * vTangents[i].dot( normals[i] );
-
-		uTangents[i].normalize();
-		vTangents[i].normalize();
-
-		if( orthoTangents )
-		{
-			vTangents[i] -= uTangents[i] * vTangents[i].dot( uTangents[i] );
-			vTangents[i].normalize();
-		}
-
-		// Ensure we have set of basis vectors (n, uT, vT) with the correct handedness.
-		if( uTangents[i].cross( vTangents[i] ).dot( normals[i] ) < 0.0f )
-		{
-			uTangents[i] *= -1.0f;
-		}
-	}
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, numUVs ),
+		UVTangents( uvFaceVaryingOffsets, uvFaceVaryings, faceTangents, faceBitangents, faceNormals, orthoTangents, uTangents, vTangents )
+	);
 
 	// convert the tangents back to facevarying data and add that to the mesh
 	V3fVectorDataPtr fvUD = new V3fVectorData();
@@ -172,11 +280,10 @@ std::pair<PrimitiveVariable, PrimitiveVariable> IECore::MeshAlgo::calculateTange
 	fvU.resize( uvIndices.size() );
 	fvV.resize( uvIndices.size() );
 
-	for( unsigned i = 0; i < uvIndices.size(); i++ )
-	{
-		fvU[i] = uTangents[uvIndices[i]];
-		fvV[i] = vTangents[uvIndices[i]];
-	}
+	tbb::parallel_for(
+		tbb::blocked_range<size_t>( 0, uvIndices.size() ),
+		ExpandTangents( uvIndices, uTangents, vTangents, fvU, fvV )
+	);
 
 	PrimitiveVariable tangentPrimVar( PrimitiveVariable::FaceVarying, fvUD );
 	PrimitiveVariable bitangentPrimVar( PrimitiveVariable::FaceVarying, fvVD );
@@ -34,6 +34,9 @@
 
 #include "boost/format.hpp"
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
 #include "IECore/MeshNormalsOp.h"
 #include "IECore/DespatchTypedData.h"
 #include "IECore/CompoundParameter.h"
@@ -41,6 +44,87 @@
 using namespace IECore;
 using namespace std;
 
+namespace
+{
+
+template<typename Vec>
+class FaceNormals
+{
+
+	public :
+
+		FaceNormals( const vector<Vec> &points, const vector<int> &vertIds, const vector<int> &faceOffsets, vector<Vec> &faceNormals )
+			:	m_points( points ), m_vertIds( vertIds ), m_faceOffsets( faceOffsets ), m_faceNormals( faceNormals )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t f = r.begin(); f != r.end(); ++f )
+			{
+				// calculate the face normal. note that this method is very naive, and doesn't
+				// cope with colinear vertices or concave faces - we could use polygonNormal() from
+				// PolygonAlgo.h to deal with that, but currently we'd prefer to avoid the overhead.
+				const int *vertId = &(m_vertIds[m_faceOffsets[f]]);
+				const Vec &p0 = m_points[*vertId];
+				const Vec &p1 = m_points[*(vertId+1)];
+				const Vec &p2 = m_points[*(vertId+2)];
+
+				Vec normal = (p2-p1).cross(p0-p1);
+				normal.normalize();
+				m_faceNormals[f] = normal;
+			}
+		}
+
+	private :
+
+		const vector<Vec> &m_points;
+		const vector<int> &m_vertIds;
+		const vector<int> &m_faceOffsets;
+		vector<Vec> &m_faceNormals;
+
+};
+
+// Gathers the normals of the faces using each vertex, visiting
+// them in face order so the result matches a serial accumulation.
+template<typename Vec>
+class VertexNormals
+{
+
+	public :
+
+		VertexNormals( const vector<Vec> &faceNormals, const MeshAdjacency &adjacency, vector<Vec> &normals )
+			:	m_faceNormals( faceNormals ), m_vertexOffsets( adjacency.vertexOffsets() ), m_vertexFaceVaryings( adjacency.vertexFaceVaryings() ),
+				m_faceVaryingFaces( adjacency.faceVaryingFaces() ), m_normals( normals )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t v = r.begin(); v != r.end(); ++v )
+			{
+				Vec normal( 0 );
+				for( int i = m_vertexOffsets[v], e = m_vertexOffsets[v+1]; i < e; ++i )
+				{
+					normal += m_faceNormals[m_faceVaryingFaces[m_vertexFaceVaryings[i]]];
+				}
+				normal.normalize();
+				m_normals[v] = normal;
+			}
+		}
+
+	private :
+
+		const vector<Vec> &m_faceNormals;
+		const vector<int> &m_vertexOffsets;
+		const vector<int> &m_vertexFaceVaryings;
+		const vector<int> &m_faceVaryingFaces;
+		vector<Vec> &m_normals;
+
+};
+
+} // namespace
+
 IE_CORE_DEFINERUNTIMETYPED( MeshNormalsOp );
 
 MeshNormalsOp::MeshNormalsOp() : MeshPrimitiveOp( "Calculates vertex normals for a mesh." )
@@ -113,8 +197,8 @@ struct MeshNormalsOp::CalculateNormals
 {
 	typedef DataPtr ReturnType;
 
-	CalculateNormals( const IntVectorData *vertsPerFace, const IntVectorData *vertIds, PrimitiveVariable::Interpolation interpolation )
-		:	m_vertsPerFace( vertsPerFace ), m_vertIds( vertIds ), m_interpolation( interpolation )
+	CalculateNormals( const IntVectorData *vertIds, const MeshAdjacency *adjacency, PrimitiveVariable::Interpolation interpolation )
+		:	m_vertIds( vertIds ), m_adjacency( adjacency ), m_interpolation( interpolation )
 	{
 	}
 
@@ -125,59 +209,34 @@ struct MeshNormalsOp::CalculateNormals
 		typedef typename VecContainer::value_type Vec;
 
 		const typename T::ValueType &points = data->readable();
-		const vector<int> &vertsPerFace = m_vertsPerFace->readable();
 		const vector<int> &vertIds = m_vertIds->readable();
+		const vector<int> &faceOffsets = m_adjacency->faceOffsets();
+		const size_t numFaces = m_adjacency->numFaces();
 
 		typename T::Ptr normalsData = new T;
 		normalsData->setInterpretation( GeometricData::Normal );
 		VecContainer &normals = normalsData->writable();
+
+		// calculate the face normals
+		VecContainer faceNormals( numFaces );
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>( 0, numFaces ),
+			FaceNormals<Vec>( points, vertIds, faceOffsets, faceNormals )
+		);
+
 		if( m_interpolation == PrimitiveVariable::Uniform )
 		{
-			normals.reserve( vertsPerFace.size() );
+			normals.swap( faceNormals );
 		}
 		else
 		{
-			normals.resize( points.size(), Vec( 0 ) );
-		}
-
-		// loop over the faces
-		const int *vertId = &(vertIds[0]);
-		for( vector<int>::const_iterator it = vertsPerFace.begin(); it!=vertsPerFace.end(); it++ )
-		{
-			// calculate the face normal. note that this method is very naive, and doesn't
-			// cope with colinear vertices or concave faces - we could use polygonNormal() from
-			// PolygonAlgo.h to deal with that, but currently we'd prefer to avoid the overhead.
-			const Vec &p0 = points[*vertId];
-			const Vec &p1 = points[*(vertId+1)];
-			const Vec &p2 = points[*(vertId+2)];
-
-			Vec normal = (p2-p1).cross(p0-p1);
-			normal.normalize();
-
-			if( m_interpolation == PrimitiveVariable::Uniform )
-			{
-				normals.push_back( normal );
-				vertId += *it;
-			}
-			else
-			{
-				// accumulate the face normal onto each of the vertices
-				// for this face.
-				for( int i=0; i<*it; ++i )
-				{
-					normals[*vertId] += normal;
-					++vertId;
-				}
-			}
-		}
-
-		// normalize each of the vertex normals
-		if( m_interpolation == PrimitiveVariable::Vertex )
-		{
-			for( typename VecContainer::iterator it=normals.begin(), eIt=normals.end(); it != eIt; ++it )
-			{
-				it->normalize();
-			}
+			// accumulate the face normals onto each of the vertices
+			// using them, and normalize.
+			normals.resize( points.size() );
+			tbb::parallel_for(
+				tbb::blocked_range<size_t>( 0, points.size() ),
+				VertexNormals<Vec>( faceNormals, *m_adjacency, normals )
+			);
 		}
 
 		return normalsData;
@@ -185,8 +244,8 @@ struct MeshNormalsOp::CalculateNormals
 
 	private :
 
-		ConstIntVectorDataPtr m_vertsPerFace;
 		ConstIntVectorDataPtr m_vertIds;
+		ConstMeshAdjacencyPtr m_adjacency;
 		PrimitiveVariable::Interpolation m_interpolation;
 
 };
@@ -219,7 +278,8 @@ void MeshNormalsOp::modifyTypedPrimitive( MeshPrimitive * mesh, const CompoundOb
 
 	const PrimitiveVariable::Interpolation interpolation = static_cast<PrimitiveVariable::Interpolation>( operands->member<IntData>( "interpolation" )->readable() );
 
-	CalculateNormals f( mesh->verticesPerFace(), mesh->vertexIds(), interpolation );
+	ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
+	CalculateNormals f( mesh->vertexIds(), adjacency.get(), interpolation );
 	DataPtr n = despatchTypedData<CalculateNormals, TypeTraits::IsVec3VectorTypedData, HandleErrors>( pvIt->second.data.get(), f );
 
 	mesh->variables[ nPrimVarNameParameter()->getTypedValue() ] = PrimitiveVariable( interpolation, n );
@@ -35,7 +35,11 @@
 #include <algorithm>
 #include <numeric>
 
+#include "boost/bind.hpp"
+
 #include "IECore/MeshPrimitive.h"
+#include "IECore/LRUCache.h"
+#include "IECore/CacheRegistry.h"
 #include "IECore/Renderer.h"
 #include "IECore/PolygonIterator.h"
 #include "IECore/MurmurHash.h"
@@ -51,6 +55,92 @@ static IndexedIO::EntryID g_vertexIdsEntry("vertexIds");
 static IndexedIO::EntryID g_numVerticesEntry("numVertices");
 static IndexedIO::EntryID g_interpolationEntry("interpolation");
 
+//////////////////////////////////////////////////////////////////////////
+// Adjacency cache
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+struct AdjacencyCacheGetterKey
+{
+
+	AdjacencyCacheGetterKey( const MeshPrimitive *mesh )
+		:	mesh( mesh )
+	{
+		mesh->verticesPerFace()->hash( hash );
+		mesh->vertexIds()->hash( hash );
+		hash.append( (uint64_t)mesh->variableSize( PrimitiveVariable::Vertex ) );
+	}
+
+	operator const MurmurHash & () const
+	{
+		return hash;
+	}
+
+	MurmurHash hash;
+	const MeshPrimitive *mesh;
+
+};
+
+class AdjacencyCache
+{
+
+	public :
+
+		AdjacencyCache()
+			:	cache( boost::bind( &AdjacencyCache::getter, this, ::_1, ::_2 ), 1024 * 1024 * 200 ),
+				registryClient(
+					"MeshAdjacency",
+					boost::bind( &Cache::currentCost, &cache ),
+					boost::bind( &Cache::getMaxCost, &cache ),
+					boost::bind( &Cache::setMaxCost, &cache, ::_1 )
+				)
+		{
+		}
+
+		ConstMeshAdjacencyPtr get( const MeshPrimitive *mesh )
+		{
+			registryClient.recordLookup();
+			ConstMeshAdjacencyPtr result = cache.get( AdjacencyCacheGetterKey( mesh ) );
+			registryClient.memoryAdded();
+			return result;
+		}
+
+	private :
+
+		ConstMeshAdjacencyPtr getter( const AdjacencyCacheGetterKey &key, size_t &cost )
+		{
+			registryClient.recordMiss();
+			ConstMeshAdjacencyPtr result = new MeshAdjacency(
+				key.mesh->verticesPerFace()->readable(),
+				key.mesh->vertexIds()->readable(),
+				key.mesh->variableSize( PrimitiveVariable::Vertex )
+			);
+			cost = result->memoryUsage();
+			return result;
+		}
+
+		typedef LRUCache<MurmurHash, ConstMeshAdjacencyPtr, LRUCachePolicy::Parallel, AdjacencyCacheGetterKey> Cache;
+		Cache cache;
+		// Declared after the cache so that it is deregistered before
+		// the cache is destroyed.
+		CacheRegistry::Client registryClient;
+
+};
+
+AdjacencyCache &adjacencyCache()
+{
+	static AdjacencyCache *c = new AdjacencyCache;
+	return *c;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+// MeshPrimitive
+//////////////////////////////////////////////////////////////////////////
+
 const unsigned int MeshPrimitive::m_ioVersion = 0;
 IE_CORE_DEFINEOBJECTTYPEDESCRIPTION(MeshPrimitive);
 
@@ -165,6 +255,7 @@ void MeshPrimitive::setTopology( ConstIntVectorDataPtr verticesPerFace, ConstInt
 		m_numVertices = 0;
 	}
 	m_interpolation = interpolation;
+	m_adjacency = nullptr;
 }
 
 void MeshPrimitive::setTopologyUnchecked( ConstIntVectorDataPtr verticesPerFace, ConstIntVectorDataPtr vertexIds, size_t numVertices, const std::string &interpolation )
@@ -175,6 +266,7 @@ void MeshPrimitive::setTopologyUnchecked( ConstIntVectorDataPtr verticesPerFace,
 	m_numVertices = numVertices;
 	m_minVerticesPerFace = 0;
 	m_maxVerticesPerFace = 0;
+	m_adjacency = nullptr;
 }
 
 void MeshPrimitive::setInterpolation( const std::string &interpolation )
@@ -192,6 +284,26 @@ PolygonIterator MeshPrimitive::faceEnd()
 	return PolygonIterator( m_verticesPerFace->readable().end(), m_vertexIds->readable().end(), m_vertexIds->readable().size() );
 }
 
+ConstMeshAdjacencyPtr MeshPrimitive::adjacency() const
+{
+	{
+		tbb::spin_mutex::scoped_lock lock( m_adjacencyMutex );
+		if( m_adjacency )
+		{
+			return m_adjacency;
+		}
+	}
+
+	// Build outside the lock. The cache ensures that concurrent
+	// callers wait for a single computation rather than each
+	// doing their own.
+	ConstMeshAdjacencyPtr result = adjacencyCache().get( this );
+
+	tbb::spin_mutex::scoped_lock lock( m_adjacencyMutex );
+	m_adjacency = result;
+	return result;
+}
+
 size_t MeshPrimitive::variableSize( PrimitiveVariable::Interpolation interpolation ) const
 {
 	switch(interpolation)
@@ -228,6 +340,9 @@ void MeshPrimitive::copyFrom( const Object *other, IECore::Object::CopyContext *
 	m_vertexIds = tOther->m_vertexIds->copy();
 	m_numVertices = tOther->m_numVertices;
 	m_interpolation = tOther->m_interpolation;
+
+	tbb::spin_mutex::scoped_lock lock( tOther->m_adjacencyMutex );
+	m_adjacency = tOther->m_adjacency;
 }
 
 void MeshPrimitive::save( IECore::Object::SaveContext *context ) const
@@ -260,6 +375,7 @@ void MeshPrimitive::load( IECore::Object::LoadContextPtr context )
 	m_numVertices = numVertices;
 
 	container->read( g_interpolationEntry, m_interpolation );
+	m_adjacency = nullptr;
 }
 
 bool MeshPrimitive::isEqualTo( const Object *other ) const
@@ -32,8 +32,13 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <cassert>
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_invoke.h"
+
 #include "OpenEXR/ImathBoxAlgo.h"
 #include "OpenEXR/ImathLineAlgo.h"
 #include "OpenEXR/ImathMatrix.h"
@@ -52,6 +57,446 @@ IE_CORE_DEFINERUNTIMETYPED( MeshPrimitiveEvaluator );
 
 static PrimitiveEvaluator::Description< MeshPrimitiveEvaluator > g_registraar = PrimitiveEvaluator::Description< MeshPrimitiveEvaluator >();
 
+//////////////////////////////////////////////////////////////////////////
+// BVH
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Number of bins used to evaluate the surface area heuristic.
+const int g_numBins = 16;
+// Ranges with this many triangles or fewer may become leaves.
+const size_t g_maxLeafSize = 4;
+// Ranges with more triangles than this have their children built in parallel.
+const size_t g_parallelBuildThreshold = 4096;
+// Beyond this depth, ranges are split at the median so that the tree depth
+// remains bounded, and traversal can use a fixed size stack.
+const int g_maxSAHDepth = 64;
+const int g_maxStackSize = 128;
+
+float halfArea( const Box3f &b )
+{
+	if( b.isEmpty() )
+	{
+		return 0.0f;
+	}
+	const V3f s = b.size();
+	return s.x * s.y + s.y * s.z + s.z * s.x;
+}
+
+// Returns true if the ray hits the box before maxDistance, setting
+// distance to the point where it enters.
+inline bool rayBoxIntersection( const Box3f &box, const V3f &origin, const V3f &inverseDirection, float maxDistance, float &distance )
+{
+	float tNear = 0.0f;
+	float tFar = maxDistance;
+	for( int i = 0; i < 3; ++i )
+	{
+		float t0 = ( box.min[i] - origin[i] ) * inverseDirection[i];
+		float t1 = ( box.max[i] - origin[i] ) * inverseDirection[i];
+		if( t0 > t1 )
+		{
+			std::swap( t0, t1 );
+		}
+		// Written so that NaNs, which arise when the ray lies
+		// within a slab plane, leave the interval unchanged.
+		tNear = t0 > tNear ? t0 : tNear;
+		tFar = t1 < tFar ? t1 : tFar;
+		if( tNear > tFar )
+		{
+			return false;
+		}
+	}
+	distance = tNear;
+	return true;
+}
+
+struct StackEntry
+{
+	unsigned int node;
+	// Squared distance for closest point queries, and
+	// distance along the ray for intersection queries.
+	float distance;
+};
+
+} // namespace
+
+class MeshPrimitiveEvaluator::BVH
+{
+
+	public :
+
+		struct Node
+		{
+			Box3f bound;
+			// For internal nodes, the index of the second child, the first child
+			// immediately following its parent. For leaves, the index of the first
+			// triangle in triangleIndices.
+			unsigned int offset;
+			// Number of triangles in a leaf, or 0 for internal nodes.
+			unsigned int numTriangles;
+		};
+
+		BVH( const TriangleBoundVector &triangles )
+		{
+			if( triangles.empty() )
+			{
+				return;
+			}
+
+			std::vector<V3f> centroids( triangles.size() );
+			triangleIndices.resize( triangles.size() );
+			for( size_t i = 0; i < triangles.size(); ++i )
+			{
+				centroids[i] = triangles[i].center();
+				triangleIndices[i] = i;
+			}
+
+			BuildNode root;
+			Builder builder( triangles, centroids, triangleIndices, &root, 0, triangles.size(), 0 );
+			builder();
+
+			nodes.reserve( root.numNodes );
+			flatten( &root );
+		}
+
+		std::vector<Node> nodes;
+		std::vector<unsigned int> triangleIndices;
+
+	private :
+
+		// Intermediate representation used during the parallel
+		// build, before flattening into depth first order.
+		struct BuildNode
+		{
+			BuildNode()
+				:	begin( 0 ), end( 0 ), numNodes( 1 )
+			{
+				children[0] = children[1] = nullptr;
+			}
+
+			~BuildNode()
+			{
+				delete children[0];
+				delete children[1];
+			}
+
+			Box3f bound;
+			size_t begin;
+			size_t end;
+			size_t numNodes;
+			BuildNode *children[2];
+		};
+
+		struct Bin
+		{
+			Bin() : count( 0 ) {}
+			Box3f bound;
+			size_t count;
+		};
+
+		class Builder
+		{
+
+			public :
+
+				Builder( const TriangleBoundVector &triangles, const std::vector<V3f> &centroids, std::vector<unsigned int> &indices, BuildNode *node, size_t begin, size_t end, int depth )
+					:	m_triangles( triangles ), m_centroids( centroids ), m_indices( indices ), m_node( node ), m_begin( begin ), m_end( end ), m_depth( depth )
+				{
+				}
+
+				void operator()() const
+				{
+					BuildNode *node = m_node;
+					node->begin = m_begin;
+					node->end = m_end;
+
+					Box3f centroidBound;
+					for( size_t i = m_begin; i < m_end; ++i )
+					{
+						node->bound.extendBy( m_triangles[m_indices[i]] );
+						centroidBound.extendBy( m_centroids[m_indices[i]] );
+					}
+
+					const size_t size = m_end - m_begin;
+					if( size <= 1 )
+					{
+						return;
+					}
+
+					size_t mid = m_begin;
+					if( m_depth < g_maxSAHDepth )
+					{
+						mid = sahSplit( node->bound, centroidBound );
+						if( mid == m_begin )
+						{
+							// A leaf is cheaper than any split.
+							return;
+						}
+					}
+
+					if( mid == m_begin || mid == m_end )
+					{
+						// No useful split was found, either because the depth limit was
+						// reached or because the centroids coincide. Split at the median.
+						if( size <= g_maxLeafSize )
+						{
+							return;
+						}
+						const int axis = centroidBound.majorAxis();
+						mid = m_begin + size / 2;
+						std::nth_element(
+							m_indices.begin() + m_begin, m_indices.begin() + mid, m_indices.begin() + m_end,
+							CentroidLess( m_centroids, axis )
+						);
+					}
+
+					node->children[0] = new BuildNode;
+					node->children[1] = new BuildNode;
+
+					Builder lowBuilder( m_triangles, m_centroids, m_indices, node->children[0], m_begin, mid, m_depth + 1 );
+					Builder highBuilder( m_triangles, m_centroids, m_indices, node->children[1], mid, m_end, m_depth + 1 );
+					if( size > g_parallelBuildThreshold )
+					{
+						tbb::parallel_invoke( lowBuilder, highBuilder );
+					}
+					else
+					{
+						lowBuilder();
+						highBuilder();
+					}
+
+					node->numNodes = 1 + node->children[0]->numNodes + node->children[1]->numNodes;
+				}
+
+			private :
+
+				struct CentroidLess
+				{
+					CentroidLess( const std::vector<V3f> &centroids, int axis )
+						:	m_centroids( centroids ), m_axis( axis )
+					{
+					}
+
+					bool operator()( unsigned int a, unsigned int b ) const
+					{
+						return m_centroids[a][m_axis] < m_centroids[b][m_axis];
+					}
+
+					const std::vector<V3f> &m_centroids;
+					int m_axis;
+				};
+
+				struct BinLess
+				{
+					BinLess( const std::vector<V3f> &centroids, int axis, float min, float scale, int bin )
+						:	m_centroids( centroids ), m_axis( axis ), m_min( min ), m_scale( scale ), m_bin( bin )
+					{
+					}
+
+					bool operator()( unsigned int i ) const
+					{
+						return binIndex( m_centroids[i][m_axis], m_min, m_scale ) <= m_bin;
+					}
+
+					const std::vector<V3f> &m_centroids;
+					int m_axis;
+					float m_min;
+					float m_scale;
+					int m_bin;
+				};
+
+				static int binIndex( float c, float min, float scale )
+				{
+					return std::min( (int)( ( c - min ) * scale ), g_numBins - 1 );
+				}
+
+				// Partitions the range according to the surface area heuristic, returning the start
+				// of the second partition. Returns m_begin if a leaf is preferable to any split, and
+				// m_end if the centroids are coincident, so there is nothing to bin.
+				size_t sahSplit( const Box3f &bound, const Box3f &centroidBound ) const
+				{
+					const size_t size = m_end - m_begin;
+
+					int bestAxis = -1;
+					int bestBin = 0;
+					float bestCost = limits<float>::max();
+					for( int axis = 0; axis < 3; ++axis )
+					{
+						const float extent = centroidBound.max[axis] - centroidBound.min[axis];
+						if( extent <= 0.0f )
+						{
+							continue;
+						}
+
+						const float scale = g_numBins / extent;
+						Bin bins[g_numBins];
+						for( size_t i = m_begin; i < m_end; ++i )
+						{
+							const unsigned int t = m_indices[i];
+							Bin &bin = bins[binIndex( m_centroids[t][axis], centroidBound.min[axis], scale )];
+							bin.bound.extendBy( m_triangles[t] );
+							bin.count++;
+						}
+
+						float highArea[g_numBins];
+						size_t highCount[g_numBins];
+						Box3f accumulatedBound;
+						size_t accumulatedCount = 0;
+						for( int b = g_numBins - 1; b > 0; --b )
+						{
+							accumulatedBound.extendBy( bins[b].bound );
+							accumulatedCount += bins[b].count;
+							highArea[b] = halfArea( accumulatedBound );
+							highCount[b] = accumulatedCount;
+						}
+
+						accumulatedBound.makeEmpty();
+						accumulatedCount = 0;
+						for( int b = 0; b < g_numBins - 1; ++b )
+						{
+							accumulatedBound.extendBy( bins[b].bound );
+							accumulatedCount += bins[b].count;
+							if( !accumulatedCount || !highCount[b+1] )
+							{
+								continue;
+							}
+							const float cost = accumulatedCount * halfArea( accumulatedBound ) + highCount[b+1] * highArea[b+1];
+							if( cost < bestCost )
+							{
+								bestCost = cost;
+								bestAxis = axis;
+								bestBin = b;
+							}
+						}
+					}
+
+					if( bestAxis == -1 )
+					{
+						return m_end;
+					}
+
+					// Costs are relative to the cost of intersecting a triangle, with
+					// traversing a node costing the same as a triangle.
+					const float area = halfArea( bound );
+					if( size <= g_maxLeafSize && size * area <= area + bestCost )
+					{
+						return m_begin;
+					}
+
+					const float min = centroidBound.min[bestAxis];
+					const float scale = g_numBins / ( centroidBound.max[bestAxis] - min );
+					std::vector<unsigned int>::iterator midIt = std::partition(
+						m_indices.begin() + m_begin, m_indices.begin() + m_end,
+						BinLess( m_centroids, bestAxis, min, scale, bestBin )
+					);
+
+					return midIt - m_indices.begin();
+				}
+
+				const TriangleBoundVector &m_triangles;
+				const std::vector<V3f> &m_centroids;
+				std::vector<unsigned int> &m_indices;
+				BuildNode *m_node;
+				size_t m_begin;
+				size_t m_end;
+				int m_depth;
+
+		};
+
+		void flatten( const BuildNode *buildNode )
+		{
+			const size_t index = nodes.size();
+			nodes.push_back( Node() );
+			nodes[index].bound = buildNode->bound;
+			if( buildNode->children[0] )
+			{
+				flatten( buildNode->children[0] );
+				nodes[index].offset = nodes.size();
+				nodes[index].numTriangles = 0;
+				flatten( buildNode->children[1] );
+			}
+			else
+			{
+				nodes[index].offset = buildNode->begin;
+				nodes[index].numTriangles = buildNode->end - buildNode->begin;
+			}
+		}
+
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Batched queries
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+class ClosestPoints
+{
+
+	public :
+
+		ClosestPoints( const MeshPrimitiveEvaluator *evaluator, const std::vector<V3f> &points, std::vector<PrimitiveEvaluator::ResultPtr> &results )
+			:	m_evaluator( evaluator ), m_points( points ), m_results( results )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				PrimitiveEvaluator::ResultPtr result = m_evaluator->createResult();
+				if( m_evaluator->closestPoint( m_points[i], result.get() ) )
+				{
+					m_results[i] = result;
+				}
+			}
+		}
+
+	private :
+
+		const MeshPrimitiveEvaluator *m_evaluator;
+		const std::vector<V3f> &m_points;
+		std::vector<PrimitiveEvaluator::ResultPtr> &m_results;
+
+};
+
+class ClosestIntersectionPoints
+{
+
+	public :
+
+		ClosestIntersectionPoints( const MeshPrimitiveEvaluator *evaluator, const std::vector<V3f> &origins, const std::vector<V3f> &directions, float maxDistance, std::vector<PrimitiveEvaluator::ResultPtr> &results )
+			:	m_evaluator( evaluator ), m_origins( origins ), m_directions( directions ), m_maxDistance( maxDistance ), m_results( results )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				PrimitiveEvaluator::ResultPtr result = m_evaluator->createResult();
+				if( m_evaluator->intersectionPoint( m_origins[i], m_directions[i], result.get(), m_maxDistance ) )
+				{
+					m_results[i] = result;
+				}
+			}
+		}
+
+	private :
+
+		const MeshPrimitiveEvaluator *m_evaluator;
+		const std::vector<V3f> &m_origins;
+		const std::vector<V3f> &m_directions;
+		float m_maxDistance;
+		std::vector<PrimitiveEvaluator::ResultPtr> &m_results;
+
+};
+
+} // namespace
+
 MeshPrimitiveEvaluator::Result::Result()
 {
 }
@@ -210,7 +655,7 @@ const V3i &MeshPrimitiveEvaluator::Result::vertexIds() const
 	return m_vertexIds;
 }
 
-MeshPrimitiveEvaluator::MeshPrimitiveEvaluator( ConstMeshPrimitivePtr mesh ) : m_uvTree(nullptr), m_haveMassProperties( false ), m_haveSurfaceArea( false ), m_haveAverageNormals( false )
+MeshPrimitiveEvaluator::MeshPrimitiveEvaluator( ConstMeshPrimitivePtr mesh ) : m_bvh(nullptr), m_uvTree(nullptr), m_haveMassProperties( false ), m_haveSurfaceArea( false ), m_haveAverageNormals( false )
 {
 	if (! mesh )
 	{
@@ -293,7 +738,8 @@ MeshPrimitiveEvaluator::MeshPrimitiveEvaluator( ConstMeshPrimitivePtr mesh ) : m
 		}
 	}
 
-	m_tree = new TriangleBoundTree( m_triangles.begin(), m_triangles.end() );
+	m_tree = nullptr;
+	m_bvh = new BVH( m_triangles );
 
 	if( m_uv.interpolation != PrimitiveVariable::Invalid )
 	{
@@ -315,11 +761,12 @@ PrimitiveEvaluatorPtr MeshPrimitiveEvaluator::create( ConstPrimitivePtr primitiv
 
 MeshPrimitiveEvaluator::~MeshPrimitiveEvaluator()
 {
-	assert( m_tree );
-
 	delete m_tree;
 	m_tree = nullptr;
 
+	delete m_bvh;
+	m_bvh = nullptr;
+
 	delete m_uvTree;
 	m_uvTree = nullptr;
 }
@@ -765,15 +1212,9 @@ bool MeshPrimitiveEvaluator::closestPoint( const V3f &p, PrimitiveEvaluator::Res
 		return false;
 	}
 
-	assert( m_tree );
-
 	Result *mr = static_cast<Result *>( result );
 
-	float maxDistSqrd = limits<float>::max();
-
-	closestPointWalk( m_tree->rootIndex(), p, maxDistSqrd, mr );
-
-	return true;
+	return closestPointTraverse( p, mr );
 }
 
 bool MeshPrimitiveEvaluator::pointAtUV( const Imath::V2f &uv, PrimitiveEvaluator::Result *result ) const
@@ -801,20 +1242,13 @@ bool MeshPrimitiveEvaluator::intersectionPoint( const Imath::V3f &origin, const
 		return false;
 	}
 
-	assert( m_tree );
-
 	Result *mr = static_cast<Result *>( result );
 
-	float maxDistSqrd = maxDistance * maxDistance;
-
 	Imath::Line3f ray;
 	ray.pos = origin;
 	ray.dir = direction.normalized();
 
-	bool hit = false;
-
-	intersectionPointWalk( m_tree->rootIndex(), ray, maxDistSqrd, mr, hit );
-	return hit;
+	return intersectionPointTraverse( ray, maxDistance, mr );
 }
 
 int MeshPrimitiveEvaluator::intersectionPoints( const Imath::V3f &origin, const Imath::V3f &direction,
@@ -827,19 +1261,39 @@ int MeshPrimitiveEvaluator::intersectionPoints( const Imath::V3f &origin, const
 		return 0;
 	}
 
-	assert( m_tree );
-
-	float maxDistSqrd = maxDistance * maxDistance;
-
 	Imath::Line3f ray;
 	ray.pos = origin;
 	ray.dir = direction.normalized();
 
-	intersectionPointsWalk( m_tree->rootIndex(), ray, maxDistSqrd, results );
+	intersectionPointsTraverse( ray, maxDistance, results );
 
 	return results.size();
 }
 
+void MeshPrimitiveEvaluator::closestPoints( const std::vector<Imath::V3f> &points, std::vector<PrimitiveEvaluator::ResultPtr> &results ) const
+{
+	results.clear();
+	results.resize( points.size() );
+
+	ClosestPoints closestPoints( this, points, results );
+	tbb::parallel_for( tbb::blocked_range<size_t>( 0, points.size(), 64 ), closestPoints );
+}
+
+void MeshPrimitiveEvaluator::closestIntersectionPoints( const std::vector<Imath::V3f> &origins, const std::vector<Imath::V3f> &directions,
+	std::vector<PrimitiveEvaluator::ResultPtr> &results, float maxDistance ) const
+{
+	if( origins.size() != directions.size() )
+	{
+		throw InvalidArgumentException( "MeshPrimitiveEvaluator::closestIntersectionPoints : Number of origins and directions must match" );
+	}
+
+	results.clear();
+	results.resize( origins.size() );
+
+	ClosestIntersectionPoints closestIntersectionPoints( this, origins, directions, maxDistance, results );
+	tbb::parallel_for( tbb::blocked_range<size_t>( 0, origins.size(), 64 ), closestIntersectionPoints );
+}
+
 bool MeshPrimitiveEvaluator::barycentricPosition( unsigned int triangleIndex, const Imath::V3f &barycentricCoordinates, PrimitiveEvaluator::Result *result ) const
 {
 	if( triangleIndex >= m_triangles.size() )
@@ -871,93 +1325,90 @@ bool MeshPrimitiveEvaluator::barycentricPosition( unsigned int triangleIndex, co
 	return true;
 }
 
-void MeshPrimitiveEvaluator::closestPointWalk( TriangleBoundTree::NodeIndex nodeIndex, const V3f &p, float &closestDistanceSqrd, Result *result ) const
+bool MeshPrimitiveEvaluator::closestPointTraverse( const V3f &p, Result *result ) const
 {
-	assert( m_tree );
-
-	const TriangleBoundTree::Node &node = m_tree->node( nodeIndex );
-	if( node.isLeaf() )
+	if( m_bvh->nodes.empty() )
 	{
-		TriangleBoundTree::Iterator *permLast = node.permLast();
-		for( TriangleBoundTree::Iterator *perm = node.permFirst(); perm!=permLast; perm++ )
-		{
-			size_t triangleIndex = *perm - m_triangles.begin(); // triangle index is just the distance of the triangle from the beginning of the vector
-			size_t vertIdOffset = triangleIndex * 3;
-			Imath::V3i vertexIds( (*m_meshVertexIds)[vertIdOffset], (*m_meshVertexIds)[vertIdOffset+1], (*m_meshVertexIds)[vertIdOffset+2] );
+		return false;
+	}
 
-			assert( vertexIds[0] < (int)( m_verts->readable().size() ) );
-			assert( vertexIds[1] < (int)( m_verts->readable().size() ) );
-			assert( vertexIds[2] < (int)( m_verts->readable().size() ) );
+	const std::vector<BVH::Node> &nodes = m_bvh->nodes;
+	const std::vector<unsigned int> &triangleIndices = m_bvh->triangleIndices;
+	const std::vector<V3f> &verts = m_verts->readable();
 
-			V3f bary;
-			float dSqrd = triangleClosestBarycentric(
-				m_verts->readable()[vertexIds[0]],
-				m_verts->readable()[vertexIds[1]],
-				m_verts->readable()[vertexIds[2]],
-				p,
-				bary );
+	float closestDistanceSqrd = limits<float>::max();
+	unsigned int closestTriangle = 0;
+	V3f closestBary;
+	bool found = false;
 
-			if (dSqrd < closestDistanceSqrd)
-			{
-				closestDistanceSqrd = dSqrd;
+	StackEntry stack[g_maxStackSize];
+	int stackSize = 0;
+	stack[stackSize].node = 0;
+	stack[stackSize++].distance = 0.0f;
 
-				result->m_bary = bary;
-				result->m_vertexIds = vertexIds;
-				result->m_triangleIdx = triangleIndex;
+	while( stackSize )
+	{
+		const StackEntry entry = stack[--stackSize];
+		if( entry.distance >= closestDistanceSqrd )
+		{
+			continue;
+		}
 
-				if( m_uv.interpolation != PrimitiveVariable::Invalid )
+		const BVH::Node &node = nodes[entry.node];
+		if( node.numTriangles )
+		{
+			for( unsigned int i = node.offset, e = node.offset + node.numTriangles; i < e; ++i )
+			{
+				const unsigned int triangleIndex = triangleIndices[i];
+				const int *vertexIds = &(*m_meshVertexIds)[triangleIndex * 3];
+
+				V3f bary;
+				float dSqrd = triangleClosestBarycentric(
+					verts[vertexIds[0]],
+					verts[vertexIds[1]],
+					verts[vertexIds[2]],
+					p,
+					bary
+				);
+
+				if( dSqrd < closestDistanceSqrd )
 				{
-					result->m_uv = result->vec2PrimVar( m_uv );
+					closestDistanceSqrd = dSqrd;
+					closestTriangle = triangleIndex;
+					closestBary = bary;
+					found = true;
 				}
-
-				const Imath::V3f &p0 = m_verts->readable()[vertexIds[0]];
-				const Imath::V3f &p1 = m_verts->readable()[vertexIds[1]];
-				const Imath::V3f &p2 = m_verts->readable()[vertexIds[2]];
-
-				result->m_p = trianglePoint( p0, p1, p2, result->m_bary );
-
-				result->m_n = triangleNormal( p0, p1, p2 );
 			}
 		}
-	}
-	else
-	{
-		/// Descend into the closest box first
-
-		float dHigh = vecDistance(
-			closestPointInBox( p, m_tree->node( TriangleBoundTree::highChildIndex( nodeIndex ) ).bound() ),
-			p
-		);
-
-		float dLow = vecDistance(
-			closestPointInBox( p, m_tree->node( TriangleBoundTree::lowChildIndex( nodeIndex ) ).bound() ),
-			p
-		);
-
-		TriangleBoundTree::NodeIndex firstChild, secondChild;
-
-		float dSecond;
-
-		if (dHigh < dLow)
-		{
-			firstChild = TriangleBoundTree::highChildIndex( nodeIndex );
-			secondChild = TriangleBoundTree::lowChildIndex( nodeIndex );
-			dSecond = dLow;
-		}
 		else
 		{
-			firstChild = TriangleBoundTree::lowChildIndex( nodeIndex );
-			secondChild = TriangleBoundTree::highChildIndex( nodeIndex );
-			dSecond = dHigh;
+			/// Push the furthest child first, so that we descend into the closest first
+			StackEntry low, high;
+			low.node = entry.node + 1;
+			low.distance = vecDistance2( closestPointInBox( p, nodes[low.node].bound ), p );
+			high.node = node.offset;
+			high.distance = vecDistance2( closestPointInBox( p, nodes[high.node].bound ), p );
+			if( high.distance < low.distance )
+			{
+				std::swap( low, high );
+			}
+			if( high.distance < closestDistanceSqrd )
+			{
+				stack[stackSize++] = high;
+			}
+			if( low.distance < closestDistanceSqrd )
+			{
+				stack[stackSize++] = low;
+			}
 		}
+	}
 
-		closestPointWalk( firstChild, p, closestDistanceSqrd, result );
-
-		if (dSecond * dSecond < closestDistanceSqrd )
-		{
-			closestPointWalk( secondChild, p, closestDistanceSqrd, result );
-		}
+	if( !found )
+	{
+		return false;
 	}
+
+	return barycentricPosition( closestTriangle, closestBary, result );
 }
 
 bool MeshPrimitiveEvaluator::pointAtUVWalk( UVBoundTree::NodeIndex nodeIndex, const Imath::V2f &targetUV, Result *result ) const
@@ -1029,244 +1480,155 @@ bool MeshPrimitiveEvaluator::pointAtUVWalk( UVBoundTree::NodeIndex nodeIndex, co
 }
 
 
-bool MeshPrimitiveEvaluator::intersectionPointWalk( TriangleBoundTree::NodeIndex nodeIndex, const Imath::Line3f &ray, float &maxDistSqrd, Result *result, bool &hit ) const
+bool MeshPrimitiveEvaluator::intersectionPointTraverse( const Imath::Line3f &ray, float maxDistance, Result *result ) const
 {
-	assert( m_tree );
-
-	const TriangleBoundTree::Node &node = m_tree->node( nodeIndex );
-
-	if( node.isLeaf() )
+	if( m_bvh->nodes.empty() )
 	{
-		TriangleBoundTree::Iterator *permLast = node.permLast();
-		bool intersects = false;
-
-		for( TriangleBoundTree::Iterator *perm = node.permFirst(); perm!=permLast; perm++ )
-		{
-			size_t triangleIndex = *perm - m_triangles.begin(); // triangle index is just the distance of the triangle from the beginning of the vector
-			size_t vertIdOffset = triangleIndex * 3;
-			Imath::V3i vertexIds( (*m_meshVertexIds)[vertIdOffset], (*m_meshVertexIds)[vertIdOffset+1], (*m_meshVertexIds)[vertIdOffset+2] );
-
-			assert( vertexIds[0] < (int)( m_verts->readable().size() ) );
-			assert( vertexIds[1] < (int)( m_verts->readable().size() ) );
-			assert( vertexIds[2] < (int)( m_verts->readable().size() ) );
-
-			const Imath::V3f &p0 = m_verts->readable()[ vertexIds[0] ];
-			const Imath::V3f &p1 = m_verts->readable()[ vertexIds[1] ];
-			const Imath::V3f &p2 = m_verts->readable()[ vertexIds[2] ];
-
-			V3f hitPoint, bary;
-			bool front;
-
-			if ( triangleRayIntersection( p0, p1, p2, ray.pos, ray.dir, hitPoint, bary, front ) )
-			{
-				float dSqrd = vecDistance2( hitPoint, ray.pos );
-
-				if (dSqrd < maxDistSqrd)
-				{
-					maxDistSqrd = dSqrd;
-
-					result->m_bary = bary;
-					result->m_vertexIds = vertexIds;
-					result->m_triangleIdx = triangleIndex;
+		return false;
+	}
 
-					result->m_p = hitPoint;
+	const std::vector<BVH::Node> &nodes = m_bvh->nodes;
+	const std::vector<unsigned int> &triangleIndices = m_bvh->triangleIndices;
+	const std::vector<V3f> &verts = m_verts->readable();
 
-					if( m_uv.interpolation != PrimitiveVariable::Invalid )
-					{
-						result->m_uv = result->vec2PrimVar( m_uv );
-					}
+	const V3f inverseDirection( 1.0f / ray.dir.x, 1.0f / ray.dir.y, 1.0f / ray.dir.z );
 
-					result->m_n = triangleNormal( p0, p1, p2 );
-
-					intersects = true;
-					hit = true;
-				}
-			}
-		}
+	float maxDistSqrd = maxDistance * maxDistance;
+	unsigned int closestTriangle = 0;
+	V3f closestBary, closestPoint;
+	bool hit = false;
 
-		return intersects;
-	}
-	else
+	StackEntry stack[g_maxStackSize];
+	int stackSize = 0;
+	if( rayBoxIntersection( nodes[0].bound, ray.pos, inverseDirection, maxDistance, stack[0].distance ) )
 	{
-		V3f highHitPoint;
-		bool highHit = boxIntersects(
-			m_tree->node( TriangleBoundTree::highChildIndex( nodeIndex ) ).bound(),
-			ray.pos,
-			ray.dir,
-			highHitPoint
-		);
-
-		V3f lowHitPoint;
-		bool lowHit = boxIntersects(
-			m_tree->node( TriangleBoundTree::lowChildIndex( nodeIndex ) ).bound(),
-			ray.pos,
-			ray.dir,
-			lowHitPoint
-		);
-
-		float dHigh = -1;
-		if ( highHit )
-		{
-			float distSqrd = vecDistance2( highHitPoint, ray.pos );
-			if ( distSqrd > maxDistSqrd )
-			{
-				highHit = false;
-			}
-			else
-			{
-				dHigh = distSqrd;
-			}
-		}
+		stack[stackSize++].node = 0;
+	}
 
-		float dLow = -1;
-		if ( lowHit )
+	while( stackSize )
+	{
+		const StackEntry entry = stack[--stackSize];
+		if( entry.distance > maxDistance )
 		{
-			float distSqrd = vecDistance2( lowHitPoint, ray.pos );
-			if ( distSqrd > maxDistSqrd )
-			{
-				lowHit = false;
-			}
-			else
-			{
-				dLow = distSqrd;
-			}
+			continue;
 		}
 
-		if (lowHit)
+		const BVH::Node &node = nodes[entry.node];
+		if( node.numTriangles )
 		{
-			if (highHit)
+			for( unsigned int i = node.offset, e = node.offset + node.numTriangles; i < e; ++i )
 			{
-				/// Descend into the closest intersection first
-
-				TriangleBoundTree::NodeIndex firstChild, secondChild;
-				float dSecond;
-				if (dHigh < dLow)
-				{
-					firstChild = TriangleBoundTree::highChildIndex( nodeIndex );
-					secondChild = TriangleBoundTree::lowChildIndex( nodeIndex );
-					dSecond = dLow;
-				}
-				else
-				{
-					firstChild = TriangleBoundTree::lowChildIndex( nodeIndex );
-					secondChild = TriangleBoundTree::highChildIndex( nodeIndex );
-					dSecond = dHigh;
-				}
-
-				bool intersection = intersectionPointWalk( firstChild, ray, maxDistSqrd, result, hit );
+				const unsigned int triangleIndex = triangleIndices[i];
+				const int *vertexIds = &(*m_meshVertexIds)[triangleIndex * 3];
 
-				if (intersection)
+				V3f hitPoint, bary;
+				bool front;
+				if( triangleRayIntersection( verts[vertexIds[0]], verts[vertexIds[1]], verts[vertexIds[2]], ray.pos, ray.dir, hitPoint, bary, front ) )
 				{
-					if ( dSecond < maxDistSqrd )
+					const float dSqrd = vecDistance2( hitPoint, ray.pos );
+					if( dSqrd < maxDistSqrd )
 					{
-						intersectionPointWalk( secondChild, ray, maxDistSqrd, result, hit );
+						maxDistSqrd = dSqrd;
+						maxDistance = sqrtf( dSqrd );
+						closestTriangle = triangleIndex;
+						closestBary = bary;
+						closestPoint = hitPoint;
+						hit = true;
 					}
-
-					return true;
 				}
-				else
+			}
+		}
+		else
+		{
+			/// Push the furthest child first, so that we descend into the closest first
+			StackEntry low, high;
+			low.node = entry.node + 1;
+			high.node = node.offset;
+			const bool lowHit = rayBoxIntersection( nodes[low.node].bound, ray.pos, inverseDirection, maxDistance, low.distance );
+			const bool highHit = rayBoxIntersection( nodes[high.node].bound, ray.pos, inverseDirection, maxDistance, high.distance );
+			if( lowHit && highHit )
+			{
+				if( high.distance < low.distance )
 				{
-					return intersectionPointWalk( secondChild, ray, maxDistSqrd, result, hit );
+					std::swap( low, high );
 				}
+				stack[stackSize++] = high;
+				stack[stackSize++] = low;
 			}
-			else
+			else if( lowHit )
 			{
-				return intersectionPointWalk( TriangleBoundTree::lowChildIndex( nodeIndex ), ray, maxDistSqrd, result, hit );
+				stack[stackSize++] = low;
+			}
+			else if( highHit )
+			{
+				stack[stackSize++] = high;
 			}
-
-		}
-		else if (highHit)
-		{
-			return intersectionPointWalk( TriangleBoundTree::highChildIndex( nodeIndex ), ray, maxDistSqrd, result, hit );
 		}
+	}
 
-
+	if( !hit )
+	{
 		return false;
 	}
 
+	barycentricPosition( closestTriangle, closestBary, result );
+	result->m_p = closestPoint;
+	return true;
 }
 
-void MeshPrimitiveEvaluator::intersectionPointsWalk( TriangleBoundTree::NodeIndex nodeIndex, const Imath::Line3f &ray, float maxDistSqrd, std::vector<PrimitiveEvaluator::ResultPtr> &results ) const
+void MeshPrimitiveEvaluator::intersectionPointsTraverse( const Imath::Line3f &ray, float maxDistance, std::vector<PrimitiveEvaluator::ResultPtr> &results ) const
 {
-	assert( m_tree );
-
-	const TriangleBoundTree::Node &node = m_tree->node( nodeIndex );
-
-	if( node.isLeaf() )
+	if( m_bvh->nodes.empty() )
 	{
-		TriangleBoundTree::Iterator *permLast = node.permLast();
+		return;
+	}
 
-		for( TriangleBoundTree::Iterator *perm = node.permFirst(); perm!=permLast; perm++ )
-		{
-			size_t triangleIndex = *perm - m_triangles.begin(); // triangle index is just the distance of the triangle from the beginning of the vector
-			size_t vertIdOffset = triangleIndex * 3;
-			Imath::V3i vertexIds( (*m_meshVertexIds)[vertIdOffset], (*m_meshVertexIds)[vertIdOffset+1], (*m_meshVertexIds)[vertIdOffset+2] );
+	const std::vector<BVH::Node> &nodes = m_bvh->nodes;
+	const std::vector<unsigned int> &triangleIndices = m_bvh->triangleIndices;
+	const std::vector<V3f> &verts = m_verts->readable();
+
+	const V3f inverseDirection( 1.0f / ray.dir.x, 1.0f / ray.dir.y, 1.0f / ray.dir.z );
+	const float maxDistSqrd = maxDistance * maxDistance;
 
-			assert( vertexIds[0] < (int)( m_verts->readable().size() ) );
-			assert( vertexIds[1] < (int)( m_verts->readable().size() ) );
-			assert( vertexIds[2] < (int)( m_verts->readable().size() ) );
+	unsigned int stack[g_maxStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
 
-			const Imath::V3f &p0 =  m_verts->readable()[ vertexIds[0] ];
-			const Imath::V3f &p1 =  m_verts->readable()[ vertexIds[1] ];
-			const Imath::V3f &p2 =  m_verts->readable()[ vertexIds[2] ];
+	while( stackSize )
+	{
+		const BVH::Node &node = nodes[stack[--stackSize]];
 
-			V3f hitPoint, bary;
-			bool front;
+		float distance;
+		if( !rayBoxIntersection( node.bound, ray.pos, inverseDirection, maxDistance, distance ) )
+		{
+			continue;
+		}
 
-			if ( triangleRayIntersection( p0, p1, p2, ray.pos, ray.dir, hitPoint, bary, front ) )
+		if( node.numTriangles )
+		{
+			for( unsigned int i = node.offset, e = node.offset + node.numTriangles; i < e; ++i )
 			{
-				float dSqrd = vecDistance2( hitPoint, ray.pos );
+				const unsigned int triangleIndex = triangleIndices[i];
+				const int *vertexIds = &(*m_meshVertexIds)[triangleIndex * 3];
 
-				if (dSqrd < maxDistSqrd)
+				V3f hitPoint, bary;
+				bool front;
+				if( triangleRayIntersection( verts[vertexIds[0]], verts[vertexIds[1]], verts[vertexIds[2]], ray.pos, ray.dir, hitPoint, bary, front ) )
 				{
-					ResultPtr result = new Result();
-
-					result->m_bary = bary;
-					result->m_vertexIds = vertexIds;
-					result->m_triangleIdx = triangleIndex;
-
-					result->m_p = hitPoint;
-
-					if ( m_uv.interpolation != PrimitiveVariable::Invalid )
+					if( vecDistance2( hitPoint, ray.pos ) < maxDistSqrd )
 					{
-						result->m_uv = result->vec2PrimVar( m_uv );
+						ResultPtr result = new Result();
+						barycentricPosition( triangleIndex, bary, result.get() );
+						result->m_p = hitPoint;
+						results.push_back( result );
 					}
-
-					result->m_n = triangleNormal( p0, p1, p2 );
-
-					results.push_back( result );
 				}
 			}
 		}
-	}
-	else
-	{
-		V3f hitPoint;
-
-		/// Test highChild bound for intersection, descending into children if necessary
-		bool hit = boxIntersects(
-			m_tree->node( TriangleBoundTree::highChildIndex( nodeIndex ) ).bound(),
-			ray.pos,
-			ray.dir,
-			hitPoint
-		);
-
-		if ( hit && vecDistance2( hitPoint, ray.pos ) < maxDistSqrd )
-		{
-			intersectionPointsWalk( TriangleBoundTree::highChildIndex( nodeIndex ), ray, maxDistSqrd, results );
-		}
-
-		/// Test lowChild bound for intersection, descending into children if necessary
-		hit = boxIntersects(
-			m_tree->node( TriangleBoundTree::lowChildIndex( nodeIndex ) ).bound(),
-			ray.pos,
-			ray.dir,
-			hitPoint
-		);
-
-		if ( hit && vecDistance2( hitPoint, ray.pos ) < maxDistSqrd )
+		else
 		{
-			intersectionPointsWalk( TriangleBoundTree::lowChildIndex( nodeIndex ), ray, maxDistSqrd, results );
+			stack[stackSize++] = node.offset;
+			stack[stackSize++] = &node - &nodes[0] + 1;
 		}
 	}
 }
@@ -1287,6 +1649,16 @@ const MeshPrimitiveEvaluator::TriangleBoundVector *MeshPrimitiveEvaluator::trian
 
 const MeshPrimitiveEvaluator::TriangleBoundTree *MeshPrimitiveEvaluator::triangleBoundTree() const
 {
+	if( !m_tree )
+	{
+		TreeMutex::scoped_lock lock( m_treeMutex );
+		if( !m_tree )
+		{
+			// another thread may have built the tree while we waited for the mutex
+			TriangleBoundVector &triangles = const_cast<TriangleBoundVector &>( m_triangles );
+			m_tree = new TriangleBoundTree( triangles.begin(), triangles.end() );
+		}
+	}
 	return m_tree;
 }
 
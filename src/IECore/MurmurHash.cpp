@@ -34,6 +34,18 @@
 
 #include <iomanip>
 #include <sstream>
+#include <vector>
+
+#include "tbb/atomic.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/tbb_stddef.h"
+
+// Task isolation is only available from TBB 2018.
+#if TBB_INTERFACE_VERSION >= 10000
+#include "tbb/task_arena.h"
+#define IECORE_MURMURHASH_PARALLELCHUNKS
+#endif
 
 #include "IECore/MurmurHash.h"
 
@@ -49,6 +61,85 @@ MurmurHash::MurmurHash( const MurmurHash &other )
 {
 }
 
+// Zero initialised, giving SerialArrayHash.
+static tbb::atomic<MurmurHash::ArrayHashVersion> g_arrayHashVersion;
+
+void MurmurHash::setArrayHashVersion( ArrayHashVersion version )
+{
+	g_arrayHashVersion = version;
+}
+
+MurmurHash::ArrayHashVersion MurmurHash::getArrayHashVersion()
+{
+	return g_arrayHashVersion;
+}
+
+namespace
+{
+
+class ChunkHashes
+{
+
+	public :
+
+		typedef void (*ChunkHasher)( MurmurHash &h, const void *data, size_t begin, size_t end );
+
+		ChunkHashes( const void *data, size_t numElements, size_t chunkElements, ChunkHasher chunkHasher, MurmurHash *chunkHashes )
+			:	m_data( data ), m_numElements( numElements ), m_chunkElements( chunkElements ), m_chunkHasher( chunkHasher ), m_chunkHashes( chunkHashes )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				const size_t begin = i * m_chunkElements;
+				m_chunkHasher( m_chunkHashes[i], m_data, begin, std::min( begin + m_chunkElements, m_numElements ) );
+			}
+		}
+
+		// Runs the parallel_for. Called via task isolation, so that
+		// a thread waiting for the chunks can't pick up unrelated outer
+		// tasks, which might need a lock already held by our caller.
+		void operator()() const
+		{
+			const size_t numChunks = ( m_numElements + m_chunkElements - 1 ) / m_chunkElements;
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, numChunks ), *this );
+		}
+
+	private :
+
+		const void *m_data;
+		size_t m_numElements;
+		size_t m_chunkElements;
+		ChunkHasher m_chunkHasher;
+		MurmurHash *m_chunkHashes;
+
+};
+
+} // namespace
+
+void MurmurHash::appendChunks( const void *data, size_t numElements, size_t chunkElements, ChunkHasher chunkHasher )
+{
+	const size_t numChunks = ( numElements + chunkElements - 1 ) / chunkElements;
+	std::vector<MurmurHash> chunkHashes( numChunks );
+	const ChunkHashes hasher( data, numElements, chunkElements, chunkHasher, &chunkHashes[0] );
+#ifdef IECORE_MURMURHASH_PARALLELCHUNKS
+	tbb::this_task_arena::isolate( hasher );
+#else
+	// Without isolation, waiting for a parallel_for could deadlock
+	// a caller holding a lock, so the chunks are hashed serially.
+	// The result is the same either way.
+	hasher( tbb::blocked_range<size_t>( 0, numChunks ) );
+#endif
+
+	append( (uint64_t)numElements );
+	for( std::vector<MurmurHash>::const_iterator it = chunkHashes.begin(), eIt = chunkHashes.end(); it != eIt; ++it )
+	{
+		append( *it );
+	}
+}
+
 std::string MurmurHash::toString() const
 {
 	std::stringstream s;
@@ -33,7 +33,9 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "boost/lexical_cast.hpp"
+#include "boost/bind.hpp"
 #include "IECore/LRUCache.h"
+#include "IECore/CacheRegistry.h"
 #include "IECore/ObjectPool.h"
 
 using namespace IECore;
@@ -45,11 +47,23 @@ using namespace IECore;
 struct ObjectPool::MemberData
 {
 
-	MemberData( size_t maxMemory ) : cache( getter, maxMemory )
+	typedef LRUCache< MurmurHash, ConstObjectPtr, LRUCachePolicy::Sharded > Cache;
+
+	MemberData( size_t maxMemory )
+		:	cache( getter, maxMemory ),
+			registryClient(
+				"ObjectPool",
+				boost::bind( &Cache::currentCost, &cache ),
+				boost::bind( &Cache::getMaxCost, &cache ),
+				boost::bind( &Cache::setMaxCost, &cache, ::_1 )
+			)
 	{
 	}
 
-	LRUCache< MurmurHash, ConstObjectPtr > cache;
+	Cache cache;
+	// Declared after the cache so that it is deregistered before
+	// the cache is destroyed.
+	CacheRegistry::Client registryClient;
 
 	/// our getter always returns NULL
 	static ConstObjectPtr getter( const MurmurHash &h, size_t &cost )
@@ -74,7 +88,13 @@ ObjectPool::~ObjectPool()
 
 ConstObjectPtr ObjectPool::retrieve( const MurmurHash &hash ) const
 {
-	return m_data->cache.get(hash);
+	m_data->registryClient.recordLookup();
+	ConstObjectPtr result = m_data->cache.get(hash);
+	if( !result )
+	{
+		m_data->registryClient.recordMiss();
+	}
+	return result;
 }
 
 ConstObjectPtr ObjectPool::store( const Object *obj, StoreMode mode )
@@ -92,11 +112,13 @@ ConstObjectPtr ObjectPool::store( const Object *obj, StoreMode mode )
 	{
 		cachedObj = obj->copy();
 		m_data->cache.set( h, cachedObj, obj->memoryUsage() );
+		m_data->registryClient.memoryAdded();
 		return cachedObj;
 	}
 	else if ( mode == StoreReference )
 	{
 		m_data->cache.set( h, obj, obj->memoryUsage() );
+		m_data->registryClient.memoryAdded();
 		return obj;
 	}
 	else
@@ -135,6 +157,11 @@ size_t ObjectPool::memoryUsage() const
 	return m_data->cache.currentCost();
 }
 
+void ObjectPool::shardStatistics( std::vector<LRUCachePolicy::ShardStatistics> &stats ) const
+{
+	m_data->cache.policy().statistics( stats );
+}
+
 ObjectPool *ObjectPool::defaultObjectPool()
 {
 	static ObjectPoolPtr c = nullptr;
@@ -131,17 +131,18 @@ static void densities( const vector<Vec3<T> > &points, int numNeighbours, T mult
 	Tree tree( points.begin(), points.end() );
 	vector<typename Tree::Neighbour> neighbours;
 
+	const unsigned int numFound = tree.nearestNNeighbours( points.begin(), points.end(), numNeighbours, neighbours );
+
 	result.resize( points.size() );
 	for( unsigned int i=0; i<points.size(); i++ )
 	{
-		tree.nearestNNeighbours( points[i], numNeighbours, neighbours );
-		T r = ((*(neighbours.rbegin()->point)) - points[i]).length();
+		// neighbours are sorted closest first, so the last one for each point is the furthest
+		T r = sqrt( neighbours[(i+1)*numFound - 1].distSquared );
 		result[i] = multiplier / (r*r*r);
 	}
 }
 
 /// \todo Support 2d point types?
-/// \todo Threading?
 ObjectPtr PointDensitiesOp::doOperation( const CompoundObject * operands )
 {
 	const int numNeighbours = m_numNeighboursParameter->getNumericValue();
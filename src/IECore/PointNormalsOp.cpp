@@ -32,6 +32,9 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
 #include "IECore/PointNormalsOp.h"
 #include "IECore/VectorTypedData.h"
 #include "IECore/ObjectParameter.h"
@@ -102,34 +105,66 @@ const IntParameter * PointNormalsOp::numNeighboursParameter() const
 /// Calculates density at a point by finding the volume of a sphere holding numNeighbours. Doesn't bother
 /// with any constant factors for the density (PI, 4/3, numNeighbours) as these are factored out in the use below anyway.
 template<typename T>
-static inline typename T::Point::BaseType density( const T tree, const typename T::Point &p, int numNeighbours, vector<typename T::Neighbour> &neighbours )
+static inline typename T::Point::BaseType density( const T &tree, const typename T::Point &p, int numNeighbours, vector<typename T::Neighbour> &neighbours )
 {
 	tree.nearestNNeighbours( p, numNeighbours, neighbours );
 	typename T::Point::BaseType r = ((*(neighbours.rbegin()->point)) - p).length();
 	return 1.0/(r*r*r);
 }
 
+namespace
+{
+
+template<typename T>
+class Normals
+{
+
+	public :
+
+		typedef KDTree<typename vector<T>::const_iterator > Tree;
+		typedef typename T::BaseType Real;
+
+		Normals( const Tree &tree, const vector<T> &points, int numNeighbours, vector<T> &result )
+			:	m_tree( tree ), m_points( points ), m_numNeighbours( numNeighbours ), m_result( result )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			// reused for every point in the range, to avoid allocating per query
+			vector<typename Tree::Neighbour> neighbours;
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				const T &p = m_points[i];
+				Real d = density( m_tree, p, m_numNeighbours, neighbours );
+				float o = Real( 0.1 ) ; // should we scale offset for gradient by the radius of the neighbours sphere?
+				Real dx = d - density( m_tree, p + T( o, 0, 0 ), m_numNeighbours, neighbours );
+				Real dy = d - density( m_tree, p + T( 0, o, 0 ), m_numNeighbours, neighbours );
+				Real dz = d - density( m_tree, p + T( 0, 0, o ), m_numNeighbours, neighbours );
+				m_result[i] = T( dx, dy, dz ).normalized();
+			}
+		}
+
+	private :
+
+		const Tree &m_tree;
+		const vector<T> &m_points;
+		int m_numNeighbours;
+		vector<T> &m_result;
+
+};
+
+} // namespace
+
 /// This works by finding the gradient of a density function defined by the particles.
 template<typename T>
 static void normals( const vector<T> &points, int numNeighbours, vector<T> &result )
 {
-	typedef KDTree<typename vector<T>::const_iterator > Tree;
-	typedef typename T::BaseType Real;
-
-	Tree tree( points.begin(), points.end() );
-	vector<typename Tree::Neighbour> neighbours;
+	typename Normals<T>::Tree tree( points.begin(), points.end() );
 
 	result.resize( points.size() );
 
-	for( unsigned int i=0; i<points.size(); i++ )
-	{
-		Real d = density( tree, points[i], numNeighbours, neighbours );
-		float o = Real( 0.1 ) ; // should we scale offset for gradient by the radius of the neighbours sphere?
-		Real dx = d - density( tree, points[i] + T( o, 0, 0 ), numNeighbours, neighbours );
-		Real dy = d - density( tree, points[i] + T( 0, o, 0 ), numNeighbours, neighbours );
-		Real dz = d - density( tree, points[i] + T( 0, 0, o ), numNeighbours, neighbours );
-		result[i] = T( dx, dy, dz ).normalized();
-	}
+	tbb::parallel_for( tbb::blocked_range<size_t>( 0, points.size() ), Normals<T>( tree, points, numNeighbours, result ) );
 }
 
 ObjectPtr PointNormalsOp::doOperation( const CompoundObject *operands )
@@ -32,18 +32,26 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+
 #include "boost/tuple/tuple.hpp"
+#include "tbb/atomic.h"
 #include "tbb/concurrent_hash_map.h"
+#include "tbb/mutex.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_group.h"
 
 #include "OpenEXR/ImathBoxAlgo.h"
 
 #include "IECore/SceneCache.h"
 #include "IECore/FileIndexedIO.h"
+#include "IECore/StreamIndexedIO.h"
 #include "IECore/HeaderGenerator.h"
 #include "IECore/VisibleRenderable.h"
 #include "IECore/ObjectInterpolator.h"
 #include "IECore/Primitive.h"
 #include "IECore/SimpleTypedData.h"
+#include "IECore/VectorTypedData.h"
 #include "IECore/TransformationMatrixData.h"
 #include "IECore/SharedSceneInterfaces.h"
 #include "IECore/MessageHandler.h"
@@ -84,6 +92,59 @@ const SceneInterface::Name &SceneCache::animatedObjectPrimVarsAttribute = Intern
 
 typedef std::vector<double> SampleTimes;
 
+// The primitive variables which may be delta encoded. When they are,
+// they are stored under the name returned by deltaEncodedName(), so that
+// older versions of the library load a primitive which is obviously
+// incomplete, rather than one with garbage positions.
+static const InternedString g_deltaEncodablePrimVars[] = { "P", "N", "velocity" };
+
+static InternedString deltaEncodedName( const InternedString &name )
+{
+	return InternedString( "sceneCache:delta:" + name.string() );
+}
+
+// Returns the bitwise XOR of data with previous, or null if they are not
+// both of type T with the same length. Applying the XOR twice gives back
+// the original data, so this is used for both encoding and decoding.
+template<typename T>
+static DataPtr xorVectorData( const Data *data, const Data *previous )
+{
+	const T *typedData = runTimeCast<const T>( data );
+	const T *typedPrevious = runTimeCast<const T>( previous );
+	if ( !typedData || !typedPrevious || typedData->readable().size() != typedPrevious->readable().size() )
+	{
+		return nullptr;
+	}
+
+	typename T::Ptr result = new T;
+	result->setInterpretation( typedData->getInterpretation() );
+	result->writable().resize( typedData->readable().size() );
+
+	const size_t numWords = typedData->readable().size() * sizeof( typename T::ValueType::value_type ) / sizeof( uint32_t );
+	const uint32_t *a = reinterpret_cast<const uint32_t *>( typedData->readable().data() );
+	const uint32_t *b = reinterpret_cast<const uint32_t *>( typedPrevious->readable().data() );
+	uint32_t *r = reinterpret_cast<uint32_t *>( result->writable().data() );
+	for ( size_t i = 0; i < numWords; ++i )
+	{
+		r[i] = a[i] ^ b[i];
+	}
+
+	return result;
+}
+
+static DataPtr xorData( const Data *data, const Data *previous )
+{
+	DataPtr result = xorVectorData<V3fVectorData>( data, previous );
+	if ( !result )
+	{
+		result = xorVectorData<V3dVectorData>( data, previous );
+	}
+	return result;
+}
+
+// Default settings for SceneCache::setObjectDeltaEncoding().
+static size_t g_defaultDeltaKeyframeInterval = 0;
+
 class SceneCache::Implementation : public RefCounted
 {
 	public :
@@ -556,9 +617,60 @@ class SceneCache::ReaderImplementation : public SceneCache::Implementation
 			return m_sharedData->readObjectAtSample( this, sampleIndex );
 		}
 
-		static PrimitiveVariableMap readObjectPrimitiveVariablesAtSample( const IndexedIOPtr &io, const std::vector<InternedString> &primVarNames, size_t sample )
+		PrimitiveVariableMap readObjectPrimitiveVariablesAtSample( const std::vector<InternedString> &primVarNames, size_t sample ) const
 		{
-			return Primitive::loadPrimitiveVariables( io->subdirectory( objectEntry ).get(), sampleEntry(sample), primVarNames );
+			// also load the delta encoded versions of the variables, in case they were stored that way.
+			std::vector<InternedString> names( primVarNames );
+			for ( const auto &name : g_deltaEncodablePrimVars )
+			{
+				if ( std::find( primVarNames.begin(), primVarNames.end(), name ) != primVarNames.end() )
+				{
+					names.push_back( deltaEncodedName( name ) );
+				}
+			}
+
+			PrimitiveVariableMap variables = Primitive::loadPrimitiveVariables( m_indexedIO->subdirectory( objectEntry ).get(), sampleEntry(sample), names );
+			decodePrimitiveVariables( variables, sample );
+			return variables;
+		}
+
+		// Replaces any delta encoded variables with the values they encode, using
+		// the previous sample. See WriterImplementation::deltaEncode().
+		void decodePrimitiveVariables( PrimitiveVariableMap &variables, size_t sample ) const
+		{
+			ConstPrimitivePtr previous;
+			for ( const auto &name : g_deltaEncodablePrimVars )
+			{
+				PrimitiveVariableMap::iterator it = variables.find( deltaEncodedName( name ) );
+				if ( it == variables.end() )
+				{
+					continue;
+				}
+
+				if ( !previous )
+				{
+					if ( sample == 0 )
+					{
+						throw Exception( "Delta encoded primitive variable found in first object sample!" );
+					}
+					// this is usually already in the cache when reading the samples in order.
+					previous = runTimeCast< const Primitive >( readObjectAtSample( sample - 1 ) );
+					if ( !previous )
+					{
+						throw Exception( "Previous object sample is not a Primitive, can't decode primitive variable \"" + name.string() + "\"." );
+					}
+				}
+
+				PrimitiveVariableMap::const_iterator pIt = previous->variables.find( name );
+				DataPtr data = pIt != previous->variables.end() ? xorData( it->second.data.get(), pIt->second.data.get() ) : nullptr;
+				if ( !data )
+				{
+					throw Exception( "Can't decode primitive variable \"" + name.string() + "\" from previous object sample." );
+				}
+
+				variables[name] = PrimitiveVariable( it->second.interpolation, data, it->second.indices );
+				variables.erase( it );
+			}
 		}
 
 		PrimitiveVariableMap readObjectPrimitiveVariables( const std::vector<InternedString> &primVarNames, double time ) const
@@ -568,16 +680,15 @@ class SceneCache::ReaderImplementation : public SceneCache::Implementation
 
 			if ( x == 0 )
 			{
-				return readObjectPrimitiveVariablesAtSample(m_indexedIO, primVarNames, sample1);
+				return readObjectPrimitiveVariablesAtSample( primVarNames, sample1 );
 			}
 			if ( x == 1 )
 			{
-				return readObjectPrimitiveVariablesAtSample(m_indexedIO, primVarNames, sample2);
+				return readObjectPrimitiveVariablesAtSample( primVarNames, sample2 );
 			}
 
-			IndexedIOPtr objectIO = m_indexedIO->subdirectory( objectEntry );
-			PrimitiveVariableMap map1 = Primitive::loadPrimitiveVariables( objectIO.get(), sampleEntry(sample1), primVarNames );
-			PrimitiveVariableMap map2 = Primitive::loadPrimitiveVariables( objectIO.get(), sampleEntry(sample2), primVarNames );
+			PrimitiveVariableMap map1 = readObjectPrimitiveVariablesAtSample( primVarNames, sample1 );
+			PrimitiveVariableMap map2 = readObjectPrimitiveVariablesAtSample( primVarNames, sample2 );
 
 			for ( PrimitiveVariableMap::iterator it1 = map1.begin(); it1 != map1.end(); it1++ )
 			{
@@ -623,6 +734,58 @@ class SceneCache::ReaderImplementation : public SceneCache::Implementation
 			return location;
 		}
 
+		// Schedules the reads for SceneCache::prefetch() on the monitor.
+		void prefetch( const std::vector<Path> &paths, double time, int what, SceneInterface::PrefetchMonitor *monitor )
+		{
+			monitor->schedule( paths.size(), PrefetchTask( this, paths, time, what, monitor ) );
+		}
+
+		// Loads the samples either side of the given time into the caches in m_sharedData,
+		// along with the sample times and the directories they live in.
+		void prefetchSamples( double time, int what ) const
+		{
+			size_t s0, s1;
+			double x;
+
+			if ( what & SceneInterface::PrefetchBound )
+			{
+				// bounds are not cached, but reading them loads the sample times
+				// and the bound directory, and brings the data into memory.
+				x = boundSampleInterval( time, s0, s1 );
+				prefetchSample( x, s0, s1, &ReaderImplementation::readBoundAtSample );
+			}
+
+			if ( (what & SceneInterface::PrefetchTransform) && m_indexedIO->hasEntry( transformEntry ) )
+			{
+				x = transformSampleInterval( time, s0, s1 );
+				prefetchSample( x, s0, s1, &ReaderImplementation::readTransformAtSample );
+			}
+
+			if ( what & SceneInterface::PrefetchAttributes )
+			{
+				NameList attrs;
+				attributeNames( attrs );
+				for ( NameList::const_iterator it = attrs.begin(); it != attrs.end(); ++it )
+				{
+					x = attributeSampleInterval( *it, time, s0, s1 );
+					if ( x < 1 )
+					{
+						readAttributeAtSample( *it, s0 );
+					}
+					if ( x > 0 )
+					{
+						readAttributeAtSample( *it, s1 );
+					}
+				}
+			}
+
+			if ( (what & SceneInterface::PrefetchObject) && hasObject() )
+			{
+				x = objectSampleInterval( time, s0, s1 );
+				prefetchSample( x, s0, s1, &ReaderImplementation::readObjectAtSample );
+			}
+		}
+
 		void hash( HashType hashType, double time, MurmurHash &h, bool ignoreSceneHash = false ) const
 		{
 			size_t s0, s1;
@@ -781,7 +944,7 @@ class SceneCache::ReaderImplementation : public SceneCache::Implementation
 									if ( prim )
 									{
 										// we managed to load the object from a different time sample from the cache, just have to load the changing prim vars...
-										mergeMaps( prim->variables, readObjectPrimitiveVariablesAtSample( reader->m_indexedIO, varNames->readable(), sample ) );
+										mergeMaps( prim->variables, reader->readObjectPrimitiveVariablesAtSample( varNames->readable(), sample ) );
 										objectCache->set( currentKey, prim.get(), ObjectPool::StoreReference );
 										return prim;
 									}
@@ -841,6 +1004,79 @@ class SceneCache::ReaderImplementation : public SceneCache::Implementation
 
 		};
 
+		// Reads the samples needed to interpolate at x, discarding the results.
+		template<typename R>
+		void prefetchSample( double x, size_t floorIndex, size_t ceilIndex, R (ReaderImplementation::*readFn)( size_t ) const ) const
+		{
+			if ( x < 1 )
+			{
+				(this->*readFn)( floorIndex );
+			}
+			if ( x > 0 )
+			{
+				(this->*readFn)( ceilIndex );
+			}
+		}
+
+		class PrefetchLocations
+		{
+			public :
+
+				PrefetchLocations( ReaderImplementation *reader, const std::vector<Path> &paths, double time, int what, SceneInterface::PrefetchMonitor *monitor )
+					: m_reader( reader ), m_paths( paths ), m_time( time ), m_what( what ), m_monitor( monitor )
+				{
+				}
+
+				void operator()( const tbb::blocked_range<size_t> &r ) const
+				{
+					for ( size_t i = r.begin(); i != r.end(); ++i )
+					{
+						if ( !m_monitor->cancelled() )
+						{
+							SceneCache::ImplementationPtr location = m_reader->scene( m_paths[i], SceneInterface::NullIfMissing );
+							if ( location )
+							{
+								static_cast< ReaderImplementation * >( location.get() )->prefetchSamples( m_time, m_what );
+							}
+						}
+						m_monitor->locationCompleted();
+					}
+				}
+
+			private :
+
+				ReaderImplementation *m_reader;
+				const std::vector<Path> &m_paths;
+				double m_time;
+				int m_what;
+				SceneInterface::PrefetchMonitor *m_monitor;
+		};
+
+		class PrefetchTask
+		{
+			public :
+
+				// Keeps the reader, and therefore the whole file, alive until the reads are done.
+				// The monitor is not referenced, since its destructor waits for this task.
+				PrefetchTask( ReaderImplementation *reader, const std::vector<Path> &paths, double time, int what, SceneInterface::PrefetchMonitor *monitor )
+					: m_reader( reader ), m_paths( paths ), m_time( time ), m_what( what ), m_monitor( monitor )
+				{
+				}
+
+				void operator()() const
+				{
+					tbb::parallel_for( tbb::blocked_range<size_t>( 0, m_paths.size() ), PrefetchLocations( m_reader.get(), m_paths, m_time, m_what, m_monitor ) );
+				}
+
+			private :
+
+				ReaderImplementationPtr m_reader;
+				std::vector<Path> m_paths;
+				double m_time;
+				int m_what;
+				SceneInterface::PrefetchMonitor *m_monitor;
+		};
+
 		ReaderImplementationPtr m_parent;
 		mutable SharedData *m_sharedData;
 
@@ -979,7 +1215,12 @@ class SceneCache::ReaderImplementation : public SceneCache::Implementation
 		// static function used by the cache mechanism to actually load the object data from file.
 		static ObjectPtr doReadObjectAtSample( const SimpleCacheKey &key )
 		{
-			return Object::load( key.first->m_indexedIO->subdirectory( objectEntry ), sampleEntry(key.second) );
+			ObjectPtr object = Object::load( key.first->m_indexedIO->subdirectory( objectEntry ), sampleEntry(key.second) );
+			if ( Primitive *primitive = runTimeCast< Primitive >( object.get() ) )
+			{
+				key.first->decodePrimitiveVariables( primitive->variables, key.second );
+			}
+			return object;
 		}
 
 		static MurmurHash attributeHash( const AttributeCacheKey &key )
@@ -1036,20 +1277,26 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 		{
 			if ( m_parent )
 			{
-				// use same map from the root
-				m_sampleTimesMap = m_parent->m_sampleTimesMap;
+				// use same state from the root
+				m_sharedState = m_parent->m_sharedState;
 			}
 			else
 			{
-				// only the root instance allocate the map.
-				m_sampleTimesMap = new SampleTimesMap;
+				// only the root instance allocate the state.
+				m_sharedState = new SharedState;
+				// StreamIndexedIO supports writing different locations from different threads,
+				// other implementations might not.
+				m_sharedState->concurrent = runTimeCast< StreamIndexedIO >( io.get() ) != nullptr;
+				m_sharedState->deltaKeyframeInterval = g_defaultDeltaKeyframeInterval;
+				m_sharedState->saveFailed = false;
 			}
 		}
 
 		~WriterImplementation() override
 		{
-			// the root location destruction triggers the flush on the file.
-			if ( !m_parent )
+			// the root location destruction triggers the flush on the file,
+			// unless the caller has already done so explicitly.
+			if ( !m_parent && m_sharedState )
 			{
 				try
 				{
@@ -1135,7 +1382,7 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 			size_t sampleIndex = m_transformSampleTimes.size();
 			m_transformSampleTimes.push_back( time );
 			IndexedIOPtr io = m_indexedIO->subdirectory( transformEntry, IndexedIO::CreateIfMissing );
-			((const Object *)transform)->save( io, sampleEntry(sampleIndex) );
+			save( transform, io, sampleEntry(sampleIndex) );
 			m_transformSamples.push_back( transform );
 		}
 
@@ -1161,7 +1408,7 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 			sampleTimes.push_back( time );
 			IndexedIOPtr io = m_indexedIO->subdirectory( attributesEntry, IndexedIO::CreateIfMissing );
 			io = io->subdirectory( name, IndexedIO::CreateIfMissing );
-			attribute->save( io, sampleEntry(sampleIndex) );
+			save( attribute, io, sampleEntry(sampleIndex) );
 		}
 
 		void writeLocalTag( const char *tag )
@@ -1226,7 +1473,8 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 			size_t sampleIndex = m_objectSampleTimes.size();
 			m_objectSampleTimes.push_back( time );
 			IndexedIOPtr io = m_indexedIO->subdirectory( objectEntry, IndexedIO::CreateIfMissing );
-			object->save( io, sampleEntry(sampleIndex) );
+			ConstObjectPtr encodedObject = deltaEncode( object, sampleIndex );
+			save( encodedObject ? encodedObject.get() : object, io, sampleEntry(sampleIndex) );
 
 			const VisibleRenderable *renderable = runTimeCast< const VisibleRenderable >( object );
 			if ( renderable )
@@ -1304,6 +1552,9 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 				writable();
 			}
 
+			// sibling locations may be created from different threads
+			tbb::mutex::scoped_lock lock( m_childrenMutex );
+
 			std::map< SceneCache::Name, WriterImplementationPtr >::const_iterator it = m_children.find( name );
 			if ( it != m_children.end() )
 			{
@@ -1328,6 +1579,7 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 		SceneCache::ImplementationPtr createChild( const SceneCache::Name &name )
 		{
 			writable();
+			tbb::mutex::scoped_lock lock( m_childrenMutex );
 			IndexedIOPtr children = m_indexedIO->subdirectory( childrenEntry, IndexedIO::CreateIfMissing );
 			if ( children->hasEntry( name ) )
 			{
@@ -1339,6 +1591,35 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 			return result;
 		}
 
+		void setObjectDeltaEncoding( bool enabled, size_t keyframeInterval )
+		{
+			m_sharedState->deltaKeyframeInterval = enabled ? std::max( keyframeInterval, (size_t)1 ) : 0;
+		}
+
+		void setConcurrentWriting( bool enabled )
+		{
+			if ( enabled && !runTimeCast< StreamIndexedIO >( m_indexedIO.get() ) )
+			{
+				throw Exception( "Concurrent writing is only supported for StreamIndexedIO." );
+			}
+			m_sharedState->concurrent = enabled;
+		}
+
+		// Flushes the file on behalf of the caller, so that errors are thrown
+		// rather than reported by the destructor.
+		void close()
+		{
+			if ( m_parent )
+			{
+				throw Exception( "Only the root location can be flushed." );
+			}
+			if ( !m_sharedState )
+			{
+				throw Exception( "This scene has already been flushed to disk." );
+			}
+			flush();
+		}
+
 		static WriterImplementation *writer( Implementation *impl, bool throwException = true )
 		{
 			WriterImplementation *writer = dynamic_cast< WriterImplementation* >( impl );
@@ -1366,24 +1647,37 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 
 		void writable() const
 		{
-			if ( !m_sampleTimesMap )
+			if ( !m_sharedState )
 			{
 				throw Exception( "This scene has already been flushed to disk. You can't make further changes to it." );
 			}
+			if ( m_sharedState->saveFailed )
+			{
+				throwSaveError();
+			}
+		}
+
+		// Throws the first error raised by the samples saved in the background.
+		void throwSaveError() const
+		{
+			tbb::mutex::scoped_lock lock( m_sharedState->saveErrorMutex );
+			throw Exception( "Error saving in the background : " + m_sharedState->saveError );
 		}
 
 		// Function to store intelligently the given sample times in the file location.
 		// It actually saves the index there, and stores the unique sample times in a global shared location.
 		void storeSampleTimes( const SampleTimes &sampleTimes, IndexedIOPtr location )
 		{
-			assert( m_sampleTimesMap );
+			assert( m_sharedState );
 			uint64_t sampleTimesIndex = 	0;
 			IndexedIO::EntryID samplesEntry;
-			std::pair< SampleTimesMap::iterator, bool > it = m_sampleTimesMap->insert( std::pair< SampleTimes, uint64_t >( sampleTimes, 0 ) );
+			tbb::mutex::scoped_lock lock( m_sharedState->sampleTimesMutex );
+			SampleTimesMap &sampleTimesMap = m_sharedState->sampleTimesMap;
+			std::pair< SampleTimesMap::iterator, bool > it = sampleTimesMap.insert( std::pair< SampleTimes, uint64_t >( sampleTimes, 0 ) );
 			if ( it.second )
 			{
 				// Unique Id for the sampleTimes (incremental integer)
-				sampleTimesIndex = m_sampleTimesMap->size() - 1;
+				sampleTimesIndex = sampleTimesMap.size() - 1;
 				// store the uniqueId in the global map
 				it.first->second = sampleTimesIndex;
 				// find the global location for the sample times from the root Scene.
@@ -1398,6 +1692,7 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 				sampleTimesIndex = it.first->second;
 				samplesEntry = sampleEntry(sampleTimesIndex);
 			}
+			lock.release();
 			location->createSubdirectory( sampleTimesEntry )->createSubdirectory( samplesEntry );
 		}
 
@@ -1516,14 +1811,18 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 		}
 
 		// Called from the destructor of the root location.
-		// It triggers flush recursivelly on all the child locations.
-		// It also sets m_sampleTimesMap to NULL which prevents further modification on this and all child scene interface objects through their call to writable().
+		// It triggers flush recursivelly on all the child locations, flushing siblings in parallel.
+		// It also sets m_sharedState to NULL which prevents further modification on this and all child scene interface objects through their call to writable().
 		// Responsible for writing missing data such as all the sample
 		// times from object,transform,attributes and bounds. And also computes the
 		// animated bounding boxes in case they were not explicitly writen.
 		//
 		void flush()
 		{
+			// if anything fails, the root must still wait for the background
+			// saves and release the shared state before the error propagates.
+			SharedStateGuard sharedStateGuard( m_parent ? nullptr : this );
+
 			if ( m_parent )
 			{
 				NameList tags;
@@ -1532,9 +1831,22 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 				writeTags( tags, SceneInterface::AncestorTag );
 			}
 			/// first call flush recursively on children...
+			std::vector< WriterImplementation * > children;
+			children.reserve( m_children.size() );
 			for ( std::map< SceneCache::Name, WriterImplementationPtr >::const_iterator cit = m_children.begin(); cit != m_children.end(); cit++ )
 			{
-				cit->second->flush();
+				children.push_back( cit->second.get() );
+			}
+			if ( m_sharedState->concurrent && children.size() > 1 )
+			{
+				tbb::parallel_for( tbb::blocked_range<size_t>( 0, children.size() ), FlushChildren( children ) );
+			}
+			else
+			{
+				for ( std::vector< WriterImplementation * >::const_iterator cit = children.begin(); cit != children.end(); cit++ )
+				{
+					(*cit)->flush();
+				}
 			}
 
 			IndexedIOPtr io;
@@ -1765,20 +2077,209 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 			// deallocate children since we now computed everything from them anyways...
 			m_children.clear();
 
-			if ( !m_parent && m_sampleTimesMap )
+			if ( !m_parent && m_sharedState )
 			{
 				// we are at the root...
-				// deallocate samples map stored in the root object.
-				delete m_sampleTimesMap;
+				// wait for all the samples being saved in the background, and report the first of their errors.
+				m_sharedState->saveTasks.wait();
+				if ( m_sharedState->saveFailed )
+				{
+					throwSaveError();
+				}
+				// deallocate state stored in the root object.
+				delete m_sharedState;
 				// and make sure the cache does not contain this file, forcing it to reload it.
 				if ( m_indexedIO->typeId() == FileIndexedIOTypeId )
 				{
 					SharedSceneInterfaces::erase( static_cast< FileIndexedIO * >( m_indexedIO.get() )->fileName() );
 				}
 			}
-			m_sampleTimesMap = nullptr;
+			m_sharedState = nullptr;
+		}
+
+		// When delta encoding is enabled, returns a copy of the object with the encodable primitive
+		// variables replaced by their XOR with the same variables in the previous sample. For smooth
+		// animation most of the resulting bits are zero, which compresses very well. Returns null if
+		// nothing was encoded. Every deltaKeyframeInterval samples are stored in full, to limit the
+		// number of samples needed to decode a sample read out of order.
+		ConstObjectPtr deltaEncode( const Object *object, size_t sampleIndex )
+		{
+			ConstPrimitivePtr previous = m_previousObjectSample;
+			m_previousObjectSample = nullptr;
+
+			const Primitive *primitive = runTimeCast< const Primitive >( object );
+			if ( !primitive || !m_sharedState->deltaKeyframeInterval )
+			{
+				return nullptr;
+			}
+
+			// the copy is cheap, and protects against the caller modifying the object after writing it.
+			m_previousObjectSample = primitive->copy();
+			if ( !previous || sampleIndex % m_sharedState->deltaKeyframeInterval == 0 )
+			{
+				return nullptr;
+			}
+
+			PrimitivePtr result = nullptr;
+			for ( const auto &name : g_deltaEncodablePrimVars )
+			{
+				PrimitiveVariableMap::const_iterator it = primitive->variables.find( name );
+				PrimitiveVariableMap::const_iterator pIt = previous->variables.find( name );
+				if ( it == primitive->variables.end() || pIt == previous->variables.end() )
+				{
+					continue;
+				}
+
+				DataPtr delta = xorData( it->second.data.get(), pIt->second.data.get() );
+				if ( !delta )
+				{
+					continue;
+				}
+
+				if ( !result )
+				{
+					result = primitive->copy();
+				}
+				result->variables.erase( name );
+				result->variables[deltaEncodedName( name )] = PrimitiveVariable( it->second.interpolation, delta, it->second.indices );
+			}
+
+			return result;
+		}
+
+		// Saves the object in the given location. When the file supports it, the object is encoded,
+		// compressed and written on a worker thread, while the caller carries on with other samples and locations.
+		void save( const Object *object, IndexedIOPtr io, const IndexedIO::EntryID &entry )
+		{
+			if ( !m_sharedState->concurrent )
+			{
+				object->save( io, entry );
+				return;
+			}
+			// The copy is cheap since the data is shared with the original until someone modifies it,
+			// and it guarantees that we save the object as it was at the time of the call.
+			m_sharedState->saveTasks.run( SaveTask( m_sharedState, object->copy(), io, entry ) );
+		}
+
+		struct SharedState;
+
+		// Errors are recorded in the shared state rather than left to the task_group,
+		// so that they can be reported by the next write instead of only by the flush.
+		class SaveTask
+		{
+			public :
+
+				SaveTask( SharedState *sharedState, ConstObjectPtr object, IndexedIOPtr io, const IndexedIO::EntryID &entry ) : m_sharedState( sharedState ), m_object( object ), m_io( io ), m_entry( entry )
+				{
+				}
+
+				void operator()() const
+				{
+					if ( m_sharedState->saveFailed )
+					{
+						// the file is unusable already, so don't bother.
+						return;
+					}
+
+					try
+					{
+						m_object->save( m_io, m_entry );
+					}
+					catch ( std::exception &e )
+					{
+						saveFailed( e.what() );
+					}
+					catch ( ... )
+					{
+						saveFailed( "Unknown error" );
+					}
+				}
+
+			private :
+
+				void saveFailed( const std::string &error ) const
+				{
+					tbb::mutex::scoped_lock lock( m_sharedState->saveErrorMutex );
+					if ( !m_sharedState->saveFailed )
+					{
+						m_sharedState->saveError = error;
+						m_sharedState->saveFailed = true;
+					}
+				}
+
+				SharedState *m_sharedState;
+				ConstObjectPtr m_object;
+				IndexedIOPtr m_io;
+				IndexedIO::EntryID m_entry;
+		};
+
+		// Used by the root location to clean up after a failed flush.
+		class SharedStateGuard
+		{
+			public :
+
+				SharedStateGuard( WriterImplementation *root ) : m_root( root )
+				{
+				}
+
+				~SharedStateGuard()
+				{
+					if ( !m_root || !m_root->m_sharedState )
+					{
+						// not the root, or the flush completed
+						return;
+					}
+
+					SharedState *sharedState = m_root->m_sharedState;
+					try
+					{
+						sharedState->saveTasks.wait();
+					}
+					catch ( ... )
+					{
+						// the exception which interrupted the flush takes precedence
+					}
+					m_root->releaseSharedState();
+					delete sharedState;
+				}
+
+			private :
+
+				WriterImplementation *m_root;
+		};
+
+		// Prevents further writes to this location and all the descendants which
+		// have not been flushed, after a flush was interrupted by an exception.
+		void releaseSharedState()
+		{
+			for ( std::map< SceneCache::Name, WriterImplementationPtr >::const_iterator cit = m_children.begin(); cit != m_children.end(); cit++ )
+			{
+				cit->second->releaseSharedState();
+			}
+			m_sharedState = nullptr;
 		}
 
+		class FlushChildren
+		{
+			public :
+
+				FlushChildren( const std::vector< WriterImplementation * > &children ) : m_children( children )
+				{
+				}
+
+				void operator()( const tbb::blocked_range<size_t> &r ) const
+				{
+					for ( size_t i = r.begin(); i != r.end(); ++i )
+					{
+						m_children[i]->flush();
+					}
+				}
+
+			private :
+
+				const std::vector< WriterImplementation * > &m_children;
+		};
+
 		/// This functions transforms the bounding boxes with the animated transforms and also scales the bounding boxes in a way that it
 		/// guarantees that the original bounding boxes transformed at any time (which would trace curved trajectories in space),
 		/// would always be fully included in the linear interpolation of the resulting transformed bounding boxes.
@@ -1907,11 +2408,30 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 
 		WriterImplementation* m_parent;
 		std::map< SceneCache::Name, WriterImplementationPtr > m_children;
+		tbb::mutex m_childrenMutex;
 
 		typedef std::map< SampleTimes, uint64_t > SampleTimesMap;
 		typedef std::map< SceneCache::Name, SampleTimes > AttributeSamplesMap;
 
-		SampleTimesMap *m_sampleTimesMap;
+		// State shared by all the locations in the file, owned by the root location.
+		struct SharedState
+		{
+			SampleTimesMap sampleTimesMap;
+			tbb::mutex sampleTimesMutex;
+			// samples being saved in the background
+			tbb::task_group saveTasks;
+			// the first error raised by the samples saved in the background,
+			// reported by the next write to any location, or by the flush.
+			tbb::mutex saveErrorMutex;
+			std::string saveError;
+			tbb::atomic<bool> saveFailed;
+			// whether or not the IndexedIO supports writing from multiple threads
+			bool concurrent;
+			// every nth object sample is stored in full, the rest delta encoded. 0 disables delta encoding.
+			size_t deltaKeyframeInterval;
+		};
+
+		SharedState *m_sharedState;
 		SampleTimes m_boundSampleTimes;		// implicit or explicit bound sample times
 		SampleTimes m_transformSampleTimes;
 		AttributeSamplesMap m_attributeSampleTimes;
@@ -1928,6 +2448,9 @@ class SceneCache::WriterImplementation : public SceneCache::Implementation
 
 		AnimatedHashTest m_animatedObjectTopology;
 		AnimatedPrimVarMap m_animatedObjectPrimVars;
+
+		// the last object sample written, used for delta encoding.
+		ConstPrimitivePtr m_previousObjectSample;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -2211,6 +2734,29 @@ void SceneCache::writeObject( const Object *object, double time )
 	writer->writeObject( object, time );
 }
 
+void SceneCache::setObjectDeltaEncoding( bool enabled, size_t keyframeInterval )
+{
+	WriterImplementation *writer = WriterImplementation::writer( m_implementation.get() );
+	writer->setObjectDeltaEncoding( enabled, keyframeInterval );
+}
+
+void SceneCache::setConcurrentWriting( bool enabled )
+{
+	WriterImplementation *writer = WriterImplementation::writer( m_implementation.get() );
+	writer->setConcurrentWriting( enabled );
+}
+
+void SceneCache::flush()
+{
+	WriterImplementation *writer = WriterImplementation::writer( m_implementation.get() );
+	writer->close();
+}
+
+void SceneCache::setDefaultObjectDeltaEncoding( bool enabled, size_t keyframeInterval )
+{
+	g_defaultDeltaKeyframeInterval = enabled ? std::max( keyframeInterval, (size_t)1 ) : 0;
+}
+
 void SceneCache::childNames( NameList &childNames ) const
 {
 	return m_implementation->childNames(childNames);
@@ -2294,6 +2840,14 @@ void SceneCache::hash( HashType hashType, double time, MurmurHash &h ) const
 	reader->hash( hashType, time, h );
 }
 
+SceneInterface::PrefetchMonitorPtr SceneCache::prefetch( const std::vector<Path> &paths, double time, int what, PrefetchMonitor *monitor ) const
+{
+	ReaderImplementation *reader = ReaderImplementation::reader( m_implementation.get() );
+	PrefetchMonitorPtr result = monitor ? monitor : new PrefetchMonitor;
+	reader->prefetch( paths, time, what, result.get() );
+	return result;
+}
+
 SceneCachePtr SceneCache::duplicate( ImplementationPtr& impl ) const
 {
 	return new SceneCache( impl );
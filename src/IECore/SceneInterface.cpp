@@ -129,6 +129,72 @@ void SceneInterface::hash( HashType hashType, double time, MurmurHash &h ) const
 	h.append( typeId() );
 }
 
+SceneInterface::PrefetchMonitorPtr SceneInterface::prefetch( const std::vector<Path> &paths, double time, int what, PrefetchMonitor *monitor ) const
+{
+	return monitor ? monitor : new PrefetchMonitor;
+}
+
+SceneInterface::PrefetchMonitor::PrefetchMonitor()
+	:	m_tasks( new tbb::task_group )
+{
+	m_numScheduled = 0;
+	m_numCompleted = 0;
+	m_cancelled = false;
+}
+
+SceneInterface::PrefetchMonitor::~PrefetchMonitor()
+{
+	cancel();
+	try
+	{
+		m_tasks->wait();
+	}
+	catch( ... )
+	{
+		// nobody is left to report errors to.
+	}
+	delete m_tasks;
+}
+
+void SceneInterface::PrefetchMonitor::cancel()
+{
+	m_cancelled = true;
+}
+
+bool SceneInterface::PrefetchMonitor::cancelled() const
+{
+	return m_cancelled;
+}
+
+void SceneInterface::PrefetchMonitor::wait()
+{
+	m_tasks->wait();
+}
+
+size_t SceneInterface::PrefetchMonitor::numCompleted() const
+{
+	return m_numCompleted;
+}
+
+size_t SceneInterface::PrefetchMonitor::numScheduled() const
+{
+	return m_numScheduled;
+}
+
+void SceneInterface::PrefetchMonitor::locationCompleted()
+{
+	size_t numCompleted = ++m_numCompleted;
+	if( !m_cancelled )
+	{
+		// once cancelled, the monitor may be in the middle of being destroyed.
+		progress( numCompleted, m_numScheduled );
+	}
+}
+
+void SceneInterface::PrefetchMonitor::progress( size_t numCompleted, size_t numScheduled )
+{
+}
+
 void SceneInterface::pathToString( const SceneInterface::Path &p, std::string &path )
 {
 	if ( !p.size() )
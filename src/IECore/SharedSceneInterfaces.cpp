@@ -33,6 +33,7 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "IECore/LRUCache.h"
+#include "IECore/CacheRegistry.h"
 #include "IECore/SharedSceneInterfaces.h"
 
 using namespace IECore;
@@ -46,6 +47,14 @@ namespace
 
 typedef IECore::LRUCache< std::string, IECore::ConstSceneInterfacePtr > SceneLRUCache;
 
+// The memory held by a SceneInterface can't be measured, so
+// the cache is registered for statistics only.
+CacheRegistry::Client &registryClient()
+{
+	static CacheRegistry::Client *client = new CacheRegistry::Client( "SharedSceneInterfaces" );
+	return *client;
+}
+
 class Cache : public SceneLRUCache
 {
 	public :
@@ -59,6 +68,7 @@ class Cache : public SceneLRUCache
 
 		static SceneInterfacePtr fileCacheGetter( const std::string &fileName, size_t &cost )
 		{
+			registryClient().recordMiss();
 			SceneInterfacePtr result = SceneInterface::create( fileName, IECore::IndexedIO::Read );
 			cost = 1;
 			return result;
@@ -79,6 +89,7 @@ Cache &cache()
 
 ConstSceneInterfacePtr SharedSceneInterfaces::get( const std::string &fileName )
 {
+	registryClient().recordLookup();
 	return cache().get( fileName );
 }
 
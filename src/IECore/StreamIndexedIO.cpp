@@ -38,8 +38,10 @@
 #include <list>
 #include <iostream>
 #include <cassert>
+#include <cstring>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "boost/tokenizer.hpp"
 #include "boost/optional.hpp"
@@ -49,8 +51,14 @@
 #include "boost/iostreams/filtering_stream.hpp"
 #include "boost/iostreams/stream.hpp"
 #include "boost/iostreams/filter/gzip.hpp"
+#include "boost/iostreams/filter/zlib.hpp"
+#include "tbb/atomic.h"
+#include "tbb/mutex.h"
+#include "tbb/spin_mutex.h"
 #include "tbb/spin_rw_mutex.h"
 
+#include "zlib.h"
+
 #include "IECore/ByteOrder.h"
 #include "IECore/MemoryStream.h"
 #include "IECore/MessageHandler.h"
@@ -60,6 +68,7 @@
 
 #define HARDLINK				127
 #define SUBINDEX_DIR			126
+#define COMPRESSED_DATA			125
 
 static const Imf::Int64 g_unversionedMagicNumber = 0x0B00B1E5;
 static const Imf::Int64 g_versionedMagicNumber = 0xB00B1E50;
@@ -69,17 +78,30 @@ static const Imf::Int64 g_versionedMagicNumber = 0xB00B1E50;
 /// Version 5: introduced subindex as zipped data blocks (to reduce size of the main index).
 ///            Hard links are represented as regular data nodes, that points to same data on file (no removal of data ever).
 ///            Removed the linkCount field on the data nodes.
+/// Version 6: introduced a choice of codec for the index and subindex, and optionally compressed data blocks.
+///            Files which don't use either feature are still written as version 5.
 /// \todo Store SubIndexSize and NodeCount as unsigned 64bit integers
-static const Imf::Int64 g_currentVersion = 5;
+static const Imf::Int64 g_currentVersion = 6;
+static const Imf::Int64 g_compatibleVersion = 5;
 
 /// FileFormat ::= Data Index IndexOffset Version MagicNumber
 /// Data ::= DataEntry*
-/// Index ::= zip(StringCache NodeTree FreePages)
+/// Index ::= zip(StringCache NodeTree FreePages) ( Version <= 5 )
+///           IndexCodec DataCodec DataLevel DataShuffle codec(StringCache NodeTree FreePages) ( Version >= 6 )
+/// IndexCodec ::= uint8 ( value from StreamIndexedIO::Compression, also used for all the subindices in the file )
+/// DataCodec ::= uint8 ( the data compression last used to write the file, restored when appending to it )
+/// DataLevel ::= int8
+/// DataShuffle ::= uint8 ( 0 or 1 )
 
 /// DataEntry ::= Stores data from nodes:
 ///                [Data nodes] binary data indexed by DataOffset/DataSize and
-///                [Subindex]   SubIndexSize zip(NodeCount NodeTree*) indexed by SubIndexOffset.
+///                [Compressed data nodes] CompressedData indexed by DataOffset/DataSize and
+///                [Subindex]   SubIndexSize zip(NodeCount NodeTree*) indexed by SubIndexOffset ( codec(NodeCount NodeTree*) for Version >= 6 ).
 /// SubIndexSize :: = uint32 - number of bytes in the zipped subindex that follows
+/// CompressedData ::= DataCodec ShuffleSize UncompressedSize codec(shuffle(data))
+/// DataCodec ::= uint8 ( value from StreamIndexedIO::Compression )
+/// ShuffleSize ::= uint8 ( the size of the elements whose bytes were grouped by significance, or 1 if not shuffled )
+/// UncompressedSize ::= uint64
 
 /// StringCache ::= NumStrings String*
 /// NumStrings ::= int64
@@ -88,7 +110,7 @@ static const Imf::Int64 g_currentVersion = 5;
 
 /// NodeTree Node* ( A Directory node followed by it's child nodes )
 /// Node ::= EntryType EntryStringCacheID NodeCount ( if EntryType == Directory )
-///          EntryType EntryStringCacheID DataType ArrayLength DataOffset DataSize ( if EntryType == File )
+///          EntryType EntryStringCacheID DataType ArrayLength DataOffset DataSize ( if EntryType == File or EntryType == COMPRESSED_DATA )
 ///			 EntryType EntryStringCacheID SubIndexOffset ( If EntryType == SUBINDEX_DIR )
 /// EntryType ::= char ( value from IndexedIO::EntryType )
 /// EntryStringCacheID ::= int64 ( index in StringCache )
@@ -140,6 +162,199 @@ void readLittleEndian( F &f, T &n )
 	}
 }
 
+//// Compression utilities //////
+
+namespace
+{
+
+/// Size of DataCodec, ShuffleSize and UncompressedSize in front of compressed data blocks
+const size_t g_compressedDataHeaderSize = 2 + sizeof( uint64_t );
+
+/// Data blocks smaller than this are never compressed, as the savings wouldn't justify
+/// the cost of decompression.
+const size_t g_minCompressedDataSize = 256;
+
+struct CompressionSettings
+{
+	StreamIndexedIO::Compression dataCompression;
+	int dataLevel;
+	bool shuffle;
+	StreamIndexedIO::Compression indexCompression;
+};
+
+/// The settings are copied as a whole under a lock, so that files opened while the defaults
+/// are being changed from another thread never see a mixture of the old and new settings.
+CompressionSettings &defaultCompressionSettings()
+{
+	static CompressionSettings s = { StreamIndexedIO::Uncompressed, -1, true, StreamIndexedIO::Gzip };
+	return s;
+}
+
+tbb::spin_mutex &defaultCompressionSettingsMutex()
+{
+	static tbb::spin_mutex m;
+	return m;
+}
+
+/// Returns the size of the elements of the given type for the purposes of byte shuffling,
+/// or 1 if the data shouldn't be shuffled.
+size_t shuffleSize( IndexedIO::DataType dataType )
+{
+	switch( dataType )
+	{
+		case IndexedIO::HalfArray :
+		case IndexedIO::ShortArray :
+		case IndexedIO::UShortArray :
+			return 2;
+		case IndexedIO::FloatArray :
+		case IndexedIO::IntArray :
+		case IndexedIO::UIntArray :
+			return 4;
+		case IndexedIO::DoubleArray :
+		case IndexedIO::Int64Array :
+		case IndexedIO::UInt64Array :
+		case IndexedIO::InternedStringArray :
+			return 8;
+		default :
+			return 1;
+	}
+}
+
+template<size_t N>
+void shuffle( const char *src, char *dst, size_t numElements )
+{
+	for( size_t b = 0; b < N; ++b )
+	{
+		const char *s = src + b;
+		char *d = dst + b * numElements;
+		for( size_t i = 0; i < numElements; ++i, s += N )
+		{
+			d[i] = *s;
+		}
+	}
+}
+
+template<size_t N>
+void unshuffle( const char *src, char *dst, size_t numElements )
+{
+	for( size_t b = 0; b < N; ++b )
+	{
+		const char *s = src + b * numElements;
+		char *d = dst + b;
+		for( size_t i = 0; i < numElements; ++i, d += N )
+		{
+			*d = s[i];
+		}
+	}
+}
+
+/// Groups the bytes of each element by significance, so that the slowly varying high bytes
+/// of similar numbers end up next to each other. Trailing bytes are copied verbatim.
+void shuffle( const char *src, char *dst, size_t size, size_t elementSize, bool reverse )
+{
+	const size_t numElements = size / elementSize;
+	switch( elementSize )
+	{
+		case 2 :
+			reverse ? unshuffle<2>( src, dst, numElements ) : shuffle<2>( src, dst, numElements );
+			break;
+		case 4 :
+			reverse ? unshuffle<4>( src, dst, numElements ) : shuffle<4>( src, dst, numElements );
+			break;
+		case 8 :
+			reverse ? unshuffle<8>( src, dst, numElements ) : shuffle<8>( src, dst, numElements );
+			break;
+		default :
+			throw IOException( "StreamIndexedIO: Invalid shuffle size!" );
+	}
+	const size_t tail = numElements * elementSize;
+	memcpy( dst + tail, src + tail, size - tail );
+}
+
+/// Decompresses a CompressedData block into buffer, which must be exactly as big as the uncompressed data.
+void decompressData( const char *block, size_t blockSize, char *buffer, size_t size )
+{
+	if ( blockSize < g_compressedDataHeaderSize )
+	{
+		throw IOException( "StreamIndexedIO: Invalid compressed data block!" );
+	}
+
+	const StreamIndexedIO::Compression codec = (StreamIndexedIO::Compression)block[0];
+	const size_t elementSize = (unsigned char)block[1];
+	if ( codec != StreamIndexedIO::Deflate )
+	{
+		throw IOException( "StreamIndexedIO: Unsupported data compression!" );
+	}
+
+	char *dst = buffer;
+	std::vector<char> shuffled;
+	if ( elementSize > 1 )
+	{
+		shuffled.resize( size );
+		dst = shuffled.data();
+	}
+
+	uLongf uncompressedSize = size;
+	int status = uncompress( (Bytef *)dst, &uncompressedSize, (const Bytef *)( block + g_compressedDataHeaderSize ), blockSize - g_compressedDataHeaderSize );
+	if ( status != Z_OK || uncompressedSize != size )
+	{
+		throw IOException( "StreamIndexedIO: Failed to decompress data!" );
+	}
+
+	if ( elementSize > 1 )
+	{
+		shuffle( dst, buffer, size, elementSize, true );
+	}
+}
+
+/// Returns the size of the data stored in a CompressedData block.
+size_t uncompressedDataSize( const char *block, size_t blockSize )
+{
+	if ( blockSize < g_compressedDataHeaderSize )
+	{
+		throw IOException( "StreamIndexedIO: Invalid compressed data block!" );
+	}
+	uint64_t size;
+	memcpy( &size, block + 2, sizeof( size ) );
+	return asLittleEndian<>( size );
+}
+
+void pushCompressor( io::filtering_ostream &stream, StreamIndexedIO::Compression compression )
+{
+	switch( compression )
+	{
+		case StreamIndexedIO::Uncompressed :
+			break;
+		case StreamIndexedIO::Gzip :
+			stream.push( io::gzip_compressor() );
+			break;
+		case StreamIndexedIO::Deflate :
+			stream.push( io::zlib_compressor( io::zlib::best_speed ) );
+			break;
+		default :
+			throw IOException( "StreamIndexedIO: Unsupported index compression!" );
+	}
+}
+
+void pushDecompressor( io::filtering_istream &stream, StreamIndexedIO::Compression compression )
+{
+	switch( compression )
+	{
+		case StreamIndexedIO::Uncompressed :
+			break;
+		case StreamIndexedIO::Gzip :
+			stream.push( io::gzip_decompressor() );
+			break;
+		case StreamIndexedIO::Deflate :
+			stream.push( io::zlib_decompressor() );
+			break;
+		default :
+			throw IOException( "StreamIndexedIO: Unsupported index compression!" );
+	}
+}
+
+} // namespace
+
 class StreamIndexedIO::StringCache
 {
 	public:
@@ -305,7 +520,8 @@ class NodeBase
 			SmallData,
 			Data,
 			Directory,
-			SubIndex
+			SubIndex,
+			CompressedData
 		} NodeType;
 
 		NodeBase( NodeType type, IndexedIO::EntryID name ) : m_name(name), m_nodeType(type) {}
@@ -370,6 +586,11 @@ class SmallDataNode : public NodeBase
 			return m_offset;
 		}
 
+		inline bool compressed()
+		{
+			return false;
+		}
+
 	protected :
 
 		/// data fields from IndexedIO::Entry
@@ -387,14 +608,15 @@ class SmallDataNode : public NodeBase
 };
 
 /// Class that represents Data nodes
+/// Compressed data blocks are always represented by this class, using the CompressedData node type.
 class DataNode : public NodeBase
 {
 	public :
 		static const size_t maxArrayLength = UINT64_MAX;
 		static const size_t maxSize = UINT64_MAX;
 
-		DataNode( IndexedIO::EntryID name, IndexedIO::DataType dataType, Imf::Int64 arrayLength, Imf::Int64 size, Imf::Int64 offset ) :
-			NodeBase(NodeBase::Data, name), m_dataType(dataType), m_arrayLength(arrayLength), m_size(size), m_offset(offset) {}
+		DataNode( IndexedIO::EntryID name, IndexedIO::DataType dataType, Imf::Int64 arrayLength, Imf::Int64 size, Imf::Int64 offset, bool compressed = false ) :
+			NodeBase(compressed ? NodeBase::CompressedData : NodeBase::Data, name), m_dataType(dataType), m_arrayLength(arrayLength), m_size(size), m_offset(offset) {}
 
 		inline IndexedIO::DataType dataType()
 		{
@@ -416,6 +638,11 @@ class DataNode : public NodeBase
 			return m_offset;
 		}
 
+		inline bool compressed()
+		{
+			return nodeType() == NodeBase::CompressedData;
+		}
+
 		void copyFrom( DataNode *other )
 		{
 			m_dataType = other->m_dataType;
@@ -440,21 +667,52 @@ class DataNode : public NodeBase
 
 };
 
+class DirectoryNode;
+
 /// A compressed subindex node
+/// The contents are loaded on first access into a DirectoryNode which is owned by this node.
+/// The node is never replaced in its parent's children, so loading doesn't modify the parent
+/// and lookups from other threads don't need to lock it.
 class SubIndexNode : public NodeBase
 {
 	public :
-		SubIndexNode(IndexedIO::EntryID name, Imf::Int64 offset) : NodeBase(NodeBase::SubIndex, name), m_offset(offset) {}
+		typedef tbb::spin_mutex LoadMutex;
+
+		SubIndexNode(IndexedIO::EntryID name, Imf::Int64 offset) : NodeBase(NodeBase::SubIndex, name), m_offset(offset)
+		{
+			m_directory = nullptr;
+		}
 
 		inline Imf::Int64 offset()
 		{
 			return m_offset;
 		}
 
+		/// Returns the directory loaded from the subindex, or NULL if it hasn't been loaded yet.
+		inline DirectoryNode *directory()
+		{
+			return m_directory;
+		}
+
+		/// Publishes the loaded directory. Must only be called once, with loadMutex() held.
+		inline void setDirectory( DirectoryNode *directory )
+		{
+			m_directory = directory;
+		}
+
+		/// Serialises the loading of the subindex, so it happens only once.
+		inline LoadMutex &loadMutex()
+		{
+			return m_loadMutex;
+		}
+
 	protected :
 		/// The offset in the file to this node's subindex block if m_subindex is not NoSubIndex.
 		const Imf::Int64 m_offset;
 
+		tbb::atomic<DirectoryNode *> m_directory;
+		LoadMutex m_loadMutex;
+
 };
 
 /// A directory node within an index
@@ -473,10 +731,10 @@ class DirectoryNode : public NodeBase
 		typedef std::vector< NodeBase* > ChildMap;
 
 		// regular constructor
-		DirectoryNode(IndexedIO::EntryID name) : NodeBase(NodeBase::Directory, name), m_subindex(NoSubIndex), m_sortedChildren(false), m_subindexChildren(false), m_offset(0), m_parent(nullptr) {}
+		DirectoryNode(IndexedIO::EntryID name) : NodeBase(NodeBase::Directory, name), m_subindex(NoSubIndex), m_sortedChildren(false), m_offset(0), m_parent(nullptr) {}
 
 		// constructor used when building a directory based on an existing SubIndexNode (because we want to load the contents soon).
-		DirectoryNode( SubIndexNode *subindex, DirectoryNode *parent ) : NodeBase(NodeBase::Directory, subindex->name()), m_subindex(SavedSubIndex), m_sortedChildren(false), m_subindexChildren(false), m_offset(subindex->offset()), m_parent(parent) {}
+		DirectoryNode( SubIndexNode *subindex, DirectoryNode *parent ) : NodeBase(NodeBase::Directory, subindex->name()), m_subindex(SavedSubIndex), m_sortedChildren(false), m_offset(subindex->offset()), m_parent(parent) {}
 
 		// returns what's the state of this directory, whether it's contents are in a subindex and whether they have been loaded or not.
 		inline SubIndexMode subindex()
@@ -484,11 +742,6 @@ class DirectoryNode : public NodeBase
 			return static_cast<SubIndexMode>(m_subindex);
 		}
 
-		inline bool subindexChildren() const
-		{
-			return m_subindexChildren;
-		}
-
 		inline Imf::Int64 offset() const
 		{
 			return m_offset;
@@ -548,7 +801,6 @@ class DirectoryNode : public NodeBase
 
 		char m_subindex;	// using char instead of enum to compact members in one word
 		bool m_sortedChildren; // same as above
-		bool m_subindexChildren;	// true if one or more children are subindex. Helps avoiding the mutex...
 
 		/// The offset in the file to this node's subindex block if m_subindex is not NoSubIndex.
 		Imf::Int64 m_offset;
@@ -579,10 +831,10 @@ class StreamIndexedIO::Node
 		// Returns the named child directory node or NULL if not existent. Loads the subindex for the child nodes (if applicable).
 		DirectoryNode* directoryChild( const IndexedIO::EntryID &name ) const;
 		/// returns information about the Data node
-		inline bool dataChildInfo( const IndexedIO::EntryID &name, size_t &offset, size_t &size ) const;
+		inline bool dataChildInfo( const IndexedIO::EntryID &name, size_t &offset, size_t &size, bool &compressed ) const;
 
 		DirectoryNode* addChild( const IndexedIO::EntryID & childName );
-		void addDataChild( const IndexedIO::EntryID & childName, IndexedIO::DataType dataType, size_t arrayLen, size_t offset, size_t size );
+		void addDataChild( const IndexedIO::EntryID & childName, IndexedIO::DataType dataType, size_t arrayLen, size_t offset, size_t size, bool compressed = false );
 
 		void removeChild( const IndexedIO::EntryID &childName, bool throwException = true );
 
@@ -621,9 +873,30 @@ class StreamIndexedIO::Index : public RefCounted
 		/// flushes index to the file
 		void flush();
 
-		/// Returns the offset after saving the data to file or the offset for a previouly saved data (with matching hash)
-		/// \param prefixSize If true than it will prepend to the block, the size of it
-		Imf::Int64 writeUniqueData( const char *data, size_t size, bool prefixSize = false );
+		/// Writes the data for a data node, compressing it according to the current data compression settings.
+		/// Returns the offset of the block, and sets the size it occupies in the file and whether or not it was compressed.
+		/// This function is thread safe : hashing and compression happen outside of any lock, so several threads
+		/// writing to different locations of the same file encode their data concurrently.
+		Imf::Int64 writeData( const char *data, size_t size, IndexedIO::DataType dataType, size_t &storedSize, bool &compressed );
+
+		/// Reads the data for a data node, decompressing it if necessary. Returns a pointer to the
+		/// uncompressed data, which is either a view into the file if it is memory mapped, or the
+		/// contents of storage. releaseData() must be called once the data has been consumed.
+		/// These functions are thread safe.
+		const char *readData( std::vector<char> &storage, Imf::Int64 offset, Imf::Int64 storedSize, bool compressed ) const;
+		/// Releases the pages of a memory mapped file used by the function above, so that
+		/// mapping the file doesn't leave all the data read resident in memory.
+		void releaseData( Imf::Int64 offset, Imf::Int64 storedSize ) const;
+		/// As above, but reads into a buffer which must be exactly the size of the uncompressed data.
+		void readData( char *buffer, size_t size, Imf::Int64 offset, Imf::Int64 storedSize, bool compressed ) const;
+
+		void setDataCompression( StreamIndexedIO::Compression compression, int level, bool shuffle );
+		void setIndexCompression( StreamIndexedIO::Compression compression );
+
+		/// Converts between strings and the ids stored in the file, registering new strings in the string cache.
+		/// These functions are thread safe.
+		void stringIds( const InternedString *strings, unsigned long arrayLength, Imf::Int64 *ids );
+		void strings( const Imf::Int64 *ids, unsigned long arrayLength, InternedString *strings ) const;
 
 		/// flushes the children of the given directory node to a subindex in the file
 		void commitNodeToSubIndex( DirectoryNode *n );
@@ -631,10 +904,17 @@ class StreamIndexedIO::Index : public RefCounted
 		/// read the subindex that contains the children of the given node
 		void readNodeFromSubIndex( DirectoryNode *n );
 
+		/// Returns the directory stored in the given subindex node, loading it if necessary.
+		/// This function is thread safe, and the subindex is loaded only once, regardless
+		/// of the number of threads requesting it.
+		DirectoryNode *subIndexDirectory( SubIndexNode *n, DirectoryNode *parent );
+
 		typedef tbb::spin_rw_mutex Mutex;
 		typedef Mutex::scoped_lock MutexLock;
 		/// Returns an appropriate mutex scoped lock to access the given Directory node.
 		/// It selects on mutex from the pool, reducing the changes of blocking other threads that are accessing different locations.
+		/// On writable files the lock is always exclusive, since even queries may sort the children of a directory.
+		/// On read-only files the children of a directory are never modified after they are read, so no lock is taken.
 		void lockDirectory( MutexLock &lock, const DirectoryNode *n, bool writeAccess = false ) const;
 
 	protected:
@@ -644,6 +924,13 @@ class StreamIndexedIO::Index : public RefCounted
 		/// defines a pool of mutexes for thread-safe access to the Node hierarchy
 		mutable Mutex m_mutexes[ MAX_MUTEXES ];
 
+		/// Protects the state shared by all the locations of a writable file : the string cache, the data
+		/// hashes, the free pages and the write position of the stream. When both are needed, it must be
+		/// acquired after the directory lock.
+		typedef tbb::mutex WriteMutex;
+		mutable WriteMutex m_writeMutex;
+		bool m_writable;
+
 		DirectoryNode *m_root;
 
 		/// we keep all the removed nodes alive until the Index destruction
@@ -663,6 +950,29 @@ class StreamIndexedIO::Index : public RefCounted
 		typedef std::map< std::pair<MurmurHash,unsigned int>, Imf::Int64 > HashToDataMap;
 		HashToDataMap m_hashToDataMap;
 
+		/// Maps the hash of uncompressed data to the block that was written for it, so
+		/// that duplicate data is neither compressed nor stored twice.
+		struct DataBlock
+		{
+			Imf::Int64 offset;
+			size_t storedSize;
+			bool compressed;
+		};
+		typedef std::map< std::pair<MurmurHash,size_t>, DataBlock > HashToDataBlockMap;
+		HashToDataBlockMap m_hashToDataBlockMap;
+
+		StreamIndexedIO::Compression m_dataCompression;
+		int m_dataCompressionLevel;
+		bool m_shuffle;
+		StreamIndexedIO::Compression m_indexCompression;
+		/// True once the index codec can no longer be changed, because the file
+		/// already contains subindices written with it.
+		bool m_indexCompressionLocked;
+		bool m_hasCompressedData;
+
+		/// The file format version to be written, which is the oldest one supporting the features in use.
+		Imf::Int64 writeVersion() const;
+
 		StringCache m_stringCache;
 
 		StreamIndexedIO::StreamFilePtr m_stream;
@@ -688,8 +998,20 @@ class StreamIndexedIO::Index : public RefCounted
 
 		void addFreePage( Imf::Int64 offset, Imf::Int64 sz );
 
+		/// Returns the offset after saving the data to file or the offset for a previouly saved data (with matching hash).
+		/// \param prefixSize If true than it will prepend to the block, the size of it
+		/// These functions must be called with m_writeMutex locked.
+		Imf::Int64 writeUniqueData( const char *data, size_t size, bool prefixSize = false );
+		Imf::Int64 writeUniqueData( const char *data, size_t size, const MurmurHash &hash, bool prefixSize );
+		/// Allocates and writes a new block in the file, regardless of its contents.
+		Imf::Int64 writeBlock( const char *data, size_t size, bool prefixSize );
+
 		void deallocateWalk( NodeBase* n );
 
+		/// Reads the children of the given node from its subindex. Unlike readNodeFromSubIndex()
+		/// this doesn't synchronise access to the node, so it must not be visible to other threads.
+		void readSubIndexChildren( DirectoryNode *n );
+
 		/// Write the index to the file stream
 		Imf::Int64 write();
 
@@ -748,6 +1070,7 @@ void NodeBase::destroy( NodeBase *n )
 				break;
 			}
 		case NodeBase::Data :
+		case NodeBase::CompressedData :
 			{
 				DataNode *dn = static_cast< DataNode *>(n);
 				delete dn;
@@ -762,6 +1085,7 @@ void NodeBase::destroy( NodeBase *n )
 		case NodeBase::SubIndex :
 			{
 				SubIndexNode *dn = static_cast< SubIndexNode *>(n);
+				destroy( dn->directory() );
 				delete dn;
 				break;
 			}
@@ -799,10 +1123,6 @@ void DirectoryNode::registerChild( NodeBase* c )
 		}
 		childNode->m_parent = this;
 	}
-	else if ( c->nodeType() == NodeBase::SubIndex )
-	{
-		m_subindexChildren = true;
-	}
 	m_children.push_back( c );
 	m_sortedChildren = false;
 }
@@ -871,11 +1191,6 @@ DirectoryNode* StreamIndexedIO::Node::directoryChild( const IndexedIO::EntryID &
 
 			if ( dir->subindex() == DirectoryNode::SavedSubIndex )
 			{
-				if ( m_node->subindexChildren() )
-				{
-					lock.release();		/// we will not change the children dictionary, so we release the lock!
-				}
-
 				// this can occur when the user flushed a directory and right after tries to access it.
 				m_idx->readNodeFromSubIndex( dir );
 			}
@@ -885,37 +1200,15 @@ DirectoryNode* StreamIndexedIO::Node::directoryChild( const IndexedIO::EntryID &
 		{
 			SubIndexNode *subIndex = static_cast< SubIndexNode *>( (*it) );
 
-			// build a Directory that knows it's flushed to a subindex.
-			DirectoryNode *newDir = new DirectoryNode( subIndex, m_node );
-
-			lock.release();		/// we release the lock while loading data..
-
-			m_idx->readNodeFromSubIndex( newDir );
-
-			// now that we loaded the whole thing, lock our Index for writing
-			m_idx->lockDirectory( lock, m_node, true );
-
-			// there's a chance that someone else already replaced the pointer...
-			if ( (*it)->nodeType() == NodeBase::Directory )
-			{
-				lock.release();		/// we release the lock because we won't change the children anyways..
-				NodeBase::destroy( newDir );
-				return static_cast< DirectoryNode *>(*it);
-			}
-
-			// replace SubIndex by Directory node.
-			(*it) = newDir;
-
-			// and now we are ok to delete the SubIndexNode..
-			delete subIndex;
+			lock.release();		/// loading the subindex doesn't change our children, so we release the lock.
 
-			return newDir;
+			return m_idx->subIndexDirectory( subIndex, m_node );
 		}
 	}
 	return nullptr;
 }
 
-bool StreamIndexedIO::Node::dataChildInfo( const IndexedIO::EntryID &name, size_t &offset, size_t &size ) const
+bool StreamIndexedIO::Node::dataChildInfo( const IndexedIO::EntryID &name, size_t &offset, size_t &size, bool &compressed ) const
 {
 	Index::MutexLock lock;
 	m_idx->lockDirectory( lock, m_node );
@@ -925,11 +1218,12 @@ bool StreamIndexedIO::Node::dataChildInfo( const IndexedIO::EntryID &name, size_
 	{
 		NodeBase *p = *cit;
 
-		if ( p->nodeType() == NodeBase::Data )
+		if ( p->nodeType() == NodeBase::Data || p->nodeType() == NodeBase::CompressedData )
 		{
 			DataNode *n = static_cast< DataNode *>( p );
 			offset = n->offset();
 			size = n->size();
+			compressed = n->compressed();
 			return true;
 		}
 		else if ( p->nodeType() == NodeBase::SmallData )
@@ -937,6 +1231,7 @@ bool StreamIndexedIO::Node::dataChildInfo( const IndexedIO::EntryID &name, size_
 			SmallDataNode *n = static_cast< SmallDataNode *>( p );
 			offset = n->offset();
 			size = n->size();
+			compressed = false;
 			return true;
 		}
 	}
@@ -950,7 +1245,10 @@ DirectoryNode* StreamIndexedIO::Node::addChild( const IndexedIO::EntryID &childN
 		throw Exception( "Cannot modify the file at current location! It was already committed to the file." );
 	}
 
-	if ( hasChild(childName) )
+	Index::MutexLock lock;
+	m_idx->lockDirectory( lock, m_node, true );
+
+	if ( m_node->findChild( childName ) != m_node->children().end() )
 	{
 		return nullptr;
 	}
@@ -960,30 +1258,40 @@ DirectoryNode* StreamIndexedIO::Node::addChild( const IndexedIO::EntryID &childN
 	{
 		throw Exception( "Failed to allocate node!" );
 	}
-	m_idx->m_stringCache.add( childName );
 
-	m_node->registerChild( child );
+	{
+		Index::WriteMutex::scoped_lock writeLock( m_idx->m_writeMutex );
+		m_idx->m_stringCache.add( childName );
+		m_idx->m_hasChanged = true;
+	}
 
-	m_idx->m_hasChanged = true;
+	m_node->registerChild( child );
 
 	return child;
 }
 
-void StreamIndexedIO::Node::addDataChild( const IndexedIO::EntryID &childName, IndexedIO::DataType dataType, size_t arrayLen, size_t offset, size_t size )
+void StreamIndexedIO::Node::addDataChild( const IndexedIO::EntryID &childName, IndexedIO::DataType dataType, size_t arrayLen, size_t offset, size_t size, bool compressed )
 {
 	if ( m_node->subindex() )
 	{
 		throw Exception( "Cannot modify the file at current location! It was already committed to the file." );
 	}
 
-	if ( hasChild(childName) )
+	Index::MutexLock lock;
+	m_idx->lockDirectory( lock, m_node, true );
+
+	if ( m_node->findChild( childName ) != m_node->children().end() )
 	{
 		throw IOException( "StreamIndexedIO: Could not insert node '" + childName.value() + "' into index" );
 	}
 
-	m_idx->m_stringCache.add( childName );
+	{
+		Index::WriteMutex::scoped_lock writeLock( m_idx->m_writeMutex );
+		m_idx->m_stringCache.add( childName );
+		m_idx->m_hasChanged = true;
+	}
 
-	if ( arrayLen <= SmallDataNode::maxArrayLength && size <= SmallDataNode::maxSize )
+	if ( !compressed && arrayLen <= SmallDataNode::maxArrayLength && size <= SmallDataNode::maxSize )
 	{
 		SmallDataNode* child = new SmallDataNode(childName, dataType, arrayLen, size, offset);
 		if ( !child )
@@ -994,14 +1302,13 @@ void StreamIndexedIO::Node::addDataChild( const IndexedIO::EntryID &childName, I
 	}
 	else
 	{
-		DataNode* child = new DataNode(childName, dataType, arrayLen, size, offset);
+		DataNode* child = new DataNode(childName, dataType, arrayLen, size, offset, compressed);
 		if ( !child )
 		{
 			throw Exception( "Failed to allocate node!" );
 		}
 		m_node->registerChild( child );
 	}
-	m_idx->m_hasChanged = true;
 }
 
 const IndexedIO::EntryID &StreamIndexedIO::Node::name() const
@@ -1012,11 +1319,12 @@ const IndexedIO::EntryID &StreamIndexedIO::Node::name() const
 void StreamIndexedIO::Node::childNames( IndexedIO::EntryIDList &names ) const
 {
 	names.clear();
-	names.reserve( m_node->children().size() );
 
 	Index::MutexLock lock;
 	m_idx->lockDirectory( lock, m_node );
 
+	names.reserve( m_node->children().size() );
+
 	for ( DirectoryNode::ChildMap::const_iterator cit = m_node->children().begin(); cit != m_node->children().end(); cit++ )
 	{
 		names.push_back( (*cit)->name() );
@@ -1026,13 +1334,13 @@ void StreamIndexedIO::Node::childNames( IndexedIO::EntryIDList &names ) const
 void StreamIndexedIO::Node::childNames( IndexedIO::EntryIDList &names, IndexedIO::EntryType type ) const
 {
 	names.clear();
-	names.reserve( m_node->children().size() );
-
 	bool typeIsDirectory = ( type == IndexedIO::Directory );
 
 	Index::MutexLock lock;
 	m_idx->lockDirectory( lock, m_node );
 
+	names.reserve( m_node->children().size() );
+
 	for ( DirectoryNode::ChildMap::const_iterator cit = m_node->children().begin(); cit != m_node->children().end(); cit++ )
 	{
 		NodeBase *cc = *cit;
@@ -1046,6 +1354,9 @@ void StreamIndexedIO::Node::childNames( IndexedIO::EntryIDList &names, IndexedIO
 
 void StreamIndexedIO::Node::removeChild( const IndexedIO::EntryID &childName, bool throwException )
 {
+	Index::MutexLock lock;
+	m_idx->lockDirectory( lock, m_node, true );
+
 	DirectoryNode::ChildMap::iterator it = m_node->findChild( childName );
 	if ( it == m_node->children().end() )
 	{
@@ -1058,7 +1369,10 @@ void StreamIndexedIO::Node::removeChild( const IndexedIO::EntryID &childName, bo
 
 	NodeBase *child = *it;
 
-	m_idx->deallocateWalk(child);
+	{
+		Index::WriteMutex::scoped_lock writeLock( m_idx->m_writeMutex );
+		m_idx->deallocateWalk(child);
+	}
 
 	m_node->children().erase( it );
 }
@@ -1075,8 +1389,21 @@ void StreamIndexedIO::Node::removeChild( const IndexedIO::EntryID &childName, bo
 //
 ///////////////////////////////////////////////
 
-StreamIndexedIO::Index::Index( StreamIndexedIO::StreamFilePtr stream ) : m_root(nullptr), m_version(g_currentVersion), m_hasChanged(false), m_offset(0), m_next(0), m_stream(stream)
+StreamIndexedIO::Index::Index( StreamIndexedIO::StreamFilePtr stream ) : m_root(nullptr), m_version(g_compatibleVersion), m_hasChanged(false), m_offset(0), m_next(0),
+	m_indexCompressionLocked(false), m_hasCompressedData(false), m_stream(stream)
 {
+	m_writable = m_stream->openMode() & ( IndexedIO::Write | IndexedIO::Append );
+
+	CompressionSettings settings;
+	{
+		tbb::spin_mutex::scoped_lock lock( defaultCompressionSettingsMutex() );
+		settings = defaultCompressionSettings();
+	}
+	m_dataCompression = settings.dataCompression;
+	m_dataCompressionLevel = settings.dataLevel;
+	m_shuffle = settings.shuffle;
+	m_indexCompression = settings.indexCompression;
+
 	m_stringCache.add(IndexedIO::rootName);
 }
 
@@ -1149,13 +1476,39 @@ void StreamIndexedIO::Index::openStream()
 
 		f.seekg( m_offset, std::ios::beg );
 
+		// the index codec is also used by all the subindices in the file, so it can't be changed from now on
+		m_indexCompressionLocked = true;
+		m_indexCompression = Gzip;
+
+		Imf::Int64 indexStart = m_offset;
+		if ( m_version >= 6 )
+		{
+			unsigned char codecs[4] = { 0, 0, 0, 0 };
+			f.read( (char*)codecs, sizeof( codecs ) );
+			m_indexCompression = (StreamIndexedIO::Compression)codecs[0];
+			indexStart += sizeof( codecs );
+
+			// appending keeps the file's data compression rather than the defaults
+			if ( m_stream->openMode() & IndexedIO::Append )
+			{
+				m_dataCompression = (StreamIndexedIO::Compression)codecs[1];
+				m_dataCompressionLevel = (signed char)codecs[2];
+				m_shuffle = codecs[3];
+			}
+		}
+		else if ( m_stream->openMode() & IndexedIO::Append )
+		{
+			// older files have uncompressed data, and we keep them readable by older versions
+			m_dataCompression = StreamIndexedIO::Uncompressed;
+		}
+
 		if (m_version >= 2 )
 		{
 			io::filtering_istream decompressingStream;
-			char *compressedIndex = new char[ end - m_offset ];
-			f.read( compressedIndex, end - m_offset );
-			MemoryStreamSource source( compressedIndex, end - m_offset, true );
-			decompressingStream.push( io::gzip_decompressor() );
+			char *compressedIndex = new char[ end - indexStart ];
+			f.read( compressedIndex, end - indexStart );
+			MemoryStreamSource source( compressedIndex, end - indexStart, true );
+			pushDecompressor( decompressingStream, m_indexCompression );
 			decompressingStream.push( source );
 			assert( decompressingStream.is_complete() );
 
@@ -1331,7 +1684,7 @@ NodeBase *StreamIndexedIO::Index::readNode( F &f )
 	Imf::Int64 stringId;
 	readLittleEndian(f,stringId);
 
-	if ( entryType == IndexedIO::File )
+	if ( entryType == IndexedIO::File || entryType == COMPRESSED_DATA )
 	{
 		char t;
 		IndexedIO::DataType dataType = IndexedIO::Invalid;
@@ -1348,7 +1701,12 @@ NodeBase *StreamIndexedIO::Index::readNode( F &f )
 		readLittleEndian( f, offset );
 		readLittleEndian( f, size );
 
-		if ( arrayLength <= SmallDataNode::maxArrayLength && size <= SmallDataNode::maxSize )
+		if ( entryType == COMPRESSED_DATA )
+		{
+			DataNode *n = new DataNode( m_stringCache.findById( stringId ), dataType, arrayLength, size, offset, true );
+			return n;
+		}
+		else if ( arrayLength <= SmallDataNode::maxArrayLength && size <= SmallDataNode::maxSize )
 		{
 			SmallDataNode *n = new SmallDataNode( m_stringCache.findById( stringId ), dataType, arrayLength, size, offset );
 			return n;
@@ -1491,7 +1849,7 @@ void StreamIndexedIO::Index::read( F &f )
 template < typename F, typename D >
 void StreamIndexedIO::Index::writeDataNode( D *node, F &f )
 {
-	char t = IndexedIO::File;
+	char t = ( node->compressed() ? COMPRESSED_DATA : IndexedIO::File );
 	f.write( &t, sizeof(char) );
 
 	Imf::Int64 id = m_stringCache.find( node->name() );
@@ -1533,6 +1891,7 @@ void StreamIndexedIO::Index::writeNodeChildren( DirectoryNode *n, F &f )
 		switch( p->nodeType() )
 		{
 			case NodeBase::Data :
+			case NodeBase::CompressedData :
 			{
 				DataNode *childNode = static_cast< DataNode *>(p);
 				writeDataNode( childNode, f );
@@ -1592,9 +1951,21 @@ Imf::Int64 StreamIndexedIO::Index::write()
 
 	m_offset = indexStart;
 
+	const Imf::Int64 version = writeVersion();
+	if ( version >= 6 )
+	{
+		const unsigned char codecs[4] = {
+			(unsigned char)m_indexCompression,
+			(unsigned char)m_dataCompression,
+			(unsigned char)(signed char)std::max( -1, std::min( m_dataCompressionLevel, 127 ) ),
+			(unsigned char)m_shuffle
+		};
+		f.write( (const char *)codecs, sizeof( codecs ) );
+	}
+
 	MemoryStreamSink sink;
 	io::filtering_ostream compressingStream;
-	compressingStream.push( io::gzip_compressor() );
+	pushCompressor( compressingStream, m_indexCompression );
 	compressingStream.push( sink );
 	assert( compressingStream.is_complete() );
 
@@ -1616,8 +1987,10 @@ Imf::Int64 StreamIndexedIO::Index::write()
 	}
 
 	/// To synchronize/close, etc.
-	compressingStream.pop();
-	compressingStream.pop();
+	while ( !compressingStream.empty() )
+	{
+		compressingStream.pop();
+	}
 
 	char *data=nullptr;
 	std::streamsize sz;
@@ -1628,7 +2001,7 @@ Imf::Int64 StreamIndexedIO::Index::write()
 	f.write( data, sz );
 
 	writeLittleEndian( f, m_offset );
-	writeLittleEndian( f, g_currentVersion );
+	writeLittleEndian( f, version );
 	writeLittleEndian( f, g_versionedMagicNumber );
 
 	m_hasChanged = false;
@@ -1705,7 +2078,7 @@ template< typename D >
 void StreamIndexedIO::Index::deallocate( D* n )
 {
 	assert(n);
-	assert(n->nodeType() == NodeBase::Data || n->nodeType() == NodeBase::SmallData );
+	assert(n->nodeType() == NodeBase::Data || n->nodeType() == NodeBase::CompressedData || n->nodeType() == NodeBase::SmallData );
 
 	addFreePage( n->m_offset, n->m_size );
 }
@@ -1832,25 +2205,24 @@ void StreamIndexedIO::Index::addFreePage(  Imf::Int64 offset, Imf::Int64 sz )
 
 Imf::Int64 StreamIndexedIO::Index::writeUniqueData( const char *data, size_t size, bool prefixSize )
 {
-	m_hasChanged = true;
-
-	/// Find next writable location
-	Imf::Int64 loc;
-
 	// compute hash for the data
 	MurmurHash hash;
 	hash.append( data, size );
 
+	return writeUniqueData( data, size, hash, prefixSize );
+}
+
+Imf::Int64 StreamIndexedIO::Index::writeUniqueData( const char *data, size_t size, const MurmurHash &hash, bool prefixSize )
+{
 	if ( size >= UINT32_MAX )
 	{
 		throw IOException( "StreamIndexedIO: Data size too long!" );
 	}
-	uint32_t clampedSize = size;
 	size_t totalSize = size;
 
 	if ( prefixSize )
 	{
-		totalSize += sizeof( clampedSize );
+		totalSize += sizeof( uint32_t );
 	}
 
 	// see if it's already stored by another node..
@@ -1861,9 +2233,31 @@ Imf::Int64 StreamIndexedIO::Index::writeUniqueData( const char *data, size_t siz
 		return ret.first->second;
 	}
 
+	ret.first->second = writeBlock( data, size, prefixSize );
+	return ret.first->second;
+}
+
+Imf::Int64 StreamIndexedIO::Index::writeBlock( const char *data, size_t size, bool prefixSize )
+{
+	m_hasChanged = true;
+
+	if ( size >= UINT32_MAX )
+	{
+		throw IOException( "StreamIndexedIO: Data size too long!" );
+	}
+	uint32_t clampedSize = size;
+	size_t totalSize = size;
+
+	if ( prefixSize )
+	{
+		totalSize += sizeof( clampedSize );
+	}
+
 	/// New data, find next writable location.
-	loc = allocate( totalSize );
-	ret.first->second = loc;
+	Imf::Int64 loc = allocate( totalSize );
+
+	/// the stream may be shared with threads reading back from the file
+	StreamFile::MutexLock lock( m_stream->mutex() );
 
 	/// Seek 'write' pointer to writable location
 	m_stream->seekp( loc, std::ios::beg );
@@ -1879,6 +2273,229 @@ Imf::Int64 StreamIndexedIO::Index::writeUniqueData( const char *data, size_t siz
 	return loc;
 }
 
+Imf::Int64 StreamIndexedIO::Index::writeData( const char *data, size_t size, IndexedIO::DataType dataType, size_t &storedSize, bool &compressed )
+{
+	storedSize = size;
+	compressed = false;
+
+	if ( size >= UINT32_MAX )
+	{
+		throw IOException( "StreamIndexedIO: Data size too long!" );
+	}
+
+	// hashing is done before locking, so that concurrent writers only serialise on the actual IO
+	MurmurHash hash;
+	hash.append( data, size );
+
+	if ( m_dataCompression == StreamIndexedIO::Uncompressed || size < g_minCompressedDataSize )
+	{
+		WriteMutex::scoped_lock lock( m_writeMutex );
+		return writeUniqueData( data, size, hash, false );
+	}
+
+	const HashToDataBlockMap::key_type key( hash, size );
+
+	{
+		WriteMutex::scoped_lock lock( m_writeMutex );
+
+		// see if we already wrote this data, either compressed or not
+		HashToDataBlockMap::const_iterator it = m_hashToDataBlockMap.find( key );
+		if ( it != m_hashToDataBlockMap.end() )
+		{
+			storedSize = it->second.storedSize;
+			compressed = it->second.compressed;
+			return it->second.offset;
+		}
+
+		HashToDataMap::const_iterator rit = m_hashToDataMap.find( HashToDataMap::key_type( hash, size ) );
+		if ( rit != m_hashToDataMap.end() )
+		{
+			return rit->second;
+		}
+	}
+
+	const char *src = data;
+	std::vector<char> shuffled;
+	const size_t elementSize = m_shuffle ? shuffleSize( dataType ) : 1;
+	if ( elementSize > 1 )
+	{
+		shuffled.resize( size );
+		shuffle( data, shuffled.data(), size, elementSize, false );
+		src = shuffled.data();
+	}
+
+	uLongf compressedSize = compressBound( size );
+	std::vector<char> block( g_compressedDataHeaderSize + compressedSize );
+	const int level = m_dataCompressionLevel < 0 ? Z_BEST_SPEED : m_dataCompressionLevel;
+	if ( compress2( (Bytef *)( block.data() + g_compressedDataHeaderSize ), &compressedSize, (const Bytef *)src, size, level ) != Z_OK )
+	{
+		throw IOException( "StreamIndexedIO: Failed to compress data!" );
+	}
+
+	WriteMutex::scoped_lock lock( m_writeMutex );
+
+	// another thread may have written the same data while we were compressing it
+	HashToDataBlockMap::const_iterator it = m_hashToDataBlockMap.find( key );
+	if ( it != m_hashToDataBlockMap.end() )
+	{
+		storedSize = it->second.storedSize;
+		compressed = it->second.compressed;
+		return it->second.offset;
+	}
+
+	DataBlock dataBlock;
+	if ( g_compressedDataHeaderSize + compressedSize < size )
+	{
+		block[0] = m_dataCompression;
+		block[1] = elementSize;
+		const uint64_t uncompressedSize = asLittleEndian<uint64_t>( size );
+		memcpy( block.data() + 2, &uncompressedSize, sizeof( uncompressedSize ) );
+
+		// the block is identified by the hash of the uncompressed data, so there's no need to hash it again
+		dataBlock.storedSize = g_compressedDataHeaderSize + compressedSize;
+		dataBlock.compressed = true;
+		dataBlock.offset = writeBlock( block.data(), dataBlock.storedSize, false );
+		m_hasCompressedData = true;
+	}
+	else
+	{
+		// incompressible data is stored as it is, and is faster to read too
+		dataBlock.storedSize = size;
+		dataBlock.compressed = false;
+		dataBlock.offset = writeUniqueData( data, size, hash, false );
+	}
+
+	m_hashToDataBlockMap[ key ] = dataBlock;
+
+	storedSize = dataBlock.storedSize;
+	compressed = dataBlock.compressed;
+	return dataBlock.offset;
+}
+
+const char *StreamIndexedIO::Index::readData( std::vector<char> &storage, Imf::Int64 offset, Imf::Int64 storedSize, bool compressed ) const
+{
+	const char *mapped = m_stream->mappedData( storedSize, offset );
+	if ( !compressed )
+	{
+		if ( mapped )
+		{
+			return mapped;
+		}
+		storage.resize( storedSize );
+		m_stream->positionalRead( storage.data(), storedSize, offset );
+		return storage.data();
+	}
+
+	std::vector<char> block;
+	if ( !mapped )
+	{
+		block.resize( storedSize );
+		m_stream->positionalRead( block.data(), storedSize, offset );
+		mapped = block.data();
+	}
+	storage.resize( uncompressedDataSize( mapped, storedSize ) );
+	decompressData( mapped, storedSize, storage.data(), storage.size() );
+	return storage.data();
+}
+
+void StreamIndexedIO::Index::readData( char *buffer, size_t size, Imf::Int64 offset, Imf::Int64 storedSize, bool compressed ) const
+{
+	if ( !compressed )
+	{
+		// the buffer must be filled entirely, so we can't accept a short block
+		if ( (size_t)storedSize != size )
+		{
+			throw IOException( "StreamIndexedIO: Unexpected data size!" );
+		}
+		m_stream->positionalRead( buffer, size, offset );
+		return;
+	}
+
+	// decompress straight from the mapping if we have one
+	const char *mapped = m_stream->mappedData( storedSize, offset );
+	std::vector<char> block;
+	if ( !mapped )
+	{
+		block.resize( storedSize );
+		m_stream->positionalRead( block.data(), storedSize, offset );
+		mapped = block.data();
+	}
+	if ( uncompressedDataSize( mapped, storedSize ) != size )
+	{
+		throw IOException( "StreamIndexedIO: Unexpected data size!" );
+	}
+	decompressData( mapped, storedSize, buffer, size );
+	releaseData( offset, storedSize );
+}
+
+void StreamIndexedIO::Index::releaseData( Imf::Int64 offset, Imf::Int64 storedSize ) const
+{
+	m_stream->releaseMappedData( storedSize, offset );
+}
+
+void StreamIndexedIO::Index::setDataCompression( StreamIndexedIO::Compression compression, int level, bool shuffle )
+{
+	if ( compression != StreamIndexedIO::Uncompressed && compression != StreamIndexedIO::Deflate )
+	{
+		throw InvalidArgumentException( "StreamIndexedIO: Unsupported data compression!" );
+	}
+	m_dataCompression = compression;
+	m_dataCompressionLevel = level;
+	m_shuffle = shuffle;
+}
+
+void StreamIndexedIO::Index::setIndexCompression( StreamIndexedIO::Compression compression )
+{
+	if ( compression != StreamIndexedIO::Uncompressed && compression != StreamIndexedIO::Gzip && compression != StreamIndexedIO::Deflate )
+	{
+		throw InvalidArgumentException( "StreamIndexedIO: Unsupported index compression!" );
+	}
+
+	if ( compression == m_indexCompression )
+	{
+		return;
+	}
+
+	if ( m_indexCompressionLocked )
+	{
+		throw IOException( "StreamIndexedIO: Cannot change the index compression of a file which already contains subindices!" );
+	}
+
+	m_indexCompression = compression;
+}
+
+void StreamIndexedIO::Index::stringIds( const InternedString *strings, unsigned long arrayLength, Imf::Int64 *ids )
+{
+	WriteMutex::scoped_lock lock( m_writeMutex );
+	for ( unsigned long i = 0; i < arrayLength; i++ )
+	{
+		ids[i] = m_stringCache.find( strings[i], false /* create entry if missing */ );
+	}
+}
+
+void StreamIndexedIO::Index::strings( const Imf::Int64 *ids, unsigned long arrayLength, InternedString *strings ) const
+{
+	// read-only files never change the string cache, so they don't need to lock
+	WriteMutex::scoped_lock lock;
+	if ( m_writable )
+	{
+		lock.acquire( m_writeMutex );
+	}
+	for ( unsigned long i = 0; i < arrayLength; i++ )
+	{
+		strings[i] = m_stringCache.findById( ids[i] );
+	}
+}
+
+Imf::Int64 StreamIndexedIO::Index::writeVersion() const
+{
+	if ( m_version >= 6 || m_hasCompressedData || m_indexCompression != StreamIndexedIO::Gzip )
+	{
+		return g_currentVersion;
+	}
+	return g_compatibleVersion;
+}
+
 void StreamIndexedIO::Index::deallocateWalk( NodeBase* n )
 {
 	assert(n);
@@ -1912,18 +2529,27 @@ void StreamIndexedIO::Index::commitNodeToSubIndex( DirectoryNode *n )
 		return;
 	}
 
+	MutexLock directoryLock;
+	lockDirectory( directoryLock, n, true );
+
 	if ( n->subindex() == DirectoryNode::NoSubIndex )
 	{
+		WriteMutex::scoped_lock lock( m_writeMutex );
+
+		m_indexCompressionLocked = true;
+
 		MemoryStreamSink sink;
 		io::filtering_ostream compressingStream;
-		compressingStream.push( io::gzip_compressor() );
+		pushCompressor( compressingStream, m_indexCompression );
 		compressingStream.push( sink );
 		assert( compressingStream.is_complete() );
 
 		writeNodeChildren( n, compressingStream );
 
-		compressingStream.pop();
-		compressingStream.pop();
+		while ( !compressingStream.empty() )
+		{
+			compressingStream.pop();
+		}
 
 		char *data=nullptr;
 		std::streamsize sz;
@@ -1937,7 +2563,7 @@ void StreamIndexedIO::Index::commitNodeToSubIndex( DirectoryNode *n )
 
 void StreamIndexedIO::Index::readNodeFromSubIndex( DirectoryNode *n )
 {
-	/// guarantees thread safe access to the file and also to the m_subindex variable
+	/// guarantees thread safe access to the m_subindex variable
 	StreamFile::MutexLock lock( m_stream->mutex() );
 
 	if ( n->subindex() == DirectoryNode::LoadedSubIndex )
@@ -1945,17 +2571,63 @@ void StreamIndexedIO::Index::readNodeFromSubIndex( DirectoryNode *n )
 		return;
 	}
 
-	m_stream->seekg( n->offset(), std::ios::beg );
+	readSubIndexChildren( n );
+}
+
+DirectoryNode *StreamIndexedIO::Index::subIndexDirectory( SubIndexNode *n, DirectoryNode *parent )
+{
+	DirectoryNode *dir = n->directory();
+	if ( dir )
+	{
+		return dir;
+	}
+
+	SubIndexNode::LoadMutex::scoped_lock lock( n->loadMutex() );
+
+	// there's a chance that another thread loaded it while we were waiting for the lock...
+	dir = n->directory();
+	if ( dir )
+	{
+		return dir;
+	}
+
+	// build a Directory that knows it's flushed to a subindex.
+	dir = new DirectoryNode( n, parent );
+	try
+	{
+		readSubIndexChildren( dir );
+	}
+	catch ( ... )
+	{
+		NodeBase::destroy( dir );
+		throw;
+	}
+
+	n->setDirectory( dir );
+	return dir;
+}
 
+void StreamIndexedIO::Index::readSubIndexChildren( DirectoryNode *n )
+{
 	uint32_t subindexSize = 0;
-	readLittleEndian( *m_stream, subindexSize );
+	m_stream->positionalRead( (char*)&subindexSize, sizeof( subindexSize ), n->offset() );
+	subindexSize = asLittleEndian<>( subindexSize );
 
-	char *data = m_stream->ioBuffer(subindexSize);
-	m_stream->read( data, subindexSize );
+	/// we use our own buffer rather than the stream's, so that subindices can be loaded concurrently,
+	/// or parse the subindex directly from the file if it is memory mapped.
+	std::vector<char> data;
+	const char *subindex = m_stream->mappedData( subindexSize, n->offset() + sizeof( subindexSize ) );
+	if ( !subindex )
+	{
+		data.resize( subindexSize );
+		m_stream->positionalRead( data.data(), subindexSize, n->offset() + sizeof( subindexSize ) );
+		subindex = data.data();
+	}
 
 	io::filtering_istream decompressingStream;
-	MemoryStreamSource source( data, subindexSize, false );
-	decompressingStream.push( io::gzip_decompressor() );
+	// the source only reads from the buffer, so it is safe to use the read-only mapping
+	MemoryStreamSource source( const_cast<char *>( subindex ), subindexSize, false );
+	pushDecompressor( decompressingStream, m_indexCompression );
 	decompressingStream.push( source );
 	assert( decompressingStream.is_complete() );
 
@@ -1969,6 +2641,8 @@ void StreamIndexedIO::Index::readNodeFromSubIndex( DirectoryNode *n )
 		n->registerChild( child );
 	}
 
+	m_stream->releaseMappedData( subindexSize, n->offset() + sizeof( subindexSize ) );
+
 	/// make sure the children is sorted to avoid non-thread safe sorting happening later...
 	n->sortChildren();
 
@@ -1978,13 +2652,13 @@ void StreamIndexedIO::Index::readNodeFromSubIndex( DirectoryNode *n )
 
 void StreamIndexedIO::Index::lockDirectory( MutexLock &lock, const DirectoryNode *n, bool writeAccess ) const
 {
-	if ( n->subindexChildren() )
+	if ( m_writable )
 	{
 		// choose one of the mutexes from the pool (in a deterministic way)
 		size_t v = (size_t)n / sizeof(DirectoryNode*);
 		unsigned int m = ( (v + 1) / 3 ) % MAX_MUTEXES;
 
-		lock.acquire( m_mutexes[ m ], writeAccess );
+		lock.acquire( m_mutexes[ m ], writeAccess || m_writable );
 	}
 }
 
@@ -2052,6 +2726,22 @@ StreamIndexedIO::StreamFile::Mutex & StreamIndexedIO::StreamFile::mutex()
 	return m_mutex;
 }
 
+void StreamIndexedIO::StreamFile::positionalRead( char *buffer, size_t size, size_t pos )
+{
+	MutexLock lock( m_mutex );
+	m_stream->seekg( pos, std::ios::beg );
+	m_stream->read( buffer, size );
+}
+
+const char *StreamIndexedIO::StreamFile::mappedData( size_t size, size_t pos )
+{
+	return nullptr;
+}
+
+void StreamIndexedIO::StreamFile::releaseMappedData( size_t size, size_t pos )
+{
+}
+
 void StreamIndexedIO::StreamFile::flush( size_t endPosition )
 {
 	assert( m_stream );
@@ -2202,6 +2892,39 @@ void StreamIndexedIO::flush()
 	m_node->m_idx->flush();
 }
 
+void StreamIndexedIO::setDataCompression( Compression compression, int level, bool shuffle )
+{
+	m_node->m_idx->setDataCompression( compression, level, shuffle );
+}
+
+void StreamIndexedIO::setIndexCompression( Compression compression )
+{
+	m_node->m_idx->setIndexCompression( compression );
+}
+
+void StreamIndexedIO::setDefaultDataCompression( Compression compression, int level, bool shuffle )
+{
+	if ( compression != Uncompressed && compression != Deflate )
+	{
+		throw InvalidArgumentException( "StreamIndexedIO: Unsupported data compression!" );
+	}
+	tbb::spin_mutex::scoped_lock lock( defaultCompressionSettingsMutex() );
+	CompressionSettings &settings = defaultCompressionSettings();
+	settings.dataCompression = compression;
+	settings.dataLevel = level;
+	settings.shuffle = shuffle;
+}
+
+void StreamIndexedIO::setDefaultIndexCompression( Compression compression )
+{
+	if ( compression != Uncompressed && compression != Gzip && compression != Deflate )
+	{
+		throw InvalidArgumentException( "StreamIndexedIO: Unsupported index compression!" );
+	}
+	tbb::spin_mutex::scoped_lock lock( defaultCompressionSettingsMutex() );
+	defaultCompressionSettings().indexCompression = compression;
+}
+
 StreamIndexedIO::StreamFile& StreamIndexedIO::streamFile() const
 {
 	return m_node->m_idx->streamFile();
@@ -2250,6 +2973,11 @@ IndexedIOPtr StreamIndexedIO::subdirectory( const IndexedIO::EntryID &name, Inde
 			writable( name );
 			childNode = m_node->addChild( name );
 			if ( !childNode )
+			{
+				// another thread may have created it in the meantime
+				childNode = m_node->directoryChild( name );
+			}
+			if ( !childNode )
 			{
 				throw IOException( "StreamIndexedIO: Could not insert child '" + name.value() + "'" );
 			}
@@ -2360,6 +3088,7 @@ IndexedIO::Entry StreamIndexedIO::entry(const IndexedIO::EntryID &name) const
 	switch( node->nodeType() )
 	{
 		case NodeBase::Data:
+		case NodeBase::CompressedData:
 			{
 				DataNode *dn = static_cast< DataNode * >(node);
 				return IndexedIO::Entry( dn->name(), IndexedIO::File, dn->dataType(), dn->arrayLength() );
@@ -2459,23 +3188,19 @@ void StreamIndexedIO::write(const IndexedIO::EntryID &name, const InternedString
 	unsigned long size = IndexedIO::DataSizeTraits<Imf::Int64 *>::size(constIds, arrayLength);
 	IndexedIO::DataType dataType = IndexedIO::InternedStringArray;
 
-	char *data = streamFile().ioBuffer(size);
-	assert(data);
+	// temporary buffer per call, so that different locations can be written concurrently
+	std::vector<char> data( size );
 
 	Index *index = m_node->m_idx.get();
+	index->stringIds( x, arrayLength, ids );
 
-	StringCache &stringCache = index->stringCache();
-
-	for ( unsigned long i = 0; i < arrayLength; i++ )
-	{
-		ids[i] = stringCache.find( x[i], false /* create entry if missing */ );
-	}
-
-	IndexedIO::DataFlattenTraits<Imf::Int64*>::flatten(constIds, arrayLength, data);
+	IndexedIO::DataFlattenTraits<Imf::Int64*>::flatten(constIds, arrayLength, data.data());
 
-	size_t offset = index->writeUniqueData( data, size );
+	size_t storedSize = 0;
+	bool compressed = false;
+	size_t offset = index->writeData( data.data(), size, dataType, storedSize, compressed );
 
-	m_node->addDataChild( name, dataType, arrayLength, offset, size );
+	m_node->addDataChild( name, dataType, arrayLength, offset, storedSize, compressed );
 
 	delete [] ids;
 }
@@ -2486,40 +3211,30 @@ void StreamIndexedIO::read(const IndexedIO::EntryID &name, InternedString *&x, u
 	readable(name);
 
 	Imf::Int64 dataOffset(0), dataSize(0);
+	bool compressed = false;
 
-	if ( !m_node->dataChildInfo( name, dataOffset, dataSize ) )
+	if ( !m_node->dataChildInfo( name, dataOffset, dataSize, compressed ) )
 	{
 		throw IOException( "StreamIndexedIO::read : Data entry not found '" + name.value() + "'" );
 	}
 
 	Imf::Int64 *ids = new Imf::Int64[arrayLength];
 
-	StreamIndexedIO::StreamFile &f = streamFile();
-	{
-		StreamFile::MutexLock lock( f.mutex() );
-		f.seekg( dataOffset, std::ios::beg );
-
 #ifdef IE_CORE_LITTLE_ENDIAN
-		// raw read
-		f.read( (char*)ids, dataSize );
-	}
+	// raw read
+	m_node->m_idx->readData( (char*)ids, arrayLength * sizeof( Imf::Int64 ), dataOffset, dataSize, compressed );
 #else
-		char *data = f.ioBuffer(dataSize);
-		f.read( data, dataSize );
-	}
-	IndexedIO::DataFlattenTraits<Imf::Int64*>::unflatten( data, ids, arrayLength );
+	std::vector<char> data;
+	IndexedIO::DataFlattenTraits<Imf::Int64*>::unflatten( m_node->m_idx->readData( data, dataOffset, dataSize, compressed ), ids, arrayLength );
+	m_node->m_idx->releaseData( dataOffset, dataSize );
 #endif
 
-	const StringCache &stringCache = m_node->m_idx->stringCache();
 	if (!x)
 	{
 		x = new InternedString[arrayLength];
 	}
 
-	for ( unsigned long i = 0; i < arrayLength; i++ )
-	{
-		x[i] = stringCache.findById( ids[i] );
-	}
+	m_node->m_idx->strings( ids, arrayLength, x );
 	delete [] ids;
 }
 
@@ -2532,13 +3247,15 @@ void StreamIndexedIO::write(const IndexedIO::EntryID &name, const T *x, unsigned
 	unsigned long size = IndexedIO::DataSizeTraits<T*>::size(x, arrayLength);
 	IndexedIO::DataType dataType = IndexedIO::DataTypeTraits<T*>::type();
 
-	char *data = streamFile().ioBuffer(size);
-	assert(data);
-	IndexedIO::DataFlattenTraits<T*>::flatten(x, arrayLength, data);
+	// temporary buffer per call, so that different locations can be written concurrently
+	std::vector<char> data( size );
+	IndexedIO::DataFlattenTraits<T*>::flatten(x, arrayLength, data.data());
 
-	Imf::Int64 offset = m_node->m_idx->writeUniqueData( data, size );
+	size_t storedSize = 0;
+	bool compressed = false;
+	Imf::Int64 offset = m_node->m_idx->writeData( data.data(), size, dataType, storedSize, compressed );
 
-	m_node->addDataChild( name, dataType, arrayLength, offset, size );
+	m_node->addDataChild( name, dataType, arrayLength, offset, storedSize, compressed );
 }
 
 template<typename T>
@@ -2550,9 +3267,11 @@ void StreamIndexedIO::rawWrite(const IndexedIO::EntryID &name, const T *x, unsig
 	unsigned long size = IndexedIO::DataSizeTraits<T*>::size(x, arrayLength);
 	IndexedIO::DataType dataType = IndexedIO::DataTypeTraits<T*>::type();
 
-	Imf::Int64 offset =  m_node->m_idx->writeUniqueData( (char*)x, size );
+	size_t storedSize = 0;
+	bool compressed = false;
+	Imf::Int64 offset = m_node->m_idx->writeData( (char*)x, size, dataType, storedSize, compressed );
 
-	m_node->addDataChild( name, dataType, arrayLength, offset, size );
+	m_node->addDataChild( name, dataType, arrayLength, offset, storedSize, compressed );
 }
 
 template<typename T>
@@ -2564,13 +3283,14 @@ void StreamIndexedIO::write(const IndexedIO::EntryID &name, const T &x)
 	unsigned long size = IndexedIO::DataSizeTraits<T>::size(x);
 	IndexedIO::DataType dataType = IndexedIO::DataTypeTraits<T>::type();
 
-	char *data = streamFile().ioBuffer(size);
-	assert(data);
-	IndexedIO::DataFlattenTraits<T>::flatten(x, data);
+	std::vector<char> data( size );
+	IndexedIO::DataFlattenTraits<T>::flatten(x, data.data());
 
-	Imf::Int64 offset =  m_node->m_idx->writeUniqueData( data, size );
+	size_t storedSize = 0;
+	bool compressed = false;
+	Imf::Int64 offset = m_node->m_idx->writeData( data.data(), size, dataType, storedSize, compressed );
 
-	m_node->addDataChild( name, dataType, 0, offset, size );
+	m_node->addDataChild( name, dataType, 0, offset, storedSize, compressed );
 }
 
 template<typename T>
@@ -2582,9 +3302,11 @@ void StreamIndexedIO::rawWrite(const IndexedIO::EntryID &name, const T &x)
 	unsigned long size = IndexedIO::DataSizeTraits<T>::size(x);
 	IndexedIO::DataType dataType = IndexedIO::DataTypeTraits<T>::type();
 
-	Imf::Int64 offset = m_node->m_idx->writeUniqueData( (char*)&x, size );
+	size_t storedSize = 0;
+	bool compressed = false;
+	Imf::Int64 offset = m_node->m_idx->writeData( (char*)&x, size, dataType, storedSize, compressed );
 
-	m_node->addDataChild( name, dataType, 0, offset, size );
+	m_node->addDataChild( name, dataType, 0, offset, storedSize, compressed );
 }
 
 template<typename T>
@@ -2594,20 +3316,19 @@ void StreamIndexedIO::read(const IndexedIO::EntryID &name, T *&x, unsigned long
 	readable(name);
 
 	Imf::Int64 dataOffset(0), dataSize(0);
+	bool compressed = false;
 
-	if ( !m_node->dataChildInfo( name, dataOffset, dataSize ) )
+	if ( !m_node->dataChildInfo( name, dataOffset, dataSize, compressed ) )
 	{
 		throw IOException( "StreamIndexedIO::read: Data entry not found '" + name.value() + "'" );
 	}
 
-	StreamIndexedIO::StreamFile &f = streamFile();
-	{
-		StreamFile::MutexLock lock( f.mutex() );
-		char *data = f.ioBuffer(dataSize);
-		f.seekg( dataOffset, std::ios::beg );
-		f.read( data, dataSize );
-		IndexedIO::DataFlattenTraits<T*>::unflatten( data, x, arrayLength );
-	}
+	// we use a temporary buffer per call rather than the shared StreamFile::ioBuffer(),
+	// so that concurrent reads don't need to be serialised. Memory mapped files need no
+	// buffer at all for uncompressed data.
+	std::vector<char> data;
+	IndexedIO::DataFlattenTraits<T*>::unflatten( m_node->m_idx->readData( data, dataOffset, dataSize, compressed ), x, arrayLength );
+	m_node->m_idx->releaseData( dataOffset, dataSize );
 }
 
 template<typename T>
@@ -2617,8 +3338,9 @@ void StreamIndexedIO::rawRead(const IndexedIO::EntryID &name, T *&x, unsigned lo
 	readable(name);
 
 	Imf::Int64 dataOffset(0), dataSize(0);
+	bool compressed = false;
 
-	if ( !m_node->dataChildInfo( name, dataOffset, dataSize ) )
+	if ( !m_node->dataChildInfo( name, dataOffset, dataSize, compressed ) )
 	{
 		throw IOException( "StreamIndexedIO::rawRead: Data entry not found '" + name.value() + "'" );
 	}
@@ -2628,12 +3350,7 @@ void StreamIndexedIO::rawRead(const IndexedIO::EntryID &name, T *&x, unsigned lo
 		x = new T[arrayLength];
 	}
 
-	StreamIndexedIO::StreamFile &f = streamFile();
-	{
-		StreamFile::MutexLock lock( f.mutex() );
-		f.seekg( dataOffset, std::ios::beg );
-		f.read( (char*)x, dataSize );
-	}
+	m_node->m_idx->readData( (char*)x, arrayLength * sizeof( T ), dataOffset, dataSize, compressed );
 }
 
 template<typename T>
@@ -2643,20 +3360,16 @@ void StreamIndexedIO::read(const IndexedIO::EntryID &name, T &x) const
 	readable(name);
 
 	Imf::Int64 dataOffset(0), dataSize(0);
+	bool compressed = false;
 
-	if ( !m_node->dataChildInfo( name, dataOffset, dataSize ) )
+	if ( !m_node->dataChildInfo( name, dataOffset, dataSize, compressed ) )
 	{
 		throw IOException( "StreamIndexedIO::read Data entry not found '" + name.value() + "'" );
 	}
 
-	StreamIndexedIO::StreamFile &f = streamFile();
-	{
-		StreamFile::MutexLock lock( f.mutex() );
-		char *data = f.ioBuffer(dataSize);
-		f.seekg( dataOffset, std::ios::beg );
-		f.read( data, dataSize );
-		IndexedIO::DataFlattenTraits<T>::unflatten( data, x );
-	}
+	std::vector<char> data;
+	IndexedIO::DataFlattenTraits<T>::unflatten( m_node->m_idx->readData( data, dataOffset, dataSize, compressed ), x );
+	m_node->m_idx->releaseData( dataOffset, dataSize );
 }
 
 template<typename T>
@@ -2666,18 +3379,14 @@ void StreamIndexedIO::rawRead(const IndexedIO::EntryID &name, T &x) const
 	readable(name);
 
 	Imf::Int64 dataOffset(0), dataSize(0);
+	bool compressed = false;
 
-	if ( !m_node->dataChildInfo( name, dataOffset, dataSize ) )
+	if ( !m_node->dataChildInfo( name, dataOffset, dataSize, compressed ) )
 	{
 		throw IOException( "StreamIndexedIO::rawRead: Data entry not found '" + name.value() + "'" );
 	}
 
-	StreamIndexedIO::StreamFile &f = streamFile();
-	{
-		StreamFile::MutexLock lock( f.mutex() );
-		f.seekg( dataOffset, std::ios::beg );
-		f.read( (char*)&x, dataSize );
-	}
+	m_node->m_idx->readData( (char*)&x, sizeof( T ), dataOffset, dataSize, compressed );
 }
 
 #ifdef IE_CORE_LITTLE_ENDIAN
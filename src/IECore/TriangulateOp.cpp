@@ -1,6 +1,6 @@
 //////////////////////////////////////////////////////////////////////////
 //
-//  Copyright (c) 2008-2013, Image Engine Design Inc. All rights reserved.
+//  Copyright (c) 2008-2017, Image Engine Design Inc. All rights reserved.
 //
 //  Redistribution and use in source and binary forms, with or without
 //  modification, are permitted provided that the following conditions are
@@ -32,6 +32,13 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include "boost/type_traits/is_same.hpp"
+
+#include "tbb/atomic.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/spin_mutex.h"
+
 #include "IECore/CompoundObject.h"
 #include "IECore/MeshPrimitive.h"
 #include "IECore/TriangulateOp.h"
@@ -39,6 +46,7 @@
 #include "IECore/TriangleAlgo.h"
 #include "IECore/Exception.h"
 #include "IECore/CompoundParameter.h"
+#include "IECore/private/MeshAlgoUtils.h"
 
 using namespace IECore;
 
@@ -88,211 +96,370 @@ const BoolParameter * TriangulateOp::throwExceptionsParameter() const
 	return m_throwExceptionsParameter.get();
 }
 
-/// A functor for use with despatchTypedData, which copies elements from another vector, as specified by an array of indices into that data
+namespace
+{
+
+template<typename T>
+class Remap
+{
+
+	public :
+
+		Remap( const std::vector<T> &src, const std::vector<int> &indices, std::vector<T> &dst )
+			:	m_src( src ), m_indices( indices ), m_dst( dst )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				m_dst[i] = m_src[m_indices[i]];
+			}
+		}
+
+	private :
+
+		const std::vector<T> &m_src;
+		const std::vector<int> &m_indices;
+		std::vector<T> &m_dst;
+
+};
+
+template<typename T>
+void copyInterpretation( const T *from, T *to )
+{
+}
+
+template<typename T>
+void copyInterpretation( const GeometricTypedData<T> *from, GeometricTypedData<T> *to )
+{
+	to->setInterpretation( from->getInterpretation() );
+}
+
+/// A functor for use with despatchTypedData, which creates new data by copying elements from
+/// the source data, as specified by an array of indices into that data.
 struct TriangleDataRemap
 {
-	typedef void ReturnType;
+	typedef DataPtr ReturnType;
 
-	TriangleDataRemap( const std::vector<int> &indices ) : m_other(nullptr), m_indices( indices )
+	TriangleDataRemap( const std::vector<int> &indices ) : m_indices( indices )
 	{
 	}
 
-	const Data * m_other;
 	const std::vector<int> &m_indices;
 
 	template<typename T>
-	void operator() ( T * data )
+	ReturnType operator() ( const T *data )
 	{
-		assert( data );
-		typename T::ValueType &dataWritable = data->writable();
-
-		const T * otherData = runTimeCast<const T, const Data>( m_other );
-		assert( otherData );
-		const typename T::ValueType &otherDataReadable = otherData->readable();
+		typedef typename T::ValueType::value_type ValueType;
 
-		dataWritable.clear();
-		dataWritable.reserve( m_indices.size() );
+		typename T::Ptr result = new T;
+		copyInterpretation( data, result.get() );
+		std::vector<ValueType> &resultWritable = result->writable();
+		resultWritable.resize( m_indices.size() );
 
-		for ( std::vector<int>::const_iterator it = m_indices.begin(); it != m_indices.end(); ++it )
+		Remap<ValueType> remap( data->readable(), m_indices, resultWritable );
+		const tbb::blocked_range<size_t> range( 0, m_indices.size() );
+		if( boost::is_same<ValueType, bool>::value )
 		{
-			dataWritable.push_back( otherDataReadable[ *it ] );
+			// std::vector<bool> can't be written concurrently
+			remap( range );
+		}
+		else
+		{
+			tbb::parallel_for( range, remap );
 		}
 
-		assert( dataWritable.size() == m_indices.size() );
+		return result;
 	}
 };
 
-/// A simple class to allow TriangulateOp to operate on either V3fVectorData or V3dVectorData using
-/// despatchTypedData
-struct TriangulateOp::TriangulateFn
+enum TriangulationError
 {
-	typedef void ReturnType;
+	NoError,
+	ConcaveError,
+	NonPlanarError
+};
 
-	MeshPrimitive * m_mesh;
-	float m_tolerance;
-	bool m_throwExceptions;
+/// Records the error for the first invalid face, so that the error reported
+/// doesn't depend on the order in which the faces were processed.
+struct FaceError
+{
 
-	TriangulateFn( MeshPrimitive * mesh, float tolerance, bool throwExceptions )
-	: m_mesh( mesh ), m_tolerance( tolerance ), m_throwExceptions( throwExceptions )
+	FaceError( size_t numFaces )
+		:	type( NoError )
 	{
+		face = numFaces;
 	}
 
-	template<typename T>
-	ReturnType operator()( T * p )
+	void record( size_t faceIndex, TriangulationError errorType )
 	{
-		typedef typename T::ValueType::value_type Vec;
-
-		const typename T::ValueType &pReadable = p->readable();
+		tbb::spin_mutex::scoped_lock lock( mutex );
+		if( faceIndex < face )
+		{
+			face = faceIndex;
+			type = errorType;
+		}
+	}
 
-		MeshPrimitivePtr meshCopy = m_mesh->copy();
+	tbb::spin_mutex mutex;
+	/// May be read without the lock, to skip faces after the
+	/// first invalid one.
+	tbb::atomic<size_t> face;
+	TriangulationError type;
 
-		ConstIntVectorDataPtr verticesPerFace = m_mesh->verticesPerFace();
-		const std::vector<int> &verticesPerFaceReadable = verticesPerFace->readable();
-		ConstIntVectorDataPtr vertexIds = m_mesh->vertexIds();
-		const std::vector<int> &vertexIdsReadable = vertexIds->readable();
+};
 
-		IntVectorDataPtr newVertexIds = new IntVectorData();
-		std::vector<int> &newVertexIdsWritable = newVertexIds->writable();
-		newVertexIdsWritable.reserve( vertexIdsReadable.size() );
+/// Triangulates the faces in a range, writing the results directly
+/// into preallocated arrays at offsets computed up front, so that faces
+/// may be processed in parallel. Errors are recorded rather than thrown
+/// so that the first invalid face can be reported from the calling thread.
+template<typename Vec>
+class TriangulateFaces
+{
 
-		IntVectorDataPtr newVerticesPerFace = new IntVectorData();
-		std::vector<int> &newVerticesPerFaceWritable = newVerticesPerFace->writable();
-		newVerticesPerFaceWritable.reserve( verticesPerFaceReadable.size() );
-
-		std::vector<int> faceVaryingIndices;
-		std::vector<int> uniformIndices;
-		int faceVertexIdStart = 0;
-		int faceIdx = 0;
-		for ( IntVectorData::ValueType::const_iterator it = verticesPerFaceReadable.begin(); it != verticesPerFaceReadable.end(); ++it, ++faceIdx )
+	public :
+
+		TriangulateFaces(
+			const std::vector<Vec> &p, const std::vector<int> &verticesPerFace, const std::vector<int> &vertexIds,
+			const std::vector<int> &faceOffsets, const std::vector<int> &triangleOffsets,
+			float tolerance, bool throwExceptions,
+			std::vector<int> &newVertexIds, std::vector<int> &faceVaryingIndices, std::vector<int> &uniformIndices,
+			FaceError &error
+		)
+			:	m_p( p ), m_verticesPerFace( verticesPerFace ), m_vertexIds( vertexIds ),
+				m_faceOffsets( faceOffsets ), m_triangleOffsets( triangleOffsets ),
+				m_tolerance( tolerance ), m_throwExceptions( throwExceptions ),
+				m_newVertexIds( newVertexIds ), m_faceVaryingIndices( faceVaryingIndices ), m_uniformIndices( uniformIndices ),
+				m_error( error )
 		{
-			int numFaceVerts = *it;
+		}
 
-			if ( numFaceVerts > 3 )
+		void operator()( const tbb::blocked_range<size_t> &r ) const
+		{
+			for( size_t faceIdx = r.begin(); faceIdx != r.end(); ++faceIdx )
 			{
+				if( faceIdx > m_error.face )
+				{
+					// faces are processed in order, so the rest of
+					// the range is after the first invalid face too.
+					return;
+				}
+
+				const int numFaceVerts = m_verticesPerFace[faceIdx];
+				const int faceVertexIdStart = m_faceOffsets[faceIdx];
+				int triangleIdx = m_triangleOffsets[faceIdx];
+
+				if( numFaceVerts == 3 )
+				{
+					addTriangle( triangleIdx, faceIdx, faceVertexIdStart, faceVertexIdStart + 1, faceVertexIdStart + 2 );
+					continue;
+				}
+				else if( numFaceVerts < 3 )
+				{
+					continue;
+				}
+
 				/// For the time being, just do a simple triangle fan.
 
-				const int i0 = faceVertexIdStart + 0;
-				const int v0 = vertexIdsReadable[ i0 ];
+				const int i0 = faceVertexIdStart;
+				const Vec firstTriangleNormal = triangleNormal( m_p[m_vertexIds[i0]], m_p[m_vertexIds[i0+1]], m_p[m_vertexIds[i0+2]] );
 
-				int i1 = faceVertexIdStart + 1;
-				int i2 = faceVertexIdStart + 2;
-				int v1 = vertexIdsReadable[ i1 ];
-				int v2 = vertexIdsReadable[ i2 ];
+				if( m_throwExceptions && !convex( faceVertexIdStart, numFaceVerts, firstTriangleNormal ) )
+				{
+					m_error.record( faceIdx, ConcaveError );
+					return;
+				}
 
-				const Vec firstTriangleNormal = triangleNormal( pReadable[ v0 ], pReadable[ v1 ], pReadable[ v2 ] );
+				if( numFaceVerts == 4 )
+				{
+					if( m_throwExceptions && ( nonPlanar( i0, i0 + 1, i0 + 2, firstTriangleNormal ) || nonPlanar( i0, i0 + 2, i0 + 3, firstTriangleNormal ) ) )
+					{
+						m_error.record( faceIdx, NonPlanarError );
+						return;
+					}
+					addTriangle( triangleIdx++, faceIdx, i0, i0 + 1, i0 + 2 );
+					addTriangle( triangleIdx, faceIdx, i0, i0 + 2, i0 + 3 );
+					continue;
+				}
 
-				if (m_throwExceptions)
+				for( int i = 1; i < numFaceVerts - 1; i++ )
 				{
-					/// Convexivity test - for each edge, all other vertices must be on the same "side" of it
-					for (int i = 0; i < numFaceVerts - 1; i++)
+					const int i1 = faceVertexIdStart + i;
+					const int i2 = faceVertexIdStart + i + 1;
+
+					if( m_throwExceptions && nonPlanar( i0, i1, i2, firstTriangleNormal ) )
 					{
-						const int edgeStartIndex = faceVertexIdStart + i + 0;
-						const int edgeStart = vertexIdsReadable[ edgeStartIndex ];
+						m_error.record( faceIdx, NonPlanarError );
+						return;
+					}
+
+					addTriangle( triangleIdx++, faceIdx, i0, i1, i2 );
+				}
+			}
+		}
 
-						const int edgeEndIndex = faceVertexIdStart + i + 1;
-						const int edgeEnd = vertexIdsReadable[ edgeEndIndex ];
+	private :
 
-						const Vec edge = pReadable[ edgeEnd ] - pReadable[ edgeStart ];
-						const float edgeLength = edge.length();
+		void addTriangle( int triangleIdx, int faceIdx, int i0, int i1, int i2 ) const
+		{
+			int *vertexIds = &m_newVertexIds[triangleIdx*3];
+			vertexIds[0] = m_vertexIds[i0];
+			vertexIds[1] = m_vertexIds[i1];
+			vertexIds[2] = m_vertexIds[i2];
+
+			/// Store the indices required to rebuild the facevarying primvars
+			int *faceVaryingIndices = &m_faceVaryingIndices[triangleIdx*3];
+			faceVaryingIndices[0] = i0;
+			faceVaryingIndices[1] = i1;
+			faceVaryingIndices[2] = i2;
+
+			m_uniformIndices[triangleIdx] = faceIdx;
+		}
 
-						if (edgeLength > m_tolerance)
-						{
-							const Vec edgeDirection = edge / edgeLength;
+		/// Convexivity test - for each edge, all other vertices must be on the same "side" of it
+		bool convex( int faceVertexIdStart, int numFaceVerts, const Vec &normal ) const
+		{
+			for( int i = 0; i < numFaceVerts - 1; i++ )
+			{
+				const int edgeStart = m_vertexIds[faceVertexIdStart + i];
+				const int edgeEnd = m_vertexIds[faceVertexIdStart + i + 1];
 
-							/// Construct a plane whose normal is perpendicular to both the edge and the polygon's normal
-							const Vec planeNormal = edgeDirection.cross( firstTriangleNormal );
-							const float planeConstant = planeNormal.dot( pReadable[ edgeStart ] );
+				const Vec edge = m_p[edgeEnd] - m_p[edgeStart];
+				const float edgeLength = edge.length();
 
-							int sign = 0;
-							bool first = true;
-							for (int j = 0; j < numFaceVerts; j++)
-							{
-								const int testVertexIndex = faceVertexIdStart + j;
-								const int testVertex = vertexIdsReadable[ testVertexIndex ];
+				if( edgeLength > m_tolerance )
+				{
+					const Vec edgeDirection = edge / edgeLength;
+
+					/// Construct a plane whose normal is perpendicular to both the edge and the polygon's normal
+					const Vec planeNormal = edgeDirection.cross( normal );
+					const float planeConstant = planeNormal.dot( m_p[edgeStart] );
 
-								if ( testVertex != edgeStart && testVertex != edgeEnd )
+					int sign = 0;
+					bool first = true;
+					for( int j = 0; j < numFaceVerts; j++ )
+					{
+						const int testVertex = m_vertexIds[faceVertexIdStart + j];
+
+						if( testVertex != edgeStart && testVertex != edgeEnd )
+						{
+							float signedDistance = planeNormal.dot( m_p[testVertex] ) - planeConstant;
+
+							if( fabs( signedDistance ) > m_tolerance )
+							{
+								int thisSign = signedDistance < 0.0 ? -1 : 1;
+								if( first )
 								{
-									float signedDistance = planeNormal.dot( pReadable[ testVertex ] ) - planeConstant;
-
-									if ( fabs(signedDistance) > m_tolerance)
-									{
-										int thisSign = 1;
-										if ( signedDistance < 0.0 )
-										{
-											thisSign = -1;
-										}
-										if (first)
-										{
-											sign = thisSign;
-											first = false;
-										}
-										else if ( thisSign != sign )
-										{
-											assert( sign != 0 );
-											throw InvalidArgumentException("TriangulateOp cannot deal with concave polygons");
-										}
-									}
+									sign = thisSign;
+									first = false;
+								}
+								else if( thisSign != sign )
+								{
+									return false;
 								}
 							}
 						}
 					}
 				}
+			}
+			return true;
+		}
 
-				for (int i = 1; i < numFaceVerts - 1; i++)
-				{
-					i1 = faceVertexIdStart + ( (i + 0) % numFaceVerts );
-					i2 = faceVertexIdStart + ( (i + 1) % numFaceVerts );
-					v1 = vertexIdsReadable[ i1 ];
-					v2 = vertexIdsReadable[ i2 ];
+		bool nonPlanar( int i0, int i1, int i2, const Vec &normal ) const
+		{
+			return fabs( triangleNormal( m_p[m_vertexIds[i0]], m_p[m_vertexIds[i1]], m_p[m_vertexIds[i2]] ).dot( normal ) - 1.0 ) > m_tolerance;
+		}
 
-					if ( m_throwExceptions && fabs( triangleNormal( pReadable[ v0 ], pReadable[ v1 ], pReadable[ v2 ] ).dot( firstTriangleNormal ) - 1.0 ) > m_tolerance )
-					{
-						throw InvalidArgumentException("TriangulateOp cannot deal with non-planar polygons");
-					}
+		const std::vector<Vec> &m_p;
+		const std::vector<int> &m_verticesPerFace;
+		const std::vector<int> &m_vertexIds;
+		const std::vector<int> &m_faceOffsets;
+		const std::vector<int> &m_triangleOffsets;
+		const float m_tolerance;
+		const bool m_throwExceptions;
+		std::vector<int> &m_newVertexIds;
+		std::vector<int> &m_faceVaryingIndices;
+		std::vector<int> &m_uniformIndices;
+		FaceError &m_error;
+
+};
+
+} // namespace
 
-					/// Create a new triangle
-					newVerticesPerFaceWritable.push_back( 3 );
+/// A simple class to allow TriangulateOp to operate on either V3fVectorData or V3dVectorData using
+/// despatchTypedData
+struct TriangulateOp::TriangulateFn
+{
+	typedef void ReturnType;
 
-					/// Triangulate the vertices
-					newVertexIdsWritable.push_back( v0 );
-					newVertexIdsWritable.push_back( v1 );
-					newVertexIdsWritable.push_back( v2 );
+	MeshPrimitive * m_mesh;
+	float m_tolerance;
+	bool m_throwExceptions;
 
-					/// Store the indices required to rebuild the facevarying primvars
-					faceVaryingIndices.push_back( i0 );
-					faceVaryingIndices.push_back( i1 );
-					faceVaryingIndices.push_back( i2 );
+	TriangulateFn( MeshPrimitive * mesh, float tolerance, bool throwExceptions )
+	: m_mesh( mesh ), m_tolerance( tolerance ), m_throwExceptions( throwExceptions )
+	{
+	}
 
-					uniformIndices.push_back( faceIdx );
-				}
-			}
-			else
-			{
-				assert( numFaceVerts == 3 );
+	template<typename T>
+	ReturnType operator()( T * p )
+	{
+		typedef typename T::ValueType::value_type Vec;
 
-				int i0 = faceVertexIdStart + 0;
-				int i1 = faceVertexIdStart + 1;
-				int i2 = faceVertexIdStart + 2;
+		const typename T::ValueType &pReadable = p->readable();
 
-				newVerticesPerFaceWritable.push_back( 3 );
+		ConstIntVectorDataPtr verticesPerFace = m_mesh->verticesPerFace();
+		const std::vector<int> &verticesPerFaceReadable = verticesPerFace->readable();
+		ConstIntVectorDataPtr vertexIds = m_mesh->vertexIds();
+		const std::vector<int> &vertexIdsReadable = vertexIds->readable();
+		const size_t numFaces = verticesPerFaceReadable.size();
 
-				/// Copy across the vertexId data
-				newVertexIdsWritable.push_back( vertexIdsReadable[ i0 ] );
-				newVertexIdsWritable.push_back( vertexIdsReadable[ i1 ] );
-				newVertexIdsWritable.push_back( vertexIdsReadable[ i2 ] );
+		/// Compute the offsets of the first FaceVarying value and the first
+		/// triangle for each face, so faces can be triangulated independently.
+		std::vector<int> faceOffsets;
+		Detail::faceOffsets( verticesPerFaceReadable, faceOffsets );
 
-				/// Store the indices required to rebuild the facevarying primvars
-				faceVaryingIndices.push_back( i0 );
-				faceVaryingIndices.push_back( i1 );
-				faceVaryingIndices.push_back( i2 );
+		std::vector<int> triangleOffsets( numFaces + 1 );
+		int numTriangles = 0;
+		for( size_t i = 0; i < numFaces; ++i )
+		{
+			triangleOffsets[i] = numTriangles;
+			numTriangles += std::max( verticesPerFaceReadable[i] - 2, 0 );
+		}
+		triangleOffsets.back() = numTriangles;
 
-				uniformIndices.push_back( faceIdx );
-			}
+		IntVectorDataPtr newVertexIds = new IntVectorData();
+		std::vector<int> &newVertexIdsWritable = newVertexIds->writable();
+		newVertexIdsWritable.resize( numTriangles * 3 );
 
-			faceVertexIdStart += numFaceVerts;
+		IntVectorDataPtr newVerticesPerFace = new IntVectorData();
+		newVerticesPerFace->writable().resize( numTriangles, 3 );
+
+		std::vector<int> faceVaryingIndices( numTriangles * 3 );
+		std::vector<int> uniformIndices( numTriangles );
+
+		FaceError error( numFaces );
+		tbb::parallel_for(
+			tbb::blocked_range<size_t>( 0, numFaces ),
+			TriangulateFaces<Vec>(
+				pReadable, verticesPerFaceReadable, vertexIdsReadable, faceOffsets, triangleOffsets,
+				m_tolerance, m_throwExceptions,
+				newVertexIdsWritable, faceVaryingIndices, uniformIndices, error
+			)
+		);
+
+		if( error.type == ConcaveError )
+		{
+			throw InvalidArgumentException("TriangulateOp cannot deal with concave polygons");
+		}
+		else if( error.type == NonPlanarError )
+		{
+			throw InvalidArgumentException("TriangulateOp cannot deal with non-planar polygons");
 		}
 
-		m_mesh->setTopology( newVerticesPerFace, newVertexIds, m_mesh->interpolation() );
+		m_mesh->setTopologyUnchecked( newVerticesPerFace, newVertexIds, m_mesh->variableSize( PrimitiveVariable::Vertex ), m_mesh->interpolation() );
 
 		/// Rebuild all the facevarying primvars, using the list of indices into the old data we created above.
 		assert( faceVaryingIndices.size() == newVertexIds->readable().size() );
@@ -314,11 +481,8 @@ struct TriangulateOp::TriangulateFn
 				continue;
 			}
 
-			const Data *inputData = it->second.indices ? it->second.indices.get() : it->second.data.get();
-			DataPtr result = inputData->copy();
-			remap->m_other = inputData;
-
-			despatchTypedData<TriangleDataRemap, TypeTraits::IsVectorTypedData>( result.get(), *remap );
+			Data *inputData = it->second.indices ? it->second.indices.get() : it->second.data.get();
+			DataPtr result = despatchTypedData<TriangleDataRemap, TypeTraits::IsVectorTypedData>( inputData, *remap );
 
 			if( it->second.indices )
 			{
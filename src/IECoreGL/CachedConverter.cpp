@@ -37,8 +37,11 @@
 #include "boost/bind.hpp"
 #include "boost/bind/placeholders.hpp"
 
+#include "tbb/atomic.h"
+
 #include "IECore/LRUCache.h"
 #include "IECore/MurmurHash.h"
+#include "IECore/CacheRegistry.h"
 
 #include "IECoreGL/ToGLConverter.h"
 #include "IECoreGL/CachedConverter.h"
@@ -86,12 +89,22 @@ struct CacheGetterKey
 struct CachedConverter::MemberData
 {
 	MemberData( size_t maxMemory )
-		:	cache( getter, boost::bind( &MemberData::removalCallback, this, ::_1, ::_2 ), maxMemory )
+		:	cache( boost::bind( &MemberData::getter, this, ::_1, ::_2 ), boost::bind( &MemberData::removalCallback, this, ::_1, ::_2 ), maxMemory ),
+			// Value initialisation zeroes the atomic, before the registry
+			// can set it from another thread.
+			budgetedMaxMemory(),
+			registryClient(
+				"IECoreGL::CachedConverter",
+				boost::bind( &Cache::currentCost, &cache ),
+				boost::bind( &MemberData::getBudgetedMaxMemory, this ),
+				boost::bind( &MemberData::setBudgetedMaxMemory, this, ::_1 )
+			)
 	{
 	}
 
-	static IECore::RunTimeTypedPtr getter( const CacheGetterKey &key, size_t &cost )
+	IECore::RunTimeTypedPtr getter( const CacheGetterKey &key, size_t &cost )
 	{
+		registryClient.recordMiss();
 		cost = key.object->memoryUsage();
 		ToGLConverterPtr converter = ToGLConverter::create( key.object );
 		if( !converter )
@@ -112,9 +125,36 @@ struct CachedConverter::MemberData
 		deferredRemovals.push_back( value );
 	}
 
+	// The CacheRegistry may change our limit from any thread, but
+	// removals must only be made from the threads calling convert(),
+	// so we just record the new limit and apply it in convert().
+	size_t getBudgetedMaxMemory() const
+	{
+		const size_t b = budgetedMaxMemory;
+		return b ? b : cache.getMaxCost();
+	}
+
+	void setBudgetedMaxMemory( size_t maxMemory )
+	{
+		budgetedMaxMemory = maxMemory;
+	}
+
+	void applyBudgetedMaxMemory()
+	{
+		const size_t b = budgetedMaxMemory.fetch_and_store( 0 );
+		if( b )
+		{
+			cache.setMaxCost( b );
+		}
+	}
+
 	typedef IECore::LRUCache<IECore::MurmurHash, IECore::RunTimeTypedPtr, IECore::LRUCachePolicy::Parallel, CacheGetterKey> Cache;
 	Cache cache;
 	std::vector<IECore::RunTimeTypedPtr> deferredRemovals;
+	tbb::atomic<size_t> budgetedMaxMemory;
+	// Declared after the cache so that it is deregistered before
+	// the cache is destroyed.
+	IECore::CacheRegistry::Client registryClient;
 
 };
 
@@ -130,7 +170,11 @@ CachedConverter::~CachedConverter()
 
 IECore::ConstRunTimeTypedPtr CachedConverter::convert( const IECore::Object *object )
 {
-	return m_data->cache.get( CacheGetterKey( object ) );
+	m_data->applyBudgetedMaxMemory();
+	m_data->registryClient.recordLookup();
+	IECore::ConstRunTimeTypedPtr result = m_data->cache.get( CacheGetterKey( object ) );
+	m_data->registryClient.memoryAdded();
+	return result;
 }
 
 size_t CachedConverter::getMaxMemory() const
@@ -33,12 +33,24 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <poll.h>
+
 #include "boost/asio.hpp"
 #include "boost/bind.hpp"
 #include "boost/array.hpp"
 
+#include "tbb/concurrent_queue.h"
+#include "tbb/mutex.h"
+#include "tbb/spin_mutex.h"
+#include "tbb/tbb_thread.h"
+
 #include "IECore/SimpleTypedData.h"
 #include "IECore/MemoryIndexedIO.h"
+#include "IECore/MessageHandler.h"
 
 #include "IECoreImage/ClientDisplayDriver.h"
 #include "IECoreImage/Private/DisplayDriverServerHeader.h"
@@ -50,25 +62,202 @@ using namespace Imath;
 using namespace IECore;
 using namespace IECoreImage;
 
+namespace
+{
+
+// Default limit for the number of buckets queued for sending
+// before imageData() blocks.
+const int g_defaultMaxBucketsInFlight = 32;
+
+// Default size for the region shared with servers on the same host.
+const int g_defaultSharedMemorySize = 64 * 1024 * 1024;
+
+// A bucket waiting to be sent, with its header and box followed by the
+// encoded pixels.
+struct Bucket
+{
+	DisplayDriverServerHeader header;
+	Box2i box;
+	std::vector<char> pixels;
+};
+
+} // namespace
+
 class ClientDisplayDriver::PrivateData : public RefCounted
 {
 	public :
 		PrivateData() :
-		m_service(), m_host(""), m_port(""), m_scanLineOrderOnly(false), m_acceptsRepeatedData(false), m_socket( m_service )
+		m_service(), m_host(""), m_port(""), m_scanLineOrderOnly(false), m_acceptsRepeatedData(false), m_socket( m_service ),
+		m_protocolVersion( DisplayDriverServerHeader::minimumProtocolVersion ), m_writePosition( 0 )
 		{
 		}
 
 		~PrivateData() override
 		{
+			stopSending();
 			m_socket.close();
 		}
 
+		// Starts a thread to send the buckets queued by imageData(),
+		// so that rendering can continue while they are sent.
+		void startSending( int maxBucketsInFlight )
+		{
+			m_buckets.set_capacity( maxBucketsInFlight );
+			tbb::tbb_thread senderThread( boost::bind( &PrivateData::sender, this ) );
+			m_senderThread.swap( senderThread );
+		}
+
+		// Waits for all queued buckets to be sent, and stops the thread.
+		void stopSending()
+		{
+			if( m_senderThread.joinable() )
+			{
+				m_buckets.push( nullptr );
+				m_senderThread.join();
+			}
+		}
+
+		// Throws if an error occurred when sending.
+		void checkSendError()
+		{
+			tbb::spin_mutex::scoped_lock lock( m_sendErrorMutex );
+			if( m_sendError.size() )
+			{
+				throw Exception( std::string( "Could not send data to remote display driver server : " ) + m_sendError );
+			}
+		}
+
+		// Copies the bucket into m_sharedMemory and queues a message describing
+		// its location. Returns false if the bucket is too large for the region,
+		// in which case it must be sent over the socket instead.
+		bool queueSharedBucket( const Box2i &box, const float *data, size_t dataSize )
+		{
+			const char *pixels = reinterpret_cast<const char *>( data );
+			size_t size = dataSize * sizeof( float );
+			std::vector<char> encodedPixels;
+			if( !m_encoding.raw() )
+			{
+				m_encoding.encode( data, dataSize, encodedPixels );
+				pixels = encodedPixels.data();
+				size = encodedPixels.size();
+			}
+
+			const size_t capacity = m_sharedMemory->capacity();
+			if( size > capacity )
+			{
+				return false;
+			}
+
+			// The server consumes buckets in the order they are queued, so we must
+			// hold the lock from choosing the position until the bucket is queued.
+			tbb::mutex::scoped_lock lock( m_sharedMemoryMutex );
+
+			// keep buckets aligned to a cache line, and never wrap a bucket
+			// around the end of the region.
+			boost::uint64_t position = ( m_writePosition + 63 ) & ~(boost::uint64_t)63;
+			if( position % capacity + size > capacity )
+			{
+				position += capacity - position % capacity;
+			}
+
+			// wait for the server to consume the buckets we're going to overwrite.
+			while( position + size > m_sharedMemory->readPosition() + capacity )
+			{
+				checkSendError();
+				checkConnection();
+				tbb::this_tbb_thread::sleep( tbb::tick_count::interval_t( 0.0001 ) );
+			}
+
+			memcpy( m_sharedMemory->data() + position % capacity, pixels, size );
+			m_writePosition = position + size;
+
+			DisplayDriverServerSharedMemory::SharedBucket sharedBucket;
+			sharedBucket.offset = position % capacity;
+			sharedBucket.size = size;
+			sharedBucket.endPosition = m_writePosition;
+
+			std::unique_ptr<Bucket> bucket( new Bucket );
+			bucket->box = box;
+			bucket->pixels.assign( reinterpret_cast<const char *>( &sharedBucket ), reinterpret_cast<const char *>( &sharedBucket ) + sizeof( sharedBucket ) );
+			bucket->header = DisplayDriverServerHeader(
+				DisplayDriverServerHeader::imageSharedData,
+				sizeof( box ) + bucket->pixels.size(),
+				m_protocolVersion
+			);
+
+			m_buckets.push( bucket.get() );
+			bucket.release();
+			return true;
+		}
+
 		boost::asio::io_service m_service;
 		std::string m_host;
 		std::string m_port;
 		bool m_scanLineOrderOnly;
 		bool m_acceptsRepeatedData;
 		boost::asio::ip::tcp::socket m_socket;
+		int m_protocolVersion;
+		DisplayDriverServerEncoding m_encoding;
+		tbb::concurrent_bounded_queue<Bucket *> m_buckets;
+		// Used in place of the socket for the pixels when the
+		// server is on the same host.
+		std::unique_ptr<DisplayDriverServerSharedMemory> m_sharedMemory;
+
+	private :
+
+		// The server only writes to the socket after imageData messages if
+		// it has failed, so anything to read means the session is over.
+		void checkConnection()
+		{
+			pollfd fd;
+			fd.fd = m_socket.native();
+			fd.events = POLLIN;
+			fd.revents = 0;
+			if( poll( &fd, 1, 0 ) != 0 )
+			{
+				throw Exception( "Connection to remote display driver server lost." );
+			}
+		}
+
+		void sender()
+		{
+			Bucket *bucket = nullptr;
+			while( true )
+			{
+				m_buckets.pop( bucket );
+				if( !bucket )
+				{
+					return;
+				}
+
+				std::unique_ptr<Bucket> bucketOwner( bucket );
+				try
+				{
+					// gather the header, box and pixels into a single write.
+					boost::array<boost::asio::const_buffer, 3> buffers = { {
+						boost::asio::buffer( bucket->header.buffer(), bucket->header.headerLength ),
+						boost::asio::buffer( &bucket->box, sizeof( bucket->box ) ),
+						boost::asio::buffer( bucket->pixels )
+					} };
+					boost::asio::write( m_socket, buffers );
+				}
+				catch( std::exception &e )
+				{
+					tbb::spin_mutex::scoped_lock lock( m_sendErrorMutex );
+					if( m_sendError.empty() )
+					{
+						m_sendError = e.what();
+					}
+				}
+			}
+		}
+
+		tbb::tbb_thread m_senderThread;
+		tbb::spin_mutex m_sendErrorMutex;
+		std::string m_sendError;
+
+		tbb::mutex m_sharedMemoryMutex;
+		boost::uint64_t m_writePosition;
 };
 
 IE_CORE_DEFINERUNTIMETYPED( ClientDisplayDriver );
@@ -113,8 +302,31 @@ ClientDisplayDriver::ClientDisplayDriver( const Imath::Box2i &displayWindow, con
 
 	IECore::CompoundDataPtr tmpParameters = parameters->copy();
 	tmpParameters->writable()[ "clientPID" ] = new IntData( getpid() );
+	// request the latest protocol, so that the server may agree to
+	// the "displayPixelFormat" and "displayCompression" parameters.
+	tmpParameters->writable()[ "displayProtocolVersion" ] = new IntData( DisplayDriverServerHeader::currentProtocolVersion );
+
+	// offer the server a shared memory region if it is on the same host.
+	const BoolData *sharedMemoryData = parameters->member<BoolData>( "displaySharedMemory" );
+	if( ( !sharedMemoryData || sharedMemoryData->readable() ) && m_data->m_socket.remote_endpoint().address() == m_data->m_socket.local_endpoint().address() )
+	{
+		const IntData *sharedMemorySizeData = parameters->member<IntData>( "displaySharedMemorySize" );
+		try
+		{
+			m_data->m_sharedMemory.reset(
+				new DisplayDriverServerSharedMemory( sharedMemorySizeData ? std::max( 1, sharedMemorySizeData->readable() ) : g_defaultSharedMemorySize )
+			);
+			tmpParameters->writable()[ "displaySharedMemoryFile" ] = new StringData( m_data->m_sharedMemory->fileName() );
+		}
+		catch( const std::exception &e )
+		{
+			// we can still send the pixels over the socket.
+			msg( Msg::Warning, "ClientDisplayDriver", e.what() );
+		}
+	}
 
-	// build the data block
+	// build the data block. The protocol version isn't agreed until the server
+	// replies, so this must use MemoryIndexedIO, which every server can read.
 	io = new MemoryIndexedIO( ConstCharVectorDataPtr(), IndexedIO::rootPath, IndexedIO::Exclusive | IndexedIO::Write );
 	displayWindowData->Object::save( io, "displayWindow" );
 	dataWindowData->Object::save( io, "dataWindow" );
@@ -124,11 +336,13 @@ ClientDisplayDriver::ClientDisplayDriver( const Imath::Box2i &displayWindow, con
 
 	size_t dataSize = buf->readable().size();
 
+	// Older servers only accept version 2 headers, so we open the image with one,
+	// and the server replies with the protocol version it has chosen.
 	sendHeader( DisplayDriverServerHeader::imageOpen, dataSize );
 
 	boost::asio::write( m_data->m_socket, boost::asio::buffer( &(buf->readable()[0]), dataSize ) );
 
-	if ( receiveHeader( DisplayDriverServerHeader::imageOpen ) != sizeof(m_data->m_scanLineOrderOnly) )
+	if ( receiveHeader( DisplayDriverServerHeader::imageOpen, &m_data->m_protocolVersion ) != sizeof(m_data->m_scanLineOrderOnly) )
 	{
 		throw Exception( "Invalid returned scanLineOrder from display driver server!" );
 	}
@@ -139,6 +353,40 @@ ClientDisplayDriver::ClientDisplayDriver( const Imath::Box2i &displayWindow, con
 		throw Exception( "Invalid returned acceptsRepeatedData from display driver server!" );
 	}
 	m_data->m_socket.receive( boost::asio::buffer( &m_data->m_acceptsRepeatedData, sizeof(m_data->m_acceptsRepeatedData) ) );
+
+	// version 3 replies with the encoding, and version 4 adds
+	// whether or not the server has mapped the shared memory.
+	unsigned char encoding[3] = { 0, 0, 0 };
+	if( m_data->m_protocolVersion >= 3 )
+	{
+		const size_t encodingSize = m_data->m_protocolVersion >= 4 ? 3 : 2;
+		if ( receiveHeader( DisplayDriverServerHeader::imageOpen ) != encodingSize )
+		{
+			throw Exception( "Invalid returned encoding from display driver server!" );
+		}
+		boost::asio::read( m_data->m_socket, boost::asio::buffer( encoding, encodingSize ) );
+		m_data->m_encoding = DisplayDriverServerEncoding(
+			(DisplayDriverServerEncoding::PixelFormat)encoding[0],
+			(DisplayDriverServerEncoding::Compression)encoding[1]
+		);
+	}
+
+	if( m_data->m_sharedMemory )
+	{
+		if( encoding[2] )
+		{
+			// the server has its own mapping now, so we don't
+			// need the file any more.
+			m_data->m_sharedMemory->unlink();
+		}
+		else
+		{
+			m_data->m_sharedMemory.reset();
+		}
+	}
+
+	const IntData *maxBucketsInFlightData = parameters->member<IntData>( "displayMaxBucketsInFlight" );
+	m_data->startSending( maxBucketsInFlightData ? std::max( 1, maxBucketsInFlightData->readable() ) : g_defaultMaxBucketsInFlight );
 }
 
 ClientDisplayDriver::~ClientDisplayDriver()
@@ -155,6 +403,11 @@ std::string ClientDisplayDriver::port() const
 	return m_data->m_port;
 }
 
+bool ClientDisplayDriver::sharedMemory() const
+{
+	return m_data->m_sharedMemory != nullptr;
+}
+
 bool ClientDisplayDriver::scanLineOrderOnly() const
 {
 	return m_data->m_scanLineOrderOnly;
@@ -167,11 +420,11 @@ bool ClientDisplayDriver::acceptsRepeatedData() const
 
 void ClientDisplayDriver::sendHeader( int msg, size_t dataSize )
 {
-	DisplayDriverServerHeader header( (DisplayDriverServerHeader::MessageType)msg, dataSize );
+	DisplayDriverServerHeader header( (DisplayDriverServerHeader::MessageType)msg, dataSize, m_data->m_protocolVersion );
 	boost::asio::write( m_data->m_socket, boost::asio::buffer( header.buffer(), header.headerLength ) );
 }
 
-size_t ClientDisplayDriver::receiveHeader( int msg )
+size_t ClientDisplayDriver::receiveHeader( int msg, int *protocolVersion )
 {
 	DisplayDriverServerHeader header;
 	m_data->m_socket.receive( boost::asio::buffer( header.buffer(), header.headerLength ) );
@@ -179,6 +432,10 @@ size_t ClientDisplayDriver::receiveHeader( int msg )
 	{
 		throw Exception( "Invalid display driver header block on socket package." );
 	}
+	if( protocolVersion )
+	{
+		*protocolVersion = header.protocolVersion();
+	}
 	size_t bytesAhead = header.getDataSize();
 
 	if ( header.messageType() == DisplayDriverServerHeader::exception )
@@ -197,17 +454,34 @@ size_t ClientDisplayDriver::receiveHeader( int msg )
 
 void ClientDisplayDriver::imageData( const Box2i &box, const float *data, size_t dataSize )
 {
-	sendHeader( DisplayDriverServerHeader::imageData, sizeof( box ) + dataSize * sizeof( float ) );
+	m_data->checkSendError();
 
-	boost::array<boost::asio::const_buffer, 2> buffers = { {
-		boost::asio::buffer( &box, sizeof( box ) ),
-		boost::asio::buffer( data, dataSize * sizeof( float ) )
-	} };
-	boost::asio::write( m_data->m_socket, buffers );
+	if( m_data->m_sharedMemory && m_data->queueSharedBucket( box, data, dataSize ) )
+	{
+		return;
+	}
+
+	// Encode the bucket on the calling thread, so that buckets from
+	// several render threads are encoded in parallel, then queue it
+	// for sending. This blocks only if too many buckets are queued.
+	std::unique_ptr<Bucket> bucket( new Bucket );
+	bucket->box = box;
+	m_data->m_encoding.encode( data, dataSize, bucket->pixels );
+	bucket->header = DisplayDriverServerHeader(
+		DisplayDriverServerHeader::imageData,
+		sizeof( box ) + bucket->pixels.size(),
+		m_data->m_protocolVersion
+	);
+
+	m_data->m_buckets.push( bucket.get() );
+	bucket.release();
 }
 
 void ClientDisplayDriver::imageClose()
 {
+	m_data->stopSending();
+	m_data->checkSendError();
+
 	sendHeader( DisplayDriverServerHeader::imageClose, 0 );
 	receiveHeader( DisplayDriverServerHeader::imageClose );
 	m_data->m_socket.close();
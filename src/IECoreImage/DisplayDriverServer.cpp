@@ -35,6 +35,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include "boost/asio.hpp"
 #include "boost/bind.hpp"
 #include "tbb/tbb_thread.h"
@@ -70,12 +74,21 @@ class DisplayDriverServer::Session : public RefCounted
 		void handleReadDataParameters( const boost::system::error_code& error );
 		void sendResult( DisplayDriverServerHeader::MessageType msg, size_t dataSize );
 		void sendException( const char *message );
+		// returns true if the client is connected from this host.
+		bool peerIsLocal();
 
 	private:
 		boost::asio::ip::tcp::socket m_socket;
 		DisplayDriverPtr m_displayDriver;
 		DisplayDriverServerHeader m_header;
 		CharVectorDataPtr m_buffer;
+		// protocol version and pixel encoding agreed with the client in imageOpen.
+		int m_protocolVersion;
+		DisplayDriverServerEncoding m_encoding;
+		// reused between imageData messages to hold decoded pixels.
+		std::vector<float> m_decodedData;
+		// pixels for imageSharedData messages, from clients on the same host.
+		std::unique_ptr<DisplayDriverServerSharedMemory> m_sharedMemory;
 };
 
 class DisplayDriverServer::PrivateData : public RefCounted
@@ -87,14 +100,15 @@ class DisplayDriverServer::PrivateData : public RefCounted
 		boost::asio::ip::tcp::endpoint m_endpoint;
 		boost::asio::io_service m_service;
 		boost::asio::ip::tcp::acceptor m_acceptor;
-		tbb::tbb_thread m_thread;
+		// Threads running m_service, so that sessions from several
+		// clients can be serviced concurrently.
+		std::vector<std::unique_ptr<tbb::tbb_thread>> m_threads;
 
 		PrivateData( int portNumber ) :
 			m_success(false),
 			m_endpoint(tcp::v4(), portNumber),
 			m_service(),
-			m_acceptor( m_service ),
-			m_thread()
+			m_acceptor( m_service )
 		{
 			m_acceptor.open(  m_endpoint.protocol() );
 			m_acceptor.set_option( boost::asio::ip::tcp::acceptor::reuse_address(true));
@@ -109,7 +123,10 @@ class DisplayDriverServer::PrivateData : public RefCounted
 			{
 				m_acceptor.cancel();
 				m_acceptor.close();
-				m_thread.join();
+				for( auto &thread : m_threads )
+				{
+					thread->join();
+				}
 			}
 		}
 
@@ -135,8 +152,15 @@ DisplayDriverServer::DisplayDriverServer( int portNumber ) :
 			boost::bind( &DisplayDriverServer::handleAccept, this, newSession,
 			boost::asio::placeholders::error));
 	fixSocketFlags( m_data->m_acceptor.native() );
-	tbb::tbb_thread newThread( boost::bind(&DisplayDriverServer::serverThread, this) );
-	m_data->m_thread.swap( newThread );
+
+	// Each session reads its messages in sequence, so a session is only ever
+	// serviced by one thread at a time, but separate sessions (such as the AOVs
+	// of a render) can be serviced in parallel.
+	const unsigned numThreads = std::min( std::max( tbb::tbb_thread::hardware_concurrency(), 1u ), 8u );
+	for( unsigned i = 0; i < numThreads; ++i )
+	{
+		m_data->m_threads.emplace_back( new tbb::tbb_thread( boost::bind( &DisplayDriverServer::serverThread, this ) ) );
+	}
 }
 
 DisplayDriverServer::~DisplayDriverServer()
@@ -177,7 +201,8 @@ void DisplayDriverServer::handleAccept( DisplayDriverServer::SessionPtr session,
  */
 
 DisplayDriverServer::Session::Session( boost::asio::io_service& io_service ) :
-	m_socket( io_service ), m_displayDriver(nullptr), m_buffer( new CharVectorData( ) )
+	m_socket( io_service ), m_displayDriver(nullptr), m_buffer( new CharVectorData( ) ),
+	m_protocolVersion( DisplayDriverServerHeader::minimumProtocolVersion )
 {
 }
 
@@ -236,6 +261,7 @@ void DisplayDriverServer::Session::handleReadHeader( const boost::system::error_
 		break;
 
 	case DisplayDriverServerHeader::imageData:
+	case DisplayDriverServerHeader::imageSharedData:
 		boost::asio::async_read( m_socket,
 				boost::asio::buffer( &data[0], bytesAhead ),
 				boost::bind(&DisplayDriverServer::Session::handleReadDataParameters, SessionPtr(this),
@@ -299,7 +325,7 @@ void DisplayDriverServer::Session::handleReadOpenParameters( const boost::system
 	// handle imageOpen parameters.
 	try
 	{
-		MemoryIndexedIOPtr io = new MemoryIndexedIO( m_buffer, IndexedIO::rootPath, IndexedIO::Exclusive | IndexedIO::Read );
+		ConstIndexedIOPtr io = new MemoryIndexedIO( m_buffer, IndexedIO::rootPath, IndexedIO::Exclusive | IndexedIO::Read );
 		displayWindow = boost::static_pointer_cast<Box2iData>( Object::load( io, "displayWindow" ) );
 		dataWindow = boost::static_pointer_cast<Box2iData>( Object::load( io, "dataWindow" ) );
 		channelNames = boost::static_pointer_cast<StringVectorData>( Object::load( io, "channelNames" ) );
@@ -307,6 +333,43 @@ void DisplayDriverServer::Session::handleReadOpenParameters( const boost::system
 
 		const StringData *displayType = parameters->member<StringData>( "remoteDisplayType", true /* throw if missing */ );
 
+		// Agree a protocol version with the client, and the encoding for the pixels
+		// if the protocol supports it. Clients which don't request a version get the
+		// original protocol.
+		if( const IntData *protocolVersion = parameters->member<IntData>( "displayProtocolVersion" ) )
+		{
+			m_protocolVersion = std::max<int>(
+				DisplayDriverServerHeader::minimumProtocolVersion,
+				std::min<int>( protocolVersion->readable(), DisplayDriverServerHeader::currentProtocolVersion )
+			);
+		}
+		if( m_protocolVersion >= 3 )
+		{
+			const StringData *pixelFormat = parameters->member<StringData>( "displayPixelFormat" );
+			const StringData *compression = parameters->member<StringData>( "displayCompression" );
+			m_encoding = DisplayDriverServerEncoding(
+				pixelFormat ? pixelFormat->readable() : "float",
+				compression ? compression->readable() : "none"
+			);
+		}
+		if( m_protocolVersion >= 4 )
+		{
+			const StringData *sharedMemoryFile = parameters->member<StringData>( "displaySharedMemoryFile" );
+			if( sharedMemoryFile && peerIsLocal() )
+			{
+				try
+				{
+					m_sharedMemory.reset( new DisplayDriverServerSharedMemory( sharedMemoryFile->readable() ) );
+				}
+				catch( const std::exception &e )
+				{
+					// the file isn't one we can use, so the client
+					// will have to send the pixels over the socket.
+					msg( Msg::Debug, "DisplayDriverServer::Session::handleReadOpenParameters", e.what() );
+				}
+			}
+		}
+
 		// create a displayDriver using the factory function.
 		m_displayDriver = DisplayDriver::create( displayType->readable(), displayWindow->readable(), dataWindow->readable(), channelNames->readable(), parameters );
 
@@ -330,6 +393,18 @@ void DisplayDriverServer::Session::handleReadOpenParameters( const boost::system
 		sendResult( DisplayDriverServerHeader::imageOpen, sizeof(acceptsRepeatedData) );
 		m_socket.send( boost::asio::buffer( &acceptsRepeatedData, sizeof(acceptsRepeatedData) ) );
 
+		if( m_protocolVersion >= 3 )
+		{
+			const unsigned char encoding[3] = {
+				(unsigned char)m_encoding.pixelFormat(),
+				(unsigned char)m_encoding.compression(),
+				(unsigned char)( m_sharedMemory ? 1 : 0 )
+			};
+			const size_t encodingSize = m_protocolVersion >= 4 ? 3 : 2;
+			sendResult( DisplayDriverServerHeader::imageOpen, encodingSize );
+			boost::asio::write( m_socket, boost::asio::buffer( encoding, encodingSize ) );
+		}
+
 		// prepare for getting imageData packages
 		boost::asio::async_read( m_socket,
 			boost::asio::buffer( m_header.buffer(), m_header.headerLength),
@@ -371,12 +446,50 @@ void DisplayDriverServer::Session::handleReadDataParameters( const boost::system
 		/// for us, but the overhead of this significantly affected interactive render
 		/// speeds.
 		const Imath::Box2i box = *reinterpret_cast<const Imath::Box2i *>( &m_buffer->readable()[0] );
-		const float *data = reinterpret_cast<const float *>( &m_buffer->readable()[0] + sizeof( box ) );
-		const size_t dataSize = ( m_buffer->readable().size() - sizeof( box ) ) / sizeof( float );
+		const char *encodedData = &m_buffer->readable()[0] + sizeof( box );
+		size_t encodedSize = m_buffer->readable().size() - sizeof( box );
+
+		// buckets from clients on the same host are found in the shared memory.
+		const DisplayDriverServerSharedMemory::SharedBucket *sharedBucket = nullptr;
+		if( m_header.messageType() == DisplayDriverServerHeader::imageSharedData )
+		{
+			sharedBucket = reinterpret_cast<const DisplayDriverServerSharedMemory::SharedBucket *>( encodedData );
+			if(
+				!m_sharedMemory || encodedSize != sizeof( *sharedBucket ) ||
+				sharedBucket->offset > m_sharedMemory->capacity() ||
+				sharedBucket->size > m_sharedMemory->capacity() - sharedBucket->offset
+			)
+			{
+				throw Exception( "Invalid shared bucket." );
+			}
+			encodedData = m_sharedMemory->data() + sharedBucket->offset;
+			encodedSize = sharedBucket->size;
+		}
+
+		const float *data;
+		size_t dataSize;
+		if( m_encoding.raw() )
+		{
+			// use the pixels in place
+			data = reinterpret_cast<const float *>( encodedData );
+			dataSize = encodedSize / sizeof( float );
+		}
+		else
+		{
+			m_encoding.decode( encodedData, encodedSize, m_decodedData );
+			data = m_decodedData.data();
+			dataSize = m_decodedData.size();
+		}
 
 		// call imageData passing the data
 		m_displayDriver->imageData( box, data, dataSize );
 
+		if( sharedBucket )
+		{
+			// let the client reuse the memory.
+			m_sharedMemory->readPosition() = sharedBucket->endPosition;
+		}
+
 		// prepare for getting more imageData packages or a imageClose.
 		boost::asio::async_read( m_socket,
 			boost::asio::buffer( m_header.buffer(), m_header.headerLength),
@@ -396,7 +509,7 @@ void DisplayDriverServer::Session::handleReadDataParameters( const boost::system
 
 void DisplayDriverServer::Session::sendResult( DisplayDriverServerHeader::MessageType msg, size_t dataSize )
 {
-	DisplayDriverServerHeader header( msg, dataSize );
+	DisplayDriverServerHeader header( msg, dataSize, m_protocolVersion );
 	m_socket.send( boost::asio::buffer( header.buffer(), header.headerLength ) );
 }
 
@@ -406,3 +519,21 @@ void DisplayDriverServer::Session::sendException( const char *message )
 	sendResult( DisplayDriverServerHeader::exception, msgLen );
 	m_socket.send( boost::asio::buffer( message, msgLen ) );
 }
+
+bool DisplayDriverServer::Session::peerIsLocal()
+{
+	// Only a client on this host can share memory with us, and we must never
+	// let a remote client choose a file for us to write to.
+	boost::system::error_code error;
+	const boost::asio::ip::tcp::endpoint remote = m_socket.remote_endpoint( error );
+	if( error )
+	{
+		return false;
+	}
+	const boost::asio::ip::tcp::endpoint local = m_socket.local_endpoint( error );
+	if( error )
+	{
+		return false;
+	}
+	return remote.address() == local.address();
+}
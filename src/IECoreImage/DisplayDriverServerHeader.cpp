@@ -32,6 +32,21 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "zlib.h"
+
+#include "OpenEXR/half.h"
+
+#include "IECore/Exception.h"
+
 #include "IECoreImage/Private/DisplayDriverServerHeader.h"
 
 using namespace IECore;
@@ -52,10 +67,10 @@ DisplayDriverServerHeader::DisplayDriverServerHeader()
 	memset( &m_header[0], 0, sizeof(m_header) );
 }
 
-DisplayDriverServerHeader::DisplayDriverServerHeader( MessageType msg, size_t dataSize )
+DisplayDriverServerHeader::DisplayDriverServerHeader( MessageType msg, size_t dataSize, unsigned char protocolVersion )
 {
 	m_header[orderMagicNumber] = magicNumber;
-	m_header[orderProtocolVersion] = currentProtocolVersion;
+	m_header[orderProtocolVersion] = protocolVersion;
 	m_header[orderMessageType] = msg;
 	setDataSize( dataSize );
 }
@@ -68,11 +83,13 @@ unsigned char *DisplayDriverServerHeader::buffer()
 bool DisplayDriverServerHeader::valid()
 {
 	if ( m_header[orderMagicNumber] != magicNumber ||
-		 m_header[orderProtocolVersion] != currentProtocolVersion ||
+		 m_header[orderProtocolVersion] < minimumProtocolVersion ||
+		 m_header[orderProtocolVersion] > currentProtocolVersion ||
 		( m_header[orderMessageType] != imageOpen &&
 			m_header[orderMessageType] != imageData &&
 			m_header[orderMessageType] != imageClose &&
-			m_header[orderMessageType] != exception ) )
+			m_header[orderMessageType] != exception &&
+			m_header[orderMessageType] != imageSharedData ) )
 	{
 		return false;
 	}
@@ -97,3 +114,281 @@ DisplayDriverServerHeader::MessageType DisplayDriverServerHeader::messageType()
 {
 	return (MessageType)m_header[2];
 }
+
+unsigned char DisplayDriverServerHeader::protocolVersion()
+{
+	return m_header[orderProtocolVersion];
+}
+
+DisplayDriverServerEncoding::DisplayDriverServerEncoding( PixelFormat pixelFormat, Compression compression )
+	:	m_pixelFormat( pixelFormat ), m_compression( compression )
+{
+}
+
+DisplayDriverServerEncoding::DisplayDriverServerEncoding( const std::string &pixelFormat, const std::string &compression )
+	:	m_pixelFormat( pixelFormat == "half" ? halfFormat : floatFormat ),
+		m_compression( compression == "zip" ? zipCompression : noCompression )
+{
+}
+
+DisplayDriverServerEncoding::PixelFormat DisplayDriverServerEncoding::pixelFormat() const
+{
+	return m_pixelFormat;
+}
+
+DisplayDriverServerEncoding::Compression DisplayDriverServerEncoding::compression() const
+{
+	return m_compression;
+}
+
+bool DisplayDriverServerEncoding::raw() const
+{
+	return m_pixelFormat == floatFormat && m_compression == noCompression;
+}
+
+void DisplayDriverServerEncoding::encode( const float *data, size_t dataSize, std::vector<char> &buffer ) const
+{
+	const char *pixels = reinterpret_cast<const char *>( data );
+	size_t pixelsSize = dataSize * sizeof( float );
+
+	std::vector<half> halfData;
+	if( m_pixelFormat == halfFormat )
+	{
+		halfData.resize( dataSize );
+		for( size_t i = 0; i < dataSize; ++i )
+		{
+			halfData[i] = data[i];
+		}
+		pixels = reinterpret_cast<const char *>( halfData.data() );
+		pixelsSize = dataSize * sizeof( half );
+	}
+
+	if( m_compression == noCompression )
+	{
+		buffer.insert( buffer.end(), pixels, pixels + pixelsSize );
+		return;
+	}
+
+	const size_t offset = buffer.size();
+	uLongf compressedSize = compressBound( pixelsSize );
+	buffer.resize( offset + 4 + compressedSize );
+
+	unsigned char *sizeBytes = reinterpret_cast<unsigned char *>( &buffer[offset] );
+	sizeBytes[0] = pixelsSize & 0xff;
+	sizeBytes[1] = ( pixelsSize >> 8 ) & 0xff;
+	sizeBytes[2] = ( pixelsSize >> 16 ) & 0xff;
+	sizeBytes[3] = ( pixelsSize >> 24 ) & 0xff;
+
+	// we favour speed over size, as the point is to reduce latency
+	if( compress2( reinterpret_cast<Bytef *>( &buffer[offset + 4] ), &compressedSize, reinterpret_cast<const Bytef *>( pixels ), pixelsSize, Z_BEST_SPEED ) != Z_OK )
+	{
+		throw Exception( "DisplayDriverServerEncoding : Failed to compress pixels." );
+	}
+
+	buffer.resize( offset + 4 + compressedSize );
+}
+
+void DisplayDriverServerEncoding::decode( const char *data, size_t size, std::vector<float> &result ) const
+{
+	const char *pixels = data;
+	size_t pixelsSize = size;
+
+	std::vector<char> uncompressed;
+	if( m_compression == zipCompression )
+	{
+		if( size < 4 )
+		{
+			throw Exception( "DisplayDriverServerEncoding : Invalid compressed pixels." );
+		}
+
+		const unsigned char *sizeBytes = reinterpret_cast<const unsigned char *>( data );
+		uLongf uncompressedSize = (unsigned int)sizeBytes[0] | ( (unsigned int)sizeBytes[1] << 8 ) |
+			( (unsigned int)sizeBytes[2] << 16 ) | ( (unsigned int)sizeBytes[3] << 24 );
+
+		uncompressed.resize( uncompressedSize );
+		if(
+			uncompress( reinterpret_cast<Bytef *>( uncompressed.data() ), &uncompressedSize, reinterpret_cast<const Bytef *>( data + 4 ), size - 4 ) != Z_OK ||
+			uncompressedSize != uncompressed.size()
+		)
+		{
+			throw Exception( "DisplayDriverServerEncoding : Failed to uncompress pixels." );
+		}
+
+		pixels = uncompressed.data();
+		pixelsSize = uncompressed.size();
+	}
+
+	if( m_pixelFormat == halfFormat )
+	{
+		const half *halfData = reinterpret_cast<const half *>( pixels );
+		result.resize( pixelsSize / sizeof( half ) );
+		for( size_t i = 0, e = result.size(); i < e; ++i )
+		{
+			result[i] = halfData[i];
+		}
+	}
+	else
+	{
+		result.resize( pixelsSize / sizeof( float ) );
+		memcpy( result.data(), pixels, result.size() * sizeof( float ) );
+	}
+}
+
+// The region starts with the read position, padded to keep
+// the pixels aligned to a cache line.
+static const size_t g_sharedMemoryHeaderSize = 64;
+
+// Regions are created by mkstemp() with this name, in one of the directories below.
+static const char *g_sharedMemoryFilePrefix = "cortexDisplayDriver.";
+static const char *g_sharedMemoryFileSuffix = "XXXXXX";
+
+static const char *sharedMemoryDirectory()
+{
+	// Prefer a memory backed filesystem, so the pixels never reach a disk.
+	return access( "/dev/shm", W_OK ) == 0 ? "/dev/shm" : P_tmpdir;
+}
+
+// Returns true if fileName could have been made by the client constructor. The server
+// writes to the region, so it must never be persuaded to open any other file.
+static bool validSharedMemoryFileName( const std::string &fileName )
+{
+	const size_t slash = fileName.rfind( '/' );
+	if( slash == std::string::npos )
+	{
+		return false;
+	}
+
+	const std::string directory = fileName.substr( 0, slash );
+	if( directory != "/dev/shm" && directory != P_tmpdir )
+	{
+		return false;
+	}
+
+	const std::string prefix = g_sharedMemoryFilePrefix;
+	const std::string name = fileName.substr( slash + 1 );
+	if( name.size() != prefix.size() + strlen( g_sharedMemoryFileSuffix ) || name.compare( 0, prefix.size(), prefix ) != 0 )
+	{
+		return false;
+	}
+
+	for( size_t i = prefix.size(); i < name.size(); ++i )
+	{
+		if( !isalnum( (unsigned char)name[i] ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+DisplayDriverServerSharedMemory::DisplayDriverServerSharedMemory( size_t size )
+	:	m_owner( true ), m_map( nullptr ), m_mapSize( size + g_sharedMemoryHeaderSize )
+{
+	const char *directory = sharedMemoryDirectory();
+	std::string fileName = std::string( directory ) + "/" + g_sharedMemoryFilePrefix + g_sharedMemoryFileSuffix;
+
+	int fd = mkstemp( &fileName[0] );
+	if( fd < 0 )
+	{
+		throw IOException( "DisplayDriverServerSharedMemory : Unable to create file in \"" + std::string( directory ) + "\"" );
+	}
+	m_fileName = fileName;
+
+	if( ftruncate( fd, m_mapSize ) == 0 )
+	{
+		void *map = mmap( nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		if( map != MAP_FAILED )
+		{
+			m_map = static_cast<char *>( map );
+		}
+	}
+	// the mapping remains valid after the file is closed.
+	close( fd );
+
+	if( !m_map )
+	{
+		::unlink( m_fileName.c_str() );
+		throw IOException( "DisplayDriverServerSharedMemory : Unable to map \"" + m_fileName + "\"" );
+	}
+}
+
+DisplayDriverServerSharedMemory::DisplayDriverServerSharedMemory( const std::string &fileName )
+	:	m_fileName( fileName ), m_owner( false ), m_map( nullptr ), m_mapSize( 0 )
+{
+	if( !validSharedMemoryFileName( fileName ) )
+	{
+		throw IOException( "DisplayDriverServerSharedMemory : \"" + fileName + "\" is not a shared memory file" );
+	}
+
+	// Don't follow symbolic links, and don't block if we're given a fifo.
+	int fd = open( fileName.c_str(), O_RDWR | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC );
+	if( fd < 0 )
+	{
+		throw IOException( "DisplayDriverServerSharedMemory : Unable to open \"" + fileName + "\"" );
+	}
+
+	// Only accept a file made by mkstemp() in a process belonging to
+	// the same user, and which isn't a hard link to some other file.
+	struct stat fileStat;
+	if(
+		fstat( fd, &fileStat ) != 0 ||
+		!S_ISREG( fileStat.st_mode ) || fileStat.st_uid != geteuid() ||
+		( fileStat.st_mode & ( S_IRWXG | S_IRWXO ) ) || fileStat.st_nlink != 1
+	)
+	{
+		close( fd );
+		throw IOException( "DisplayDriverServerSharedMemory : \"" + fileName + "\" is not a shared memory file" );
+	}
+
+	if( (size_t)fileStat.st_size > g_sharedMemoryHeaderSize )
+	{
+		void *map = mmap( nullptr, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		if( map != MAP_FAILED )
+		{
+			m_map = static_cast<char *>( map );
+			m_mapSize = fileStat.st_size;
+		}
+	}
+	close( fd );
+
+	if( !m_map )
+	{
+		throw IOException( "DisplayDriverServerSharedMemory : Unable to map \"" + fileName + "\"" );
+	}
+}
+
+DisplayDriverServerSharedMemory::~DisplayDriverServerSharedMemory()
+{
+	munmap( m_map, m_mapSize );
+	unlink();
+}
+
+const std::string &DisplayDriverServerSharedMemory::fileName() const
+{
+	return m_fileName;
+}
+
+void DisplayDriverServerSharedMemory::unlink()
+{
+	if( m_owner )
+	{
+		::unlink( m_fileName.c_str() );
+		m_owner = false;
+	}
+}
+
+size_t DisplayDriverServerSharedMemory::capacity() const
+{
+	return m_mapSize - g_sharedMemoryHeaderSize;
+}
+
+char *DisplayDriverServerSharedMemory::data()
+{
+	return m_map + g_sharedMemoryHeaderSize;
+}
+
+tbb::atomic<boost::uint64_t> &DisplayDriverServerSharedMemory::readPosition()
+{
+	return *reinterpret_cast<tbb::atomic<boost::uint64_t> *>( m_map );
+}
@@ -32,7 +32,12 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include "tbb/atomic.h"
+#include "tbb/blocked_range.h"
 #include "tbb/mutex.h"
+#include "tbb/parallel_for.h"
+#include "tbb/spin_mutex.h"
+#include "tbb/spin_rw_mutex.h"
 
 #include "boost/algorithm/string/predicate.hpp"
 
@@ -44,27 +49,346 @@ using namespace Imath;
 using namespace IECore;
 using namespace IECoreImage;
 
+//////////////////////////////////////////////////////////////////////////
+// Internal utilities
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+const int g_tileSize = 64;
+
+// Copies a rectangle of interleaved pixels into separate planes for each
+// channel. Specialised for the common channel counts, so that the inner
+// loop can be unrolled and vectorised by the compiler.
+template<int N>
+void deinterleave( const float *source, size_t sourceStride, int width, int height, float *target, size_t planeStride, size_t targetStride )
+{
+	for( int y = 0; y < height; ++y )
+	{
+		const float *s = source + y * sourceStride;
+		float *t = target + y * targetStride;
+		for( int x = 0; x < width; ++x )
+		{
+			for( int c = 0; c < N; ++c )
+			{
+				t[c * planeStride + x] = s[x * N + c];
+			}
+		}
+	}
+}
+
+void deinterleave( int numChannels, const float *source, size_t sourceStride, int width, int height, float *target, size_t planeStride, size_t targetStride )
+{
+	switch( numChannels )
+	{
+		case 1 :
+			deinterleave<1>( source, sourceStride, width, height, target, planeStride, targetStride );
+			break;
+		case 2 :
+			deinterleave<2>( source, sourceStride, width, height, target, planeStride, targetStride );
+			break;
+		case 3 :
+			deinterleave<3>( source, sourceStride, width, height, target, planeStride, targetStride );
+			break;
+		case 4 :
+			deinterleave<4>( source, sourceStride, width, height, target, planeStride, targetStride );
+			break;
+		default :
+			for( int c = 0; c < numChannels; ++c )
+			{
+				for( int y = 0; y < height; ++y )
+				{
+					const float *s = source + y * sourceStride + c;
+					float *t = target + c * planeStride + y * targetStride;
+					for( int x = 0; x < width; ++x, s += numChannels )
+					{
+						t[x] = *s;
+					}
+				}
+			}
+	}
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+// TileStore
+//////////////////////////////////////////////////////////////////////////
+
+// Stores the image as a grid of tiles, each holding a plane of pixels for
+// every channel. Tiles are shared with snapshots rather than copied, and
+// are only copied if they are written to while a snapshot references them.
+// Writers share a lock, so that buckets may be written concurrently, and
+// snapshots take it exclusively so they never see a partially written
+// bucket. Once the image has been closed, the final snapshot is taken and
+// the tiles are released, so that only the ImagePrimitive remains.
+class ImageDisplayDriver::TileStore : public RefCounted
+{
+
+	public :
+
+		TileStore( const Box2i &displayWindow, const Box2i &dataWindow, const vector<string> &channelNames )
+			:	m_image( new ImagePrimitive( dataWindow, displayWindow ) ), m_dataWindow( dataWindow ), m_channelNames( channelNames ),
+				m_numTiles( ( dataWindow.size() + V2i( g_tileSize ) ) / g_tileSize ),
+				m_tiles( m_numTiles.x * m_numTiles.y ), m_tileMutexes( m_tiles.size() ), m_dirty( m_tiles.size(), 0 )
+		{
+			m_anyDirty = false;
+			m_closed = false;
+			for( const auto &name : m_channelNames )
+			{
+				m_image->createChannel<float>( name );
+			}
+		}
+
+		// May only be used before any other method is called.
+		CompoundData *blindData()
+		{
+			return m_image->blindData();
+		}
+
+		void write( const Box2i &box, const float *data )
+		{
+			const int numChannels = m_channelNames.size();
+			const size_t boxWidth = box.size().x + 1;
+			const V2i minTile = ( box.min - m_dataWindow.min ) / g_tileSize;
+			const V2i maxTile = ( box.max - m_dataWindow.min ) / g_tileSize;
+
+			tbb::spin_rw_mutex::scoped_lock lock( m_mutex, /* write = */ false );
+			if( m_closed )
+			{
+				throw Exception( "ImageDisplayDriver : imageData() called after imageClose()." );
+			}
+
+			for( int ty = minTile.y; ty <= maxTile.y; ++ty )
+			{
+				for( int tx = minTile.x; tx <= maxTile.x; ++tx )
+				{
+					const V2i origin = m_dataWindow.min + V2i( tx, ty ) * g_tileSize;
+					const Box2i region(
+						V2i( std::max( box.min.x, origin.x ), std::max( box.min.y, origin.y ) ),
+						V2i( std::min( box.max.x, origin.x + g_tileSize - 1 ), std::min( box.max.y, origin.y + g_tileSize - 1 ) )
+					);
+
+					const size_t index = ty * m_numTiles.x + tx;
+					tbb::spin_mutex::scoped_lock tileLock( m_tileMutexes[index] );
+
+					TilePtr &tile = m_tiles[index];
+					if( !tile )
+					{
+						tile = new Tile( vector<float>( g_tileSize * g_tileSize * numChannels, 0.0f ) );
+					}
+					else if( tile->refCount() > 1 )
+					{
+						// referenced by a snapshot in progress
+						tile = new Tile( tile->pixels );
+					}
+
+					const float *source = data + ( ( region.min.y - box.min.y ) * boxWidth + ( region.min.x - box.min.x ) ) * numChannels;
+					float *target = &tile->pixels[( region.min.y - origin.y ) * g_tileSize + ( region.min.x - origin.x )];
+					deinterleave(
+						numChannels, source, boxWidth * numChannels,
+						region.size().x + 1, region.size().y + 1,
+						target, g_tileSize * g_tileSize, g_tileSize
+					);
+
+					m_dirty[index] = 1;
+				}
+			}
+
+			m_anyDirty = true;
+		}
+
+		ConstImagePrimitivePtr image()
+		{
+			tbb::mutex::scoped_lock imageLock( m_imageMutex );
+			return updateImage();
+		}
+
+		// Updates the image with the final contents of the tiles,
+		// and releases them.
+		void close()
+		{
+			{
+				tbb::spin_rw_mutex::scoped_lock lock( m_mutex, /* write = */ true );
+				if( m_closed )
+				{
+					return;
+				}
+				m_closed = true;
+			}
+
+			tbb::mutex::scoped_lock imageLock( m_imageMutex );
+			updateImage();
+
+			vector<TilePtr> tiles;
+			{
+				tbb::spin_rw_mutex::scoped_lock lock( m_mutex, /* write = */ true );
+				tiles.swap( m_tiles );
+			}
+		}
+
+	private :
+
+		// Must be called with m_imageMutex held.
+		ConstImagePrimitivePtr updateImage()
+		{
+			// If nothing has been written since the last snapshot, we can return
+			// it without blocking the writers. A write in progress will set
+			// m_anyDirty when it completes, and be picked up by the next call.
+			if( !m_anyDirty )
+			{
+				return m_image;
+			}
+
+			// Take references to the tiles modified since the last snapshot, so
+			// that any concurrent writes copy them rather than modifying them
+			// while we read.
+			vector<size_t> indices;
+			vector<ConstTilePtr> tiles;
+			{
+				tbb::spin_rw_mutex::scoped_lock lock( m_mutex, /* write = */ true );
+				m_anyDirty = false;
+				for( size_t i = 0, e = m_dirty.size(); i < e; ++i )
+				{
+					if( m_dirty[i] )
+					{
+						indices.push_back( i );
+						tiles.push_back( m_tiles[i] );
+						m_dirty[i] = 0;
+					}
+				}
+			}
+
+			if( indices.empty() )
+			{
+				return m_image;
+			}
+
+			if( m_image->refCount() > 1 )
+			{
+				// The previous snapshot is still in use, so we
+				// mustn't modify it.
+				m_image = m_image->copy();
+			}
+
+			vector<float *> channels;
+			for( const auto &name : m_channelNames )
+			{
+				channels.push_back( static_cast<FloatVectorData *>( m_image->channels[name].get() )->baseWritable() );
+			}
+
+			tbb::parallel_for( tbb::blocked_range<size_t>( 0, indices.size() ), TileCopier( this, indices, tiles, channels ) );
+
+			return m_image;
+		}
+
+		struct Tile : public RefCounted
+		{
+			Tile( const vector<float> &pixels )
+				:	pixels( pixels )
+			{
+			}
+
+			vector<float> pixels;
+		};
+
+		IE_CORE_DECLAREPTR( Tile );
+
+		// Copies tiles into the channels of the image.
+		class TileCopier
+		{
+
+			public :
+
+				TileCopier( const TileStore *store, const vector<size_t> &indices, const vector<ConstTilePtr> &tiles, const vector<float *> &channels )
+					:	m_store( store ), m_indices( indices ), m_tiles( tiles ), m_channels( channels )
+				{
+				}
+
+				void operator()( const tbb::blocked_range<size_t> &range ) const
+				{
+					const Box2i &dataWindow = m_store->m_dataWindow;
+					const size_t imageWidth = dataWindow.size().x + 1;
+
+					for( size_t i = range.begin(); i != range.end(); ++i )
+					{
+						const int tx = m_indices[i] % m_store->m_numTiles.x;
+						const int ty = m_indices[i] / m_store->m_numTiles.x;
+						const V2i origin = dataWindow.min + V2i( tx, ty ) * g_tileSize;
+						const int width = std::min( g_tileSize, dataWindow.max.x - origin.x + 1 );
+						const int height = std::min( g_tileSize, dataWindow.max.y - origin.y + 1 );
+
+						const float *source = &m_tiles[i]->pixels[0];
+						for( size_t c = 0, ce = m_channels.size(); c < ce; ++c )
+						{
+							float *target = m_channels[c] + ( origin.y - dataWindow.min.y ) * imageWidth + ( origin.x - dataWindow.min.x );
+							for( int y = 0; y < height; ++y )
+							{
+								std::copy( source + y * g_tileSize, source + y * g_tileSize + width, target + y * imageWidth );
+							}
+							source += g_tileSize * g_tileSize;
+						}
+					}
+				}
+
+			private :
+
+				const TileStore *m_store;
+				const vector<size_t> &m_indices;
+				const vector<ConstTilePtr> &m_tiles;
+				const vector<float *> &m_channels;
+
+		};
+
+		// Protected by m_imageMutex.
+		ImagePrimitivePtr m_image;
+		tbb::mutex m_imageMutex;
+
+		const Box2i m_dataWindow;
+		const vector<string> m_channelNames;
+		const V2i m_numTiles;
+
+		// Held for reading by writers, and for writing
+		// while taking a snapshot.
+		tbb::spin_rw_mutex m_mutex;
+		// Each tile is protected by its own mutex while writing.
+		vector<TilePtr> m_tiles;
+		vector<tbb::spin_mutex> m_tileMutexes;
+		// Modified tiles. We avoid vector<bool> because its elements
+		// can't be written concurrently.
+		vector<char> m_dirty;
+		// True if any element of m_dirty is set.
+		tbb::atomic<bool> m_anyDirty;
+		// Set by close(), after which the tiles are released
+		// and no more writes are accepted.
+		bool m_closed;
+
+};
+
+//////////////////////////////////////////////////////////////////////////
+// ImageDisplayDriver
+//////////////////////////////////////////////////////////////////////////
+
 IE_CORE_DEFINERUNTIMETYPED( ImageDisplayDriver );
 
 const DisplayDriver::DisplayDriverDescription<ImageDisplayDriver> ImageDisplayDriver::g_description;
 
-typedef std::map<std::string, ConstImagePrimitivePtr> ImagePool;
+// The pool holds the TileStore for each image, so that stored images
+// may be retrieved while rendering is still in progress.
+typedef std::map<std::string, RefCountedPtr> ImagePool;
 static ImagePool g_pool;
 static tbb::mutex g_poolMutex;
 
 ImageDisplayDriver::ImageDisplayDriver( const Box2i &displayWindow, const Box2i &dataWindow, const vector<string> &channelNames, ConstCompoundDataPtr parameters ) :
 		DisplayDriver( displayWindow, dataWindow, channelNames, parameters ),
-		m_image( new ImagePrimitive( dataWindow, displayWindow ) )
+		m_tileStore( new TileStore( displayWindow, dataWindow, channelNames ) )
 {
-	for ( vector<string>::const_iterator it = channelNames.begin(); it != channelNames.end(); it++ )
-	{
-		m_image->createChannel<float>( *it );
-	}
 	if( parameters )
 	{
 		// Add all entries that follow our 'header:' metadata convention to the blindData.
 		// Other entries are omitted.
-		CompoundDataMap &xData = m_image->blindData()->writable();
+		CompoundDataMap &xData = m_tileStore->blindData()->writable();
 		const CompoundDataMap &yData = parameters->readable();
 		CompoundDataMap::const_iterator iterY = yData.begin();
 		for ( ; iterY != yData.end(); iterY++ )
@@ -79,7 +403,7 @@ ImageDisplayDriver::ImageDisplayDriver( const Box2i &displayWindow, const Box2i
 		if( handle )
 		{
 			tbb::mutex::scoped_lock lock( g_poolMutex );
-			g_pool[handle->readable()] = m_image;
+			g_pool[handle->readable()] = m_tileStore;
 		}
 	}
 }
@@ -101,78 +425,58 @@ bool ImageDisplayDriver::acceptsRepeatedData() const
 void ImageDisplayDriver::imageData( const Box2i &box, const float *data, size_t dataSize )
 {
 	Box2i tmpBox = box;
-	Box2i dataWindow = m_image->getDataWindow();
+	Box2i dataWindow = this->dataWindow();
 	tmpBox.extendBy( dataWindow );
 	if ( tmpBox != dataWindow )
 	{
 		throw Exception("The box is outside image data window.");
 	}
 
-	int pixelSize = channelNames().size();
 	if ( dataSize != (box.max.x - box.min.x + 1) * (box.max.y - box.min.y + 1) * channelNames().size() )
 	{
 		throw Exception("Invalid dataSize value.");
 	}
 
-	int channelId, targetX, targetY, sourceWidth, sourceHeight, targetWidth;
-	sourceWidth = box.max.x - box.min.x + 1;
-	sourceHeight = box.max.y - box.min.y + 1;
-	targetWidth = dataWindow.max.x - dataWindow.min.x + 1;
-	channelId = 0;
-	targetX = box.min.x - dataWindow.min.x;
-	targetY = box.min.y - dataWindow.min.y;
-
-	for( const auto &name : channelNames() )
-	{
-		vector< float > &target = boost::static_pointer_cast< FloatVectorData >( m_image->channels[name] )->writable();
-		vector< float >::iterator targetIt;
-		const float *sourceIt = data+channelId;
-		targetIt = target.begin()+targetWidth*targetY+targetX;
-
-		for ( int y = 0; y < sourceHeight; y++ )
-		{
-			for ( int x = 0; x < sourceWidth; x++ )
-			{
-				*targetIt = *sourceIt;
-				sourceIt += pixelSize;
-				targetIt++;
-			}
-			targetIt += targetWidth - sourceWidth;
-		}
-
-		++channelId;
-	}
+	m_tileStore->write( box, data );
 }
 
 void ImageDisplayDriver::imageClose()
 {
+	m_tileStore->close();
 }
 
 ConstImagePrimitivePtr ImageDisplayDriver::image() const
 {
-	return m_image;
+	return m_tileStore->image();
 }
 
 ConstImagePrimitivePtr ImageDisplayDriver::storedImage( const std::string &handle )
 {
-	tbb::mutex::scoped_lock lock( g_poolMutex );
-	ImagePool::const_iterator it = g_pool.find( handle );
-	if( it != g_pool.end() )
+	TileStorePtr tileStore;
 	{
-		return it->second;
+		tbb::mutex::scoped_lock lock( g_poolMutex );
+		ImagePool::const_iterator it = g_pool.find( handle );
+		if( it == g_pool.end() )
+		{
+			return nullptr;
+		}
+		tileStore = static_cast<TileStore *>( it->second.get() );
 	}
-	return nullptr;
+	return tileStore->image();
 }
 
 ConstImagePrimitivePtr ImageDisplayDriver::removeStoredImage( const std::string &handle )
 {
-	ConstImagePrimitivePtr result = nullptr;
-	tbb::mutex::scoped_lock lock( g_poolMutex );
-	ImagePool::iterator it = g_pool.find( handle );
-	if( it != g_pool.end() )
+	TileStorePtr tileStore;
 	{
-		result = it->second;
+		tbb::mutex::scoped_lock lock( g_poolMutex );
+		ImagePool::iterator it = g_pool.find( handle );
+		if( it == g_pool.end() )
+		{
+			return nullptr;
+		}
+		tileStore = static_cast<TileStore *>( it->second.get() );
 		g_pool.erase( it );
 	}
-	return result;
+	return tileStore->image();
 }
@@ -32,8 +32,15 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include "boost/algorithm/string/join.hpp"
 #include "boost/tokenizer.hpp"
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/spin_mutex.h"
+
+#include "OpenImageIO/color.h"
+#include "OpenImageIO/imagebufalgo.h"
 #include "OpenImageIO/imagecache.h"
 #include "OpenImageIO/imageio.h"
 OIIO_NAMESPACE_USING
@@ -57,6 +64,143 @@ using namespace IECoreImage;
 
 IE_CORE_DEFINERUNTIMETYPED( ImageReader );
 
+////////////////////////////////////////////////////////////////////////////////
+// Internal utilities
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Scanline images are presented by the ImageCache as bands of
+// this many scanlines, so that the bands may be decoded concurrently.
+const int g_autoTileSize = 64;
+
+int floorDivide( int a, int b )
+{
+	return a >= 0 ? a / b : -( ( b - 1 - a ) / b );
+}
+
+// Reads a range of horizontal bands of an image, where each band is aligned
+// with a row of tiles in the ImageCache. All the requested channels are fetched
+// with a single call per band, then deinterleaved into their destinations and
+// colour converted while the pixels are still in cache.
+template<typename T>
+class BandReader
+{
+
+	public :
+
+		BandReader(
+			ImageCache *cache, ustring fileName, const Box2i &window, int bandOrigin, int bandHeight,
+			int channelBegin, int channelEnd, TypeDesc format,
+			const vector<int> &channelIndices, const vector<T *> &channels,
+			const vector<bool> &transform, const ColorProcessor *processor,
+			tbb::spin_mutex &errorMutex, string &error
+		)
+			:	m_cache( cache ), m_fileName( fileName ), m_window( window ), m_bandOrigin( bandOrigin ), m_bandHeight( bandHeight ),
+				m_channelBegin( channelBegin ), m_channelEnd( channelEnd ), m_format( format ),
+				m_channelIndices( channelIndices ), m_channels( channels ),
+				m_transform( transform ), m_processor( processor ),
+				m_errorMutex( errorMutex ), m_error( error )
+		{
+		}
+
+		void operator()( const tbb::blocked_range<int> &range ) const
+		{
+			const int width = m_window.size().x + 1;
+			const int numChannels = m_channelEnd - m_channelBegin;
+			vector<T> buffer;
+
+			for( int band = range.begin(); band != range.end(); ++band )
+			{
+				const int yBegin = std::max( m_bandOrigin + band * m_bandHeight, m_window.min.y );
+				const int yEnd = std::min( m_bandOrigin + ( band + 1 ) * m_bandHeight, m_window.max.y + 1 );
+				const size_t numPixels = (size_t)width * ( yEnd - yBegin );
+
+				buffer.resize( numPixels * numChannels );
+				bool status = m_cache->get_pixels(
+					m_fileName,
+					0, 0, // subimage, miplevel
+					m_window.min.x, m_window.max.x + 1,
+					yBegin, yEnd,
+					0, 1, // z begin, z end
+					m_channelBegin, m_channelEnd,
+					/* format */ m_format,
+					/* data */ &buffer[0]
+				);
+
+				if( !status )
+				{
+					// ImageCache errors are stored per thread, so
+					// we must retrieve the message here.
+					setError( m_cache->geterror() );
+					return;
+				}
+
+				const size_t offset = (size_t)width * ( yBegin - m_window.min.y );
+				for( size_t c = 0, ce = m_channels.size(); c < ce; ++c )
+				{
+					const T *src = &buffer[m_channelIndices[c] - m_channelBegin];
+					T *dst = m_channels[c] + offset;
+					for( size_t i = 0; i < numPixels; ++i, src += numChannels )
+					{
+						dst[i] = *src;
+					}
+
+					if( m_processor && m_transform[c] )
+					{
+						// present the band as a single channel, single scanline image
+						ImageSpec spec( (int)numPixels, 1, 1, m_format );
+						ImageBuf imageBuf( spec, dst );
+						ROI roi(
+							/* xbegin */ 0, /* xend */ (int)numPixels,
+							/* ybegin */ 0, /* yend */ 1,
+							/* zbegin */ 0, /* zend */ 1,
+							/* chbegin */ 0, /* chend */ 1
+						);
+
+						// convert in-place, using only this thread as
+						// we are already running in parallel.
+						if( !ImageBufAlgo::colorconvert( imageBuf, imageBuf, m_processor, /* unpremult */ false, roi, /* nthreads */ 1 ) )
+						{
+							setError( imageBuf.geterror() );
+							return;
+						}
+					}
+				}
+			}
+		}
+
+	private :
+
+		void setError( const string &error ) const
+		{
+			tbb::spin_mutex::scoped_lock lock( m_errorMutex );
+			if( m_error.empty() )
+			{
+				m_error = error.size() ? error : "Unknown error.";
+			}
+		}
+
+		ImageCache *m_cache;
+		ustring m_fileName;
+		const Box2i &m_window;
+		const int m_bandOrigin;
+		const int m_bandHeight;
+		const int m_channelBegin;
+		const int m_channelEnd;
+		const TypeDesc m_format;
+		const vector<int> &m_channelIndices;
+		const vector<T *> &m_channels;
+		const vector<bool> &m_transform;
+		const ColorProcessor *m_processor;
+		tbb::spin_mutex &m_errorMutex;
+		string &m_error;
+
+};
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 // ImageReader::Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -193,59 +337,79 @@ class ImageReader::Implementation
 			members["dataWindow"] = new Box2iData( dataWindow() );
 		}
 
-		DataPtr readChannel( const std::string &name, bool raw )
+		void readChannels( const std::vector<std::string> &names, const Imath::Box2i &window, bool raw, std::vector<DataPtr> &channels )
 		{
 			open( /* throwOnFailure */ true );
 
 			const ImageSpec *spec = m_cache->imagespec( m_inputFileName );
 
-			const auto channelIt = find( spec->channelnames.begin(), spec->channelnames.end(), name );
-			if( channelIt == spec->channelnames.end() )
+			vector<int> channelIndices;
+			channelIndices.reserve( names.size() );
+			for( const auto &name : names )
 			{
-				throw InvalidArgumentException( "Image Reader : Non-existent image channel \"" + name + "\" requested." );
+				const auto channelIt = find( spec->channelnames.begin(), spec->channelnames.end(), name );
+				if( channelIt == spec->channelnames.end() )
+				{
+					throw InvalidArgumentException( "Image Reader : Non-existent image channel \"" + name + "\" requested." );
+				}
+				channelIndices.push_back( channelIt - spec->channelnames.begin() );
 			}
 
-			size_t channelIndex = channelIt - spec->channelnames.begin();
+			channels.clear();
+			if( channelIndices.empty() )
+			{
+				return;
+			}
 
 			if( raw )
 			{
+				const vector<bool> transform( channelIndices.size(), false );
 				switch( spec->format.basetype )
 				{
 					case TypeDesc::UCHAR :
 					{
-						return readTypedChannel<unsigned char>( channelIndex, spec->format );
+						readTypedChannels<unsigned char>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::CHAR :
 					{
-						return readTypedChannel<char>( channelIndex, spec->format );
+						readTypedChannels<char>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::USHORT :
 					{
-						return readTypedChannel<unsigned short>( channelIndex, spec->format );
+						readTypedChannels<unsigned short>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::SHORT :
 					{
-						return readTypedChannel<short>( channelIndex, spec->format );
+						readTypedChannels<short>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::UINT :
 					{
-						return readTypedChannel<unsigned int>( channelIndex, spec->format );
+						readTypedChannels<unsigned int>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::INT :
 					{
-						return readTypedChannel<int>( channelIndex, spec->format );
+						readTypedChannels<int>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::HALF :
 					{
-						return readTypedChannel<half>( channelIndex, spec->format );
+						readTypedChannels<half>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::FLOAT :
 					{
-						return readTypedChannel<float>( channelIndex, spec->format );
+						readTypedChannels<float>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					case TypeDesc::DOUBLE :
 					{
-						return readTypedChannel<double>( channelIndex, spec->format );
+						readTypedChannels<double>( channelIndices, window, spec->format, transform, nullptr, channels );
+						break;
 					}
 					default :
 					{
@@ -255,8 +419,16 @@ class ImageReader::Implementation
 			}
 			else
 			{
-				DataPtr data = readTypedChannel<float>( channelIndex, TypeDesc::FLOAT );
-				if( (int)channelIndex != spec->alpha_channel && (int)channelIndex != spec->z_channel )
+				vector<bool> transform( channelIndices.size() );
+				bool anyTransform = false;
+				for( size_t i = 0, e = channelIndices.size(); i < e; ++i )
+				{
+					transform[i] = channelIndices[i] != spec->alpha_channel && channelIndices[i] != spec->z_channel;
+					anyTransform = anyTransform || transform[i];
+				}
+
+				std::unique_ptr<ColorProcessor, decltype(&ColorConfig::deleteColorProcessor)> processor( nullptr, &ColorConfig::deleteColorProcessor );
+				if( anyTransform )
 				{
 					const char *fileFormat = nullptr;
 					m_cache->get_image_info(
@@ -268,44 +440,70 @@ class ImageReader::Implementation
 
 					std::string linearColorSpace = OpenImageIOAlgo::colorSpace( "", *spec );
 					std::string currentColorSpace = OpenImageIOAlgo::colorSpace( fileFormat, *spec );
-					ColorAlgo::transformChannel( data.get(), currentColorSpace, linearColorSpace );
+					if( currentColorSpace != linearColorSpace )
+					{
+						ColorConfig *config = OpenImageIOAlgo::colorConfig();
+						processor.reset( config->createColorProcessor( currentColorSpace, linearColorSpace ) );
+						if( !processor )
+						{
+							throw Exception( "ImageReader : " + config->geterror() );
+						}
+					}
 				}
 
-				return data;
+				readTypedChannels<float>( channelIndices, window, TypeDesc::FLOAT, transform, processor.get(), channels );
 			}
 		}
 
 	private :
 
 		template<class T>
-		DataPtr readTypedChannel( size_t channelIndex, TypeDesc dataType )
+		void readTypedChannels( const vector<int> &channelIndices, const Imath::Box2i &window, TypeDesc dataType, const vector<bool> &transform, const ColorProcessor *processor, std::vector<DataPtr> &channels )
 		{
 			typedef TypedData<vector<T> > DataType;
-			typename DataType::Ptr data = new DataType;
-
-			bool status;
 
 			const ImageSpec *spec = m_cache->imagespec( m_inputFileName );
 
-			data->writable().resize( spec->width * spec->height );
-
-			status = m_cache->get_pixels(
-				m_inputFileName,
-				0, 0, // subimage, miplevel
-				spec->x, spec->width + spec->x,
-				spec->y, spec->height + spec->y,
-				0, 1, // z begin, z end
-				channelIndex, channelIndex + 1,
-				/* format */ dataType,
-				/* data */ &( data->writable()[0] )
+			const size_t numPixels = (size_t)( window.size().x + 1 ) * ( window.size().y + 1 );
+			vector<T *> destinations;
+			destinations.reserve( channelIndices.size() );
+			channels.reserve( channelIndices.size() );
+			for( size_t i = 0, e = channelIndices.size(); i < e; ++i )
+			{
+				typename DataType::Ptr data = new DataType;
+				data->writable().resize( numPixels );
+				destinations.push_back( &( data->writable()[0] ) );
+				channels.push_back( data );
+			}
+
+			// We only need to fetch the range of channels which spans
+			// those we were asked for.
+			const int channelBegin = *std::min_element( channelIndices.begin(), channelIndices.end() );
+			const int channelEnd = *std::max_element( channelIndices.begin(), channelIndices.end() ) + 1;
+
+			const int bandHeight = spec->tile_height > 0 ? spec->tile_height : g_autoTileSize;
+			const int firstBand = floorDivide( window.min.y - spec->y, bandHeight );
+			const int lastBand = floorDivide( window.max.y - spec->y, bandHeight );
+
+			tbb::spin_mutex errorMutex;
+			string error;
+			BandReader<T> bandReader(
+				m_cache.get(), m_inputFileName, window, spec->y, bandHeight,
+				channelBegin, channelEnd, dataType,
+				channelIndices, destinations, transform, processor,
+				errorMutex, error
 			);
+			tbb::parallel_for( tbb::blocked_range<int>( firstBand, lastBand + 1, 1 ), bandReader );
 
-			if( !status )
+			if( error.size() )
 			{
-				throw IOException( string( "ImageReader : Failed to read channel \"" ) + spec->channelnames[channelIndex] + "\". " + m_cache->geterror() );
+				vector<string> names;
+				for( const auto &index : channelIndices )
+				{
+					names.push_back( spec->channelnames[index] );
+				}
+				throw IOException( string( "ImageReader : Failed to read channels \"" ) + boost::algorithm::join( names, ", " ) + "\". " + error );
 			}
-
-			return data;
 		}
 
 		void addMetadata( const std::string &name, DataPtr data, CompoundData *metadata )
@@ -341,6 +539,10 @@ class ImageReader::Implementation
 
 			m_inputFileName = "";
 			m_cache.reset( ImageCache::create( /* shared */ false ) );
+			// present scanline images as bands of scanlines, so
+			// that they can be decoded in parallel by readChannels().
+			m_cache->attribute( "autotile", g_autoTileSize );
+			m_cache->attribute( "autoscanline", 1 );
 
 			// a non-null spec indicates the image was opened successfully
 			if( m_cache->imagespec( ustring( m_reader->fileName() ) ) )
@@ -394,8 +596,16 @@ ImageReader::ImageReader() :
 		false
 	);
 
+	m_dataWindowParameter = new Box2iParameter(
+		"dataWindow",
+		"The region of the image to load. If this is empty (the default value) then the data window "
+		"stored in the file is loaded. Pixels outside the data window of the file are filled with zero.",
+		Box2i()
+	);
+
 	parameters()->addParameter( m_channelNamesParameter );
 	parameters()->addParameter( m_rawChannelsParameter );
+	parameters()->addParameter( m_dataWindowParameter );
 }
 
 ImageReader::ImageReader( const string &fileName ) : ImageReader()
@@ -435,15 +645,19 @@ Imath::Box2i ImageReader::displayWindow()
 ObjectPtr ImageReader::doOperation( const CompoundObject *operands )
 {
 	bool rawChannels = operands->member< BoolData >( "rawChannels" )->readable();
+	const Box2i dataWindow = dataWindowToRead( operands->member<Box2iData>( "dataWindow" )->readable() );
 
-	ImagePrimitivePtr image = new ImagePrimitive( dataWindow(), displayWindow() );
+	ImagePrimitivePtr image = new ImagePrimitive( dataWindow, displayWindow() );
 
 	vector<string> channelNames;
 	channelsToRead( channelNames );
 
+	vector<DataPtr> channels;
+	m_implementation->readChannels( channelNames, dataWindow, rawChannels, channels );
+
 	for( size_t ci = 0, cend = channelNames.size(); ci != cend; ++ci )
 	{
-		DataPtr d = m_implementation->readChannel( channelNames[ci], rawChannels );
+		DataPtr d = channels[ci];
 		assert( d  );
 		assert( rawChannels || d->typeId()==FloatVectorDataTypeId );
 
@@ -459,7 +673,19 @@ ObjectPtr ImageReader::doOperation( const CompoundObject *operands )
 
 DataPtr ImageReader::readChannel( const std::string &name, bool raw )
 {
-	return m_implementation->readChannel( name, raw );
+	vector<DataPtr> channels;
+	readChannels( vector<string>( 1, name ), channels, raw );
+	return channels[0];
+}
+
+void ImageReader::readChannels( const std::vector<std::string> &names, std::vector<DataPtr> &channels, bool raw )
+{
+	m_implementation->readChannels( names, dataWindowToRead( m_dataWindowParameter->getTypedValue() ), raw, channels );
+}
+
+Imath::Box2i ImageReader::dataWindowToRead( const Imath::Box2i &requested )
+{
+	return requested.isEmpty() ? dataWindow() : requested;
 }
 
 void ImageReader::channelsToRead( vector<string> &names )
@@ -509,6 +735,16 @@ const BoolParameter *ImageReader::rawChannelsParameter() const
 	return m_rawChannelsParameter.get();
 }
 
+Box2iParameter *ImageReader::dataWindowParameter()
+{
+	return m_dataWindowParameter.get();
+}
+
+const Box2iParameter *ImageReader::dataWindowParameter() const
+{
+	return m_dataWindowParameter.get();
+}
+
 CompoundObjectPtr ImageReader::readHeader()
 {
 	std::vector<std::string> cn;
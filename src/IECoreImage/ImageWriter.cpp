@@ -46,14 +46,18 @@
 
 #include "boost/type_traits.hpp"
 
+#include "tbb/pipeline.h"
+#include "tbb/spin_mutex.h"
+#include "tbb/task_scheduler_init.h"
+
+#include "OpenImageIO/color.h"
+#include "OpenImageIO/imagebufalgo.h"
 #include "OpenImageIO/imageio.h"
 OIIO_NAMESPACE_USING
 
-#include "IECore/DataInterleaveOp.h"
 #include "IECore/DespatchTypedData.h"
 #include "IECore/Exception.h"
 #include "IECore/MessageHandler.h"
-#include "IECore/ObjectVector.h"
 #include "IECore/TypedParameter.h"
 #include "IECore/CompoundParameter.h"
 #include "IECore/FileNameParameter.h"
@@ -211,6 +215,14 @@ void setImageSpecFormatOptions( const CompoundObject *operands, ImageSpec *spec,
 		spec->attribute( "compression", compression->readable() );
 	}
 
+	if( const IntData *tileSize = settings->member<const IntData>( "tileSize" ) )
+	{
+		if( tileSize->readable() > 0 )
+		{
+			spec->tile_width = spec->tile_height = tileSize->readable();
+		}
+	}
+
 	if( fileFormatName == "jpeg" )
 	{
 		spec->attribute( "CompressionQuality", settings->member<const IntData>( "quality" )->readable() );
@@ -230,6 +242,336 @@ void setImageSpecFormatOptions( const CompoundObject *operands, ImageSpec *spec,
 	}
 }
 
+// Number of scanlines converted and written at once when writing
+// scanline images. Writing several scanlines per call also allows
+// the file format to compress them in parallel.
+const int g_scanlinesPerStrip = 64;
+
+// Records the first error encountered by any stage of the
+// StripPipeline.
+class PipelineErrors
+{
+
+	public :
+
+		void set( const std::string &error )
+		{
+			tbb::spin_mutex::scoped_lock lock( m_mutex );
+			if( m_error.empty() )
+			{
+				m_error = error.size() ? error : "Unknown error.";
+			}
+		}
+
+		bool failed() const
+		{
+			tbb::spin_mutex::scoped_lock lock( m_mutex );
+			return !m_error.empty();
+		}
+
+		const std::string &error() const
+		{
+			return m_error;
+		}
+
+	private :
+
+		mutable tbb::spin_mutex m_mutex;
+		std::string m_error;
+
+};
+
+// A horizontal strip of the output image, spanning a whole row
+// of tiles or a block of scanlines, with interleaved pixels.
+template<typename T>
+struct Strip
+{
+	int yBegin;
+	int yEnd;
+	std::vector<T> pixels;
+};
+
+// First stage of the StripPipeline, generating the strips to be
+// written in order.
+template<typename T>
+class StripGenerator
+{
+
+	public :
+
+		StripGenerator( int &y, int yEnd, int stripHeight, const PipelineErrors &errors )
+			:	m_y( y ), m_yEnd( yEnd ), m_stripHeight( stripHeight ), m_errors( errors )
+		{
+		}
+
+		Strip<T> *operator()( tbb::flow_control &control ) const
+		{
+			if( m_y >= m_yEnd || m_errors.failed() )
+			{
+				control.stop();
+				return nullptr;
+			}
+
+			Strip<T> *strip = new Strip<T>;
+			strip->yBegin = m_y;
+			strip->yEnd = std::min( m_y + m_stripHeight, m_yEnd );
+			m_y = strip->yEnd;
+			return strip;
+		}
+
+	private :
+
+		int &m_y;
+		const int m_yEnd;
+		const int m_stripHeight;
+		const PipelineErrors &m_errors;
+
+};
+
+// Second stage of the StripPipeline, run in parallel. Copies each channel
+// into the strip, colour converting it if necessary, then interleaves the
+// channels ready for writing. Pixels outside the data window of the image
+// are filled with zero.
+template<typename T>
+class StripConverter
+{
+
+	public :
+
+		StripConverter(
+			const std::vector<const T *> &channels, const std::vector<bool> &transform, const ColorProcessor *processor,
+			const Box2i &dataWindow, int x, int width, TypeDesc format, PipelineErrors &errors
+		)
+			:	m_channels( channels ), m_transform( transform ), m_processor( processor ),
+				m_dataWindow( dataWindow ), m_x( x ), m_width( width ), m_format( format ), m_errors( errors )
+		{
+		}
+
+		Strip<T> *operator()( Strip<T> *strip ) const
+		{
+			if( m_errors.failed() )
+			{
+				return strip;
+			}
+
+			const size_t numChannels = m_channels.size();
+			const size_t numPixels = (size_t)m_width * ( strip->yEnd - strip->yBegin );
+			strip->pixels.resize( numPixels * numChannels );
+
+			// the region of the strip covered by the data window
+			const int xBegin = std::max( m_dataWindow.min.x, m_x );
+			const int xEnd = std::min( m_dataWindow.max.x + 1, m_x + m_width );
+			const int yBegin = std::max( m_dataWindow.min.y, strip->yBegin );
+			const int yEnd = std::min( m_dataWindow.max.y + 1, strip->yEnd );
+			const bool fullWidth = xBegin == m_x && xEnd == m_x + m_width;
+
+			std::vector<T> channel( numPixels );
+			for( size_t c = 0; c < numChannels; ++c )
+			{
+				std::fill( channel.begin(), channel.end(), T( 0 ) );
+				const bool transform = m_processor && m_transform[c];
+
+				for( int y = yBegin; y < yEnd && xBegin < xEnd; ++y )
+				{
+					const size_t dataWidth = m_dataWindow.size().x + 1;
+					const T *src = m_channels[c] + ( y - m_dataWindow.min.y ) * dataWidth + ( xBegin - m_dataWindow.min.x );
+					T *dst = &channel[( y - strip->yBegin ) * m_width + ( xBegin - m_x )];
+					std::copy( src, src + ( xEnd - xBegin ), dst );
+					if( transform && !fullWidth && !convert( dst, xEnd - xBegin ) )
+					{
+						return strip;
+					}
+				}
+
+				if( transform && fullWidth && yBegin < yEnd )
+				{
+					if( !convert( &channel[( yBegin - strip->yBegin ) * m_width], (size_t)m_width * ( yEnd - yBegin ) ) )
+					{
+						return strip;
+					}
+				}
+
+				T *dst = &strip->pixels[c];
+				for( size_t i = 0; i < numPixels; ++i, dst += numChannels )
+				{
+					*dst = channel[i];
+				}
+			}
+
+			return strip;
+		}
+
+	private :
+
+		bool convert( T *data, size_t size ) const
+		{
+			// present the data as a single channel, single scanline image
+			ImageSpec spec( (int)size, 1, 1, m_format );
+			ImageBuf buffer( spec, data );
+
+			ROI roi(
+				/* xbegin */ 0, /* xend */ (int)size,
+				/* ybegin */ 0, /* yend */ 1,
+				/* zbegin */ 0, /* zend */ 1,
+				/* chbegin */ 0, /* chend */ 1
+			);
+
+			// convert in-place, using only this thread as
+			// we are already running in parallel.
+			if( !ImageBufAlgo::colorconvert( buffer, buffer, m_processor, /* unpremult */ false, roi, /* nthreads */ 1 ) )
+			{
+				m_errors.set( buffer.geterror() );
+				return false;
+			}
+
+			return true;
+		}
+
+		const std::vector<const T *> &m_channels;
+		const std::vector<bool> &m_transform;
+		const ColorProcessor *m_processor;
+		const Box2i &m_dataWindow;
+		const int m_x;
+		const int m_width;
+		const TypeDesc m_format;
+		PipelineErrors &m_errors;
+
+};
+
+// Final stage of the StripPipeline, writing the strips to
+// the file in order.
+template<typename T>
+class StripWriter
+{
+
+	public :
+
+		StripWriter( ImageOutput *out, bool tiled, int x, int width, TypeDesc format, PipelineErrors &errors )
+			:	m_out( out ), m_tiled( tiled ), m_x( x ), m_width( width ), m_format( format ), m_errors( errors )
+		{
+		}
+
+		void operator()( Strip<T> *strip ) const
+		{
+			std::unique_ptr<Strip<T>> stripOwner( strip );
+			if( m_errors.failed() )
+			{
+				return;
+			}
+
+			bool status;
+			if( m_tiled )
+			{
+				status = m_out->write_tiles(
+					/* xbegin */ m_x, /* xend */ m_x + m_width,
+					/* ybegin */ strip->yBegin, /* yend */ strip->yEnd,
+					/* zbegin */ 0, /* zend */ 1,
+					/* format */ m_format,
+					/* data */ &strip->pixels[0]
+				);
+			}
+			else
+			{
+				status = m_out->write_scanlines(
+					/* ybegin */ strip->yBegin, /* yend */ strip->yEnd,
+					/* z */ 0,
+					/* format */ m_format,
+					/* data */ &strip->pixels[0]
+				);
+			}
+
+			if( !status )
+			{
+				m_errors.set( m_out->geterror() );
+			}
+		}
+
+	private :
+
+		ImageOutput *m_out;
+		const bool m_tiled;
+		const int m_x;
+		const int m_width;
+		const TypeDesc m_format;
+		PipelineErrors &m_errors;
+
+};
+
+// Writes the pixels of an image to an open ImageOutput, one strip at a
+// time. Strips are converted in parallel while previous strips are being
+// written, so a fully interleaved copy of the image is never needed.
+class StripPipeline
+{
+
+	public :
+
+		typedef void ReturnType;
+
+		StripPipeline(
+			const ImagePrimitive *image, const std::vector<std::string> &channels, const ColorProcessor *processor,
+			ImageOutput *out, const ImageSpec &spec, int threads
+		)
+			:	m_image( image ), m_channels( channels ), m_processor( processor ), m_out( out ), m_spec( spec ), m_threads( threads )
+		{
+		}
+
+		template<typename T>
+		ReturnType operator()( const T *data )
+		{
+			typedef typename T::ValueType::value_type ElementType;
+
+			std::vector<const ElementType *> channels;
+			std::vector<bool> transform;
+			for( const auto &name : m_channels )
+			{
+				const T *channelData = static_cast<const T *>( m_image->channels.find( name )->second.get() );
+				channels.push_back( channelData->readable().data() );
+				transform.push_back( name != "A" && name != "Z" );
+			}
+
+			const OpenImageIOAlgo::DataView dataView( data );
+			const TypeDesc format = dataView.type.elementtype();
+
+			const bool tiled = m_spec.tile_width > 0 && m_spec.tile_height > 0;
+			const int stripHeight = tiled ? m_spec.tile_height : g_scanlinesPerStrip;
+
+			PipelineErrors errors;
+			int y = m_spec.y;
+			tbb::parallel_pipeline(
+				// each live strip occupies a thread, so we use
+				// them to limit the number of threads used.
+				/* max_number_of_live_tokens */ m_threads,
+				tbb::make_filter<void, Strip<ElementType> *>(
+					tbb::filter::serial_in_order,
+					StripGenerator<ElementType>( y, m_spec.y + m_spec.height, stripHeight, errors )
+				) &
+				tbb::make_filter<Strip<ElementType> *, Strip<ElementType> *>(
+					tbb::filter::parallel,
+					StripConverter<ElementType>( channels, transform, m_processor, m_image->getDataWindow(), m_spec.x, m_spec.width, format, errors )
+				) &
+				tbb::make_filter<Strip<ElementType> *, void>(
+					tbb::filter::serial_in_order,
+					StripWriter<ElementType>( m_out, tiled, m_spec.x, m_spec.width, format, errors )
+				)
+			);
+
+			if( errors.failed() )
+			{
+				throw IECore::Exception( errors.error() );
+			}
+		}
+
+	private :
+
+		const ImagePrimitive *m_image;
+		const std::vector<std::string> &m_channels;
+		const ColorProcessor *m_processor;
+		ImageOutput *m_out;
+		const ImageSpec &m_spec;
+		const int m_threads;
+
+};
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -289,6 +631,15 @@ ImageWriter::ImageWriter()
 		)
 	);
 
+	exrSettings->addParameter(
+		new IntParameter(
+			"tileSize",
+			"If non-zero, the image is written as square tiles of this size rather than as scanlines.",
+			0,
+			/* min */ 0
+		)
+	);
+
 	CompoundParameterPtr dpxSettings = new CompoundParameter( "dpx", "dpx specific settings" );
 	m_formatSettingsParameter->addParameter( dpxSettings );
 	dpxSettings->addParameter(
@@ -339,6 +690,15 @@ ImageWriter::ImageWriter()
 		)
 	);
 
+	tifSettings->addParameter(
+		new IntParameter(
+			"tileSize",
+			"If non-zero, the image is written as square tiles of this size rather than as scanlines.",
+			0,
+			/* min */ 0
+		)
+	);
+
 	CompoundParameterPtr jpgSettings = new CompoundParameter( "jpeg", "jpeg specific settings" );
 	m_formatSettingsParameter->addParameter( jpgSettings );
 	jpgSettings->addParameter(
@@ -351,9 +711,18 @@ ImageWriter::ImageWriter()
 		)
 	);
 
+	m_threadsParameter = new IntParameter(
+		"threads",
+		"The maximum number of threads used to convert and write the image. "
+		"If this is zero (the default value) then all available threads are used.",
+		0,
+		/* min */ 0
+	);
+
 	parameters()->addParameter( m_channelsParameter );
 	parameters()->addParameter( m_rawChannelsParameter );
 	parameters()->addParameter( m_formatSettingsParameter );
+	parameters()->addParameter( m_threadsParameter );
 }
 
 ImageWriter::ImageWriter( IECore::ObjectPtr object, const std::string &fileName ) : ImageWriter()
@@ -394,6 +763,16 @@ const CompoundParameter *ImageWriter::formatSettingsParameter() const
 	return m_formatSettingsParameter.get();
 }
 
+IntParameter *ImageWriter::threadsParameter()
+{
+	return m_threadsParameter.get();
+}
+
+const IntParameter *ImageWriter::threadsParameter() const
+{
+	return m_threadsParameter.get();
+}
+
 bool ImageWriter::canWrite( ConstObjectPtr object, const string &fileName )
 {
 	const ImagePrimitive *image = runTimeCast<const ImagePrimitive>( object.get() );
@@ -547,6 +926,12 @@ void ImageWriter::doWrite( const CompoundObject *operands )
 		}
 	}
 
+	// Only use tiles if the format supports them
+	if( !out->supports( "tiles" ) )
+	{
+		spec.tile_width = spec.tile_height = 0;
+	}
+
 	// Create the directory we need and open the file
 	boost::filesystem::path directory = boost::filesystem::path( fileName() ).parent_path();
 	if( !directory.empty() )
@@ -563,52 +948,42 @@ void ImageWriter::doWrite( const CompoundObject *operands )
 		throw IECore::Exception( boost::str( boost::format( "IECoreImage::ImageWriter : Could not open \"%s\", error = %s" ) % fileName() % out->geterror() ) );
 	}
 
-	ImagePrimitivePtr correctedImage = nullptr;
+	std::unique_ptr<ColorProcessor, decltype(&ColorConfig::deleteColorProcessor)> processor( nullptr, &ColorConfig::deleteColorProcessor );
 	if( !operands->member<const BoolData>( "rawChannels" )->readable() )
 	{
 		std::string linearColorSpace = OpenImageIOAlgo::colorSpace( "", spec );
 		std::string targetColorSpace = OpenImageIOAlgo::colorSpace( out->format_name(), spec );
 		if( linearColorSpace != targetColorSpace )
 		{
-			correctedImage = image->copy();
-			ColorAlgo::transformImage( correctedImage.get(), linearColorSpace, targetColorSpace );
+			ColorConfig *config = OpenImageIOAlgo::colorConfig();
+			processor.reset( config->createColorProcessor( linearColorSpace, targetColorSpace ) );
+			if( !processor )
+			{
+				throw IECore::Exception( "IECoreImage::ImageWriter : " + config->geterror() );
+			}
 		}
 	}
 
-	const auto &channelMap = ( correctedImage ) ? correctedImage->channels : image->channels;
-
-	DataInterleaveOpPtr op = new DataInterleaveOp();
-	op->targetTypeParameter()->setNumericValue( firstChannelData->typeId() );
-	auto &vectors = static_cast<ObjectVector *>( op->dataParameter()->getValue() )->members();
-	vectors.reserve( (size_t)spec.nchannels );
-	for( const auto &channel : channels )
+	const OpenImageIOAlgo::DataView dataView( firstChannelData );
+	if( dataView.type == TypeDesc::UNKNOWN )
 	{
-		vectors.push_back( channelMap.find( channel )->second );
+		throw IECore::Exception( boost::str( boost::format( "IECoreImage::ImageWriter : Failed to write \"%s\". Unsupported dataType %s." ) % fileName() % firstChannelData->typeName() ) );
 	}
 
-	DataPtr buffer = static_pointer_cast<Data>( op->operate() );
-	const OpenImageIOAlgo::DataView dataView( buffer.get() );
-	if( dataView.type == TypeDesc::UNKNOWN )
+	int threads = operands->member<const IntData>( "threads" )->readable();
+	if( threads <= 0 )
 	{
-		throw IECore::Exception( boost::str( boost::format( "IECoreImage::ImageWriter : Failed to write \"%s\". Unsupported dataType %s." ) % fileName() % buffer->typeName() ) );
+		threads = tbb::task_scheduler_init::default_num_threads();
 	}
 
-	const unsigned char *rawBuffer = (const unsigned char *)dataView.data;
-	size_t stride = spec.nchannels * spec.width * dataView.type.elementsize();
-
-	for( int y = 0; y < spec.height; ++y )
+	StripPipeline stripPipeline( image, channels, processor.get(), out.get(), spec, threads );
+	try
 	{
-		bool status = out->write_scanline(
-			/* y */ spec.y + y,
-			/* z */ 0,
-			/* format */ dataView.type,
-			/* data */ &rawBuffer[stride * y]
-		);
-
-		if( !status )
-		{
-			throw IECore::Exception( boost::str( boost::format( "IECoreImage::ImageWriter : Failed to write \"%s\", error = %s" ) % fileName() % out->geterror() ) );
-		}
+		despatchTypedData<StripPipeline, TypeTraits::IsNumericVectorTypedData>( const_cast<Data *>( firstChannelData ), stripPipeline );
+	}
+	catch( const std::exception &e )
+	{
+		throw IECore::Exception( boost::str( boost::format( "IECoreImage::ImageWriter : Failed to write \"%s\", error = %s" ) % fileName() % e.what() ) );
 	}
 
 	out->close();
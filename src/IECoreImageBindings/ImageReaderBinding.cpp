@@ -36,6 +36,7 @@
 
 #include "IECore/VectorTypedData.h"
 #include "IECorePython/ReaderBinding.h"
+#include "IECorePython/ScopedGILRelease.h"
 
 #include "IECoreImage/ImageReader.h"
 #include "IECoreImageBindings/ImageReaderBinding.h"
@@ -57,6 +58,28 @@ static StringVectorDataPtr channelNames( ImageReader &that )
 	return result;
 }
 
+static list readChannels( ImageReader &that, object names, bool raw )
+{
+	std::vector<std::string> channelNames;
+	for( size_t i = 0, e = len( names ); i < e; ++i )
+	{
+		channelNames.push_back( extract<std::string>( names[i] ) );
+	}
+
+	std::vector<DataPtr> channels;
+	{
+		ScopedGILRelease gilRelease;
+		that.readChannels( channelNames, channels, raw );
+	}
+
+	list result;
+	for( const auto &channel : channels )
+	{
+		result.append( channel );
+	}
+	return result;
+}
+
 } // namespace
 
 namespace IECoreImageBindings
@@ -74,6 +97,7 @@ void bindImageReader()
 		.def( "dataWindow", &ImageReader::dataWindow )
 		.def( "displayWindow", &ImageReader::displayWindow )
 		.def( "readChannel", (DataPtr (ImageReader::*)( const std::string &, bool ))&ImageReader::readChannel, ( arg_("name"), arg_( "raw" ) = false ) )
+		.def( "readChannels", &readChannels, ( arg_( "names" ), arg_( "raw" ) = false ) )
 	;
 
 }
@@ -213,9 +213,14 @@ void DisplayIop::_validate( bool forReal )
 {
 	Box2i displayWindow( V2i( 0, 0 ), V2i( 255, 255 ) );
 
+	// Take a single snapshot of the image for use by all the calls to engine(),
+	// which may be made concurrently. We release the previous snapshot first,
+	// so that the driver can update it in place rather than copying it.
+	m_image = nullptr;
 	if( firstDisplayIop()->m_driver )
 	{
-		displayWindow = firstDisplayIop()->m_driver->image()->getDisplayWindow();
+		m_image = firstDisplayIop()->m_driver->image();
+		displayWindow = m_image->getDisplayWindow();
 	}
 
 	m_format = m_fullSizeFormat = Format( displayWindow.size().x + 1, displayWindow.size().y + 1 );
@@ -233,12 +238,11 @@ void DisplayIop::engine( int y, int x, int r, const DD::Image::ChannelSet &chann
 	Channel outputChannels[4] = { Chan_Red, Chan_Green, Chan_Blue, Chan_Alpha };
 	const char *inputChannels[] = { "R", "G", "B", "A", nullptr };
 
-	const ImagePrimitive *image = nullptr;
+	const ImagePrimitive *image = m_image.get();
 	Box2i inputDataWindow;
 	Box2i inputDisplayWindow;
-	if( firstDisplayIop()->m_driver )
+	if( image )
 	{
-		image = firstDisplayIop()->m_driver->image().get();
 		inputDataWindow = image->getDataWindow();
 		inputDisplayWindow = image->getDisplayWindow();
 	}
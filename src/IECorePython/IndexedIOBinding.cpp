@@ -42,6 +42,7 @@
 #include "IECore/IndexedIO.h"
 #include "IECore/FileIndexedIO.h"
 #include "IECore/MemoryIndexedIO.h"
+#include "IECore/FlatIndexedIO.h"
 #include "IECore/VectorTypedData.h"
 #include "IECore/SimpleTypedData.h"
 
@@ -56,6 +57,7 @@ void bindIndexedIOBase();
 void bindStreamIndexedIO();
 void bindFileIndexedIO();
 void bindMemoryIndexedIO();
+void bindFlatIndexedIO();
 
 void bindIndexedIO()
 {
@@ -63,6 +65,7 @@ void bindIndexedIO()
 	bindStreamIndexedIO();
 	bindFileIndexedIO();
 	bindMemoryIndexedIO();
+	bindFlatIndexedIO();
 }
 
 struct IndexedIOHelper
@@ -306,6 +309,7 @@ void bindIndexedIOBase()
 			.value("Append", IndexedIO::Append)
 			.value("Shared", IndexedIO::Shared)
 			.value("Exclusive", IndexedIO::Exclusive)
+			.value("MemoryMapped", IndexedIO::MemoryMapped)
 			.export_values()
 		;
 
@@ -408,7 +412,23 @@ void bindIndexedIOBase()
 
 void bindStreamIndexedIO()
 {
-	IECorePython::RunTimeTypedClass<StreamIndexedIO>();
+	IECorePython::RunTimeTypedClass<StreamIndexedIO> streamIndexedIOClass;
+	{
+		scope s( streamIndexedIOClass );
+
+		enum_< StreamIndexedIO::Compression >( "Compression" )
+			.value( "Uncompressed", StreamIndexedIO::Uncompressed )
+			.value( "Gzip", StreamIndexedIO::Gzip )
+			.value( "Deflate", StreamIndexedIO::Deflate )
+		;
+	}
+
+	streamIndexedIOClass
+		.def( "setDataCompression", &StreamIndexedIO::setDataCompression, ( arg( "compression" ), arg( "level" ) = -1, arg( "shuffle" ) = true ) )
+		.def( "setIndexCompression", &StreamIndexedIO::setIndexCompression )
+		.def( "setDefaultDataCompression", &StreamIndexedIO::setDefaultDataCompression, ( arg( "compression" ), arg( "level" ) = -1, arg( "shuffle" ) = true ) ).staticmethod( "setDefaultDataCompression" )
+		.def( "setDefaultIndexCompression", &StreamIndexedIO::setDefaultIndexCompression ).staticmethod( "setDefaultIndexCompression" )
+	;
 }
 
 void bindFileIndexedIO()
@@ -434,3 +454,20 @@ void bindMemoryIndexedIO()
 		.def( "buffer", memoryIndexedIOBufferWrapper )
 	;
 }
+
+bool flatIndexedIOCanReadWrapper( ConstCharVectorDataPtr buffer )
+{
+	return FlatIndexedIO::canRead( buffer.get() );
+}
+
+void bindFlatIndexedIO()
+{
+	IECorePython::RunTimeTypedClass<FlatIndexedIO>()
+		.def("__init__", make_constructor( &IndexedIOHelper::constructorAtRoot<FlatIndexedIO, ConstCharVectorDataPtr> ) )
+		.def("__init__", make_constructor( &IndexedIOHelper::constructor<FlatIndexedIO, ConstCharVectorDataPtr> ) )
+		.def( "buffer", &FlatIndexedIO::buffer )
+		.def( "canRead", &flatIndexedIOCanReadWrapper ).staticmethod( "canRead" )
+		.def( "encode", &FlatIndexedIO::encode ).staticmethod( "encode" )
+		.def( "decode", &FlatIndexedIO::decode ).staticmethod( "decode" )
+	;
+}
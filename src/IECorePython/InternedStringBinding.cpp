@@ -88,7 +88,7 @@ static string repr( const InternedString &str )
 
 static size_t hash( const InternedString &str )
 {
-	return boost::hash<const char *>()( str.c_str() );
+	return str.hash();
 }
 
 void bindInternedString()
@@ -148,6 +148,7 @@ class PythonLRUCache : public LRUCache<object, object>
 };
 
 typedef LRUCache<int, int> TestCache;
+typedef LRUCache<int, int, LRUCachePolicy::Sharded> ShardedTestCache;
 
 int get( int key, size_t &cost )
 {
@@ -155,11 +156,12 @@ int get( int key, size_t &cost )
 	return key;
 }
 
+template<typename Cache>
 struct GetFromTestCache
 {
 	public :
 
-		GetFromTestCache( TestCache &cache, size_t numValues, size_t clearFrequency )
+		GetFromTestCache( Cache &cache, size_t numValues, size_t clearFrequency )
 			:	m_cache( cache ), m_numValues( numValues ), m_clearFrequency( clearFrequency )
 		{
 		}
@@ -188,20 +190,28 @@ struct GetFromTestCache
 
 	private :
 
-		TestCache &m_cache;
+		Cache &m_cache;
 		size_t m_numValues;
 		size_t m_clearFrequency;
 
 };
 
-void testLRUCacheThreading( int numIterations, int numValues, int maxCost, int clearFrequency = 0 )
+template<typename Cache>
+void testLRUCacheThreadingWalk( Cache &cache, int numIterations, int numValues, int clearFrequency, int numThreads )
+{
+	task_scheduler_init scheduler( numThreads );
+	parallel_for( blocked_range<size_t>( 0, numIterations ), GetFromTestCache<Cache>( cache, numValues, clearFrequency ) );
+}
+
+template<typename Cache>
+void testLRUCacheThreading( int numIterations, int numValues, int maxCost, int clearFrequency, int numThreads )
 {
 	// do lots of parallel cache accesses. then clear the cache in the main
 	// thread and check that it has emptied successfully, to ensure that the
 	// cost counting has been accurate.
 
-	TestCache cache( get, maxCost );
-	parallel_for( blocked_range<size_t>( 0, numIterations ), GetFromTestCache( cache, numValues, clearFrequency ) );
+	Cache cache( get, maxCost );
+	testLRUCacheThreadingWalk( cache, numIterations, numValues, clearFrequency, numThreads );
 
 	if( cache.currentCost() > cache.getMaxCost() )
 	{
@@ -216,8 +226,8 @@ void testLRUCacheThreading( int numIterations, int numValues, int maxCost, int c
 
 	// as above, but using setMaxCost( 0 ) to clear the cache.
 
-	TestCache cache2( get, maxCost );
-	parallel_for( blocked_range<size_t>( 0, numIterations ), GetFromTestCache( cache2, numValues, clearFrequency ) );
+	Cache cache2( get, maxCost );
+	testLRUCacheThreadingWalk( cache2, numIterations, numValues, clearFrequency, numThreads );
 
 	if( cache2.currentCost() > cache2.getMaxCost() )
 	{
@@ -231,8 +241,44 @@ void testLRUCacheThreading( int numIterations, int numValues, int maxCost, int c
 	}
 }
 
+// As above, but returning the statistics for each shard
+// of the first cache.
+list testShardedLRUCacheThreading( int numIterations, int numValues, int maxCost, int clearFrequency, int numThreads )
+{
+	ShardedTestCache cache( get, maxCost );
+	testLRUCacheThreadingWalk( cache, numIterations, numValues, clearFrequency, numThreads );
+
+	if( cache.currentCost() > cache.getMaxCost() )
+	{
+		throw Exception( "LRUCache exceeds maximum cost" );
+	}
+
+	std::vector<LRUCachePolicy::ShardStatistics> stats;
+	cache.policy().statistics( stats );
+
+	cache.clear();
+	if( cache.currentCost() != 0 )
+	{
+		throw Exception( "Cost not 0 after LRUCache::clear()" );
+	}
+
+	list result;
+	for( std::vector<LRUCachePolicy::ShardStatistics>::const_iterator it = stats.begin(); it != stats.end(); ++it )
+	{
+		dict d;
+		d["hits"] = it->hits;
+		d["misses"] = it->misses;
+		d["evictions"] = it->evictions;
+		d["contention"] = it->contention;
+		result.append( d );
+	}
+	return result;
+}
+
 typedef LRUCache<int, int, LRUCachePolicy::Serial> SerialTestCache;
 typedef LRUCache<int, int, LRUCachePolicy::Parallel> ParallelTestCache;
+typedef LRUCache<int, int, LRUCachePolicy::SerialSegmented> SerialSegmentedTestCache;
+typedef LRUCache<int, int, LRUCachePolicy::ParallelFrequency> ParallelFrequencyTestCache;
 
 template<typename Cache>
 Cache &recursiveCache();
@@ -261,11 +307,12 @@ Cache &recursiveCache()
 	return c;
 }
 
+template<typename Cache>
 struct GetFromParallelRecursiveCache
 {
 	public :
 
-		GetFromParallelRecursiveCache( ParallelTestCache &cache, size_t numValues )
+		GetFromParallelRecursiveCache( Cache &cache, size_t numValues )
 			:	m_cache( cache ), m_numValues( numValues )
 		{
 		}
@@ -280,14 +327,15 @@ struct GetFromParallelRecursiveCache
 
 	private :
 
-		ParallelTestCache &m_cache;
+		Cache &m_cache;
 		size_t m_numValues;
 
 };
 
+template<typename Cache>
 void testSerialLRUCacheRecursion( int maxCost )
 {
-	SerialTestCache &cache = recursiveCache<SerialTestCache>();
+	Cache &cache = recursiveCache<Cache>();
 	cache.clear();
 	cache.setMaxCost( maxCost );
 	if( cache.get( 40 ) != 102334155 )
@@ -296,12 +344,13 @@ void testSerialLRUCacheRecursion( int maxCost )
 	}
 }
 
+template<typename Cache>
 void testParallelLRUCacheRecursion( int numIterations, size_t numValues, int maxCost )
 {
-	ParallelTestCache &cache = recursiveCache<ParallelTestCache>();
+	Cache &cache = recursiveCache<Cache>();
 	cache.clear();
 	cache.setMaxCost( maxCost );
-	parallel_for( blocked_range<size_t>( 0, numIterations ), GetFromParallelRecursiveCache( cache, numValues ) );
+	parallel_for( blocked_range<size_t>( 0, numIterations ), GetFromParallelRecursiveCache<Cache>( cache, numValues ) );
 }
 
 } // namespace
@@ -325,16 +374,32 @@ void IECorePython::bindLRUCache()
 	/// \todo If we create an IECoreTest module, move these into it.
 	def(
 		"testLRUCacheThreading",
-		testLRUCacheThreading,
+		testLRUCacheThreading<TestCache>,
+		(
+			boost::python::arg( "numIterations" ),
+			boost::python::arg( "numValues" ),
+			boost::python::arg( "maxCost" ),
+			boost::python::arg( "clearFrequency" ) = 0,
+			boost::python::arg( "numThreads" ) = int( task_scheduler_init::automatic )
+		)
+	);
+
+	def(
+		"testShardedLRUCacheThreading",
+		testShardedLRUCacheThreading,
 		(
 			boost::python::arg( "numIterations" ),
 			boost::python::arg( "numValues" ),
 			boost::python::arg( "maxCost" ),
-			boost::python::arg( "clearFrequency" ) = 0
+			boost::python::arg( "clearFrequency" ) = 0,
+			boost::python::arg( "numThreads" ) = int( task_scheduler_init::automatic )
 		)
 	);
 
-	def( "testSerialLRUCacheRecursion", testSerialLRUCacheRecursion );
-	def( "testParallelLRUCacheRecursion", testParallelLRUCacheRecursion );
+	def( "testSerialLRUCacheRecursion", testSerialLRUCacheRecursion<SerialTestCache> );
+	def( "testParallelLRUCacheRecursion", testParallelLRUCacheRecursion<ParallelTestCache> );
+	def( "testSerialSegmentedLRUCacheRecursion", testSerialLRUCacheRecursion<SerialSegmentedTestCache> );
+	def( "testParallelFrequencyLRUCacheRecursion", testParallelLRUCacheRecursion<ParallelFrequencyTestCache> );
+	def( "testShardedLRUCacheRecursion", testParallelLRUCacheRecursion<ShardedTestCache> );
 
 }
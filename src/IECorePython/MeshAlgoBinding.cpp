@@ -37,6 +37,7 @@
 #include "IECore/MeshAlgo.h"
 #include "IECorePython/MeshAlgoBinding.h"
 #include "IECorePython/RunTimeTypedBinding.h"
+#include "IECorePython/ScopedGILRelease.h"
 
 using namespace boost::python;
 using namespace IECore;
@@ -73,6 +74,27 @@ struct StdPairToTupleConverter
 	}
 };
 
+void resamplePrimitiveVariables( const MeshPrimitive *mesh, dict primitiveVariables, PrimitiveVariable::Interpolation interpolation )
+{
+	PrimitiveVariableMap m;
+	list keys = primitiveVariables.keys();
+	for( long i = 0, n = len( keys ); i < n; ++i )
+	{
+		const std::string name = extract<std::string>( keys[i] );
+		m[name] = extract<PrimitiveVariable>( primitiveVariables[keys[i]] )();
+	}
+
+	{
+		IECorePython::ScopedGILRelease gilRelease;
+		MeshAlgo::resamplePrimitiveVariables( mesh, m, interpolation );
+	}
+
+	for( PrimitiveVariableMap::const_iterator it = m.begin(); it != m.end(); ++it )
+	{
+		primitiveVariables[it->first] = it->second;
+	}
+}
+
 } // namespace anonymous
 
 namespace IECorePython
@@ -92,6 +114,7 @@ void bindMeshAlgo()
 	def( "calculateFaceTextureArea", &MeshAlgo::calculateFaceTextureArea, ( arg_( "mesh" ), arg_( "uvSet" ) = "uv", arg_( "position" ) = "P" ) );
 	def( "calculateDistortion", &MeshAlgo::calculateDistortion, ( arg_( "mesh" ), arg_( "uvSet" ) = "uv", arg_( "referencePosition" ) = "Pref", arg_( "position" ) = "P" ) );
 	def( "resamplePrimitiveVariable", &MeshAlgo::resamplePrimitiveVariable );
+	def( "resamplePrimitiveVariables", &resamplePrimitiveVariables );
 	def( "deleteFaces", &MeshAlgo::deleteFaces, arg_( "invert" ) = false );
 	def( "reverseWinding", &MeshAlgo::reverseWinding );
 	def( "distributePoints", &MeshAlgo::distributePoints, ( arg_( "mesh" ), arg_( "density" ) = 100.0, arg_( "offset" ) = Imath::V2f( 0 ), arg_( "densityMask" ) = "density", arg_( "uvSet" ) = "uv", arg_( "position" ) = "P" ) );
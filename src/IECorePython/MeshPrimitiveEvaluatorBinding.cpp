@@ -35,9 +35,11 @@
 #include "boost/python.hpp"
 
 #include "IECore/MeshPrimitiveEvaluator.h"
+#include "IECore/VectorTypedData.h"
 #include "IECorePython/MeshPrimitiveEvaluatorBinding.h"
 #include "IECorePython/RunTimeTypedBinding.h"
 #include "IECorePython/RefCountedBinding.h"
+#include "IECorePython/ScopedGILRelease.h"
 
 using namespace IECore;
 using namespace boost::python;
@@ -52,12 +54,51 @@ static bool barycentricPosition( const MeshPrimitiveEvaluator &e, unsigned int t
 	return e.barycentricPosition( t, b, r );
 }
 
+static list resultList( const std::vector<PrimitiveEvaluator::ResultPtr> &results )
+{
+	list result;
+	for( std::vector<PrimitiveEvaluator::ResultPtr>::const_iterator it = results.begin(), eIt = results.end(); it != eIt; ++it )
+	{
+		if( *it )
+		{
+			result.append( *it );
+		}
+		else
+		{
+			result.append( object() );
+		}
+	}
+	return result;
+}
+
+static list closestPoints( const MeshPrimitiveEvaluator &e, ConstV3fVectorDataPtr points )
+{
+	std::vector<PrimitiveEvaluator::ResultPtr> results;
+	{
+		ScopedGILRelease gilRelease;
+		e.closestPoints( points->readable(), results );
+	}
+	return resultList( results );
+}
+
+static list closestIntersectionPoints( const MeshPrimitiveEvaluator &e, ConstV3fVectorDataPtr origins, ConstV3fVectorDataPtr directions, float maxDistance )
+{
+	std::vector<PrimitiveEvaluator::ResultPtr> results;
+	{
+		ScopedGILRelease gilRelease;
+		e.closestIntersectionPoints( origins->readable(), directions->readable(), results, maxDistance );
+	}
+	return resultList( results );
+}
+
 void bindMeshPrimitiveEvaluator()
 {
 	object m = RunTimeTypedClass<MeshPrimitiveEvaluator>()
 		.def( init< MeshPrimitivePtr > () )
 		.def( "barycentricPosition", &barycentricPosition )
 		.def( "uvBound", &MeshPrimitiveEvaluator::uvBound )
+		.def( "closestPoints", &closestPoints )
+		.def( "closestIntersectionPoints", &closestIntersectionPoints, ( arg( "origins" ), arg( "directions" ), arg( "maxDistance" ) = Imath::limits<float>::max() ) )
 	;
 
 	{
@@ -73,8 +73,15 @@ static void appendInt( MurmurHash &hash, int64_t v )
 void bindMurmurHash()
 {
 
-	class_<MurmurHash>( "MurmurHash" )
-		.def( init<>() )
+	class_<MurmurHash> cls( "MurmurHash" );
+	scope s( cls );
+
+	enum_<MurmurHash::ArrayHashVersion>( "ArrayHashVersion" )
+		.value( "SerialArrayHash", MurmurHash::SerialArrayHash )
+		.value( "ChunkedArrayHash", MurmurHash::ChunkedArrayHash )
+	;
+
+	cls.def( init<>() )
 		.def( init<const MurmurHash &>() )
 		.def( "append", (MurmurHash &(MurmurHash::*)( float ))&MurmurHash::append, return_self<>() )
 		.def( "append", (MurmurHash &(MurmurHash::*)( double ))&MurmurHash::append, return_self<>() )
@@ -147,6 +154,8 @@ void bindMurmurHash()
 		.def( "__repr__", &repr )
 		.def( "__str__", &MurmurHash::toString )
 		.def( "toString", &MurmurHash::toString )
+		.def( "setArrayHashVersion", &MurmurHash::setArrayHashVersion ).staticmethod( "setArrayHashVersion" )
+		.def( "getArrayHashVersion", &MurmurHash::getArrayHashVersion ).staticmethod( "getArrayHashVersion" )
 	;
 
 }
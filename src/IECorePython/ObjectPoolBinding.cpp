@@ -37,6 +37,7 @@
 #include "boost/python.hpp"
 
 #include "IECore/ObjectPool.h"
+#include "IECore/LRUCache.h"
 
 #include "IECorePython/ObjectPoolBinding.h"
 #include "IECorePython/RefCountedBinding.h"
@@ -69,6 +70,24 @@ ObjectPtr retrieve( const ObjectPool &pool, MurmurHash key, bool _copy )
 	return const_cast< Object * >(o.get());
 }
 
+list shardStatistics( const ObjectPool &pool )
+{
+	std::vector<LRUCachePolicy::ShardStatistics> stats;
+	pool.shardStatistics( stats );
+
+	list result;
+	for( std::vector<LRUCachePolicy::ShardStatistics>::const_iterator it = stats.begin(); it != stats.end(); ++it )
+	{
+		dict d;
+		d["hits"] = it->hits;
+		d["misses"] = it->misses;
+		d["evictions"] = it->evictions;
+		d["contention"] = it->contention;
+		result.append( d );
+	}
+	return result;
+}
+
 void bindObjectPool()
 {
 	RefCountedClass<ObjectPool, RefCounted> objectPoolClass( "ObjectPool" );
@@ -94,6 +113,7 @@ void bindObjectPool()
 		.def( "memoryUsage", &ObjectPool::memoryUsage )
 		.def( "getMaxMemoryUsage", &ObjectPool::getMaxMemoryUsage)
 		.def( "setMaxMemoryUsage", &ObjectPool::setMaxMemoryUsage )
+		.def( "shardStatistics", &shardStatistics )
 		.def( "defaultObjectPool", &ObjectPool::defaultObjectPool, return_value_policy<CastToIntrusivePtr>() )
 		.staticmethod( "defaultObjectPool" )
 	;
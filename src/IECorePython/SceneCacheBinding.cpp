@@ -62,6 +62,10 @@ void bindSceneCache()
 	RunTimeTypedClass<SceneCache>()
 		.def( "__init__", make_constructor( &constructor ), "Opens a scene file for read or write." )
 		.def( "__init__", make_constructor( &constructor2 ), "Opens a scene from a previously opened file handle." )
+		.def( "setObjectDeltaEncoding", &SceneCache::setObjectDeltaEncoding, ( arg( "enabled" ), arg( "keyframeInterval" ) = 16 ) )
+		.def( "setDefaultObjectDeltaEncoding", &SceneCache::setDefaultObjectDeltaEncoding, ( arg( "enabled" ), arg( "keyframeInterval" ) = 16 ) ).staticmethod( "setDefaultObjectDeltaEncoding" )
+		.def( "setConcurrentWriting", &SceneCache::setConcurrentWriting )
+		.def( "flush", &SceneCache::flush )
 	;
 }
 
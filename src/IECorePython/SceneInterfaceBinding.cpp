@@ -37,6 +37,10 @@
 #include "IECore/SceneInterface.h"
 #include "IECore/SharedSceneInterfaces.h"
 #include "IECorePython/RunTimeTypedBinding.h"
+#include "IECorePython/RefCountedBinding.h"
+#include "IECorePython/ScopedGILRelease.h"
+#include "IECorePython/ScopedGILLock.h"
+#include "IECorePython/ExceptionAlgo.h"
 #include "IECorePython/IECoreBinding.h"
 
 #include "IECorePython/SceneInterfaceBinding.h"
@@ -214,6 +218,81 @@ static MurmurHash sceneHash( SceneInterface &m, SceneInterface::HashType hashTyp
 	return h;
 }
 
+static SceneInterface::PrefetchMonitorPtr prefetch( const SceneInterface &m, list pathList, double time, int what, SceneInterface::PrefetchMonitor *monitor )
+{
+	std::vector<SceneInterface::Path> paths;
+	int numPaths = IECorePython::len( pathList );
+	paths.resize( numPaths );
+	for( int i = 0; i < numPaths; i++ )
+	{
+		listToSceneInterfaceNameList( extract<list>( pathList[i] ), paths[i] );
+	}
+	return m.prefetch( paths, time, what, monitor );
+}
+
+class PrefetchMonitorWrapper : public RefCountedWrapper<SceneInterface::PrefetchMonitor>
+{
+	public :
+
+		PrefetchMonitorWrapper( PyObject *self )
+			: RefCountedWrapper<SceneInterface::PrefetchMonitor>( self )
+		{
+		}
+
+		~PrefetchMonitorWrapper() override
+		{
+			// The reads in flight must finish before the Python object goes away. We're
+			// destroyed by the GILReleasePtr held by the Python object, which has already
+			// released the GIL, so a progress() call waiting for it can complete.
+			cancel();
+			try
+			{
+				wait();
+			}
+			catch( ... )
+			{
+				// nobody is left to report errors to.
+			}
+		}
+
+	protected :
+
+		void progress( size_t numCompleted, size_t numScheduled ) override
+		{
+			if( !isSubclassed() )
+			{
+				return;
+			}
+
+			ScopedGILLock gilLock;
+			if( cancelled() )
+			{
+				// we may have been cancelled by our destructor while waiting for the GIL.
+				return;
+			}
+			object o = this->methodOverride( "progress" );
+			if( o )
+			{
+				try
+				{
+					o( numCompleted, numScheduled );
+				}
+				catch( const error_already_set &e )
+				{
+					// rethrown by PrefetchMonitor::wait().
+					IECorePython::ExceptionAlgo::translatePythonException();
+				}
+			}
+		}
+
+};
+
+static void prefetchMonitorWait( SceneInterface::PrefetchMonitor &m )
+{
+	ScopedGILRelease gilRelease;
+	m.wait();
+}
+
 void bindSceneInterface()
 {
 	SceneInterfacePtr (SceneInterface::*nonConstChild)(const SceneInterface::Name &, SceneInterface::MissingBehaviour) = &SceneInterface::child;
@@ -250,6 +329,24 @@ void bindSceneInterface()
 			.export_values()
 		;
 
+		enum_< SceneInterface::PrefetchFlags > ("PrefetchFlags")
+			.value("PrefetchBound", SceneInterface::PrefetchBound)
+			.value("PrefetchTransform", SceneInterface::PrefetchTransform)
+			.value("PrefetchAttributes", SceneInterface::PrefetchAttributes)
+			.value("PrefetchObject", SceneInterface::PrefetchObject)
+			.value("PrefetchAll", SceneInterface::PrefetchAll)
+			.export_values()
+		;
+
+		RefCountedClass<SceneInterface::PrefetchMonitor, RefCounted, PrefetchMonitorWrapper>( "PrefetchMonitor" )
+			.def( init<>() )
+			.def( "cancel", &SceneInterface::PrefetchMonitor::cancel )
+			.def( "cancelled", &SceneInterface::PrefetchMonitor::cancelled )
+			.def( "wait", &prefetchMonitorWait )
+			.def( "numCompleted", &SceneInterface::PrefetchMonitor::numCompleted )
+			.def( "numScheduled", &SceneInterface::PrefetchMonitor::numScheduled )
+		;
+
 	}
 
 	// now we've defined the nested types, we're able to define the methods for
@@ -283,6 +380,7 @@ void bindSceneInterface()
 		.def( "createChild", &SceneInterface::createChild )
 		.def( "scene", &nonConstScene, ( arg( "path" ), arg( "missingBehaviour" ) = SceneInterface::ThrowIfMissing ) )
 		.def( "hash", &sceneHash )
+		.def( "prefetch", &prefetch, ( arg( "paths" ), arg( "time" ), arg( "what" ) = SceneInterface::PrefetchAll, arg( "monitor" ) = object() ) )
 
 		.def( "pathToString", pathToString ).staticmethod("pathToString")
 		.def( "stringToPath", stringToPath ).staticmethod("stringToPath")
@@ -399,6 +399,7 @@ void bindTypeId()
 		.value( "StandardRadialLensModel", StandardRadialLensModelTypeId )
 		.value( "TransferSmoothSkinningWeightsOp", TransferSmoothSkinningWeightsOpTypeId )
 		.value( "ExternalProcedural", ExternalProceduralTypeId )
+		.value( "FlatIndexedIO", FlatIndexedIOTypeId )
 	;
 
 	converter::registry::push_back(
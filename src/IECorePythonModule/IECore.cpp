@@ -233,6 +233,7 @@
 #include "IECorePython/LensModelBinding.h"
 #include "IECorePython/StandardRadialLensModelBinding.h"
 #include "IECorePython/ObjectPoolBinding.h"
+#include "IECorePython/CacheRegistryBinding.h"
 #include "IECorePython/ExternalProceduralBinding.h"
 #include "IECorePython/ClippingPlaneBinding.h"
 #include "IECorePython/DataAlgoBinding.h"
@@ -461,6 +462,7 @@ BOOST_PYTHON_MODULE(_IECore)
 	bindLensModel();
 	bindStandardRadialLensModel();
 	bindObjectPool();
+	bindCacheRegistry();
 	bindExternalProcedural();
 	bindClippingPlane();
 	bindDataAlgo();
@@ -211,6 +211,7 @@ from SceneCacheTest import SceneCacheTest
 from LinkedSceneTest import LinkedSceneTest
 from StandardRadialLensModelTest import StandardRadialLensModelTest
 from ObjectPoolTest import ObjectPoolTest
+from CacheRegistryTest import CacheRegistryTest
 from RefCountedTest import RefCountedTest
 from ExternalProceduralTest import ExternalProceduralTest
 from ClippingPlaneTest import ClippingPlaneTest
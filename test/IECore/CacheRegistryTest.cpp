@@ -0,0 +1,182 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "boost/bind.hpp"
+#include "boost/scoped_ptr.hpp"
+
+#include "IECore/CacheRegistry.h"
+
+#include "CacheRegistryTest.h"
+
+using namespace boost;
+using namespace boost::unit_test;
+
+namespace IECore
+{
+
+struct CacheRegistryTest
+{
+
+	// A cache which just records the limit it is given, and can destroy
+	// another client when items are evicted, as happens when the evicted
+	// items own caches of their own.
+	struct TestCache
+	{
+
+		TestCache( size_t usage )
+			:	usage( usage ), limit( usage ), clientToDestroy( nullptr )
+		{
+		}
+
+		size_t getUsage() const
+		{
+			return usage;
+		}
+
+		size_t getLimit() const
+		{
+			return limit;
+		}
+
+		void setLimit( size_t l )
+		{
+			limit = l;
+			if( usage > limit )
+			{
+				usage = limit;
+				delete clientToDestroy;
+				clientToDestroy = nullptr;
+			}
+		}
+
+		size_t usage;
+		size_t limit;
+		CacheRegistry::Client *clientToDestroy;
+
+	};
+
+	static CacheRegistry::Client *newClient( const std::string &name, TestCache &cache )
+	{
+		return new CacheRegistry::Client(
+			name,
+			boost::bind( &TestCache::getUsage, &cache ),
+			boost::bind( &TestCache::getLimit, &cache ),
+			boost::bind( &TestCache::setLimit, &cache, ::_1 )
+		);
+	}
+
+	void testDestroyClientDuringEviction()
+	{
+		const size_t originalBudget = CacheRegistry::getMemoryBudget();
+
+		TestCache cache1( 0 );
+		TestCache cache2( 0 );
+		boost::scoped_ptr<CacheRegistry::Client> client1( newClient( "CacheRegistryTest1", cache1 ) );
+		CacheRegistry::Client *client2 = newClient( "CacheRegistryTest2", cache2 );
+
+		const size_t budget = CacheRegistry::memoryUsage() + 1024 * 1024;
+		CacheRegistry::setMemoryBudget( budget );
+
+		// exceeding the budget makes the registry evict from cache1,
+		// which destroys client2.
+		cache1.clientToDestroy = client2;
+		cache1.usage = 2 * 1024 * 1024;
+		client1->memoryAdded();
+
+		BOOST_CHECK( cache1.clientToDestroy == nullptr );
+		BOOST_CHECK( cache1.limit < 2 * 1024 * 1024 );
+		BOOST_CHECK( CacheRegistry::memoryUsage() <= budget );
+
+		std::vector<CacheRegistry::Statistics> stats;
+		CacheRegistry::statistics( stats );
+		for( std::vector<CacheRegistry::Statistics>::const_iterator it = stats.begin(); it != stats.end(); ++it )
+		{
+			BOOST_CHECK( it->name != "CacheRegistryTest2" );
+		}
+
+		CacheRegistry::setMemoryBudget( originalBudget );
+	}
+
+	void testUsageWithinBudget()
+	{
+		const size_t originalBudget = CacheRegistry::getMemoryBudget();
+
+		TestCache cache( 0 );
+		boost::scoped_ptr<CacheRegistry::Client> client( newClient( "CacheRegistryTest", cache ) );
+
+		const size_t budget = CacheRegistry::memoryUsage() + 1024 * 1024;
+		CacheRegistry::setMemoryBudget( budget );
+		const size_t limit = cache.limit;
+
+		// adding memory within the budget leaves the limit alone.
+		cache.usage = 1024;
+		client->memoryAdded();
+		BOOST_CHECK_EQUAL( cache.limit, limit );
+		BOOST_CHECK_EQUAL( cache.usage, 1024u );
+
+		// but exceeding it reclaims memory.
+		cache.usage = 4 * 1024 * 1024;
+		client->memoryAdded();
+		BOOST_CHECK( cache.limit <= 1024 * 1024 );
+		BOOST_CHECK( CacheRegistry::memoryUsage() <= budget );
+
+		// removing the budget restores the original limit.
+		CacheRegistry::setMemoryBudget( originalBudget );
+		if( !originalBudget )
+		{
+			BOOST_CHECK_EQUAL( cache.limit, 0u );
+		}
+	}
+
+};
+
+struct CacheRegistryTestSuite : public boost::unit_test::test_suite
+{
+
+	CacheRegistryTestSuite() : boost::unit_test::test_suite( "CacheRegistryTestSuite" )
+	{
+		boost::shared_ptr<CacheRegistryTest> instance( new CacheRegistryTest() );
+
+		add( BOOST_CLASS_TEST_CASE( &CacheRegistryTest::testDestroyClientDuringEviction, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &CacheRegistryTest::testUsageWithinBudget, instance ) );
+	}
+
+};
+
+void addCacheRegistryTest( boost::unit_test::test_suite *test )
+{
+	test->add( new CacheRegistryTestSuite() );
+}
+
+} // namespace IECore
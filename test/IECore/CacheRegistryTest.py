@@ -0,0 +1,126 @@
+##########################################################################
+#
+#  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+#
+#  Redistribution and use in source and binary forms, with or without
+#  modification, are permitted provided that the following conditions are
+#  met:
+#
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#
+#     * Neither the name of Image Engine Design nor the names of any
+#       other contributors to this software may be used to endorse or
+#       promote products derived from this software without specific prior
+#       written permission.
+#
+#  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+#  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+#  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+#  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+#  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+#  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+#  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+#  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+#  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+#  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+#  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+##########################################################################
+
+import os
+import subprocess
+import sys
+import unittest
+
+import IECore
+
+class CacheRegistryTest( unittest.TestCase ) :
+
+	def setUp( self ) :
+
+		self.__originalBudget = IECore.CacheRegistry.getMemoryBudget()
+
+	def tearDown( self ) :
+
+		IECore.CacheRegistry.setMemoryBudget( self.__originalBudget )
+
+	def __poolStatistics( self ) :
+
+		result = { "lookups" : 0, "misses" : 0 }
+		for s in IECore.CacheRegistry.statistics() :
+			if s["name"] == "ObjectPool" :
+				result["lookups"] += s["lookups"]
+				result["misses"] += s["misses"]
+
+		return result
+
+	def testStatistics( self ) :
+
+		p = IECore.ObjectPool( 1024 * 1024 )
+		a = IECore.IntVectorData( range( 0, 100 ) )
+
+		IECore.CacheRegistry.resetStatistics()
+		self.assertEqual( self.__poolStatistics(), { "lookups" : 0, "misses" : 0 } )
+
+		self.assertEqual( p.retrieve( a.hash() ), None )
+		self.assertEqual( self.__poolStatistics(), { "lookups" : 1, "misses" : 1 } )
+
+		p.store( a, IECore.ObjectPool.StoreReference )
+		self.assertEqual( p.retrieve( a.hash() ), a )
+		self.assertEqual( self.__poolStatistics(), { "lookups" : 2, "misses" : 1 } )
+
+		stats = [ s for s in IECore.CacheRegistry.statistics() if s["name"] == "ObjectPool" and s["memoryLimit"] == 1024 * 1024 ]
+		self.assertEqual( len( stats ), 1 )
+		self.assertEqual( stats[0]["memoryUsage"], p.memoryUsage() )
+
+		del p
+		stats = [ s for s in IECore.CacheRegistry.statistics() if s["name"] == "ObjectPool" and s["memoryLimit"] == 1024 * 1024 ]
+		self.assertEqual( len( stats ), 0 )
+
+	def testBudget( self ) :
+
+		IECore.CacheRegistry.setMemoryBudget( 0 )
+
+		p1 = IECore.ObjectPool( 100 * 1024 * 1024 )
+		p2 = IECore.ObjectPool( 100 * 1024 * 1024 )
+
+		budget = IECore.CacheRegistry.memoryUsage() + 1024 * 1024
+		IECore.CacheRegistry.setMemoryBudget( budget )
+		self.assertEqual( IECore.CacheRegistry.getMemoryBudget(), budget )
+
+		for i in range( 0, 100 ) :
+			p1.store( IECore.IntVectorData( [ i ] * 10000 ), IECore.ObjectPool.StoreReference )
+			p2.store( IECore.FloatVectorData( [ i ] * 10000 ), IECore.ObjectPool.StoreReference )
+			self.assertLessEqual( IECore.CacheRegistry.memoryUsage(), budget )
+
+		# both pools should have been given a fair share of the budget
+		self.assertGreater( p1.memoryUsage(), 0 )
+		self.assertGreater( p2.memoryUsage(), 0 )
+
+		# removing the budget restores the original limits
+		IECore.CacheRegistry.setMemoryBudget( 0 )
+		self.assertEqual( p1.getMaxMemoryUsage(), 100 * 1024 * 1024 )
+		self.assertEqual( p2.getMaxMemoryUsage(), 100 * 1024 * 1024 )
+
+	def testInvalidEnvironmentBudget( self ) :
+
+		env = os.environ.copy()
+		env["IECORE_CACHE_MEMORY"] = "lots"
+		env["IECORE_LOG_LEVEL"] = "Warning"
+		p = subprocess.Popen(
+			[ sys.executable, "-c", "import IECore; print IECore.CacheRegistry.getMemoryBudget()" ],
+			env = env, stdout = subprocess.PIPE, stderr = subprocess.PIPE
+		)
+		out, err = p.communicate()
+
+		self.assertEqual( p.returncode, 0 )
+		self.assertEqual( out.strip(), "0" )
+		self.assertTrue( "IECORE_CACHE_MEMORY" in err )
+
+if __name__ == "__main__":
+	unittest.main()
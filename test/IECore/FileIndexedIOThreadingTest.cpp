@@ -0,0 +1,281 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2026, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <vector>
+#include <iostream>
+
+#include "tbb/tbb.h"
+
+#include "boost/filesystem/operations.hpp"
+#include "boost/format.hpp"
+
+#include "IECore/FileIndexedIO.h"
+
+#include "FileIndexedIOThreadingTest.h"
+
+using namespace boost;
+using namespace boost::unit_test;
+using namespace tbb;
+
+namespace
+{
+
+const size_t g_numEntries = 100;
+const size_t g_arrayLength = 100000;
+const size_t g_numReads = 10;
+
+} // namespace
+
+namespace IECore
+{
+
+struct FileIndexedIOThreadingTest
+{
+
+	static const char *fileName()
+	{
+		return "/tmp/fileIndexedIOThreadingTest.fio";
+	}
+
+	static IndexedIO::EntryID entryName( size_t i )
+	{
+		return ( boost::format( "entry%d" ) % i ).str();
+	}
+
+	struct ReadEntries
+	{
+		public :
+
+			ReadEntries( ConstIndexedIOPtr io ) : m_io( io ), m_errors( 0 )
+			{
+			}
+
+			ReadEntries( ReadEntries &that, tbb::split ) : m_io( that.m_io ), m_errors( 0 )
+			{
+			}
+
+			void operator()( const blocked_range<size_t> &r ) const
+			{
+				std::vector<float> buffer( g_arrayLength );
+				for ( size_t i = r.begin(); i != r.end(); ++i )
+				{
+					const size_t entry = i % g_numEntries;
+					ConstIndexedIOPtr dir = m_io->subdirectory( entryName( entry ) );
+					float *data = &buffer[0];
+					dir->read( "data", data, g_arrayLength );
+					// can't use boost unit test assertions from threads
+					if ( buffer[0] != (float)entry || buffer[g_arrayLength-1] != (float)( entry + g_arrayLength - 1 ) )
+					{
+						m_errors++;
+					}
+				}
+			}
+
+			void join( const ReadEntries &that )
+			{
+				m_errors += that.m_errors;
+			}
+
+			size_t errors() const
+			{
+				return m_errors;
+			}
+
+		private :
+
+			ConstIndexedIOPtr m_io;
+			mutable size_t m_errors;
+
+	};
+
+	struct WriteEntries
+	{
+		public :
+
+			WriteEntries( IndexedIOPtr io ) : m_io( io )
+			{
+			}
+
+			void operator()( const blocked_range<size_t> &r ) const
+			{
+				std::vector<float> data( g_arrayLength );
+				for ( size_t i = r.begin(); i != r.end(); ++i )
+				{
+					for ( size_t j = 0; j < g_arrayLength; ++j )
+					{
+						data[j] = i + j;
+					}
+					IndexedIOPtr dir = m_io->createSubdirectory( entryName( i ) );
+					dir->write( "data", &data[0], g_arrayLength );
+					dir->subdirectory( "sub", IndexedIO::CreateIfMissing )->write( "name", entryName( i ).value() );
+					if ( i % 2 )
+					{
+						dir->commit();
+					}
+				}
+			}
+
+		private :
+
+			IndexedIOPtr m_io;
+
+	};
+
+	void writeFile()
+	{
+		IndexedIOPtr io = new FileIndexedIO( fileName(), IndexedIO::rootPath, IndexedIO::Write );
+		std::vector<float> data( g_arrayLength );
+		for ( size_t i = 0; i < g_numEntries; ++i )
+		{
+			for ( size_t j = 0; j < g_arrayLength; ++j )
+			{
+				data[j] = i + j;
+			}
+			IndexedIOPtr dir = io->createSubdirectory( entryName( i ) );
+			dir->write( "data", &data[0], g_arrayLength );
+			dir->commit();
+		}
+	}
+
+	void testConcurrentReads()
+	{
+		writeFile();
+
+		ConstIndexedIOPtr io = new FileIndexedIO( fileName(), IndexedIO::rootPath, IndexedIO::Read );
+		const size_t numIterations = g_numEntries * g_numReads;
+
+		// make sure all the subindexes are loaded so we only time the data reads
+		ReadEntries warmup( io );
+		warmup( blocked_range<size_t>( 0, g_numEntries ) );
+		BOOST_CHECK_EQUAL( warmup.errors(), 0u );
+
+		tick_count t0 = tick_count::now();
+		ReadEntries serialTask( io );
+		serialTask( blocked_range<size_t>( 0, numIterations ) );
+		tick_count t1 = tick_count::now();
+
+		ReadEntries parallelTask( io );
+		parallel_reduce( blocked_range<size_t>( 0, numIterations ), parallelTask );
+		tick_count t2 = tick_count::now();
+
+		BOOST_CHECK_EQUAL( serialTask.errors(), 0u );
+		BOOST_CHECK_EQUAL( parallelTask.errors(), 0u );
+
+		const double serialTime = ( t1 - t0 ).seconds();
+		const double parallelTime = ( t2 - t1 ).seconds();
+		BOOST_TEST_MESSAGE(
+			boost::format( "FileIndexedIO reads : serial %.3fs, parallel %.3fs, speedup %.2fx" ) %
+			serialTime % parallelTime % ( serialTime / parallelTime )
+		);
+
+		io = nullptr;
+		boost::filesystem::remove( fileName() );
+	}
+
+	void testConcurrentFirstTouch()
+	{
+		writeFile();
+
+		// every entry is committed to a subindex, and each is requested by
+		// several threads at once before any of them has been loaded.
+		for ( size_t i = 0; i < g_numReads; ++i )
+		{
+			ConstIndexedIOPtr io = new FileIndexedIO( fileName(), IndexedIO::rootPath, IndexedIO::Read );
+			ReadEntries task( io );
+			parallel_reduce( blocked_range<size_t>( 0, g_numEntries * g_numReads ), task );
+			BOOST_CHECK_EQUAL( task.errors(), 0u );
+
+			ConstIndexedIOPtr dir = io->subdirectory( entryName( i ) );
+			IndexedIO::EntryIDList path;
+			dir->path( path );
+			BOOST_CHECK_EQUAL( path.size(), 1u );
+			BOOST_CHECK_EQUAL( path[0], entryName( i ) );
+			BOOST_CHECK( dir->parentDirectory()->hasEntry( entryName( i ) ) );
+		}
+
+		boost::filesystem::remove( fileName() );
+	}
+
+	void testConcurrentWrites()
+	{
+		const StreamIndexedIO::Compression compressions[] = { StreamIndexedIO::Uncompressed, StreamIndexedIO::Deflate };
+		for ( size_t c = 0; c < 2; ++c )
+		{
+			FileIndexedIOPtr io = new FileIndexedIO( fileName(), IndexedIO::rootPath, IndexedIO::Write );
+			io->setDataCompression( compressions[c] );
+			parallel_for( blocked_range<size_t>( 0, g_numEntries ), WriteEntries( io ) );
+			io = nullptr;
+
+			ConstIndexedIOPtr readIO = new FileIndexedIO( fileName(), IndexedIO::rootPath, IndexedIO::Read );
+			IndexedIO::EntryIDList entries;
+			readIO->entryIds( entries );
+			BOOST_CHECK_EQUAL( entries.size(), g_numEntries );
+
+			ReadEntries readTask( readIO );
+			readTask( blocked_range<size_t>( 0, g_numEntries ) );
+			BOOST_CHECK_EQUAL( readTask.errors(), 0u );
+
+			for ( size_t i = 0; i < g_numEntries; ++i )
+			{
+				std::string name;
+				readIO->subdirectory( entryName( i ) )->subdirectory( "sub" )->read( "name", name );
+				BOOST_CHECK_EQUAL( name, entryName( i ).value() );
+			}
+		}
+
+		boost::filesystem::remove( fileName() );
+	}
+
+};
+
+struct FileIndexedIOThreadingTestSuite : public boost::unit_test::test_suite
+{
+
+	FileIndexedIOThreadingTestSuite() : boost::unit_test::test_suite( "FileIndexedIOThreadingTestSuite" )
+	{
+		boost::shared_ptr<FileIndexedIOThreadingTest> instance( new FileIndexedIOThreadingTest() );
+
+		add( BOOST_CLASS_TEST_CASE( &FileIndexedIOThreadingTest::testConcurrentReads, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &FileIndexedIOThreadingTest::testConcurrentWrites, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &FileIndexedIOThreadingTest::testConcurrentFirstTouch, instance ) );
+	}
+};
+
+void addFileIndexedIOThreadingTest( boost::unit_test::test_suite *test )
+{
+	test->add( new FileIndexedIOThreadingTestSuite( ) );
+}
+
+} // namespace IECore
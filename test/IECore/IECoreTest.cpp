@@ -59,10 +59,16 @@
 #include "RefCountedThreadingTest.h"
 #include "CurvesPrimitiveEvaluatorThreadingTest.h"
 #include "LRUCacheThreadingTest.h"
+#include "LRUCachePolicyTest.h"
 #include "CompoundDataTest.h"
 #include "CompoundObjectTest.h"
 #include "ComputationCacheTest.h"
 #include "SceneCacheThreadingTest.h"
+#include "FileIndexedIOThreadingTest.h"
+#include "MeshAlgoThreadingTest.h"
+#include "MeshAdjacencyTest.h"
+#include "MeshPrimitiveEvaluatorTest.h"
+#include "CacheRegistryTest.h"
 
 using namespace boost::unit_test;
 
@@ -95,10 +101,16 @@ bool init()
 		addRefCountedThreadingTest(test);
 		addCurvesPrimitiveEvaluatorThreadingTest(test);
 		addLRUCacheThreadingTest(test);
+		addLRUCachePolicyTest(test);
 		addCompoundDataTest(test);
 		addCompoundObjectTest(test);
 		addComputationCacheTest(test);
 		addSceneCacheThreadingTest(test);
+		addFileIndexedIOThreadingTest(test);
+		addMeshAlgoThreadingTest(test);
+		addMeshAdjacencyTest(test);
+		addMeshPrimitiveEvaluatorTest(test);
+		addCacheRegistryTest(test);
 	}
 	catch (std::exception &ex)
 	{
@@ -161,6 +161,154 @@ class TestMemoryIndexedIO(unittest.TestCase):
 
 			self.assertEqual( len(entryNames), len(dataPresent) )
 
+class TestFlatIndexedIO(unittest.TestCase):
+
+	def testSaveWriteObjects(self):
+		"""Test FlatIndexedIO read/write operations."""
+		f = FlatIndexedIO( CharVectorData(), [], IndexedIO.OpenMode.Write)
+		self.assertEqual( f.path() , [] )
+		self.assertEqual( f.currentEntryId() , "/" )
+		txt = StringData("test1")
+		txt.save( f, "obj1" )
+		size1 = len( f.buffer() )
+		self.assert_( size1 > 0 )
+		txt.save( f, "obj2" )
+		size2 = len( f.buffer() )
+		self.assert_( size2 > size1 )
+
+		buf = f.buffer()
+		self.assertTrue( FlatIndexedIO.canRead( buf ) )
+
+		f2 = FlatIndexedIO( buf, [], IndexedIO.OpenMode.Read)
+		self.assertEqual( txt, Object.load( f2, "obj1" ) )
+		self.assertEqual( txt, Object.load( f2, "obj2" ) )
+
+	def testReadWrite(self):
+		"""Test FlatIndexedIO read/write of data entries and directories."""
+
+		f = FlatIndexedIO( CharVectorData(), [ "a", "b" ], IndexedIO.OpenMode.Write )
+		self.assertEqual( f.path(), [ "a", "b" ] )
+
+		f.write( "f", 1.5 )
+		f.write( "i", 10 )
+		f.write( "s", "hello" )
+		f.write( "fa", FloatVectorData( [ 1, 2, 3 ] ) )
+		f.write( "ia", IntVectorData( range( 0, 1000 ) ) )
+		f.write( "sa", StringVectorData( [ "a", "", "bcd" ] ) )
+		f.subdirectory( "c", IndexedIO.MissingBehaviour.CreateIfMissing ).write( "v", 2 )
+
+		for mode in ( IndexedIO.OpenMode.Write, IndexedIO.OpenMode.Read ) :
+
+			if mode == IndexedIO.OpenMode.Read :
+				f = FlatIndexedIO( f.buffer(), [ "a", "b" ], mode )
+
+			self.assertEqual( f.read( "f" ).value, 1.5 )
+			self.assertEqual( f.read( "i" ), IntData( 10 ) )
+			self.assertEqual( f.read( "s" ), StringData( "hello" ) )
+			self.assertEqual( f.read( "fa" ), FloatVectorData( [ 1, 2, 3 ] ) )
+			self.assertEqual( f.read( "ia" ), IntVectorData( range( 0, 1000 ) ) )
+			self.assertEqual( f.read( "sa" ), StringVectorData( [ "a", "", "bcd" ] ) )
+			self.assertEqual( f.subdirectory( "c" ).read( "v" ), IntData( 2 ) )
+			self.assertEqual( f.subdirectory( "c" ).path(), [ "a", "b", "c" ] )
+			self.assertEqual( f.parentDirectory().currentEntryId(), "a" )
+			self.assertEqual( f.directory( [ "a", "b", "c" ] ).currentEntryId(), "c" )
+
+			self.assertEqual( f.entry( "ia" ).entryType(), IndexedIO.EntryType.File )
+			self.assertEqual( f.entry( "ia" ).dataType(), IndexedIO.DataType.IntArray )
+			self.assertEqual( f.entry( "ia" ).arrayLength(), 1000 )
+			self.assertEqual( f.entry( "c" ).entryType(), IndexedIO.EntryType.Directory )
+			self.assertEqual( set( f.entryIds() ), set( [ "f", "i", "s", "fa", "ia", "sa", "c" ] ) )
+			self.assertEqual( f.entryIds( IndexedIO.EntryType.Directory ), [ "c" ] )
+
+		self.assertRaises( RuntimeError, f.write, "x", 1 )
+		self.assertRaises( RuntimeError, f.read, "missing" )
+		self.assertRaises( RuntimeError, FlatIndexedIO, f.buffer(), [ "missing" ], IndexedIO.OpenMode.Read )
+
+	def testRemoveAndAppend(self):
+		"""Test that removals and overwrites survive a round trip through the buffer."""
+
+		f = FlatIndexedIO( CharVectorData(), [], IndexedIO.OpenMode.Write )
+		f.write( "a", 1 )
+		f.write( "b", 2 )
+		f.write( "c", 3 )
+		f.subdirectory( "d", IndexedIO.MissingBehaviour.CreateIfMissing ).write( "e", 4 )
+		f.remove( "a" )
+		f.write( "b", "overwritten" )
+		f.subdirectory( "d" ).removeAll()
+
+		f = FlatIndexedIO( f.buffer(), [], IndexedIO.OpenMode.Append )
+		self.assertEqual( set( f.entryIds() ), set( [ "b", "c", "d" ] ) )
+		self.assertEqual( f.read( "b" ), StringData( "overwritten" ) )
+		self.assertEqual( f.subdirectory( "d" ).entryIds(), [] )
+
+		f.write( "a", 5 )
+		f.remove( "c" )
+
+		f = FlatIndexedIO( f.buffer(), [], IndexedIO.OpenMode.Read )
+		self.assertEqual( set( f.entryIds() ), set( [ "a", "b", "d" ] ) )
+		self.assertEqual( f.read( "a" ), IntData( 5 ) )
+
+	def testEncodeDecode(self):
+		"""Test FlatIndexedIO encoding of compound objects."""
+
+		s = StringData( "shared" )
+		c = CompoundData( {
+			"a" : IntData( 1 ),
+			"b" : V3fVectorData( [ V3f( x ) for x in range( 0, 100 ) ] ),
+			"c" : CompoundData( { "d" : s, "e" : s } ),
+			"f" : Box2iData( Box2i( V2i( 0 ), V2i( 10 ) ) ),
+		} )
+
+		b = FlatIndexedIO.encode( c )
+		self.assertTrue( FlatIndexedIO.canRead( b ) )
+		self.assertFalse( FlatIndexedIO.canRead( CharVectorData() ) )
+
+		c2 = FlatIndexedIO.decode( b )
+		self.assertEqual( c2, c )
+		self.assertTrue( c2["c"]["d"].isSame( c2["c"]["e"] ) )
+
+		# The flat buffer should be considerably smaller than the
+		# MemoryIndexedIO one.
+		m = MemoryIndexedIO( CharVectorData(), [], IndexedIO.OpenMode.Write )
+		c.save( m, "object" )
+		self.assertLess( len( b ), len( m.buffer() ) )
+
+	def testInvalidBuffers(self):
+
+		self.assertRaises( RuntimeError, FlatIndexedIO, CharVectorData( "not a flat buffer" ), [], IndexedIO.OpenMode.Read )
+
+		b = FlatIndexedIO.encode( IntVectorData( range( 0, 100 ) ) )
+		truncated = b[:len(b)-32]
+		self.assertRaises( RuntimeError, FlatIndexedIO.decode, truncated )
+
+	def testCorruptData(self):
+
+		# Scalar with the wrong data size. The buffer header is 16 bytes,
+		# and the dataSize field is 24 bytes into the first record.
+
+		f = FlatIndexedIO( CharVectorData(), [], IndexedIO.OpenMode.Write )
+		f.write( "i", 1 )
+		b = f.buffer()
+		self.assertEqual( FlatIndexedIO( b, [], IndexedIO.OpenMode.Read ).read( "i" ), IntData( 1 ) )
+		b[40] = chr( 2 )
+		self.assertRaises( RuntimeError, FlatIndexedIO( b, [], IndexedIO.OpenMode.Read ).read, "i" )
+
+		# String without a terminator within the entry.
+
+		f = FlatIndexedIO( CharVectorData(), [], IndexedIO.OpenMode.Write )
+		f.write( "s", "hello" )
+		b = f.buffer()
+		b["".join( b ).find( "hello" ) + 5] = "x"
+		self.assertRaises( RuntimeError, FlatIndexedIO( b, [], IndexedIO.OpenMode.Read ).read, "s" )
+
+		# String array with an embedded length beyond the end of the entry.
+
+		f = FlatIndexedIO( CharVectorData(), [], IndexedIO.OpenMode.Write )
+		f.write( "sa", StringVectorData( [ "abc" ] ) )
+		b = f.buffer()
+		b["".join( b ).find( "abc" ) - 1] = chr( 0x7f )
+		self.assertRaises( RuntimeError, FlatIndexedIO( b, [], IndexedIO.OpenMode.Read ).read, "sa" )
+
 class TestFileIndexedIO(unittest.TestCase):
 
 	badNames = ['*', '!', '&', '^', '@', '#', '$', '(', ')', '<', '+',
@@ -421,6 +569,173 @@ class TestFileIndexedIO(unittest.TestCase):
 		for n in range(0, 1000):
 			self.assertEqual(fv[n], gv[n])
 
+	def testMemoryMapped( self ) :
+
+		f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Write | IndexedIO.OpenMode.MemoryMapped )
+		self.failIf( f.openMode() & IndexedIO.OpenMode.MemoryMapped )
+
+		g = f.subdirectory( "sub1", IndexedIO.MissingBehaviour.CreateIfMissing )
+		fv = FloatVectorData( [ math.sin( n ) for n in range( 0, 1000000 ) ] )
+		g.write( "large", fv )
+		g.write( "small", StringData( "small" ) )
+		sv = StringVectorData( [ str( n ) for n in range( 0, 1000 ) ] )
+		g.write( "strings", sv )
+		del f, g
+
+		f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Read | IndexedIO.OpenMode.MemoryMapped )
+		self.failUnless( f.openMode() & IndexedIO.OpenMode.MemoryMapped )
+
+		g = f.subdirectory( "sub1" )
+		self.assertEqual( g.read( "large" ), fv )
+		self.assertEqual( g.read( "small" ), StringData( "small" ) )
+		# strings are unflattened directly from the mapping
+		self.assertEqual( g.read( "strings" ), sv )
+		# data read from the mapping remains valid once the file is closed
+		strings = g.read( "strings" )
+		del f, g
+		self.assertEqual( strings, sv )
+
+	@unittest.skipIf( not os.path.exists( "/proc/self/statm" ), "Resident size unavailable" )
+	def testMemoryMappedResidentSize( self ) :
+
+		def residentSize() :
+			with open( "/proc/self/statm" ) as f :
+				return int( f.read().split()[1] ) * os.sysconf( "SC_PAGE_SIZE" )
+
+		fv = FloatVectorData( [ math.sin( n ) for n in range( 0, 1000000 ) ] )
+		data = FloatVectorData()
+		for i in range( 0, 8 ) :
+			data.extend( fv )
+		dataSize = len( data ) * 4
+
+		f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Write )
+		f.setDataCompression( StreamIndexedIO.Compression.Deflate, shuffle = True )
+		f.write( "large", data )
+		del f
+
+		compressedSize = os.path.getsize( "./test/FileIndexedIO.fio" )
+		self.assertLess( compressedSize, dataSize )
+
+		for mode in [ IndexedIO.OpenMode.Read, IndexedIO.OpenMode.Read | IndexedIO.OpenMode.MemoryMapped ] :
+
+			f = FileIndexedIO( "./test/FileIndexedIO.fio", [], mode )
+			before = residentSize()
+			result = f.read( "large" )
+			increase = residentSize() - before
+
+			self.assertEqual( result, data )
+			# Only the result should remain resident, and not the
+			# mapped pages of the compressed block it was read from.
+			self.assertLess( increase, dataSize + compressedSize / 2 )
+
+			del f, result
+
+	def testCompression( self ) :
+
+		fv = FloatVectorData( [ math.sin( n * 0.001 ) for n in range( 0, 100000 ) ] )
+		iv = IntVectorData( range( 0, 100000 ) )
+		sv = StringVectorData( [ "abc" ] * 1000 )
+
+		sizes = {}
+		for compression, indexCompression, shuffle in [
+			( StreamIndexedIO.Compression.Uncompressed, StreamIndexedIO.Compression.Gzip, False ),
+			( StreamIndexedIO.Compression.Deflate, StreamIndexedIO.Compression.Gzip, False ),
+			( StreamIndexedIO.Compression.Deflate, StreamIndexedIO.Compression.Deflate, True ),
+			( StreamIndexedIO.Compression.Deflate, StreamIndexedIO.Compression.Uncompressed, True ),
+		] :
+
+			f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Write )
+			f.setDataCompression( compression, shuffle = shuffle )
+			f.setIndexCompression( indexCompression )
+			for name in [ "a", "b" ] :
+				g = f.subdirectory( name, IndexedIO.MissingBehaviour.CreateIfMissing )
+				g.write( "floats", fv )
+				g.write( "ints", iv )
+				g.write( "strings", sv )
+				g.write( "small", FloatData( 1 ) )
+				g.commit()
+			if indexCompression != StreamIndexedIO.Compression.Gzip :
+				self.assertRaises( RuntimeError, f.setIndexCompression, StreamIndexedIO.Compression.Gzip )
+			del f, g
+
+			sizes[(compression, indexCompression, shuffle)] = os.path.getsize( "./test/FileIndexedIO.fio" )
+
+			# memory mapped files decompress directly from the mapping
+			for mode in [ IndexedIO.OpenMode.Read, IndexedIO.OpenMode.Read | IndexedIO.OpenMode.MemoryMapped ] :
+				f = FileIndexedIO( "./test/FileIndexedIO.fio", [], mode )
+				for name in [ "a", "b" ] :
+					g = f.subdirectory( name )
+					self.assertEqual( g.read( "floats" ), fv )
+					self.assertEqual( g.read( "ints" ), iv )
+					self.assertEqual( g.read( "strings" ), sv )
+					self.assertEqual( g.read( "small" ), FloatData( 1 ) )
+
+			# appending keeps the existing compression intact, and applies
+			# the file's data compression rather than the defaults
+			del f, g
+			StreamIndexedIO.setDefaultDataCompression( StreamIndexedIO.Compression.Deflate )
+			try :
+				f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Append )
+			finally :
+				StreamIndexedIO.setDefaultDataCompression( StreamIndexedIO.Compression.Uncompressed )
+			appendedData = FloatVectorData( [ 0.5 ] * 100000 )
+			f.write( "appended", appendedData )
+			del f
+			appendedSize = os.path.getsize( "./test/FileIndexedIO.fio" ) - sizes[(compression, indexCompression, shuffle)]
+			if compression == StreamIndexedIO.Compression.Uncompressed :
+				self.assertGreater( appendedSize, appendedData.size() * 4 )
+			else :
+				self.assertLess( appendedSize, appendedData.size() * 2 )
+			f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Read )
+			self.assertEqual( f.read( "appended" ), appendedData )
+			self.assertEqual( f.subdirectory( "b" ).read( "floats" ), fv )
+
+		uncompressed = sizes[( StreamIndexedIO.Compression.Uncompressed, StreamIndexedIO.Compression.Gzip, False )]
+		compressed = sizes[( StreamIndexedIO.Compression.Deflate, StreamIndexedIO.Compression.Gzip, False )]
+		shuffled = sizes[( StreamIndexedIO.Compression.Deflate, StreamIndexedIO.Compression.Deflate, True )]
+		self.assertLess( compressed, uncompressed )
+		self.assertLess( shuffled, compressed )
+
+		self.assertRaises( RuntimeError, FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Write ).setDataCompression, StreamIndexedIO.Compression.Gzip )
+
+	@unittest.skipIf( IECore.isDebug(), "Skip performance testing in debug builds" )
+	def testCompressionPerformance( self ) :
+
+		# Deflate is the same algorithm as Gzip, so this compares the
+		# cost of the existing gzip index with the lighter zlib framing
+		# and byte shuffling, rather than with a dedicated fast codec.
+
+		fv = FloatVectorData( [ math.sin( n * 0.001 ) for n in range( 0, 10000 ) ] )
+
+		sizes = {}
+		for compression, indexCompression in [
+			( StreamIndexedIO.Compression.Uncompressed, StreamIndexedIO.Compression.Gzip ),
+			( StreamIndexedIO.Compression.Deflate, StreamIndexedIO.Compression.Deflate ),
+		] :
+
+			f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Write )
+			f.setDataCompression( compression, shuffle = True )
+			f.setIndexCompression( indexCompression )
+			for i in range( 0, 200 ) :
+				g = f.subdirectory( "dir%d" % i, IndexedIO.MissingBehaviour.CreateIfMissing )
+				for j in range( 0, 50 ) :
+					g.write( "entry%d" % j, j )
+				g.write( "floats", fv )
+				g.commit()
+			del f, g
+
+			sizes[compression] = os.path.getsize( "./test/FileIndexedIO.fio" )
+
+			for n in range( 0, 5 ) :
+				f = FileIndexedIO( "./test/FileIndexedIO.fio", [], IndexedIO.OpenMode.Read )
+				for i in range( 0, 200 ) :
+					g = f.subdirectory( "dir%d" % i )
+					self.assertEqual( len( g.entryIds() ), 51 )
+					self.assertEqual( g.read( "floats" ), fv )
+				del f, g
+
+		self.assertLess( sizes[StreamIndexedIO.Compression.Deflate], sizes[StreamIndexedIO.Compression.Uncompressed] )
+
 	def testReadWriteDoubleVector(self):
 		"""Test FileIndexedIO read/write(DoubleVector)"""
 
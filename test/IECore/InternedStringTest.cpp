@@ -33,6 +33,8 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include <iostream>
+#include <algorithm>
+#include <vector>
 
 #include "tbb/tbb.h"
 
@@ -95,6 +97,33 @@ struct InternedStringTest
 
 	};
 
+	void testHash()
+	{
+		BOOST_CHECK_EQUAL( InternedString( "a" ).hash(), InternedString( std::string( "a" ) ).hash() );
+		BOOST_CHECK_EQUAL( InternedString( "aabb", 2 ).hash(), InternedString( "aa" ).hash() );
+		BOOST_CHECK( InternedString( "a" ).hash() != InternedString( "b" ).hash() );
+		BOOST_CHECK_EQUAL( std::hash<InternedString>()( InternedString( "a" ) ), InternedString( "a" ).hash() );
+	}
+
+	void testValueLess()
+	{
+		std::vector<InternedString> strings;
+		for( int i = 0; i < 100; ++i )
+		{
+			strings.push_back( InternedString( lexical_cast<std::string>( 99 - i ) ) );
+		}
+
+		std::sort( strings.begin(), strings.end(), InternedString::ValueLess() );
+		for( size_t i = 1; i < strings.size(); ++i )
+		{
+			BOOST_CHECK( strings[i-1].string() < strings[i].string() );
+		}
+
+		BOOST_CHECK( !InternedString::ValueLess()( InternedString( "a" ), InternedString( "a" ) ) );
+		BOOST_CHECK( InternedString::ValueLess()( InternedString( "a" ), InternedString( "b" ) ) );
+		BOOST_CHECK( !InternedString::ValueLess()( InternedString( "b" ), InternedString( "a" ) ) );
+	}
+
 };
 
 
@@ -107,6 +136,8 @@ struct InternedStringTestSuite : public boost::unit_test::test_suite
 
 		add( BOOST_CLASS_TEST_CASE( &InternedStringTest::testConcurrentConstruction, instance ) );
 		add( BOOST_CLASS_TEST_CASE( &InternedStringTest::testRangeConstruction, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &InternedStringTest::testHash, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &InternedStringTest::testValueLess, instance ) );
 
 	}
 };
@@ -192,4 +192,50 @@ void KDTreeTest<T>::testNearestNNeighours()
 
 }
 
+template<typename T>
+void KDTreeTest<T>::testBatchedNearestNeighours()
+{
+	typename T::BaseType radius = 0.05;
+
+	IteratorVector batchedNeighbours;
+	std::vector<size_t> offsets;
+	size_t numNeighbours = m_tree->nearestNeighbours( m_points.begin(), m_points.end(), radius, batchedNeighbours, offsets );
+
+	BOOST_CHECK( offsets.size() == m_points.size() + 1 );
+	BOOST_CHECK( offsets.back() == numNeighbours );
+	BOOST_CHECK( batchedNeighbours.size() == numNeighbours );
+
+	// Results should be identical to those from individual queries
+	IteratorVector nearNeighbours;
+	for( size_t i = 0; i < m_points.size(); i++ )
+	{
+		m_tree->nearestNeighbours( m_points[i], radius, nearNeighbours );
+		BOOST_CHECK( offsets[i+1] - offsets[i] == nearNeighbours.size() );
+		BOOST_CHECK( std::equal( nearNeighbours.begin(), nearNeighbours.end(), batchedNeighbours.begin() + offsets[i] ) );
+	}
+}
+
+template<typename T>
+void KDTreeTest<T>::testBatchedNearestNNeighours()
+{
+	unsigned int neighboursRequested = 4;
+
+	NeighbourVector batchedNeighbours;
+	unsigned int numNeighbours = m_tree->nearestNNeighbours( m_points.begin(), m_points.end(), neighboursRequested, batchedNeighbours );
+
+	BOOST_CHECK( numNeighbours == std::min<size_t>( neighboursRequested, m_numPoints ) );
+	BOOST_CHECK( batchedNeighbours.size() == m_points.size() * numNeighbours );
+
+	// Results should be identical to those from individual queries
+	NeighbourVector nearNeighbours;
+	for( size_t i = 0; i < m_points.size(); i++ )
+	{
+		BOOST_CHECK( m_tree->nearestNNeighbours( m_points[i], neighboursRequested, nearNeighbours ) == numNeighbours );
+		for( size_t j = 0; j < numNeighbours; j++ )
+		{
+			BOOST_CHECK( batchedNeighbours[i*numNeighbours+j].distSquared == nearNeighbours[j].distSquared );
+		}
+	}
+}
+
 }
@@ -0,0 +1,246 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <iomanip>
+#include <random>
+
+#include "boost/format.hpp"
+
+#include "tbb/tbb.h"
+
+#include "IECore/LRUCache.h"
+
+#include "LRUCachePolicyTest.h"
+
+using namespace boost;
+using namespace boost::unit_test;
+using namespace tbb;
+
+namespace IECore
+{
+
+// Compares the hit rates and throughput of the different LRUCache policies,
+// using access traces modelled on our typical workloads. Run with
+// `--log_level=message` to see the results.
+struct LRUCachePolicyTest
+{
+
+	typedef std::vector<int> Trace;
+
+	// A playblast stepping through the frames of a shot. Each frame reads
+	// a selection of the assets used by the shot, along with data which
+	// is unique to that frame and will never be read again.
+	static void playblastTrace( Trace &trace )
+	{
+		std::minstd_rand random( 42 );
+		const int numAssets = 200;
+		for( int frame = 0; frame < 500; ++frame )
+		{
+			for( int i = 0; i < 50; ++i )
+			{
+				trace.push_back( random() % numAssets );
+			}
+			for( int i = 0; i < 100; ++i )
+			{
+				trace.push_back( numAssets + frame * 100 + i );
+			}
+		}
+	}
+
+	// A farm job repeatedly referencing a small set of assets
+	// with a skewed distribution, interrupted by long sequential
+	// scans such as a cache being written or verified.
+	static void scanTrace( Trace &trace )
+	{
+		std::minstd_rand random( 42 );
+		const int numAssets = 400;
+		int scanKey = numAssets;
+		for( int pass = 0; pass < 20; ++pass )
+		{
+			for( int i = 0; i < 2000; ++i )
+			{
+				// Squaring a uniform distribution skews accesses
+				// towards the lower numbered assets.
+				const float f = (float)( random() % 1000 ) / 1000.0f;
+				trace.push_back( (int)( f * f * numAssets ) );
+			}
+			for( int i = 0; i < 1000; ++i )
+			{
+				trace.push_back( scanKey++ );
+			}
+		}
+	}
+
+	struct Getter
+	{
+		Getter( tbb::atomic<size_t> &misses )
+			:	m_misses( misses )
+		{
+		}
+
+		int operator()( const int &key, size_t &cost ) const
+		{
+			++m_misses;
+			cost = 1;
+			return key;
+		}
+
+		tbb::atomic<size_t> &m_misses;
+	};
+
+	template<typename Cache>
+	struct GetFromCache
+	{
+		GetFromCache( Cache &cache, const Trace &trace )
+			:	m_cache( cache ), m_trace( trace )
+		{
+		}
+
+		void operator()( const blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				m_cache.get( m_trace[i] );
+			}
+		}
+
+		Cache &m_cache;
+		const Trace &m_trace;
+	};
+
+	// Returns the hit rate, and the number of lookups per second.
+	template<template <typename> class Policy>
+	static std::pair<double, double> run( const Trace &trace, size_t maxCost, bool parallel )
+	{
+		typedef LRUCache<int, int, Policy> Cache;
+
+		tbb::atomic<size_t> misses;
+		misses = 0;
+		Cache cache( Getter( misses ), maxCost );
+
+		// The hit rate is measured on the first run, which starts with
+		// an empty cache. Further runs just improve the timing accuracy.
+		const size_t numRepeats = 10;
+		size_t firstRunMisses = 0;
+		tick_count t0 = tick_count::now();
+		for( size_t i = 0; i < numRepeats; ++i )
+		{
+			if( parallel )
+			{
+				parallel_for( blocked_range<size_t>( 0, trace.size() ), GetFromCache<Cache>( cache, trace ) );
+			}
+			else
+			{
+				GetFromCache<Cache>( cache, trace )( blocked_range<size_t>( 0, trace.size() ) );
+			}
+			if( i == 0 )
+			{
+				firstRunMisses = misses;
+			}
+		}
+		const double seconds = ( tick_count::now() - t0 ).seconds();
+
+		BOOST_CHECK( cache.currentCost() <= maxCost );
+
+		return std::make_pair(
+			1.0 - (double)firstRunMisses / (double)trace.size(),
+			(double)( trace.size() * numRepeats ) / seconds
+		);
+	}
+
+	template<template <typename> class Policy>
+	static double benchmark( const std::string &policy, const std::string &traceName, const Trace &trace, size_t maxCost, bool parallel )
+	{
+		std::pair<double, double> r = run<Policy>( trace, maxCost, parallel );
+		BOOST_TEST_MESSAGE(
+			boost::format( "%-28s %-10s hit rate %6.2f%%  %8.2f M lookups/s" ) % policy % traceName % ( r.first * 100.0 ) % ( r.second / 1e6 )
+		);
+		return r.first;
+	}
+
+	void testSerial()
+	{
+		Trace playblast; playblastTrace( playblast );
+		Trace scan; scanTrace( scan );
+
+		const double serialPlayblast = benchmark<LRUCachePolicy::Serial>( "Serial", "playblast", playblast, 200, false );
+		const double segmentedPlayblast = benchmark<LRUCachePolicy::SerialSegmented>( "SerialSegmented", "playblast", playblast, 200, false );
+		BOOST_CHECK( segmentedPlayblast > serialPlayblast );
+
+		const double serialScan = benchmark<LRUCachePolicy::Serial>( "Serial", "scan", scan, 300, false );
+		const double segmentedScan = benchmark<LRUCachePolicy::SerialSegmented>( "SerialSegmented", "scan", scan, 300, false );
+		BOOST_CHECK( segmentedScan > serialScan );
+	}
+
+	void testParallel()
+	{
+		Trace playblast; playblastTrace( playblast );
+		Trace scan; scanTrace( scan );
+
+		// Hit rates are measured serially so that they are deterministic.
+		const double parallelPlayblast = benchmark<LRUCachePolicy::Parallel>( "Parallel", "playblast", playblast, 200, false );
+		const double frequencyPlayblast = benchmark<LRUCachePolicy::ParallelFrequency>( "ParallelFrequency", "playblast", playblast, 200, false );
+		BOOST_CHECK( frequencyPlayblast > parallelPlayblast );
+
+		const double parallelScan = benchmark<LRUCachePolicy::Parallel>( "Parallel", "scan", scan, 300, false );
+		const double frequencyScan = benchmark<LRUCachePolicy::ParallelFrequency>( "ParallelFrequency", "scan", scan, 300, false );
+		BOOST_CHECK( frequencyScan > parallelScan );
+
+		// And then in parallel for throughput.
+		benchmark<LRUCachePolicy::Parallel>( "Parallel (threaded)", "playblast", playblast, 200, true );
+		benchmark<LRUCachePolicy::ParallelFrequency>( "ParallelFrequency (threaded)", "playblast", playblast, 200, true );
+		benchmark<LRUCachePolicy::Parallel>( "Parallel (threaded)", "scan", scan, 300, true );
+		benchmark<LRUCachePolicy::ParallelFrequency>( "ParallelFrequency (threaded)", "scan", scan, 300, true );
+	}
+
+};
+
+struct LRUCachePolicyTestSuite : public boost::unit_test::test_suite
+{
+
+	LRUCachePolicyTestSuite() : boost::unit_test::test_suite( "LRUCachePolicyTestSuite" )
+	{
+		boost::shared_ptr<LRUCachePolicyTest> instance( new LRUCachePolicyTest() );
+
+		add( BOOST_CLASS_TEST_CASE( &LRUCachePolicyTest::testSerial, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &LRUCachePolicyTest::testParallel, instance ) );
+	}
+};
+
+void addLRUCachePolicyTest( boost::unit_test::test_suite *test )
+{
+	test->add( new LRUCachePolicyTestSuite( ) );
+}
+
+} // namespace IECore
@@ -279,6 +279,55 @@ class LRUCacheTest( unittest.TestCase ) :
 		# clearing all the time while doing concurrent lookups
 		IECore.testLRUCacheThreading( 100000, 1000, 90, 20 )
 
+	def testShardedThreading( self ) :
+
+		for numValues, maxCost, clearFrequency in [
+			( 100, 100, 0 ),
+			( 100, 90, 0 ),
+			( 1000, 2, 0 ),
+			( 1000, 90, 20 ),
+		] :
+			stats = IECore.testShardedLRUCacheThreading( 100000, numValues, maxCost, clearFrequency, numThreads = 64 )
+			self.assertEqual( sum( s["hits"] + s["misses"] for s in stats ), 100000 )
+			self.assertGreaterEqual( sum( s["misses"] for s in stats ), min( numValues, maxCost ) )
+
+		# no evictions when everything fits
+		stats = IECore.testShardedLRUCacheThreading( 100000, 100, 100, numThreads = 64 )
+		self.assertEqual( sum( s["evictions"] for s in stats ), 0 )
+		self.assertEqual( sum( s["misses"] for s in stats ), 100 )
+
+	@unittest.skipIf( IECore.isDebug(), "Skip performance testing in debug builds" )
+	def testShardedThreadingPerformance( self ) :
+
+		# Runs the Sharded policy alongside the Parallel
+		# policy, using the harness above with 64 threads,
+		# so the two can be compared in the test timings.
+		# Wall clock times are too noisy to assert on here.
+		# testLRUCacheThreading walks two caches, so we walk
+		# two sharded caches to match. Both harnesses throw
+		# if they see an incorrect value.
+
+		for numValues, maxCost in [ ( 10000, 10000 ), ( 10000, 1000 ) ] :
+
+			IECore.testLRUCacheThreading( 1000000, numValues, maxCost, numThreads = 64 )
+
+			stats = [
+				IECore.testShardedLRUCacheThreading( 1000000, numValues, maxCost, numThreads = 64 ),
+				IECore.testShardedLRUCacheThreading( 1000000, numValues, maxCost, numThreads = 64 ),
+			]
+
+			for s in stats :
+				self.assertEqual( sum( x["hits"] + x["misses"] for x in s ), 1000000 )
+				self.assertGreaterEqual( sum( x["misses"] for x in s ), min( numValues, maxCost ) )
+				if maxCost >= numValues :
+					self.assertEqual( sum( x["misses"] for x in s ), numValues )
+					self.assertEqual( sum( x["evictions"] for x in s ), 0 )
+
+	def testShardedRecursion( self ) :
+
+		IECore.testShardedLRUCacheRecursion( 100000, 10000, 10000 )
+		IECore.testShardedLRUCacheRecursion( 100000, 1000, 100 )
+
 	def testEraseAndCached( self ) :
 
 		def getter( key ) :
@@ -312,6 +361,16 @@ class LRUCacheTest( unittest.TestCase ) :
 		# Cache small enough that evictions are necessary
 		IECore.testParallelLRUCacheRecursion( 100000, 1000, 100 )
 
+	def testSerialSegmentedRecursion( self ) :
+
+		IECore.testSerialSegmentedLRUCacheRecursion( 100 )
+		IECore.testSerialSegmentedLRUCacheRecursion( 10 )
+
+	def testParallelFrequencyRecursion( self ) :
+
+		IECore.testParallelFrequencyLRUCacheRecursion( 100000, 10000, 10000 )
+		IECore.testParallelFrequencyLRUCacheRecursion( 100000, 1000, 100 )
+
 	def testExceptions( self ) :
 
 		calls = []
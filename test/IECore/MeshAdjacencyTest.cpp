@@ -0,0 +1,210 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "tbb/tbb.h"
+
+#include "IECore/MeshPrimitive.h"
+
+#include "MeshAdjacencyTest.h"
+
+using namespace boost;
+using namespace boost::unit_test;
+using namespace tbb;
+using namespace Imath;
+
+namespace IECore
+{
+
+struct MeshAdjacencyTest
+{
+
+	void testPlane()
+	{
+		// 3x3 vertices, with vertex 4 in the middle
+		MeshPrimitivePtr mesh = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 2 ) );
+		ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
+		const std::vector<int> &vertexIds = mesh->vertexIds()->readable();
+
+		BOOST_CHECK_EQUAL( adjacency->numFaces(), 4u );
+		BOOST_CHECK_EQUAL( adjacency->numVertices(), 9u );
+		BOOST_CHECK_EQUAL( adjacency->numFaceVaryings(), 16u );
+
+		for( size_t f = 0; f < adjacency->numFaces(); ++f )
+		{
+			BOOST_CHECK_EQUAL( adjacency->faceOffsets()[f], (int)f * 4 );
+		}
+		BOOST_CHECK_EQUAL( adjacency->faceOffsets().back(), 16 );
+
+		for( int v = 0; v < 9; ++v )
+		{
+			BOOST_CHECK_EQUAL( adjacency->isBoundaryVertex( v ), v != 4 );
+
+			const int numFaces = adjacency->vertexOffsets()[v+1] - adjacency->vertexOffsets()[v];
+			BOOST_CHECK_EQUAL( numFaces, v == 4 ? 4 : ( v % 2 ? 2 : 1 ) );
+			for( int i = adjacency->vertexOffsets()[v]; i < adjacency->vertexOffsets()[v+1]; ++i )
+			{
+				BOOST_CHECK_EQUAL( vertexIds[adjacency->vertexFaceVaryings()[i]], v );
+			}
+		}
+
+		int numInteriorHalfEdges = 0;
+		int numBoundaryHalfEdges = 0;
+		for( int h = 0; h < 16; ++h )
+		{
+			const int opposite = adjacency->oppositeHalfEdges()[h];
+			if( opposite == -1 )
+			{
+				BOOST_CHECK( adjacency->isBoundaryEdge( h ) );
+				numBoundaryHalfEdges++;
+				continue;
+			}
+
+			BOOST_CHECK( !adjacency->isBoundaryEdge( h ) );
+			BOOST_CHECK_EQUAL( adjacency->oppositeHalfEdges()[opposite], h );
+			BOOST_CHECK_EQUAL( vertexIds[opposite], vertexIds[adjacency->nextFaceVarying( h )] );
+			BOOST_CHECK_EQUAL( vertexIds[adjacency->nextFaceVarying( opposite )], vertexIds[h] );
+			BOOST_CHECK( adjacency->faceVaryingFaces()[opposite] != adjacency->faceVaryingFaces()[h] );
+			numInteriorHalfEdges++;
+		}
+
+		BOOST_CHECK_EQUAL( numInteriorHalfEdges, 8 );
+		BOOST_CHECK_EQUAL( numBoundaryHalfEdges, 8 );
+
+		BOOST_CHECK_EQUAL( adjacency->nextFaceVarying( 3 ), 0 );
+		BOOST_CHECK_EQUAL( adjacency->previousFaceVarying( 4 ), 7 );
+	}
+
+	void testNonManifold()
+	{
+		// three triangles sharing the edge between vertices 0 and 1
+		IntVectorDataPtr verticesPerFace = new IntVectorData( std::vector<int>( 3, 3 ) );
+		IntVectorDataPtr vertexIds = new IntVectorData;
+		const int ids[] = { 0, 1, 2, 1, 0, 3, 0, 1, 4 };
+		vertexIds->writable().assign( ids, ids + 9 );
+
+		MeshPrimitivePtr mesh = new MeshPrimitive( verticesPerFace, vertexIds );
+		ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
+
+		for( int f = 0; f < 3; ++f )
+		{
+			// the shared edge is neither interior nor boundary
+			BOOST_CHECK_EQUAL( adjacency->oppositeHalfEdges()[f*3], -1 );
+			BOOST_CHECK( !adjacency->isBoundaryEdge( f*3 ) );
+			// but the others are all boundaries
+			BOOST_CHECK( adjacency->isBoundaryEdge( f*3 + 1 ) );
+			BOOST_CHECK( adjacency->isBoundaryEdge( f*3 + 2 ) );
+		}
+	}
+
+	void testSharing()
+	{
+		MeshPrimitivePtr mesh = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 10 ) );
+		ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
+		BOOST_CHECK( mesh->adjacency() == adjacency );
+
+		// copies share the adjacency of the original
+		MeshPrimitivePtr meshCopy = mesh->copy();
+		BOOST_CHECK( meshCopy->adjacency() == adjacency );
+
+		// as do independent meshes with identical topology
+		MeshPrimitivePtr mesh2 = MeshPrimitive::createPlane( Box2f( V2f( -2 ), V2f( 2 ) ), V2i( 10 ) );
+		BOOST_CHECK( mesh2->adjacency() == adjacency );
+
+		// but changing the topology gives new adjacency
+		MeshPrimitivePtr mesh3 = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 11 ) );
+		meshCopy->setTopology( mesh3->verticesPerFace(), mesh3->vertexIds() );
+		ConstMeshAdjacencyPtr adjacency3 = meshCopy->adjacency();
+		BOOST_CHECK( adjacency3 != adjacency );
+		BOOST_CHECK_EQUAL( adjacency3->numFaces(), 121u );
+		BOOST_CHECK( mesh->adjacency() == adjacency );
+	}
+
+	struct GetAdjacency
+	{
+
+		GetAdjacency( const MeshPrimitive *mesh, std::vector<const MeshAdjacency *> &results )
+			:	m_mesh( mesh ), m_results( results )
+		{
+		}
+
+		void operator()( const blocked_range<size_t> &r ) const
+		{
+			for( size_t i = r.begin(); i != r.end(); ++i )
+			{
+				m_results[i] = m_mesh->adjacency().get();
+			}
+		}
+
+		const MeshPrimitive *m_mesh;
+		std::vector<const MeshAdjacency *> &m_results;
+
+	};
+
+	void testConcurrentAccess()
+	{
+		MeshPrimitivePtr mesh = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 200, 201 ) );
+
+		std::vector<const MeshAdjacency *> results( 10000 );
+		parallel_for( blocked_range<size_t>( 0, results.size(), 1 ), GetAdjacency( mesh.get(), results ) );
+
+		// every caller must see the same adjacency
+		ConstMeshAdjacencyPtr adjacency = mesh->adjacency();
+		for( std::vector<const MeshAdjacency *>::const_iterator it = results.begin(); it != results.end(); ++it )
+		{
+			BOOST_CHECK_EQUAL( *it, adjacency.get() );
+		}
+	}
+
+};
+
+struct MeshAdjacencyTestSuite : public boost::unit_test::test_suite
+{
+
+	MeshAdjacencyTestSuite() : boost::unit_test::test_suite( "MeshAdjacencyTestSuite" )
+	{
+		boost::shared_ptr<MeshAdjacencyTest> instance( new MeshAdjacencyTest() );
+
+		add( BOOST_CLASS_TEST_CASE( &MeshAdjacencyTest::testPlane, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &MeshAdjacencyTest::testNonManifold, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &MeshAdjacencyTest::testSharing, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &MeshAdjacencyTest::testConcurrentAccess, instance ) );
+	}
+};
+
+void addMeshAdjacencyTest( boost::unit_test::test_suite *test )
+{
+	test->add( new MeshAdjacencyTestSuite( ) );
+}
+
+} // namespace IECore
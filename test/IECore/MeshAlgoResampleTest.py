@@ -293,5 +293,45 @@ class MeshAlgoResampleTest( unittest.TestCase ) :
 				for v in pv.data :
 					self.assertEqual( v, IECore.V2f( 0 ) )
 
+	def testResamplePrimitiveVariables( self ) :
+
+		mesh = self.makeMesh()
+		names = [ n for n in mesh.keys() if n != "P" ]
+
+		for interpolation in IECore.PrimitiveVariable.Interpolation.values.values() :
+
+			if interpolation == IECore.PrimitiveVariable.Interpolation.Invalid :
+				continue
+
+			variables = dict( [ ( n, mesh[n] ) for n in names ] )
+			IECore.MeshAlgo.resamplePrimitiveVariables( mesh, variables, interpolation )
+
+			for n in names :
+				expected = mesh[n]
+				IECore.MeshAlgo.resamplePrimitiveVariable( mesh, expected, interpolation )
+				self.assertEqual( variables[n], expected )
+
+			# source variables must not be modified
+			for n in names :
+				self.assertEqual( mesh[n], self.mesh[n] )
+
+	def testResampleNonArithmeticToFaceVarying( self ) :
+
+		mesh = self.makeMesh()
+		pv = IECore.PrimitiveVariable(
+			IECore.PrimitiveVariable.Interpolation.Uniform,
+			IECore.StringVectorData( [ "a", "b", "c", "d" ] )
+		)
+		IECore.MeshAlgo.resamplePrimitiveVariable( mesh, pv, IECore.PrimitiveVariable.Interpolation.FaceVarying )
+		self.assertEqual( pv.interpolation, IECore.PrimitiveVariable.Interpolation.FaceVarying )
+		self.assertEqual( pv.data, IECore.StringVectorData( [ x for x in "abcd" for i in range( 0, 4 ) ] ) )
+
+		pv = IECore.PrimitiveVariable(
+			IECore.PrimitiveVariable.Interpolation.Vertex,
+			IECore.BoolVectorData( [ i % 2 == 0 for i in range( 0, 9 ) ] )
+		)
+		IECore.MeshAlgo.resamplePrimitiveVariable( mesh, pv, IECore.PrimitiveVariable.Interpolation.FaceVarying )
+		self.assertEqual( pv.data, IECore.BoolVectorData( [ i % 2 == 0 for i in mesh.vertexIds ] ) )
+
 if __name__ == "__main__":
 	unittest.main()
@@ -0,0 +1,354 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+
+#include "boost/format.hpp"
+
+#include "tbb/tbb.h"
+
+#include "OpenEXR/ImathRandom.h"
+
+#include "IECore/MeshAlgo.h"
+#include "IECore/MeshNormalsOp.h"
+#include "IECore/TriangulateOp.h"
+
+#include "MeshAlgoThreadingTest.h"
+
+using namespace boost;
+using namespace boost::unit_test;
+using namespace tbb;
+using namespace Imath;
+
+namespace IECore
+{
+
+struct MeshAlgoThreadingTest
+{
+
+	// Makes a mesh containing many copies of a small mesh, each offset
+	// from the last. The copies are large enough in total for the algorithms
+	// to run in parallel, but the results for each copy must match the known
+	// results for a single one.
+	MeshPrimitivePtr makeTiledMesh( const std::vector<int> &verticesPerFace, const std::vector<int> &vertexIds, const std::vector<V3f> &p, const std::vector<V3f> &pRef, const std::vector<V2f> &uvs, size_t numCopies )
+	{
+		IntVectorDataPtr tiledVerticesPerFace = new IntVectorData;
+		IntVectorDataPtr tiledVertexIds = new IntVectorData;
+		V3fVectorDataPtr tiledP = new V3fVectorData;
+		V3fVectorDataPtr tiledPRef = new V3fVectorData;
+		V2fVectorDataPtr tiledUVs = new V2fVectorData;
+
+		for( size_t c = 0; c < numCopies; ++c )
+		{
+			const V3f offset( c * 10.0f, 0, 0 );
+			const int vertexOffset = c * p.size();
+			tiledVerticesPerFace->writable().insert( tiledVerticesPerFace->writable().end(), verticesPerFace.begin(), verticesPerFace.end() );
+			for( size_t i = 0; i < vertexIds.size(); ++i )
+			{
+				tiledVertexIds->writable().push_back( vertexIds[i] + vertexOffset );
+				tiledUVs->writable().push_back( uvs[i] );
+			}
+			for( size_t i = 0; i < p.size(); ++i )
+			{
+				tiledP->writable().push_back( p[i] + offset );
+				tiledPRef->writable().push_back( pRef[i] + offset );
+			}
+		}
+
+		MeshPrimitivePtr result = new MeshPrimitive( tiledVerticesPerFace, tiledVertexIds, "linear", tiledP );
+		result->variables["Pref"] = PrimitiveVariable( PrimitiveVariable::Vertex, tiledPRef );
+		result->variables["uv"] = PrimitiveVariable( PrimitiveVariable::FaceVarying, tiledUVs );
+		return result;
+	}
+
+	// Returns the number of elements of data which differ from the
+	// repeating sequence of expected values.
+	template<typename T>
+	size_t numMismatches( const Data *data, const std::vector<T> &expected, float tolerance = 1e-5f )
+	{
+		const std::vector<T> &values = static_cast<const TypedData<std::vector<T> > *>( data )->readable();
+		size_t result = values.size() % expected.size() ? 1 : 0;
+		for( size_t i = 0; i < values.size(); ++i )
+		{
+			if( !equalWithAbsError( values[i], expected[i % expected.size()], tolerance ) )
+			{
+				result++;
+			}
+		}
+		return result;
+	}
+
+	static bool equalWithAbsError( float a, float b, float e )
+	{
+		return fabs( a - b ) <= e;
+	}
+
+	template<typename V>
+	static bool equalWithAbsError( const V &a, const V &b, float e )
+	{
+		return a.equalWithAbsError( b, e );
+	}
+
+	void testTriangles()
+	{
+		// the single triangle from MeshAlgoTangentsTest.py, which has an
+		// area of 0.5 in both P and uv.
+		std::vector<int> verticesPerFace( 1, 3 );
+		std::vector<int> vertexIds;
+		std::vector<V3f> p;
+		std::vector<V2f> uvs;
+		for( int i = 0; i < 3; ++i )
+		{
+			vertexIds.push_back( i );
+			const V2f uv( i == 1, i == 2 );
+			p.push_back( V3f( uv.x, uv.y, 0 ) );
+			uvs.push_back( uv );
+		}
+
+		MeshPrimitivePtr mesh = makeTiledMesh( verticesPerFace, vertexIds, p, p, uvs, 200000 );
+
+		MeshNormalsOpPtr normalsOp = new MeshNormalsOp;
+		normalsOp->inputParameter()->setValue( mesh->copy() );
+		MeshPrimitivePtr normalsMesh = runTimeCast<MeshPrimitive>( normalsOp->operate() );
+		BOOST_CHECK_EQUAL( numMismatches( normalsMesh->variables["N"].data.get(), std::vector<V3f>( 1, V3f( 0, 0, 1 ) ) ), 0u );
+
+		std::pair<PrimitiveVariable, PrimitiveVariable> tangents = MeshAlgo::calculateTangents( mesh.get() );
+		BOOST_CHECK_EQUAL( numMismatches( tangents.first.data.get(), std::vector<V3f>( 1, V3f( 1, 0, 0 ) ) ), 0u );
+		BOOST_CHECK_EQUAL( numMismatches( tangents.second.data.get(), std::vector<V3f>( 1, V3f( 0, 1, 0 ) ) ), 0u );
+
+		PrimitiveVariable faceArea = MeshAlgo::calculateFaceArea( mesh.get() );
+		BOOST_CHECK_EQUAL( numMismatches( faceArea.data.get(), std::vector<float>( 1, 0.5f ) ), 0u );
+
+		PrimitiveVariable faceTextureArea = MeshAlgo::calculateFaceTextureArea( mesh.get() );
+		BOOST_CHECK_EQUAL( numMismatches( faceTextureArea.data.get(), std::vector<float>( 1, 0.5f ) ), 0u );
+	}
+
+	void testDistortion()
+	{
+		// the mesh and expected results from MeshAlgoDistortionsTest.py.
+		const int verticesPerFace[] = { 4, 4, 4, 4, 4, 4 };
+		const int vertexIds[] = {
+			0, 1, 5, 4,
+			1, 2, 6, 5,
+			2, 3, 7, 6,
+			4, 5, 9, 8,
+			5, 6, 10, 9,
+			6, 7, 11, 10
+		};
+
+		std::vector<V3f> pRef;
+		for( int y = -1; y <= 1; ++y )
+		{
+			for( int x = -1; x <= 2; ++x )
+			{
+				pRef.push_back( V3f( x, y, 0 ) );
+			}
+		}
+		std::vector<V3f> p = pRef;
+		p[5] = V3f( 0.5, 0.5, 0 );
+
+		std::vector<V2f> uvs;
+		for( size_t i = 0; i < 24; ++i )
+		{
+			uvs.push_back( V2f( p[vertexIds[i]].x, p[vertexIds[i]].y ) );
+		}
+
+		const float expectedDistortion[] = {
+			0, 0.290569, 0, 0, 0.290569, 0.0834627, -0.103553, 0, 0, -0.207107, 0, 0
+		};
+
+		const V2f expectedUVDistortion[] = {
+			V2f( 0, 0 ), V2f( 0.0918861, 0.275658 ), V2f( 0.0373256, 0.0373256 ), V2f( 0.275658, 0.0918861 ),
+			V2f( 0.0918861, 0.275658 ), V2f( 0, 0 ), V2f( -0.0732233, -0.0732233 ), V2f( 0.0373256, 0.0373256 ),
+			V2f( 0, 0 ), V2f( 0, 0 ), V2f( 0, 0 ), V2f( -0.0732233, -0.0732233 ),
+			V2f( 0.275658, 0.091886 ), V2f( 0.0373256, 0.0373256 ), V2f( -0.146447, -0.146447 ), V2f( 0, 0 ),
+			V2f( 0.0373256, 0.0373256 ), V2f( -0.0732233, -0.0732233 ), V2f( 0, 0 ), V2f( -0.146447, -0.146447 ),
+			V2f( -0.0732233, -0.0732233 ), V2f( 0, 0 ), V2f( 0, 0 ), V2f( 0, 0 )
+		};
+
+		MeshPrimitivePtr mesh = makeTiledMesh(
+			std::vector<int>( verticesPerFace, verticesPerFace + 6 ),
+			std::vector<int>( vertexIds, vertexIds + 24 ),
+			p, pRef, uvs, 50000
+		);
+
+		std::pair<PrimitiveVariable, PrimitiveVariable> distortion = MeshAlgo::calculateDistortion( mesh.get() );
+		BOOST_CHECK_EQUAL( numMismatches( distortion.first.data.get(), std::vector<float>( expectedDistortion, expectedDistortion + 12 ) ), 0u );
+		BOOST_CHECK_EQUAL( numMismatches( distortion.second.data.get(), std::vector<V2f>( expectedUVDistortion, expectedUVDistortion + 24 ) ), 0u );
+	}
+
+	void testResampleExceptionSafety()
+	{
+		MeshPrimitivePtr mesh = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 100 ) );
+		const size_t numVertices = mesh->variableSize( PrimitiveVariable::Vertex );
+
+		FloatVectorDataPtr floatData = new FloatVectorData( std::vector<float>( numVertices, 1.0f ) );
+		StringVectorDataPtr stringData = new StringVectorData( std::vector<std::string>( numVertices, "a" ) );
+
+		PrimitiveVariableMap variables;
+		variables["a"] = PrimitiveVariable( PrimitiveVariable::Vertex, floatData );
+		variables["b"] = PrimitiveVariable( PrimitiveVariable::Constant, new FloatData( 2.0f ) );
+		// strings can't be averaged to Uniform, so this must throw after the
+		// other variables have been processed.
+		variables["c"] = PrimitiveVariable( PrimitiveVariable::Vertex, stringData );
+
+		const PrimitiveVariableMap original = variables;
+		BOOST_CHECK_THROW( MeshAlgo::resamplePrimitiveVariables( mesh.get(), variables, PrimitiveVariable::Uniform ), IECore::Exception );
+
+		// and leave all the variables untouched.
+		BOOST_CHECK( variables == original );
+		BOOST_CHECK( variables["a"].data == floatData );
+		BOOST_CHECK( floatData->readable() == std::vector<float>( numVertices, 1.0f ) );
+	}
+
+	// Results of each of the algorithms, and the time taken to compute them.
+	struct Results
+	{
+
+		void calculate( const MeshPrimitive *mesh )
+		{
+			tick_count t0 = tick_count::now();
+			MeshNormalsOpPtr normalsOp = new MeshNormalsOp;
+			normalsOp->inputParameter()->setValue( mesh->copy() );
+			MeshPrimitivePtr normalsMesh = runTimeCast<MeshPrimitive>( normalsOp->operate() );
+			normals = normalsMesh->variables["N"].data;
+			tick_count t1 = tick_count::now();
+			tangents = MeshAlgo::calculateTangents( mesh );
+			tick_count t2 = tick_count::now();
+			distortion = MeshAlgo::calculateDistortion( mesh );
+			tick_count t3 = tick_count::now();
+
+			normalsTime = ( t1 - t0 ).seconds();
+			tangentsTime = ( t2 - t1 ).seconds();
+			distortionTime = ( t3 - t2 ).seconds();
+		}
+
+		DataPtr normals;
+		std::pair<PrimitiveVariable, PrimitiveVariable> tangents;
+		std::pair<PrimitiveVariable, PrimitiveVariable> distortion;
+
+		double normalsTime;
+		double tangentsTime;
+		double distortionTime;
+
+	};
+
+	struct SerialCalculation
+	{
+
+		SerialCalculation( const MeshPrimitive *mesh, Results &results )
+			:	m_mesh( mesh ), m_results( results )
+		{
+		}
+
+		void operator()() const
+		{
+			// must be done on a fresh thread, as the number of threads
+			// can't be changed once a scheduler has been initialised.
+			task_scheduler_init scheduler( 1 );
+			m_results.calculate( m_mesh );
+		}
+
+		const MeshPrimitive *m_mesh;
+		Results &m_results;
+
+	};
+
+	void testPerformance()
+	{
+		MeshPrimitivePtr plane = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 1000 ) );
+
+		TriangulateOpPtr triangulateOp = new TriangulateOp;
+		triangulateOp->inputParameter()->setValue( plane );
+		MeshPrimitivePtr mesh = runTimeCast<MeshPrimitive>( triangulateOp->operate() );
+
+		// perturb the points so the distortions are interesting
+		V3fVectorDataPtr pRef = mesh->variableData<V3fVectorData>( "P" )->copy();
+		mesh->variables["Pref"] = PrimitiveVariable( PrimitiveVariable::Vertex, pRef );
+
+		Rand32 rand;
+		std::vector<V3f> &p = mesh->variableData<V3fVectorData>( "P" )->writable();
+		for( std::vector<V3f>::iterator it = p.begin(); it != p.end(); ++it )
+		{
+			*it += V3f( rand.nextf(), rand.nextf(), rand.nextf() ) * 0.001f;
+		}
+
+		Results serial;
+		tbb_thread serialThread( SerialCalculation( mesh.get(), serial ) );
+		serialThread.join();
+
+		Results parallel;
+		parallel.calculate( mesh.get() );
+
+		BOOST_TEST_MESSAGE(
+			boost::format( "MeshAlgo timings for %d faces (1 thread / all threads) : MeshNormalsOp %.3fs / %.3fs, calculateTangents %.3fs / %.3fs, calculateDistortion %.3fs / %.3fs" ) %
+			mesh->numFaces() %
+			serial.normalsTime % parallel.normalsTime %
+			serial.tangentsTime % parallel.tangentsTime %
+			serial.distortionTime % parallel.distortionTime
+		);
+
+		// results must be identical regardless of the number of threads
+		BOOST_CHECK( parallel.normals->isEqualTo( serial.normals.get() ) );
+		BOOST_CHECK( parallel.tangents.first.data->isEqualTo( serial.tangents.first.data.get() ) );
+		BOOST_CHECK( parallel.tangents.second.data->isEqualTo( serial.tangents.second.data.get() ) );
+		BOOST_CHECK( parallel.distortion.first.data->isEqualTo( serial.distortion.first.data.get() ) );
+		BOOST_CHECK( parallel.distortion.second.data->isEqualTo( serial.distortion.second.data.get() ) );
+	}
+
+};
+
+struct MeshAlgoThreadingTestSuite : public boost::unit_test::test_suite
+{
+
+	MeshAlgoThreadingTestSuite() : boost::unit_test::test_suite( "MeshAlgoThreadingTestSuite" )
+	{
+		boost::shared_ptr<MeshAlgoThreadingTest> instance( new MeshAlgoThreadingTest() );
+
+		add( BOOST_CLASS_TEST_CASE( &MeshAlgoThreadingTest::testTriangles, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &MeshAlgoThreadingTest::testDistortion, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &MeshAlgoThreadingTest::testResampleExceptionSafety, instance ) );
+#ifdef NDEBUG
+		// skip performance testing in debug builds
+		add( BOOST_CLASS_TEST_CASE( &MeshAlgoThreadingTest::testPerformance, instance ) );
+#endif
+	}
+};
+
+void addMeshAlgoThreadingTest( boost::unit_test::test_suite *test )
+{
+	test->add( new MeshAlgoThreadingTestSuite( ) );
+}
+
+} // namespace IECore
@@ -368,6 +368,37 @@ class TestMeshPrimitiveEvaluator( unittest.TestCase ) :
 					hits = mpe.intersectionPoints( origin, direction )
 					self.failIf( hits )
 
+	def testBatchedQueries( self ) :
+
+		m = Reader.create( "test/IECore/data/cobFiles/pSphereShape1.cob" ).read()
+		mpe = PrimitiveEvaluator.create( m )
+		r = mpe.createResult()
+
+		random.seed( 1 )
+		points = V3fVectorData()
+		directions = V3fVectorData()
+		for i in range( 0, 1000 ) :
+			points.append( V3f( random.uniform( -2, 2 ), random.uniform( -2, 2 ), random.uniform( -2, 2 ) ) )
+			directions.append( V3f( random.uniform( -1, 1 ), random.uniform( -1, 1 ), random.uniform( -1, 1 ) ) )
+
+		closest = mpe.closestPoints( points )
+		self.assertEqual( len( closest ), len( points ) )
+		for i in range( 0, len( points ) ) :
+			self.assert_( mpe.closestPoint( points[i], r ) )
+			self.assertEqual( closest[i].triangleIndex(), r.triangleIndex() )
+			self.failUnless( closest[i].point().equalWithAbsError( r.point(), 0.00001 ) )
+
+		hits = mpe.closestIntersectionPoints( points, directions )
+		self.assertEqual( len( hits ), len( points ) )
+		for i in range( 0, len( points ) ) :
+			if mpe.intersectionPoint( points[i], directions[i], r ) :
+				self.assertEqual( hits[i].triangleIndex(), r.triangleIndex() )
+				self.failUnless( hits[i].point().equalWithAbsError( r.point(), 0.00001 ) )
+			else :
+				self.assertEqual( hits[i], None )
+
+		self.assertRaises( Exception, mpe.closestIntersectionPoints, points, V3fVectorData() )
+
 if __name__ == "__main__":
 	unittest.main()
 
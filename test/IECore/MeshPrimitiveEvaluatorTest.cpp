@@ -0,0 +1,325 @@
+//////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2017, Image Engine Design Inc. All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are
+//  met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of Image Engine Design nor the names of any
+//       other contributors to this software may be used to endorse or
+//       promote products derived from this software without specific prior
+//       written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+//  IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+//  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+//  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+//  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+//  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+//  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <vector>
+
+#include "boost/format.hpp"
+
+#include "tbb/tbb.h"
+
+#include "OpenEXR/ImathBoxAlgo.h"
+#include "OpenEXR/ImathLimits.h"
+#include "OpenEXR/ImathRandom.h"
+
+#include "IECore/BoxOps.h"
+#include "IECore/MeshPrimitiveEvaluator.h"
+#include "IECore/TriangleAlgo.h"
+#include "IECore/TriangulateOp.h"
+
+#include "MeshPrimitiveEvaluatorTest.h"
+
+using namespace boost;
+using namespace boost::unit_test;
+using namespace tbb;
+using namespace Imath;
+
+namespace IECore
+{
+
+struct MeshPrimitiveEvaluatorTest
+{
+
+	// Performs queries using the BoundedKDTree returned by triangleBoundTree(),
+	// in the same way as the MeshPrimitiveEvaluator did before it used a BVH.
+	// This provides both a reference for the results of the BVH, and a baseline
+	// for its performance.
+	struct KDTreeQueries
+	{
+
+		typedef MeshPrimitiveEvaluator::TriangleBoundTree Tree;
+
+		KDTreeQueries( const MeshPrimitiveEvaluator *evaluator )
+			:	m_tree( evaluator->triangleBoundTree() ),
+				m_firstBound( &evaluator->triangleBounds()->front() ),
+				m_p( evaluator->mesh()->variableData<V3fVectorData>( "P" )->readable() ),
+				m_vertexIds( evaluator->mesh()->vertexIds()->readable() )
+		{
+		}
+
+		// Returns the distance to the closest point on the mesh.
+		float closestPoint( const V3f &p ) const
+		{
+			float closestDistanceSqrd = limits<float>::max();
+			closestPointWalk( m_tree->rootIndex(), p, closestDistanceSqrd );
+			return sqrtf( closestDistanceSqrd );
+		}
+
+		// Returns the distance to the nearest intersection, or -1 if
+		// the ray misses the mesh.
+		float intersectionPoint( const V3f &origin, const V3f &direction ) const
+		{
+			float maxDistSqrd = limits<float>::max();
+			bool hit = false;
+			intersectionPointWalk( m_tree->rootIndex(), origin, direction.normalized(), maxDistSqrd, hit );
+			return hit ? sqrtf( maxDistSqrd ) : -1.0f;
+		}
+
+		private :
+
+			void closestPointWalk( Tree::NodeIndex nodeIndex, const V3f &p, float &closestDistanceSqrd ) const
+			{
+				const Tree::Node &node = m_tree->node( nodeIndex );
+				if( node.isLeaf() )
+				{
+					for( Tree::Iterator *perm = node.permFirst(); perm != node.permLast(); ++perm )
+					{
+						const size_t vertIdOffset = ( &**perm - m_firstBound ) * 3;
+						V3f bary;
+						const float dSqrd = triangleClosestBarycentric(
+							m_p[m_vertexIds[vertIdOffset]], m_p[m_vertexIds[vertIdOffset+1]], m_p[m_vertexIds[vertIdOffset+2]],
+							p, bary
+						);
+						closestDistanceSqrd = std::min( closestDistanceSqrd, dSqrd );
+					}
+					return;
+				}
+
+				// descend into the closest box first
+				const Tree::NodeIndex low = Tree::lowChildIndex( nodeIndex );
+				const Tree::NodeIndex high = Tree::highChildIndex( nodeIndex );
+				const float dLow = ( closestPointInBox( p, m_tree->node( low ).bound() ) - p ).length2();
+				const float dHigh = ( closestPointInBox( p, m_tree->node( high ).bound() ) - p ).length2();
+
+				closestPointWalk( dHigh < dLow ? high : low, p, closestDistanceSqrd );
+				if( std::max( dLow, dHigh ) < closestDistanceSqrd )
+				{
+					closestPointWalk( dHigh < dLow ? low : high, p, closestDistanceSqrd );
+				}
+			}
+
+			void intersectionPointWalk( Tree::NodeIndex nodeIndex, const V3f &origin, const V3f &direction, float &maxDistSqrd, bool &hit ) const
+			{
+				const Tree::Node &node = m_tree->node( nodeIndex );
+
+				V3f boxHit;
+				if( !boxIntersects( node.bound(), origin, direction, boxHit ) || ( boxHit - origin ).length2() > maxDistSqrd )
+				{
+					return;
+				}
+
+				if( node.isLeaf() )
+				{
+					for( Tree::Iterator *perm = node.permFirst(); perm != node.permLast(); ++perm )
+					{
+						const size_t vertIdOffset = ( &**perm - m_firstBound ) * 3;
+						V3f hitPoint, bary;
+						bool front;
+						if( triangleRayIntersection(
+							m_p[m_vertexIds[vertIdOffset]], m_p[m_vertexIds[vertIdOffset+1]], m_p[m_vertexIds[vertIdOffset+2]],
+							origin, direction, hitPoint, bary, front
+						) )
+						{
+							const float dSqrd = ( hitPoint - origin ).length2();
+							if( dSqrd < maxDistSqrd )
+							{
+								maxDistSqrd = dSqrd;
+								hit = true;
+							}
+						}
+					}
+					return;
+				}
+
+				intersectionPointWalk( Tree::lowChildIndex( nodeIndex ), origin, direction, maxDistSqrd, hit );
+				intersectionPointWalk( Tree::highChildIndex( nodeIndex ), origin, direction, maxDistSqrd, hit );
+			}
+
+			const Tree *m_tree;
+			const MeshPrimitiveEvaluator::TriangleBound *m_firstBound;
+			const std::vector<V3f> &m_p;
+			const std::vector<int> &m_vertexIds;
+
+	};
+
+	static MeshPrimitivePtr makeMesh( int divisions )
+	{
+		MeshPrimitivePtr plane = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( divisions ) );
+
+		TriangulateOpPtr triangulateOp = new TriangulateOp;
+		triangulateOp->inputParameter()->setValue( plane );
+		MeshPrimitivePtr mesh = runTimeCast<MeshPrimitive>( triangulateOp->operate() );
+
+		// perturb the points so the mesh isn't flat
+		Rand32 rand( 1 );
+		std::vector<V3f> &p = mesh->variableData<V3fVectorData>( "P" )->writable();
+		for( std::vector<V3f>::iterator it = p.begin(); it != p.end(); ++it )
+		{
+			it->z = rand.nextf( -0.01f, 0.01f );
+		}
+
+		return mesh;
+	}
+
+	// Checks the results of the BVH against the BoundedKDTree, for both serial
+	// and batched queries, reporting the time taken by each.
+	static void compare( const MeshPrimitive *mesh, size_t numQueries )
+	{
+		tick_count t0 = tick_count::now();
+		MeshPrimitiveEvaluatorPtr evaluator = new MeshPrimitiveEvaluator( mesh );
+		tick_count t1 = tick_count::now();
+		KDTreeQueries kdTree( evaluator.get() );
+		tick_count t2 = tick_count::now();
+
+		BOOST_TEST_MESSAGE(
+			boost::format( "Construction of %d triangles : BVH %.3fs, BoundedKDTree %.3fs" ) %
+			mesh->numFaces() % ( t1 - t0 ).seconds() % ( t2 - t1 ).seconds()
+		);
+
+		Rand32 rand( 2 );
+		std::vector<V3f> points, directions;
+		for( size_t i = 0; i < numQueries; ++i )
+		{
+			points.push_back( V3f( rand.nextf( -1, 1 ), rand.nextf( -1, 1 ), rand.nextf( -1, 1 ) ) );
+			directions.push_back( V3f( rand.nextf( -1, 1 ), rand.nextf( -1, 1 ), rand.nextf( -1, 1 ) ) );
+		}
+
+		// closest point
+
+		std::vector<float> kdDistances( numQueries );
+		t0 = tick_count::now();
+		for( size_t i = 0; i < numQueries; ++i )
+		{
+			kdDistances[i] = kdTree.closestPoint( points[i] );
+		}
+		t1 = tick_count::now();
+
+		std::vector<float> bvhDistances( numQueries );
+		PrimitiveEvaluator::ResultPtr result = evaluator->createResult();
+		for( size_t i = 0; i < numQueries; ++i )
+		{
+			evaluator->closestPoint( points[i], result.get() );
+			bvhDistances[i] = ( result->point() - points[i] ).length();
+		}
+		t2 = tick_count::now();
+
+		std::vector<PrimitiveEvaluator::ResultPtr> results;
+		evaluator->closestPoints( points, results );
+		tick_count t3 = tick_count::now();
+
+		BOOST_TEST_MESSAGE(
+			boost::format( "%d closestPoint() queries : BoundedKDTree %.3fs, BVH %.3fs, BVH batched %.3fs" ) %
+			numQueries % ( t1 - t0 ).seconds() % ( t2 - t1 ).seconds() % ( t3 - t2 ).seconds()
+		);
+
+		size_t mismatches = 0;
+		for( size_t i = 0; i < numQueries; ++i )
+		{
+			if( fabs( bvhDistances[i] - kdDistances[i] ) > 1e-5f || !results[i] || fabs( ( results[i]->point() - points[i] ).length() - kdDistances[i] ) > 1e-5f )
+			{
+				mismatches++;
+			}
+		}
+		BOOST_CHECK_EQUAL( mismatches, 0u );
+
+		// intersection point
+
+		t0 = tick_count::now();
+		for( size_t i = 0; i < numQueries; ++i )
+		{
+			kdDistances[i] = kdTree.intersectionPoint( points[i], directions[i] );
+		}
+		t1 = tick_count::now();
+
+		for( size_t i = 0; i < numQueries; ++i )
+		{
+			bvhDistances[i] = evaluator->intersectionPoint( points[i], directions[i], result.get() ) ? ( result->point() - points[i] ).length() : -1.0f;
+		}
+		t2 = tick_count::now();
+
+		evaluator->closestIntersectionPoints( points, directions, results );
+		t3 = tick_count::now();
+
+		BOOST_TEST_MESSAGE(
+			boost::format( "%d intersectionPoint() queries : BoundedKDTree %.3fs, BVH %.3fs, BVH batched %.3fs" ) %
+			numQueries % ( t1 - t0 ).seconds() % ( t2 - t1 ).seconds() % ( t3 - t2 ).seconds()
+		);
+
+		mismatches = 0;
+		for( size_t i = 0; i < numQueries; ++i )
+		{
+			const float batchedDistance = results[i] ? ( results[i]->point() - points[i] ).length() : -1.0f;
+			if( fabs( bvhDistances[i] - kdDistances[i] ) > 1e-5f || fabs( batchedDistance - kdDistances[i] ) > 1e-5f )
+			{
+				mismatches++;
+			}
+		}
+		BOOST_CHECK_EQUAL( mismatches, 0u );
+	}
+
+	void testMatchesKDTree()
+	{
+		compare( makeMesh( 50 ).get(), 10000 );
+	}
+
+	void testPerformance()
+	{
+		MeshPrimitivePtr mesh = makeMesh( 710 );
+		BOOST_CHECK( mesh->numFaces() > 1000000u );
+		compare( mesh.get(), 100000 );
+	}
+
+};
+
+struct MeshPrimitiveEvaluatorTestSuite : public boost::unit_test::test_suite
+{
+
+	MeshPrimitiveEvaluatorTestSuite() : boost::unit_test::test_suite( "MeshPrimitiveEvaluatorTestSuite" )
+	{
+		boost::shared_ptr<MeshPrimitiveEvaluatorTest> instance( new MeshPrimitiveEvaluatorTest() );
+
+		add( BOOST_CLASS_TEST_CASE( &MeshPrimitiveEvaluatorTest::testMatchesKDTree, instance ) );
+#ifdef NDEBUG
+		// skip performance testing in debug builds
+		add( BOOST_CLASS_TEST_CASE( &MeshPrimitiveEvaluatorTest::testPerformance, instance ) );
+#endif
+	}
+};
+
+void addMeshPrimitiveEvaluatorTest( boost::unit_test::test_suite *test )
+{
+	test->add( new MeshPrimitiveEvaluatorTestSuite() );
+}
+
+} // namespace IECore
@@ -216,6 +216,63 @@ class MurmurHashTest( unittest.TestCase ) :
 
 		self.assertNotEqual( h1, h2 )
 
+	def testArrayHashVersion( self ) :
+
+		self.assertEqual( IECore.MurmurHash.getArrayHashVersion(), IECore.MurmurHash.ArrayHashVersion.SerialArrayHash )
+
+		small = IECore.IntVectorData( range( 0, 1000 ) )
+		large = IECore.IntVectorData( range( 0, 1000000 ) )
+
+		def hashes() :
+			# modifying the data invalidates the cached hash
+			small[0] = small[0]
+			large[0] = large[0]
+			return small.hash(), large.hash()
+
+		serialHashes = hashes()
+
+		IECore.MurmurHash.setArrayHashVersion( IECore.MurmurHash.ArrayHashVersion.ChunkedArrayHash )
+		try :
+			chunkedHashes = hashes()
+			# deterministic
+			self.assertEqual( hashes(), chunkedHashes )
+			# data that fits in a single chunk hashes identically
+			self.assertEqual( chunkedHashes[0], serialHashes[0] )
+			# large data uses a new hash
+			self.assertNotEqual( chunkedHashes[1], serialHashes[1] )
+			# which still reflects all of the data
+			large[-1] = 0
+			self.assertNotEqual( large.hash(), chunkedHashes[1] )
+		finally :
+			IECore.MurmurHash.setArrayHashVersion( IECore.MurmurHash.ArrayHashVersion.SerialArrayHash )
+
+		self.assertEqual( hashes(), serialHashes )
+
+	@unittest.skipIf( IECore.isDebug(), "Skip performance testing in debug builds" )
+	def testArrayHashPerformance( self ) :
+
+		# Compares the serial and chunked hashes of
+		# a large array of points.
+
+		d = IECore.V3fVectorData( 10000000 )
+
+		hashes = {}
+		for version in ( IECore.MurmurHash.ArrayHashVersion.SerialArrayHash, IECore.MurmurHash.ArrayHashVersion.ChunkedArrayHash ) :
+			IECore.MurmurHash.setArrayHashVersion( version )
+			try :
+				d[0] = d[0]
+				hashes[version] = d.hash()
+				# rehashing with the same version is consistent
+				d[0] = d[0]
+				self.assertEqual( d.hash(), hashes[version] )
+			finally :
+				IECore.MurmurHash.setArrayHashVersion( IECore.MurmurHash.ArrayHashVersion.SerialArrayHash )
+
+		self.assertNotEqual(
+			hashes[IECore.MurmurHash.ArrayHashVersion.SerialArrayHash],
+			hashes[IECore.MurmurHash.ArrayHashVersion.ChunkedArrayHash]
+		)
+
 if __name__ == "__main__":
 	unittest.main()
 
@@ -112,5 +112,25 @@ class ObjectPoolTest( unittest.TestCase ) :
 			p.contains( b.hash() )
 		)
 
-if __name__ == "__main__":
+	def testShardStatistics( self ) :
+
+		p = ObjectPool( 500 )
+		a = IntData( 1 )
+
+		self.assertEqual( p.retrieve( a.hash() ), None )
+		p.store( a, ObjectPool.StoreReference )
+		p.retrieve( a.hash() )
+		p.erase( a.hash() )
+		p.clear()
+
+		stats = p.shardStatistics()
+		self.assertGreater( len( stats ), 0 )
+		# The lookup in retrieve() and store() count as a miss and a hit,
+		# and the final retrieve() as another hit.
+		self.assertEqual( sum( s["misses"] for s in stats ), 1 )
+		self.assertEqual( sum( s["hits"] for s in stats ), 2 )
+		# Erased items are not counted as evictions.
+		self.assertEqual( sum( s["evictions"] for s in stats ), 0 )
+
+
     unittest.main()
@@ -33,8 +33,10 @@
 ##########################################################################
 
 import gc
+import os
 import sys
 import math
+import time
 import unittest
 
 import IECore
@@ -671,6 +673,87 @@ class SceneCacheTest( unittest.TestCase ) :
 		self.assertEqual( b.readObject(1)['P'], b.readObjectPrimitiveVariables(['P','Cs'], 1)['P'] )
 		self.assertEqual( b.readObject(1)['Cs'], b.readObjectPrimitiveVariables(['P','Cs'], 1)['Cs'] )
 
+	def testConcurrentWritingDisabled( self ) :
+
+		s = IECore.SceneCache( "/tmp/test.scc", IECore.IndexedIO.OpenMode.Write )
+		s.setConcurrentWriting( False )
+		a = s.createChild( "a" )
+		a.writeObject( IECore.SpherePrimitive( 1 ), 0 )
+		a.writeTransform( IECore.M44dData( IECore.M44d().translate( IECore.V3d( 1, 0, 0 ) ) ), 0 )
+		del s, a
+
+		s = IECore.SceneCache( "/tmp/test.scc", IECore.IndexedIO.OpenMode.Read )
+		self.assertEqual( s.child( "a" ).readObject( 0 ), IECore.SpherePrimitive( 1 ) )
+		self.assertEqual( s.readBound( 0 ), IECore.Box3d( IECore.V3d( 0, -1, -1 ), IECore.V3d( 2, 1, 1 ) ) )
+		self.assertRaises( RuntimeError, s.setConcurrentWriting, False )
+
+	def testFlush( self ) :
+
+		s = IECore.SceneCache( "/tmp/test.scc", IECore.IndexedIO.OpenMode.Write )
+		a = s.createChild( "a" )
+		a.writeObject( IECore.SpherePrimitive( 1 ), 0 )
+		self.assertRaises( RuntimeError, a.flush )
+		s.flush()
+
+		self.assertRaises( RuntimeError, a.writeObject, IECore.SpherePrimitive( 1 ), 1 )
+		self.assertRaises( RuntimeError, s.flush )
+		del s, a
+
+		s = IECore.SceneCache( "/tmp/test.scc", IECore.IndexedIO.OpenMode.Read )
+		self.assertEqual( s.child( "a" ).readObject( 0 ), IECore.SpherePrimitive( 1 ) )
+		self.assertEqual( s.readBound( 0 ), IECore.Box3d( IECore.V3d( -1 ), IECore.V3d( 1 ) ) )
+
+	def testObjectDeltaEncoding( self ) :
+
+		def deformedBox( frame ) :
+
+			box = IECore.MeshPrimitive.createBox( IECore.Box3f( IECore.V3f( 0 ), IECore.V3f( 1 ) ) )
+			box["N"] = IECore.PrimitiveVariable( IECore.PrimitiveVariable.Interpolation.Vertex, box["P"].data.copy() )
+			box["Cs"] = IECore.PrimitiveVariable( IECore.PrimitiveVariable.Interpolation.Uniform, IECore.Color3fVectorData( [ IECore.Color3f( frame ) ] * box.variableSize( IECore.PrimitiveVariable.Interpolation.Uniform ) ) )
+			p = box["P"].data
+			for i in range( 0, len( p ) ) :
+				p[i] += IECore.V3f( math.sin( frame * 0.1 + i ) * 0.01 )
+			return box
+
+		sizes = []
+		for deltaEncoding in ( False, True ) :
+
+			f = IECore.FileIndexedIO( "/tmp/test.scc", [], IECore.IndexedIO.OpenMode.Write )
+			f.setDataCompression( IECore.StreamIndexedIO.Compression.Deflate )
+			s = IECore.SceneCache( f )
+			s.setObjectDeltaEncoding( deltaEncoding, keyframeInterval = 4 )
+			a = s.createChild( "a" )
+			b = s.createChild( "b" )
+			for frame in range( 0, 10 ) :
+				a.writeObject( deformedBox( frame ), frame )
+				# animated topology
+				b.writeObject( deformedBox( frame ) if frame % 2 else IECore.MeshPrimitive.createPlane( IECore.Box2f( IECore.V2f( 0 ), IECore.V2f( 1 ) ) ), frame )
+
+			del s, a, b, f
+			sizes.append( os.path.getsize( "/tmp/test.scc" ) )
+
+			s = IECore.SceneCache( "/tmp/test.scc", IECore.IndexedIO.OpenMode.Read )
+			a = s.child( "a" )
+			b = s.child( "b" )
+			# read out of order, to test decoding from samples which aren't in the cache
+			for frame in reversed( range( 0, 10 ) ) :
+				box = deformedBox( frame )
+				self.assertEqual( a.readObjectAtSample( frame ), box )
+				self.assertEqual( a.readObjectPrimitiveVariables( [ "P", "N", "Cs" ], frame )["P"], box["P"] )
+				self.assertEqual( a.readObjectPrimitiveVariables( [ "P", "N", "Cs" ], frame )["N"], box["N"] )
+				if frame % 2 :
+					self.assertEqual( b.readObjectAtSample( frame ), box )
+			# and interpolated
+			self.assertEqual(
+				a.readObjectPrimitiveVariables( [ "P" ], 2.5 )["P"].data,
+				IECore.linearObjectInterpolation( deformedBox( 2 )["P"].data, deformedBox( 3 )["P"].data, 0.5 )
+			)
+
+		self.assertLess( sizes[1], sizes[0] )
+
+		f = IECore.FileIndexedIO( "/tmp/test.scc", [], IECore.IndexedIO.OpenMode.Read )
+		self.assertRaises( RuntimeError, IECore.SceneCache( f ).setObjectDeltaEncoding, True )
+
 	def testTags( self ) :
 
 		sphere = IECore.SpherePrimitive( 1 )
@@ -902,6 +985,108 @@ class SceneCacheTest( unittest.TestCase ) :
 
 			self.assertEqual( h1, h2 )
 
+	def testPrefetch( self ) :
+
+		def collectPaths( scene, paths ) :
+			paths.append( scene.path() )
+			for name in scene.childNames() :
+				collectPaths( scene.child( name ), paths )
+
+		m = IECore.SceneCache( "test/IECore/data/sccFiles/animatedSpheres.scc", IECore.IndexedIO.OpenMode.Read )
+		paths = []
+		collectPaths( m, paths )
+		paths.append( [ "nonExistent" ] )
+
+		monitor = m.prefetch( paths, 0.5 )
+		monitor.wait()
+		self.assertEqual( monitor.numScheduled(), len( paths ) )
+		self.assertEqual( monitor.numCompleted(), len( paths ) )
+		self.assertFalse( monitor.cancelled() )
+
+		m2 = IECore.SceneCache( "test/IECore/data/sccFiles/animatedSpheres.scc", IECore.IndexedIO.OpenMode.Read )
+		for path in paths[:-1] :
+			s = m.scene( path )
+			s2 = m2.scene( path )
+			self.assertEqual( s.readBound( 0.5 ), s2.readBound( 0.5 ) )
+			self.assertEqual( s.readTransform( 0.5 ), s2.readTransform( 0.5 ) )
+			if s.hasObject() :
+				self.assertEqual( s.readObject( 0.5 ), s2.readObject( 0.5 ) )
+			for a in s.attributeNames() :
+				self.assertEqual( s.readAttribute( a, 0.5 ), s2.readAttribute( a, 0.5 ) )
+
+		# the monitor can be reused, and cancelling skips the reads.
+		monitor.cancel()
+		self.assertTrue( m.prefetch( paths, 1, IECore.SceneInterface.PrefetchFlags.PrefetchObject, monitor ).isSame( monitor ) )
+		monitor.wait()
+		self.assertTrue( monitor.cancelled() )
+		self.assertEqual( monitor.numScheduled(), 2 * len( paths ) )
+		self.assertEqual( monitor.numCompleted(), 2 * len( paths ) )
+
+		w = IECore.SceneCache( "/tmp/test.scc", IECore.IndexedIO.OpenMode.Write )
+		self.assertRaises( RuntimeError, w.prefetch, paths, 0 )
+
+	def testPrefetchMonitorProgress( self ) :
+
+		class CountingMonitor( IECore.SceneInterface.PrefetchMonitor ) :
+
+			def __init__( self ) :
+
+				IECore.SceneInterface.PrefetchMonitor.__init__( self )
+				self.calls = []
+
+			def progress( self, numCompleted, numScheduled ) :
+
+				self.calls.append( ( numCompleted, numScheduled ) )
+
+		m = IECore.SceneCache( "test/IECore/data/sccFiles/animatedSpheres.scc", IECore.IndexedIO.OpenMode.Read )
+		paths = [ [] ] + [ [ n ] for n in m.childNames() ]
+
+		monitor = CountingMonitor()
+		self.assertTrue( m.prefetch( paths, 0.5, IECore.SceneInterface.PrefetchFlags.PrefetchBound, monitor ).isSame( monitor ) )
+		monitor.wait()
+
+		self.assertEqual( len( monitor.calls ), len( paths ) )
+		self.assertEqual( sorted( c[0] for c in monitor.calls ), range( 1, len( paths ) + 1 ) )
+		for numCompleted, numScheduled in monitor.calls :
+			self.assertEqual( numScheduled, len( paths ) )
+
+		class FailingMonitor( IECore.SceneInterface.PrefetchMonitor ) :
+
+			def progress( self, numCompleted, numScheduled ) :
+
+				raise ValueError( "progress failed" )
+
+		monitor = FailingMonitor()
+		m.prefetch( paths, 0.5, IECore.SceneInterface.PrefetchFlags.PrefetchBound, monitor )
+		self.assertRaises( RuntimeError, monitor.wait )
+
+	def testPrefetchMonitorDestruction( self ) :
+
+		class SlowMonitor( IECore.SceneInterface.PrefetchMonitor ) :
+
+			def __init__( self ) :
+
+				IECore.SceneInterface.PrefetchMonitor.__init__( self )
+
+			def progress( self, numCompleted, numScheduled ) :
+
+				time.sleep( 0.001 )
+
+		m = IECore.SceneCache( "test/IECore/data/sccFiles/animatedSpheres.scc", IECore.IndexedIO.OpenMode.Read )
+		paths = ( [ [] ] + [ [ n ] for n in m.childNames() ] ) * 100
+
+		# dropping the monitor mid-prefetch must cancel and wait for the reads
+		# in flight, without their calls to progress() deadlocking on the GIL.
+		numWrappedInstances = IECore.RefCounted.numWrappedInstances()
+		for i in range( 0, 10 ) :
+			monitor = SlowMonitor()
+			m.prefetch( paths, i, IECore.SceneInterface.PrefetchFlags.PrefetchAll, monitor )
+			time.sleep( 0.01 )
+			del monitor
+			IECore.RefCounted.collectGarbage()
+
+		self.assertEqual( IECore.RefCounted.numWrappedInstances(), numWrappedInstances )
+
 if __name__ == "__main__":
 	unittest.main()
 
@@ -37,13 +37,59 @@
 
 #include "tbb/tbb.h"
 
+#include "boost/filesystem/operations.hpp"
+#include "boost/format.hpp"
+
 #include "IECore/SharedSceneInterfaces.h"
+#include "IECore/SceneCache.h"
+#include "IECore/MemoryIndexedIO.h"
+#include "IECore/MeshPrimitive.h"
+#include "IECore/SimpleTypedData.h"
+#include "IECore/VectorTypedData.h"
 
 #include "SceneCacheThreadingTest.h"
 
 using namespace boost;
 using namespace boost::unit_test;
 using namespace tbb;
+using namespace Imath;
+
+namespace
+{
+
+const size_t g_numChildren = 32;
+const size_t g_numGrandChildren = 8;
+const size_t g_numSamples = 3;
+
+// Fails to write any float data, as used by the points of a mesh.
+class FailingIndexedIO : public IECore::MemoryIndexedIO
+{
+	public :
+
+		FailingIndexedIO() : IECore::MemoryIndexedIO( nullptr, IECore::IndexedIO::rootPath, IECore::IndexedIO::Write )
+		{
+		}
+
+		using IECore::MemoryIndexedIO::write;
+
+		void write( const IECore::IndexedIO::EntryID &name, const float *x, unsigned long arrayLength ) override
+		{
+			throw IECore::IOException( "Write failed" );
+		}
+
+	protected :
+
+		FailingIndexedIO( IECore::StreamIndexedIO::Node &rootNode ) : IECore::MemoryIndexedIO( rootNode )
+		{
+		}
+
+		IECore::IndexedIO *duplicate( IECore::StreamIndexedIO::Node &rootNode ) const override
+		{
+			return new FailingIndexedIO( rootNode );
+		}
+};
+
+} // namespace
 
 namespace IECore
 {
@@ -123,6 +169,178 @@ struct SceneCacheThreadingTest
  		BOOST_CHECK( task.errors() == 100000 );
 	}
 
+	static SceneInterface::Name childName( size_t i )
+	{
+		return ( boost::format( "child%d" ) % i ).str();
+	}
+
+	// Writes one child of the root, along with its own children.
+	static void writeChild( SceneInterface *root, size_t i )
+	{
+		SceneInterfacePtr child = root->createChild( childName( i ) );
+		for ( size_t s = 0; s < g_numSamples; ++s )
+		{
+			child->writeTransform( new M44dData( M44d().translate( V3d( i, s, 0 ) ) ), s );
+		}
+		child->writeAttribute( "index", new IntData( i ), 0 );
+
+		MeshPrimitivePtr mesh = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 64 ) );
+		V3fVectorData *p = runTimeCast<V3fVectorData>( mesh->variables["P"].data.get() );
+		for ( size_t j = 0; j < g_numGrandChildren; ++j )
+		{
+			SceneInterfacePtr grandChild = child->createChild( childName( j ) );
+			for ( size_t s = 0; s < g_numSamples; ++s )
+			{
+				// modifying the mesh after writing it must not affect the samples already written
+				std::vector<V3f> &points = p->writable();
+				for ( std::vector<V3f>::iterator it = points.begin(); it != points.end(); ++it )
+				{
+					it->z = s + j;
+				}
+				grandChild->writeObject( mesh.get(), s );
+			}
+		}
+	}
+
+	struct WriteChildren
+	{
+		public :
+
+			WriteChildren( SceneInterface *root ) : m_root( root )
+			{
+			}
+
+			void operator()( const blocked_range<size_t> &r ) const
+			{
+				for ( size_t i = r.begin(); i != r.end(); ++i )
+				{
+					writeChild( m_root, i );
+				}
+			}
+
+		private :
+
+			SceneInterface *m_root;
+
+	};
+
+	void checkScene( const std::string &fileName )
+	{
+		ConstSceneCachePtr root = new SceneCache( fileName, IndexedIO::Read );
+		SceneInterface::NameList children;
+		root->childNames( children );
+		BOOST_CHECK_EQUAL( children.size(), g_numChildren );
+		BOOST_CHECK_EQUAL( root->numBoundSamples(), g_numSamples );
+		for ( size_t s = 0; s < g_numSamples; ++s )
+		{
+			Box3d bound = root->readBoundAtSample( s );
+			BOOST_CHECK( bound.min.equalWithAbsError( V3d( -1, s - 1.0, s ), 1e-6 ) );
+			BOOST_CHECK( bound.max.equalWithAbsError( V3d( g_numChildren, s + 1.0, s + g_numGrandChildren - 1.0 ), 1e-6 ) );
+		}
+
+		for ( size_t i = 0; i < g_numChildren; ++i )
+		{
+			ConstSceneInterfacePtr child = root->child( childName( i ) );
+			BOOST_CHECK_EQUAL( runTimeCast<const IntData>( child->readAttribute( "index", 0 ) )->readable(), (int)i );
+			for ( size_t j = 0; j < g_numGrandChildren; ++j )
+			{
+				ConstSceneCachePtr grandChild = runTimeCast<const SceneCache>( child->child( childName( j ) ) );
+				BOOST_CHECK_EQUAL( grandChild->numObjectSamples(), g_numSamples );
+				for ( size_t s = 0; s < g_numSamples; ++s )
+				{
+					ConstMeshPrimitivePtr mesh = runTimeCast<const MeshPrimitive>( grandChild->readObjectAtSample( s ) );
+					BOOST_REQUIRE( mesh );
+					const V3fVectorData *p = runTimeCast<const V3fVectorData>( mesh->variables.find( "P" )->second.data.get() );
+					BOOST_CHECK_EQUAL( p->readable()[0].z, (float)( s + j ) );
+				}
+			}
+		}
+	}
+
+	void testConcurrentWrite()
+	{
+		const std::string legacyFileName = "/tmp/sceneCacheThreadingTestLegacy.scc";
+		const std::string serialFileName = "/tmp/sceneCacheThreadingTestSerial.scc";
+		const std::string parallelFileName = "/tmp/sceneCacheThreadingTestParallel.scc";
+
+		// the legacy write disables concurrent writing, so it measures the writer as it was
+		// before, saving each sample on the calling thread and flushing one location at a time.
+		// The serial write corresponds to the way clients used to write caches, one location at
+		// a time, but with the samples saved and the flush performed concurrently. All timings
+		// include the flush performed when the root is destroyed.
+		tick_count t0 = tick_count::now();
+		SceneCachePtr root = new SceneCache( legacyFileName, IndexedIO::Write );
+		root->setConcurrentWriting( false );
+		WriteChildren legacyTask( root.get() );
+		legacyTask( blocked_range<size_t>( 0, g_numChildren ) );
+		root = nullptr;
+		tick_count t1 = tick_count::now();
+
+		root = new SceneCache( serialFileName, IndexedIO::Write );
+		WriteChildren serialTask( root.get() );
+		serialTask( blocked_range<size_t>( 0, g_numChildren ) );
+		root = nullptr;
+		tick_count t2 = tick_count::now();
+
+		root = new SceneCache( parallelFileName, IndexedIO::Write );
+		parallel_for( blocked_range<size_t>( 0, g_numChildren ), WriteChildren( root.get() ) );
+		root = nullptr;
+		tick_count t3 = tick_count::now();
+
+		const double legacyTime = ( t1 - t0 ).seconds();
+		const double serialTime = ( t2 - t1 ).seconds();
+		const double parallelTime = ( t3 - t2 ).seconds();
+		BOOST_TEST_MESSAGE(
+			boost::format( "SceneCache writes : legacy %.3fs, serial %.3fs, parallel %.3fs, speedup over legacy %.2fx" ) %
+			legacyTime % serialTime % parallelTime % ( legacyTime / parallelTime )
+		);
+
+		checkScene( legacyFileName );
+		checkScene( serialFileName );
+		checkScene( parallelFileName );
+
+		boost::filesystem::remove( legacyFileName );
+		boost::filesystem::remove( serialFileName );
+		boost::filesystem::remove( parallelFileName );
+	}
+
+	void testBackgroundSaveError()
+	{
+		SceneCachePtr root = new SceneCache( new FailingIndexedIO );
+		SceneInterfacePtr child = root->createChild( "child" );
+		MeshPrimitivePtr mesh = MeshPrimitive::createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 64 ) );
+
+		// the samples are saved in the background, so the error may be reported by
+		// any of the writes following the first one, depending on the scheduling.
+		try
+		{
+			for ( size_t s = 0; s < g_numSamples; ++s )
+			{
+				child->writeObject( mesh.get(), s );
+			}
+		}
+		catch ( const Exception &e )
+		{
+			BOOST_CHECK( std::string( e.what() ).find( "Write failed" ) != std::string::npos );
+		}
+
+		// but it must always be reported by the flush, rather than only logged by the destructor.
+		bool flushFailed = false;
+		try
+		{
+			root->flush();
+		}
+		catch ( const Exception &e )
+		{
+			flushFailed = true;
+			BOOST_CHECK( std::string( e.what() ).find( "Write failed" ) != std::string::npos );
+		}
+		BOOST_CHECK( flushFailed );
+
+		BOOST_CHECK_THROW( root->flush(), Exception );
+		BOOST_CHECK_THROW( child->writeObject( mesh.get(), g_numSamples ), Exception );
+	}
+
 };
 
 struct SceneCacheThreadingTestSuite : public boost::unit_test::test_suite
@@ -134,6 +352,8 @@ struct SceneCacheThreadingTestSuite : public boost::unit_test::test_suite
 
 		add( BOOST_CLASS_TEST_CASE( &SceneCacheThreadingTest::testAttributeRead, instance ) );
 		add( BOOST_CLASS_TEST_CASE( &SceneCacheThreadingTest::testFakeAttributeRead, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &SceneCacheThreadingTest::testConcurrentWrite, instance ) );
+		add( BOOST_CLASS_TEST_CASE( &SceneCacheThreadingTest::testBackgroundSaveError, instance ) );
 	}
 };
 
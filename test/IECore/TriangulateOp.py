@@ -288,5 +288,78 @@ class TestTriangulateOp( unittest.TestCase ) :
 		self.assertEqual( m2["myString"].data, m["myString"].data )
 		self.assertEqual( m2["myString"].indices, IntVectorData( [ 1, 1, 0, 0, 0, 0, 1, 1 ] ) )
 
+	def testMixedFaces( self ) :
+
+		# a triangle, a quad and a pentagon in the z=0 plane
+		p = V3fVectorData( [
+			V3f( 0, 0, 0 ), V3f( 1, 0, 0 ), V3f( 0, 1, 0 ),
+			V3f( 2, 0, 0 ), V3f( 3, 0, 0 ), V3f( 3, 1, 0 ), V3f( 2, 1, 0 ),
+			V3f( 4, 0, 0 ), V3f( 5, 0, 0 ), V3f( 5.5, 0.5, 0 ), V3f( 5, 1, 0 ), V3f( 4, 1, 0 ),
+		] )
+		m = MeshPrimitive( IntVectorData( [ 3, 4, 5 ] ), IntVectorData( range( 0, 12 ) ), "linear", p )
+		m["u"] = PrimitiveVariable( PrimitiveVariable.Interpolation.Uniform, BoolVectorData( [ True, False, True ] ) )
+		m["fv"] = PrimitiveVariable( PrimitiveVariable.Interpolation.FaceVarying, FloatVectorData( range( 0, 12 ) ) )
+
+		m2 = TriangulateOp()( input = m )
+
+		self.assertTrue( m2.arePrimitiveVariablesValid() )
+		self.assertEqual( m2.verticesPerFace, IntVectorData( [ 3 ] * 6 ) )
+		self.assertEqual( m2.vertexIds, IntVectorData( [ 0, 1, 2, 3, 4, 5, 3, 5, 6, 7, 8, 9, 7, 9, 10, 7, 10, 11 ] ) )
+		self.assertEqual( m2["u"].data, BoolVectorData( [ True, False, False, True, True, True ] ) )
+		self.assertEqual( m2["fv"].data, FloatVectorData( [ 0, 1, 2, 3, 4, 5, 3, 5, 6, 7, 8, 9, 7, 9, 10, 7, 10, 11 ] ) )
+
+	def testInterpretationIsPreserved( self ) :
+
+		m = MeshPrimitive.createPlane( Box2f( V2f( -1 ), V2f( 1 ) ) )
+		m["N"] = PrimitiveVariable( PrimitiveVariable.Interpolation.FaceVarying, V3fVectorData( [ V3f( 0, 0, 1 ) ] * 4, GeometricData.Interpretation.Normal ) )
+
+		m2 = TriangulateOp()( input = m )
+		self.assertEqual( m2["N"].data.getInterpretation(), GeometricData.Interpretation.Normal )
+		self.assertEqual( m2["uv"].data.getInterpretation(), GeometricData.Interpretation.UV )
+
+	def testFirstErrorIsReported( self ) :
+
+		# Returns the index within the face of the corner of the plane
+		# belonging to that face alone.
+		def corner( m, face, sign ) :
+
+			ids = m.vertexIds[face*4:face*4+4]
+			return max( range( 0, 4 ), key = lambda i : sign * ( m["P"].data[ids[i]].x + m["P"].data[ids[i]].y ) )
+
+		def makeNonPlanar( m, face, sign ) :
+
+			i = m.vertexIds[face*4+corner( m, face, sign )]
+			m["P"].data[i] += V3f( 0, 0, 0.001 )
+
+		def makeConcave( m, face, sign ) :
+
+			c = corner( m, face, sign )
+			i = m.vertexIds[face*4+c]
+			a = m["P"].data[m.vertexIds[face*4+(c+2)%4]]
+			m["P"].data[i] = a + ( m["P"].data[i] - a ) * 0.25
+
+		# The first invalid face is reported, regardless of the order in
+		# which the faces are processed.
+		for first, last, message in (
+			( makeNonPlanar, makeConcave, "non-planar" ),
+			( makeConcave, makeNonPlanar, "concave" ),
+		) :
+			m = MeshPrimitive.createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 300 ) )
+			first( m, 0, -1 )
+			last( m, m.numFaces() - 1, 1 )
+			for i in range( 0, 10 ) :
+				self.assertRaisesRegexp( RuntimeError, message, TriangulateOp(), input = m )
+
+	@unittest.skipIf( isDebug(), "Skip performance testing in debug builds" )
+	def testPerformance( self ) :
+
+		m = MeshPrimitive.createPlane( Box2f( V2f( -1 ), V2f( 1 ) ), V2i( 2000 ) )
+		m["Cs"] = PrimitiveVariable( PrimitiveVariable.Interpolation.Uniform, Color3fVectorData( [ Color3f( 1 ) ] * m.numFaces() ) )
+
+		TriangulateOp()( input = m, copyInput = False, throwExceptions = False )
+
+		self.assertTrue( m.arePrimitiveVariablesValid() )
+		self.assertEqual( m.maxVerticesPerFace(), 3 )
+
 if __name__ == "__main__":
     unittest.main()
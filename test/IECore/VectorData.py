@@ -34,7 +34,9 @@
 
 """Unit test for VectorData binding"""
 
+import ctypes
 import math
+import struct
 import unittest
 
 from IECore import *
@@ -1259,6 +1261,183 @@ class TestVectorDataHashOptimisation( unittest.TestCase ) :
 		# should be slow this time, as the hash is being recomputed
 		self.assertGreaterEqual( secondTime, 0.8 * firstTime )
 
+# The Python 2 Py_buffer structure, used to get buffers directly, since
+# memoryview neither exposes the address of the data nor requests
+# writable buffers.
+class _PyBuffer( ctypes.Structure ) :
+
+	_fields_ = [
+		( "buf", ctypes.c_void_p ),
+		( "obj", ctypes.c_void_p ),
+		( "len", ctypes.c_ssize_t ),
+		( "itemsize", ctypes.c_ssize_t ),
+		( "readonly", ctypes.c_int ),
+		( "ndim", ctypes.c_int ),
+		( "format", ctypes.c_char_p ),
+		( "shape", ctypes.c_void_p ),
+		( "strides", ctypes.c_void_p ),
+		( "suboffsets", ctypes.c_void_p ),
+		( "smalltable", ctypes.c_ssize_t * 2 ),
+		( "internal", ctypes.c_void_p ),
+	]
+
+	def __init__( self, exporter, writable = False ) :
+
+		ctypes.Structure.__init__( self )
+		ctypes.pythonapi.PyObject_GetBuffer( ctypes.py_object( exporter ), ctypes.byref( self ), 1 if writable else 0 )
+
+	def release( self ) :
+
+		ctypes.pythonapi.PyBuffer_Release( ctypes.byref( self ) )
+
+class TestVectorDataBufferProtocol( unittest.TestCase ) :
+
+	def testReadOnlyView( self ) :
+
+		d = FloatVectorData( [ 1, 2, 3 ] )
+		m = memoryview( d )
+
+		self.assertEqual( m.format, "f" )
+		self.assertEqual( m.itemsize, 4 )
+		self.assertEqual( m.shape, ( 3, ) )
+		self.assertTrue( m.readonly )
+		self.assertEqual( m.tolist(), [ 1, 2, 3 ] )
+
+	def testMultipleComponents( self ) :
+
+		d = V3fVectorData( [ V3f( 1, 2, 3 ), V3f( 4, 5, 6 ) ] )
+		m = memoryview( d )
+
+		self.assertEqual( m.format, "f" )
+		self.assertEqual( m.ndim, 2 )
+		self.assertEqual( m.shape, ( 2, 3 ) )
+		self.assertEqual( m.strides, ( 12, 4 ) )
+
+		i = d.__array_interface__
+		self.assertEqual( i["version"], 3 )
+		self.assertEqual( i["typestr"][1:], "f4" )
+		self.assertEqual( i["shape"], ( 2, 3 ) )
+		self.assertEqual( i["data"][1], True )
+
+	def testBufferConstructor( self ) :
+
+		for d in [
+			FloatVectorData( [ 1, 2, 3 ] ),
+			IntVectorData( [ 1, 2, 3 ] ),
+			V3fVectorData( [ V3f( 1, 2, 3 ), V3f( 4, 5, 6 ) ] ),
+			M44dVectorData( [ M44d().translate( V3d( 1, 2, 3 ) ) ] ),
+		] :
+			d2 = d.__class__( memoryview( d ) )
+			self.assertEqual( d2, d )
+
+	def testBufferConstructorShape( self ) :
+
+		# the base types match, but the elements don't.
+		self.assertRaises( TypeError, FloatVectorData, V3fVectorData( [ V3f( 1, 2, 3 ) ] ) )
+		self.assertRaises( Exception, V3fVectorData, FloatVectorData( [ 1, 2, 3 ] ) )
+		self.assertRaises( Exception, V2fVectorData, V3fVectorData( [ V3f( 1, 2, 3 ), V3f( 4, 5, 6 ) ] ) )
+
+	def testWritableView( self ) :
+
+		d = FloatVectorData( [ 1, 2, 3 ] )
+		struct.pack_into( "f", d, 4, 10 )
+		self.assertEqual( d, FloatVectorData( [ 1, 10, 3 ] ) )
+
+		d = V3fVectorData( [ V3f( 1, 2, 3 ), V3f( 4, 5, 6 ) ] )
+		struct.pack_into( "3f", d, 12, 7, 8, 9 )
+		self.assertEqual( d, V3fVectorData( [ V3f( 1, 2, 3 ), V3f( 7, 8, 9 ) ] ) )
+
+	def testZeroCopy( self ) :
+
+		d = FloatVectorData( [ 1, 2, 3 ] )
+		d2 = d.copy()
+
+		b = _PyBuffer( d )
+		b2 = _PyBuffer( d2 )
+		self.assertEqual( b.buf, b2.buf )
+		self.assertEqual( b.len, 12 )
+		self.assertTrue( b.readonly )
+		b.release()
+		b2.release()
+
+		i = d.__array_interface__
+		self.assertEqual( i["data"][0], b.buf )
+		self.assertEqual( d2.__array_interface__["data"][0], b.buf )
+
+	def testCopyOnWriteOnce( self ) :
+
+		d = FloatVectorData( [ 1, 2, 3 ] )
+		d2 = d.copy()
+
+		b = _PyBuffer( d )
+		shared = b.buf
+		b.release()
+
+		# the first writable view copies the shared data
+		b = _PyBuffer( d, writable = True )
+		self.assertNotEqual( b.buf, shared )
+		self.assertFalse( b.readonly )
+		written = b.buf
+		b.release()
+
+		# but no subsequent one does
+		for i in range( 0, 3 ) :
+			b = _PyBuffer( d, writable = True )
+			self.assertEqual( b.buf, written )
+			b.release()
+
+		b = _PyBuffer( d2 )
+		self.assertEqual( b.buf, shared )
+		b.release()
+
+	def testReadOnlyViewIsSnapshot( self ) :
+
+		d = FloatVectorData( [ 1, 2, 3 ] )
+		m = memoryview( d )
+
+		d.append( 4 )
+		d[0] = 10
+		d.resize( 1000 )
+
+		self.assertEqual( m.tolist(), [ 1, 2, 3 ] )
+		self.assertEqual( d[:4], FloatVectorData( [ 10, 2, 3, 4 ] ) )
+
+		a = d.__array_interface__["data"][0]
+		d[0] = 20
+		self.assertNotEqual( d.__array_interface__["data"][0], a )
+		self.assertEqual( ctypes.c_float.from_address( a ).value, 10 )
+
+	def testModificationWithWritableView( self ) :
+
+		d = FloatVectorData( [ 1, 2, 3 ] )
+		b = _PyBuffer( d, writable = True )
+
+		self.assertRaises( BufferError, d.append, 4 )
+		self.assertRaises( BufferError, d.resize, 10 )
+		self.assertRaises( BufferError, d.__setitem__, 0, 10 )
+		self.assertRaises( BufferError, d.__delitem__, 0 )
+		self.assertRaises( BufferError, d.extend, [ 4 ] )
+		self.assertRaises( BufferError, d.insert, 0, 4 )
+		self.assertRaises( BufferError, d.__iadd__, 1 )
+		self.assertRaises( BufferError, _PyBuffer, d, True )
+
+		# reading is fine
+		self.assertEqual( list( d ), [ 1, 2, 3 ] )
+		self.assertEqual( d + 1, FloatVectorData( [ 2, 3, 4 ] ) )
+
+		ctypes.c_float.from_address( b.buf ).value = 5
+		b.release()
+
+		self.assertEqual( d, FloatVectorData( [ 5, 2, 3 ] ) )
+		d.append( 4 )
+		self.assertEqual( d, FloatVectorData( [ 5, 2, 3, 4 ] ) )
+
+	def testUnsupportedTypes( self ) :
+
+		self.assertRaises( TypeError, memoryview, StringVectorData( [ "a" ] ) )
+		self.assertRaises( TypeError, memoryview, BoolVectorData( [ True ] ) )
+		self.assertFalse( hasattr( StringVectorData(), "__array_interface__" ) )
+
 class TestInternedStringVectorData( unittest.TestCase ) :
 
 	def test( self ) :
@@ -37,8 +37,13 @@ import unittest
 import os
 import gc
 import glob
+import shutil
 import sys
 import time
+import socket
+import struct
+import tempfile
+import threading
 import IECore
 import IECoreImage
 
@@ -137,6 +142,143 @@ class ImageDisplayDriverTest(unittest.TestCase):
 		i = dd.image()
 		self.assertEqual( i["Y"], y )
 
+	def testImageDataAfterClose( self ) :
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 99 ) )
+		dd = IECoreImage.ImageDisplayDriver( window, window, [ "Y" ], IECore.CompoundData() )
+
+		box = IECore.Box2i( IECore.V2i( 10 ), IECore.V2i( 19 ) )
+		dd.imageData( box, IECore.FloatVectorData( [ 1 ] * 10 * 10 ) )
+		dd.imageClose()
+
+		# the tiles have been released, so the image must
+		# already hold everything that was written.
+		image = dd.image()
+		self.assertEqual( image["Y"][10 * 100 + 10], 1 )
+		self.assertEqual( image["Y"][20 * 100 + 20], 0 )
+
+		self.assertRaises( RuntimeError, dd.imageData, box, IECore.FloatVectorData( [ 2 ] * 10 * 10 ) )
+		self.assertEqual( dd.image(), image )
+
+	def testTileBoundaries( self ) :
+
+		# a data window which doesn't align with the internal
+		# tiles, and a channel count without a specialisation
+
+		dataWindow = IECore.Box2i( IECore.V2i( -30, 10 ), IECore.V2i( 170, 90 ) )
+		channelNames = [ "R", "G", "B", "A", "Z" ]
+		dd = IECoreImage.ImageDisplayDriver( dataWindow, dataWindow, channelNames, IECore.CompoundData() )
+
+		bucketSize = 25
+		for y in range( dataWindow.min.y, dataWindow.max.y + 1, bucketSize ) :
+			for x in range( dataWindow.min.x, dataWindow.max.x + 1, bucketSize ) :
+				box = IECore.Box2i( IECore.V2i( x, y ), IECore.V2i( min( x + bucketSize - 1, dataWindow.max.x ), min( y + bucketSize - 1, dataWindow.max.y ) ) )
+				data = IECore.FloatVectorData()
+				for py in range( box.min.y, box.max.y + 1 ) :
+					for px in range( box.min.x, box.max.x + 1 ) :
+						for c in range( 0, len( channelNames ) ) :
+							data.append( px * 1000 + py + c * 0.25 )
+				dd.imageData( box, data )
+
+		dd.imageClose()
+
+		image = dd.image()
+		self.assertEqual( image.dataWindow, dataWindow )
+		self.assertTrue( image.channelsValid() )
+
+		width = dataWindow.size().x + 1
+		for y in range( dataWindow.min.y, dataWindow.max.y + 1, 7 ) :
+			for x in range( dataWindow.min.x, dataWindow.max.x + 1, 3 ) :
+				i = ( y - dataWindow.min.y ) * width + x - dataWindow.min.x
+				for c, name in enumerate( channelNames ) :
+					self.assertEqual( image[name][i], x * 1000 + y + c * 0.25 )
+
+	def testSnapshotsAreUnaffectedByLaterWrites( self ) :
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 99 ) )
+		dd = IECoreImage.ImageDisplayDriver( window, window, [ "Y" ], IECore.CompoundData() )
+
+		dd.imageData( window, IECore.FloatVectorData( [ 1 ] * 100 * 100 ) )
+		image1 = dd.image()
+		self.assertEqual( image1["Y"], IECore.FloatVectorData( [ 1 ] * 100 * 100 ) )
+
+		box = IECore.Box2i( IECore.V2i( 10 ), IECore.V2i( 19 ) )
+		dd.imageData( box, IECore.FloatVectorData( [ 2 ] * 10 * 10 ) )
+		image2 = dd.image()
+
+		self.assertEqual( image1["Y"], IECore.FloatVectorData( [ 1 ] * 100 * 100 ) )
+		self.assertEqual( image2["Y"][0], 1 )
+		self.assertEqual( image2["Y"][10 * 100 + 10], 2 )
+		self.assertEqual( image2["Y"][19 * 100 + 19], 2 )
+		self.assertEqual( image2["Y"][20 * 100 + 20], 1 )
+
+		# no writes, so nothing has changed
+
+		self.assertEqual( dd.image(), image2 )
+
+	def testConcurrentWrites( self ) :
+
+		import threading
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 511 ) )
+		dd = IECoreImage.ImageDisplayDriver( window, window, [ "R", "G", "B", "A" ], IECore.CompoundData() )
+
+		bucketSize = 16
+		def writeBuckets( row ) :
+			for y in range( row, 512, bucketSize * 4 ) :
+				for x in range( 0, 512, bucketSize ) :
+					box = IECore.Box2i( IECore.V2i( x, y ), IECore.V2i( x + bucketSize - 1, y + bucketSize - 1 ) )
+					dd.imageData( box, IECore.FloatVectorData( [ x + y * 512 ] * bucketSize * bucketSize * 4 ) )
+					# snapshots taken while writing must not disturb the writers
+					dd.image()
+
+		threads = []
+		for i in range( 0, 4 ) :
+			thread = threading.Thread( target = writeBuckets, args = ( i * bucketSize, ) )
+			threads.append( thread )
+			thread.start()
+
+		for thread in threads :
+			thread.join()
+
+		dd.imageClose()
+
+		image = dd.image()
+		for y in range( 0, 512, 5 ) :
+			for x in range( 0, 512, 5 ) :
+				expected = ( x - x % bucketSize ) + ( y - y % bucketSize ) * 512
+				for c in [ "R", "G", "B", "A" ] :
+					self.assertEqual( image[c][y*512+x], expected )
+
+	@unittest.skipIf( IECore.isDebug(), "Skip performance testing in debug builds" )
+	def testPerformance( self ) :
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 4095, 2047 ) )
+		channelNames = [ "R", "G", "B", "A" ]
+
+		bucketSize = 64
+		data = IECore.FloatVectorData( [ 0.5 ] * bucketSize * bucketSize * len( channelNames ) )
+
+		def render( holdSnapshots ) :
+
+			dd = IECoreImage.ImageDisplayDriver( window, window, channelNames, IECore.CompoundData() )
+
+			snapshot = None
+			for y in range( 0, 2048, bucketSize ) :
+				for x in range( 0, 4096, bucketSize ) :
+					dd.imageData( IECore.Box2i( IECore.V2i( x, y ), IECore.V2i( x + bucketSize - 1, y + bucketSize - 1 ) ), data )
+				if not holdSnapshots :
+					snapshot = None
+				# If the previous snapshot is still held while taking the
+				# next one, as a viewer might, every channel is copied in full.
+				snapshot = dd.image()
+
+			dd.imageClose()
+			self.assertEqual( dd.image(), snapshot )
+
+		render( holdSnapshots = False )
+		render( holdSnapshots = True )
+
 class ClientServerDisplayDriverTest(unittest.TestCase):
 
 	def setUp( self ):
@@ -261,6 +403,434 @@ class ClientServerDisplayDriverTest(unittest.TestCase):
 		i = IECoreImage.ImageDisplayDriver.removeStoredImage( "myHandle" )
 		self.assertEqual( i["Y"], y )
 
+	def __sendImage( self, img, params, sharedMemory = None ) :
+
+		width = img.dataWindow.max.x - img.dataWindow.min.x + 1
+		idd = IECoreImage.ClientDisplayDriver( img.displayWindow, img.dataWindow, list( img.channelNames() ), params )
+		if sharedMemory is not None :
+			self.assertEqual( idd.sharedMemory(), sharedMemory )
+
+		buf = IECore.FloatVectorData( width * 3 )
+		for i in xrange( 0, img.dataWindow.max.y - img.dataWindow.min.y + 1 ):
+			self.__prepareBuf( buf, width, i*width, img["R"], img["G"], img["B"] )
+			idd.imageData( IECore.Box2i( IECore.V2i( img.dataWindow.min.x, i + img.dataWindow.min.y ), IECore.V2i( img.dataWindow.max.x, i + img.dataWindow.min.y) ), buf )
+		idd.imageClose()
+
+		newImg = IECoreImage.ImageDisplayDriver.removeStoredImage( params["handle"].value )
+		newImg.blindData().clear()
+		return newImg
+
+	def testEncodings( self ) :
+
+		img = IECore.Reader.create( "test/IECoreImage/data/tiff/bluegreen_noise.400x300.tif" )()
+		img.blindData().clear()
+
+		for pixelFormat, compression, maxError in [
+			( "float", "none", 0 ),
+			( "float", "zip", 0 ),
+			( "half", "none", 0.001 ),
+			( "half", "zip", 0.001 ),
+		] :
+
+			params = IECore.CompoundData( {
+				"displayHost" : "localhost",
+				"displayPort" : "1559",
+				"remoteDisplayType" : "ImageDisplayDriver",
+				"handle" : "myHandle",
+				"displayPixelFormat" : pixelFormat,
+				"displayCompression" : compression,
+			} )
+
+			newImg = self.__sendImage( img, params )
+			if maxError == 0 :
+				self.assertEqual( newImg, img )
+			else :
+				self.assertFalse(
+					IECoreImage.ImageDiffOp()( imageA = newImg, imageB = img, maxError = maxError ).value
+				)
+
+	def testSmallInFlightLimit( self ) :
+
+		img = IECore.Reader.create( "test/IECoreImage/data/tiff/bluegreen_noise.400x300.tif" )()
+		img.blindData().clear()
+
+		params = IECore.CompoundData( {
+			"displayHost" : "localhost",
+			"displayPort" : "1559",
+			"remoteDisplayType" : "ImageDisplayDriver",
+			"handle" : "myHandle",
+			"displayMaxBucketsInFlight" : 1,
+		} )
+
+		self.assertEqual( self.__sendImage( img, params ), img )
+
+	def testSharedMemory( self ) :
+
+		img = IECore.Reader.create( "test/IECoreImage/data/tiff/bluegreen_noise.400x300.tif" )()
+		img.blindData().clear()
+
+		def sharedMemoryFiles() :
+			return set( glob.glob( "/dev/shm/cortexDisplayDriver.*" ) + glob.glob( "/tmp/cortexDisplayDriver.*" ) )
+
+		filesBefore = sharedMemoryFiles()
+
+		for sharedMemory, sharedMemorySize, pixelFormat in [
+			# socket only
+			( False, None, "float" ),
+			# shared memory, with and without encoding
+			( True, None, "float" ),
+			( True, None, "half" ),
+			# a buffer holding only a few scanlines, so that
+			# it is reused many times during the transfer
+			( True, 16384, "float" ),
+			# a buffer too small for a scanline, so that we
+			# fall back to the socket
+			( True, 1024, "float" ),
+		] :
+
+			params = IECore.CompoundData( {
+				"displayHost" : "localhost",
+				"displayPort" : "1559",
+				"remoteDisplayType" : "ImageDisplayDriver",
+				"handle" : "myHandle",
+				"displaySharedMemory" : sharedMemory,
+				"displayPixelFormat" : pixelFormat,
+			} )
+			if sharedMemorySize is not None :
+				params["displaySharedMemorySize"] = sharedMemorySize
+
+			# the server is on this host, so it must have
+			# agreed to use the shared memory.
+			newImg = self.__sendImage( img, params, sharedMemory = sharedMemory )
+			if pixelFormat == "float" :
+				self.assertEqual( newImg, img )
+			else :
+				self.assertFalse(
+					IECoreImage.ImageDiffOp()( imageA = newImg, imageB = img, maxError = 0.001 ).value
+				)
+
+			# the client must not leave files behind
+			self.assertEqual( sharedMemoryFiles(), filesBefore )
+
+	def __receive( self, connection, size ) :
+
+		result = ""
+		while len( result ) < size :
+			chunk = connection.recv( size - len( result ) )
+			if not chunk :
+				raise IOError( "Connection closed" )
+			result += chunk
+
+		return result
+
+	def __header( self, messageType, dataSize, protocolVersion = 2 ) :
+
+		return struct.pack( "<BBBI", 0x82, protocolVersion, messageType, dataSize )
+
+	def testSharedMemoryFileRefused( self ) :
+
+		# The server writes to the shared memory, so it must
+		# refuse any file which the client couldn't have created
+		# for the purpose, wherever the request comes from.
+
+		directory = tempfile.mkdtemp()
+		victim = os.path.join( directory, "cortexDisplayDriver.victim" )
+		with open( victim, "w" ) as f :
+			f.write( "x" * 4096 )
+		os.chmod( victim, 0600 )
+
+		link = "/tmp/cortexDisplayDriver.tstLnk"
+		group = "/tmp/cortexDisplayDriver.tstGrp"
+		try :
+			os.symlink( victim, link )
+			with open( group, "w" ) as f :
+				f.write( "x" * 4096 )
+			os.chmod( group, 0660 )
+
+			for fileName in [
+				# a regular file in the wrong directory
+				victim,
+				# a link from an acceptable name
+				link,
+				# a file with an acceptable name, but not made by mkstemp()
+				group,
+			] :
+
+				window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 7 ) )
+
+				io = IECore.MemoryIndexedIO( IECore.CharVectorData(), [], IECore.IndexedIO.OpenMode.Write )
+				IECore.Box2iData( window ).save( io, "displayWindow" )
+				IECore.Box2iData( window ).save( io, "dataWindow" )
+				IECore.StringVectorData( [ "Y" ] ).save( io, "channelNames" )
+				IECore.CompoundData( {
+					"remoteDisplayType" : "ImageDisplayDriver",
+					"displayProtocolVersion" : IECore.IntData( 4 ),
+					"displaySharedMemoryFile" : fileName,
+				} ).save( io, "parameters" )
+				openData = "".join( io.buffer() )
+
+				connection = socket.create_connection( ( "localhost", 1559 ) )
+				try :
+					connection.sendall( self.__header( 1, len( openData ) ) + openData )
+
+					# scanLineOrderOnly, acceptsRepeatedData and the encoding
+					for i in range( 0, 3 ) :
+						magic, version, messageType, dataSize = struct.unpack( "<BBBI", self.__receive( connection, 7 ) )
+						self.assertEqual( ( version, messageType ), ( 4, 1 ) )
+						data = self.__receive( connection, dataSize )
+
+					# the server hasn't mapped the file
+					self.assertEqual( data, "\0\0\0" )
+
+					# so must reject a bucket which would have it write
+					# the read position to the start of the file
+					bucket = struct.pack( "<4i3Q", 0, 0, 7, 7, 0, 0, 0x4141414141414141 )
+					connection.sendall( self.__header( 5, len( bucket ), 4 ) + bucket )
+					self.assertRaises( IOError, self.__receive, connection, 1 )
+				finally :
+					connection.close()
+
+				for f in ( victim, group ) :
+					with open( f ) as contents :
+						self.assertEqual( contents.read(), "x" * 4096 )
+
+		finally :
+			for f in ( link, group ) :
+				if os.path.lexists( f ) :
+					os.remove( f )
+			shutil.rmtree( directory )
+
+	def testOldServer( self ) :
+
+		# Emulates a server from before protocol version 3, which
+		# reads the imageOpen parameters with MemoryIndexedIO and
+		# only understands version 2 headers.
+
+		listener = socket.socket( socket.AF_INET, socket.SOCK_STREAM )
+		listener.bind( ( "localhost", 0 ) )
+		listener.listen( 1 )
+
+		received = { "versions" : set(), "numBuckets" : 0 }
+		def serve() :
+			connection, address = listener.accept()
+			try :
+				while True :
+					magic, version, messageType, dataSize = struct.unpack( "<BBBI", self.__receive( connection, 7 ) )
+					received["versions"].add( version )
+					data = self.__receive( connection, dataSize )
+					if messageType == 1 :
+						io = IECore.MemoryIndexedIO( IECore.CharVectorData( data ), [], IECore.IndexedIO.OpenMode.Read )
+						received["parameters"] = IECore.Object.load( io, "parameters" )
+						connection.sendall( self.__header( 1, 1 ) + "\0" )
+						connection.sendall( self.__header( 1, 1 ) + "\0" )
+					elif messageType == 2 :
+						received["numBuckets"] += 1
+					elif messageType == 3 :
+						connection.sendall( self.__header( 3, 0 ) )
+						break
+			except Exception, e :
+				received["exception"] = e
+			finally :
+				connection.close()
+
+		thread = threading.Thread( target = serve )
+		thread.start()
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 15 ) )
+		try :
+			dd = IECoreImage.ClientDisplayDriver(
+				window, window,
+				[ "Y" ],
+				IECore.CompoundData( {
+					"displayHost" : "localhost",
+					"displayPort" : str( listener.getsockname()[1] ),
+					"remoteDisplayType" : "ImageDisplayDriver",
+				} )
+			)
+			dd.imageData( window, IECore.FloatVectorData( [ 1 ] * 16 * 16 ) )
+			dd.imageClose()
+		finally :
+			thread.join()
+			listener.close()
+
+		self.assertFalse( "exception" in received )
+		self.assertEqual( received["versions"], set( [ 2 ] ) )
+		self.assertEqual( received["parameters"]["remoteDisplayType"], IECore.StringData( "ImageDisplayDriver" ) )
+		self.assertEqual( received["numBuckets"], 1 )
+
+	def testConcurrentImageData( self ) :
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 255 ) )
+		dd = IECoreImage.ClientDisplayDriver(
+			window, window,
+			[ "Y" ],
+			IECore.CompoundData( {
+				"displayHost" : "localhost",
+				"displayPort" : "1559",
+				"remoteDisplayType" : "ImageDisplayDriver",
+				"handle" : "myHandle",
+				"displayCompression" : "zip",
+			} )
+		)
+
+		bucketSize = 16
+		def writeBuckets( row ) :
+			for y in range( row, 256, bucketSize * 4 ) :
+				for x in range( 0, 256, bucketSize ) :
+					box = IECore.Box2i( IECore.V2i( x, y ), IECore.V2i( x + bucketSize - 1, y + bucketSize - 1 ) )
+					dd.imageData( box, IECore.FloatVectorData( [ x + y * 256 ] * bucketSize * bucketSize ) )
+
+		threads = []
+		for i in range( 0, 4 ) :
+			thread = threading.Thread( target = writeBuckets, args = ( i * bucketSize, ) )
+			threads.append( thread )
+			thread.start()
+
+		for thread in threads :
+			thread.join()
+
+		dd.imageClose()
+
+		image = IECoreImage.ImageDisplayDriver.removeStoredImage( "myHandle" )
+		for y in range( 0, 256, 3 ) :
+			for x in range( 0, 256, 3 ) :
+				self.assertEqual( image["Y"][y*256+x], ( x - x % bucketSize ) + ( y - y % bucketSize ) * 256 )
+
+	def testConcurrentSessions( self ) :
+
+		# The server services sessions from a pool of threads, so
+		# the display drivers for these images are created and
+		# called concurrently.
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 127 ) )
+		numSessions = 16
+		bucketSize = 16
+
+		errors = []
+		def sendImage( index ) :
+			try :
+				dd = IECoreImage.ClientDisplayDriver(
+					window, window,
+					[ "Y" ],
+					IECore.CompoundData( {
+						"displayHost" : "localhost",
+						"displayPort" : "1559",
+						"remoteDisplayType" : "ImageDisplayDriver",
+						"handle" : "myHandle%d" % index,
+					} )
+				)
+				for y in range( 0, 128, bucketSize ) :
+					for x in range( 0, 128, bucketSize ) :
+						box = IECore.Box2i( IECore.V2i( x, y ), IECore.V2i( x + bucketSize - 1, y + bucketSize - 1 ) )
+						dd.imageData( box, IECore.FloatVectorData( [ index * 1000 + x + y ] * bucketSize * bucketSize ) )
+				dd.imageClose()
+			except Exception, e :
+				errors.append( e )
+
+		threads = []
+		for i in range( 0, numSessions ) :
+			thread = threading.Thread( target = sendImage, args = ( i, ) )
+			threads.append( thread )
+			thread.start()
+
+		for thread in threads :
+			thread.join()
+
+		self.assertEqual( errors, [] )
+
+		for i in range( 0, numSessions ) :
+			image = IECoreImage.ImageDisplayDriver.removeStoredImage( "myHandle%d" % i )
+			for y in range( 0, 128, 5 ) :
+				for x in range( 0, 128, 5 ) :
+					self.assertEqual( image["Y"][y*128+x], i * 1000 + ( x - x % bucketSize ) + ( y - y % bucketSize ) )
+
+	def testVersion2Client( self ) :
+
+		# Emulates a client from before protocol version 3, which
+		# doesn't send "displayProtocolVersion" in the imageOpen
+		# parameters, and only understands version 2 headers.
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 7 ) )
+
+		io = IECore.MemoryIndexedIO( IECore.CharVectorData(), [], IECore.IndexedIO.OpenMode.Write )
+		IECore.Box2iData( window ).save( io, "displayWindow" )
+		IECore.Box2iData( window ).save( io, "dataWindow" )
+		IECore.StringVectorData( [ "Y" ] ).save( io, "channelNames" )
+		IECore.CompoundData( {
+			"remoteDisplayType" : "ImageDisplayDriver",
+			"handle" : "myHandle",
+		} ).save( io, "parameters" )
+		openData = "".join( io.buffer() )
+
+		pixels = [ float( i ) for i in range( 0, 64 ) ]
+		imageData = struct.pack( "<4i", 0, 0, 7, 7 ) + struct.pack( "<64f", *pixels )
+
+		connection = socket.create_connection( ( "localhost", 1559 ) )
+		try :
+			connection.sendall( self.__header( 1, len( openData ) ) + openData )
+
+			# scanLineOrderOnly and acceptsRepeatedData, and nothing else
+			for i in range( 0, 2 ) :
+				magic, version, messageType, dataSize = struct.unpack( "<BBBI", self.__receive( connection, 7 ) )
+				self.assertEqual( ( magic, version, messageType, dataSize ), ( 0x82, 2, 1, 1 ) )
+				self.__receive( connection, dataSize )
+
+			connection.sendall( self.__header( 2, len( imageData ) ) + imageData )
+			connection.sendall( self.__header( 3, 0 ) )
+
+			magic, version, messageType, dataSize = struct.unpack( "<BBBI", self.__receive( connection, 7 ) )
+			self.assertEqual( ( magic, version, messageType, dataSize ), ( 0x82, 2, 3, 0 ) )
+		finally :
+			connection.close()
+
+		image = IECoreImage.ImageDisplayDriver.removeStoredImage( "myHandle" )
+		self.assertEqual( image["Y"], IECore.FloatVectorData( pixels ) )
+
+	@unittest.skipIf( IECore.isDebug(), "Skip performance testing in debug builds" )
+	def testLoopbackPerformance( self ) :
+
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 2047 ) )
+		channelNames = [ "R", "G", "B", "A" ]
+		bucketSize = 64
+		data = IECore.FloatVectorData( [ 0.5 ] * bucketSize * bucketSize * len( channelNames ) )
+
+		for sharedMemory, pixelFormat, compression in [
+			( False, "float", "none" ),
+			( False, "half", "none" ),
+			( False, "float", "zip" ),
+			( False, "half", "zip" ),
+			( True, "float", "none" ),
+			( True, "half", "none" ),
+		] :
+
+			params = IECore.CompoundData( {
+				"displayHost" : "localhost",
+				"displayPort" : "1559",
+				"remoteDisplayType" : "ImageDisplayDriver",
+				"handle" : "myHandle",
+				"displaySharedMemory" : sharedMemory,
+				"displayPixelFormat" : pixelFormat,
+				"displayCompression" : compression,
+			} )
+
+			# a single bucket round trip, from open to close
+			dd = IECoreImage.ClientDisplayDriver( window, window, channelNames, params )
+			dd.imageData( IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( bucketSize - 1 ) ), data )
+			dd.imageClose()
+			IECoreImage.ImageDisplayDriver.removeStoredImage( "myHandle" )
+
+			dd = IECoreImage.ClientDisplayDriver( window, window, channelNames, params )
+			for y in range( 0, 2048, bucketSize ) :
+				for x in range( 0, 2048, bucketSize ) :
+					dd.imageData( IECore.Box2i( IECore.V2i( x, y ), IECore.V2i( x + bucketSize - 1, y + bucketSize - 1 ) ), data )
+			dd.imageClose()
+
+			image = IECoreImage.ImageDisplayDriver.removeStoredImage( "myHandle" )
+			self.assertEqual( image.dataWindow, window )
+			for c in channelNames :
+				self.assertEqual( image[c][0], 0.5 )
+				self.assertEqual( image[c][2048 * 2048 - 1], 0.5 )
+
 	def tearDown( self ):
 
 		self.server = None
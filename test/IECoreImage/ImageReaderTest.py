@@ -39,6 +39,11 @@ import unittest
 import IECore
 import IECoreImage
 
+try :
+	import OpenImageIO
+except ImportError :
+	OpenImageIO = None
+
 class ImageReaderTest( unittest.TestCase ) :
 
 	def testFactoryConstruction( self ) :
@@ -319,6 +324,102 @@ class ImageReaderTest( unittest.TestCase ) :
 		self.assertEqual( type(r), IECoreImage.ImageReader )
 		self.assertFalse( r.isComplete() )
 
+	def testDataWindowParameter( self ) :
+
+		r = IECoreImage.ImageReader( "test/IECoreImage/data/exr/uvMap.256x256.exr" )
+		full = r.read()
+
+		window = IECore.Box2i( IECore.V2i( 10, 20 ), IECore.V2i( 99, 109 ) )
+		r["dataWindow"].setTypedValue( window )
+		i = r.read()
+
+		self.assertEqual( i.dataWindow, window )
+		self.assertEqual( i.displayWindow, full.displayWindow )
+		self.assertTrue( i.channelsValid() )
+
+		for c in ["R", "G", "B"] :
+			self.assertEqual( r.readChannel( c ), i[c] )
+			for y in range( window.min.y, window.max.y + 1 ) :
+				for x in range( window.min.x, window.max.x + 1, 7 ) :
+					self.assertEqual(
+						i[c][(y - window.min.y) * 90 + x - window.min.x],
+						full[c][y * 256 + x]
+					)
+
+		# pixels outside the data window of the file are black
+
+		window = IECore.Box2i( IECore.V2i( -10 ), IECore.V2i( 9 ) )
+		r["dataWindow"].setTypedValue( window )
+		i = r.read()
+
+		self.assertEqual( i.dataWindow, window )
+		self.assertTrue( i.channelsValid() )
+		for c in ["R", "G", "B"] :
+			self.assertEqual( i[c][0], 0 )
+			self.assertEqual( i[c][19], 0 )
+			self.assertEqual( i[c][10 * 20 + 10], full[c][0] )
+
+	def testReadChannels( self ) :
+
+		for fileName in (
+			"test/IECoreImage/data/exr/manyChannels.exr",
+			"test/IECoreImage/data/exr/uvMapWithDataWindow.100x100.exr",
+			"test/IECoreImage/data/tiff/uvMap.200x100.rgba.8bit.tif",
+		) :
+
+			r = IECoreImage.ImageReader( fileName )
+			names = list( r.channelNames() )
+			names.reverse()
+
+			for raw in ( False, True ) :
+
+				channels = r.readChannels( names, raw = raw )
+				self.assertEqual( len( channels ), len( names ) )
+				for name, channel in zip( names, channels ) :
+					self.assertEqual( channel, r.readChannel( name, raw = raw ) )
+
+				channels = r.readChannels( names[1:2], raw = raw )
+				self.assertEqual( channels, [ r.readChannel( names[1], raw = raw ) ] )
+
+			self.assertEqual( r.readChannels( [] ), [] )
+			self.assertRaises( Exception, r.readChannels, [ names[0], "iDontExist" ] )
+
+	@unittest.skipIf( IECore.isDebug(), "Skip performance testing in debug builds" )
+	@unittest.skipIf( OpenImageIO is None, "OpenImageIO python module not available" )
+	def testReadChannelsPerformance( self ) :
+
+		# Build each channel from a single repeated scanline, rather than
+		# from a full resolution list, so that generating the file is cheap.
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 2047 ) )
+		row = IECore.FloatVectorData( [ float( x % 1000 ) / 1000 for x in range( 2048 ) ] )
+		data = IECore.FloatVectorData()
+		for y in range( 2048 ) :
+			data.extend( row )
+
+		image = IECoreImage.ImagePrimitive( window, window )
+		names = [ "R", "G", "B", "A" ] + [ "layer%d.%s" % ( i, c ) for i in range( 4 ) for c in "RGB" ]
+		for i, name in enumerate( names ) :
+			image[name] = data + float( i )
+
+		IECoreImage.ImageWriter( image, "test/IECoreImage/data/exr/output.exr" ).write()
+
+		# Before readChannels() was added, each channel was read with its own
+		# full frame get_pixels() call on a cache without autotiling, so the
+		# file was decoded once per channel on a single thread. We reproduce
+		# that with OpenImageIO directly, as the baseline for the batched read.
+		# Timings are left to the profiler running the test.
+		fileName = "test/IECoreImage/data/exr/output.exr"
+		baseline = OpenImageIO.ImageInput.open( fileName )
+		self.assertEqual( baseline.spec().nchannels, len( names ) )
+		for i in range( 0, len( names ) ) :
+			self.assertTrue( baseline.read_image( i, i + 1, OpenImageIO.FLOAT ) is not None )
+		baseline.close()
+
+		batched = IECoreImage.ImageReader( fileName ).readChannels( names )
+
+		r = IECoreImage.ImageReader( fileName )
+		self.assertEqual( batched, [ r.readChannel( name ) for name in names ] )
+
 	def setUp( self ) :
 
 		if os.path.isfile( "test/IECoreImage/data/exr/output.exr") :
@@ -732,6 +732,94 @@ class ImageWriterTest( unittest.TestCase ) :
 
 			self.tearDown()
 
+	def testTiledEXR( self ) :
+
+		displayWindow = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 199, 149 ) )
+		dataWindow = IECore.Box2i( IECore.V2i( 10, 15 ), IECore.V2i( 110, 133 ) )
+		imgOrig = self.__makeFloatImage( dataWindow, displayWindow, withAlpha = True )
+
+		w = IECore.Writer.create( imgOrig, "test/IECoreImage/data/exr/output.exr" )
+		w["formatSettings"]["openexr"]["tileSize"].setTypedValue( 32 )
+		w.write()
+
+		imgNew = IECore.Reader.create( "test/IECoreImage/data/exr/output.exr" ).read()
+		self.assertEqual( imgNew.dataWindow, dataWindow )
+		self.__verifyImageRGB( imgNew, imgOrig )
+
+	def testThreads( self ) :
+
+		w = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 199, 299 ) )
+		imgOrig = self.__makeFloatImage( w, w )
+
+		results = []
+		for threads in ( 1, 3, 0 ) :
+
+			self.setUp()
+
+			w = IECore.Writer.create( imgOrig, "test/IECoreImage/data/tiff/output.tif" )
+			w["threads"].setTypedValue( threads )
+			w.write()
+
+			results.append( IECore.Reader.create( "test/IECoreImage/data/tiff/output.tif" ).read() )
+			self.__verifyImageRGB( results[-1], imgOrig, maxError = 0.004 )
+
+		self.assertEqual( results[0], results[1] )
+		self.assertEqual( results[0], results[2] )
+
+	def testDataWindowWithoutDisplayWindowSupport( self ) :
+
+		displayWindow = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 99 ) )
+		dataWindow = IECore.Box2i( IECore.V2i( 20, 30 ), IECore.V2i( 59, 119 ) )
+		imgOrig = self.__makeFloatImage( dataWindow, displayWindow )
+
+		# dpx doesn't support data windows, so pixels outside
+		# the data window must be written as black.
+		w = IECore.Writer.create( imgOrig, "test/IECoreImage/data/dpx/output.dpx" )
+		w["rawChannels"].setTypedValue( True )
+		w.write()
+
+		r = IECore.Reader.create( "test/IECoreImage/data/dpx/output.dpx" )
+		r["rawChannels"].setTypedValue( True )
+		imgNew = r.read()
+		self.assertEqual( imgNew.dataWindow, displayWindow )
+		for c in ( "R", "G", "B" ) :
+			self.assertEqual( imgNew[c][0], 0 )
+			self.assertEqual( imgNew[c][29 * 100 + 40], 0 )
+			self.assertEqual( imgNew[c][99 * 100 + 60], 0 )
+
+		self.assertTrue( imgNew["R"][30 * 100 + 59] > 0 )
+
+	@unittest.skipIf( IECore.isDebug(), "Skip performance testing in debug builds" )
+	def testPerformance( self ) :
+
+		# Build each channel from a single repeated scanline, rather than
+		# from a full resolution list, so that generating the image is cheap.
+		window = IECore.Box2i( IECore.V2i( 0 ), IECore.V2i( 4095, 2047 ) )
+		image = IECoreImage.ImagePrimitive( window, window )
+		row = IECore.FloatVectorData( [ float( x % 1000 ) / 1000 for x in range( 4096 ) ] )
+		data = IECore.FloatVectorData()
+		for y in range( 2048 ) :
+			data.extend( row )
+		names = [ "R", "G", "B", "A" ] + [ "layer%d.%s" % ( i, c ) for i in range( 4 ) for c in "RGB" ]
+		for name in names :
+			image[name] = data
+
+		# The scanline write is the baseline for the tiled one. Timings are
+		# left to the profiler running the test, and we only check that both
+		# files hold the same image.
+		w = IECore.Writer.create( image, "test/IECoreImage/data/exr/output.exr" )
+		channels = []
+		for tileSize in ( 0, 64 ) :
+
+			w["formatSettings"]["openexr"]["tileSize"].setTypedValue( tileSize )
+			w.write()
+
+			r = IECoreImage.ImageReader( "test/IECoreImage/data/exr/output.exr" )
+			self.assertEqual( r.dataWindow(), window )
+			channels.append( r.readChannels( names ) )
+
+		self.assertEqual( channels[0], channels[1] )
+
 	def setUp( self ) :
 
 		for f in (